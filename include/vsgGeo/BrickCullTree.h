@@ -0,0 +1,82 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+#include <vsgGeo/Vec2i.h>
+
+#include <vector>
+
+
+namespace vsgGeo
+{
+
+/*!Bounding volume hierarchy over the bricks of a tiled node, used to
+   reject off-screen bricks hierarchically during culling. Bricks are
+   grouped by their position in the brick grid: a quadtree for the bricks
+   of a plane, degenerating to an interval tree if the grid is one brick
+   high, like along a panel strip path. */
+
+class VSGGEO_EXPORT BrickCullTree : public osg::Referenced
+{
+public:
+			BrickCullTree();
+
+    void		clear();
+    void		addBrick(const osg::BoundingBox&,const Vec2i& gridPos);
+			//!<Brick index is the order of adding
+    void		build();
+			//!<Call after adding all bricks
+
+    int			nrBricks() const	{ return _brickBounds.size(); }
+    const osg::BoundingBox& getBrickBound(int brickIdx) const;
+    void		setBrickBound(int brickIdx,const osg::BoundingBox&);
+    void		refit();
+			//!<Updates the tree after moving bricks
+
+    void		getVisibleBricks(osgUtil::CullVisitor&,
+					 std::vector<int>& brickIdxs,
+					 bool cullBricks=true) const;
+			/*!<Returned in order of adding. All bricks if not
+			    cullBricks, e.g. while a shader displaces their
+			    vertices beyond the brick bounds. */
+
+protected:
+			~BrickCullTree();
+
+    struct TreeNode
+    {
+	osg::BoundingBox	_bb;
+	std::vector<int>	_children;	// Empty for leaf
+	int			_brickIdx;	// Only for leaf
+    };
+
+    int			buildNode(std::vector<int>& brickIdxs,
+				  const Vec2i& gridMin,const Vec2i& gridMax);
+    void		refitNode(int nodeIdx);
+    void		collectVisible(int nodeIdx,osgUtil::CullVisitor&,
+				       std::vector<int>& brickIdxs) const;
+
+    std::vector<osg::BoundingBox>	_brickBounds;
+    std::vector<Vec2i>			_gridPositions;
+    std::vector<TreeNode>		_nodes;		// Root first
+};
+
+
+} // namespace vsgGeo
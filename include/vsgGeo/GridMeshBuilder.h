@@ -0,0 +1,87 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+#include <vsgGeo/Vec2i.h>
+
+#include <vector>
+
+
+namespace vsgGeo
+{
+
+/*!Triangle strip indices of a regular grid of vertices, ordered for the
+   post-transform vertex cache. The quads are split in square blocks that
+   are visited along a Z-order curve. Within a block, every quad row is a
+   strip that is short enough to find the vertices it shares with the row
+   below still in the cache, after degenerate triangles have loaded the
+   block's first vertex row. Strips are separated by the primitive restart
+   index, so all of them go in one draw call.
+
+   Vertices are indexed row-major from 0. Quads are split along their
+   diagonal from vertex (i,j) to (i+1,j+1), into triangles that are
+   counter-clockwise with rows going up. */
+
+class VSGGEO_EXPORT GridMeshBuilder
+{
+public:
+			GridMeshBuilder(int nrCols,int nrRows);
+			//!<Vertices per grid row and column
+
+    void		setVertexCacheSize(int nrVertices);
+			/*!<Sizes the blocks to a post-transform cache of
+			    this many vertices (default 16). */
+    int			getBlockSize() const	{ return _blockSize; }
+			//!<In quads per side
+
+    void		setDefinedMask(const unsigned char* mask);
+			/*!<One flag per vertex, not copied. Triangles with an
+			    undefined vertex are left out. Null (default) if
+			    all are defined. */
+
+    int			nrBlocks() const	{ return _blockOrder.size(); }
+    void		getBlockQuads(int blockIdx,Vec2i& first,
+				      Vec2i& last) const;
+			//!<Quad (col,row) range of the block, inclusive
+
+    void		addStrips(osg::DrawElements&) const;
+			//!<All blocks in Z-order
+    void		addBlockStrips(int blockIdx,osg::DrawElements&) const;
+			/*!<Every strip, or lone triangle next to undefined
+			    vertices, is ended by the restart index, so that
+			    blocks can be concatenated in any order. */
+
+    static unsigned int	getRestartIndex(osg::PrimitiveSet::Type);
+			//!<Largest value of the DrawElements index type
+    static void		enablePrimitiveRestart(osg::StateSet&,
+					       osg::PrimitiveSet::Type);
+
+protected:
+    void		updateBlockOrder();
+
+    int			_nrCols;
+    int			_nrRows;
+    int			_blockSize;
+    const unsigned char* _defined;
+    std::vector<Vec2i>	_blockOrder;	// Block (col,row) in Z-order
+};
+
+
+} // namespace vsgGeo
@@ -18,41 +18,367 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 */
 
-#include <osg/Node>
-#include <vsgGeo/Common>
-#include <osg/Geode>
-#include <osg/Vec3>
+#include <vsgGeo/Common.h>
+#include <vsgGeo/HeightTileSource.h>
+#include <vsgGeo/Palette.h>
+#include <vsgGeo/ThreadGroup.h>
+#include <vsgGeo/Vec2i.h>
+
+#include <vector>
 
 
 namespace vsgGeo
 {
 
+/*!Horizon surface on a regular grid of heights, drawn as a quadtree of
+   fixed-size chunks with a chunked level-of-detail scheme. Every chunk
+   has the same number of quads; the parent of four chunks covers their
+   area with every other grid node. Culling selects per view the coarsest
+   chunks whose geometric error projects below the maximum screen error.
+   Skirts hide the cracks between chunks of different levels. Triangles
+   with an undefined vertex are left out of the chunk index buffers, which
+   hold vertex-cache ordered strips from GridMeshBuilder. Chunk
+   geometries are built on demand during the update traversal, and
+   released again after being out of use for a while. Grids too large for
+   memory can be streamed from a HeightTileSource instead.
+
+   The horizon3d_*.glsl shaders are read through ShaderUtility, so its
+   root path must point to their directory. */
 
-class OSGGEO_EXPORT HeightField : public osg::Geode
+class VSGGEO_EXPORT HeightField : public osg::Node
 {
+    class ChunkThread;
+    class NormalMapThread;
+    class DecimationThread;
+    class PyramidThread;
+    class PickThread;
+    class ContourThread;
+    class TileFetchThread;
+    class TileQueue;
+    struct ContourTile;
+    struct Chunk;
+    struct DecimationChunk;
+    struct TileRequest;
+
 public:
 				HeightField();
-                                HeightField(const HeightField&,
-	const osg::CopyOp& op = osg::CopyOp::DEEP_COPY_ALL);
+				HeightField(const HeightField&,
+				    const osg::CopyOp& op =
+					osg::CopyOp::DEEP_COPY_ALL);
+				META_Node(vsgGeo,HeightField);
+
+    void			setHeightData(osg::FloatArray* heights,
+					      int nrRows,int nrCols);
+				/*!<Row-major grid of nrRows x nrCols nodes.
+				    Nodes at the undef value are not drawn. */
+    const osg::FloatArray*	getHeightData() const;
+
+    void			setQuantizedHeightData(osg::UShortArray*,
+					int nrRows,int nrCols,
+					float offset,float scale);
+				/*!<Compact alternative to setHeightData(.), at
+				    half its memory. Node height is offset +
+				    scale * value, and quantizedUndefValue()
+				    marks undefined nodes. May be edited in place
+				    as well. */
+    const osg::UShortArray*	getQuantizedHeightData() const;
+    static unsigned short	quantizedUndefValue()	{ return 0xffff; }
+    static bool			quantizeHeights(const osg::FloatArray&,
+					float undefValue,osg::UShortArray&,
+					float& offset,float& scale);
+				/*!<Maps the range of the defined heights onto
+				    all other values. Returns false if no height
+				    is defined. */
+
+    void			setHeightSource(HeightTileSource*);
+				/*!<Streams the grid from the source in chunk
+				    tiles instead of keeping it in memory. Only
+				    the coarsest levels are loaded up front;
+				    finer tiles are fetched in the background
+				    as views refine, and around the camera.
+				    Picking, contours, the normal map and the
+				    decimated mesh need in-memory height data,
+				    and dirtyHeightData(.) is ignored. */
+    const HeightTileSource*	getHeightSource() const { return _source.get(); }
+
+    void			setResidentBudget(unsigned int megaBytes);
+				/*!<Streamed tiles below the coarse levels are
+				    evicted least recently used first when
+				    above budget (default 256). */
+    unsigned int		getResidentBudget() const
+				{ return _residentBudget; }
+
+    int				nrRows() const		{ return _nrRows; }
+    int				nrCols() const		{ return _nrCols; }
+
+    void			dirtyHeightData(const Vec2i& start=Vec2i(0,0),
+						const Vec2i& stop=Vec2i(-1,-1));
+				/*!<Call after editing heights in place. Only
+				    chunks touching the rectangle of nodes
+				    (col,row), stop inclusive, are updated.
+				    Negative stop means up to the last node. */
 
-    void			setHeightData(osg::Vec2Array*);
-    const osg::Vec2Array*	setHeightData();
+    void			setGridGeometry(const osg::Vec2& origin,
+						const osg::Vec2& nodeStep);
+				/*!<World x-y of node (0,0) and the distance
+				    between neighbouring columns and rows. */
+    const osg::Vec2&		getGridOrigin() const	{ return _origin; }
+    const osg::Vec2&		getNodeStep() const	{ return _nodeStep; }
 
     void			setUndefValue(float);
-    float			getUndefValue() const;
+    float			getUndefValue() const	{ return _undefValue; }
+
+    enum HeightFormat		{ FloatHeights, HalfFloatHeights,
+				  QuantizedHeights };
+    void			setHeightFormat(HeightFormat);
+				/*!<Storage of the chunk heights for drawing,
+				    as 32-bit floats, or as half floats or 16-bit
+				    integers relative to the chunk's height
+				    range (default). */
+    HeightFormat		getHeightFormat() const { return _heightFormat; }
+
+    void			setChunkSize(int nrQuads);
+				//!<Power of two in [8,128], default 64
+    int				getChunkSize() const	{ return _chunkSize; }
+
+    void			setMaxScreenError(float pixels);
+				/*!<Chunks are refined until their geometric
+				    error projects below this (default 2). */
+    float			getMaxScreenError() const { return _maxScreenError; }
+
+    void			setDecimationTolerance(float);
+				/*!<Chunks are triangulated adaptively, with
+				    at most this vertical deviation from their
+				    regular grid (default 0: regular grid). */
+    float			getDecimationTolerance() const
+				{ return _decimationTolerance; }
+
+    bool			createDecimatedMesh(float tolerance,
+					osg::Vec3Array& vertices,
+					osg::DrawElementsUInt& triangles) const;
+				/*!<Adaptive triangulation of the full grid in
+				    world coordinates, e.g. for export, within
+				    the vertical tolerance and without cracks.
+				    Triangles with undefined nodes are left
+				    out. Chunks are decimated in parallel. */
+
+    bool			intersectRay(const osg::Vec3& start,
+					     const osg::Vec3& end,float& ratio,
+					     osg::Vec3* normal=0) const;
+				/*!<First hit of the line segment with the
+				    drawn triangles, at start+ratio*(end-start),
+				    in local coordinates. Descends a min/max
+				    height pyramid, skipping blocks that are
+				    empty or out of the segment's range. Line
+				    segment intersection visitors use this. */
+    void			intersectRays(const osg::Vec3Array& starts,
+					      const osg::Vec3Array& ends,
+					      std::vector<float>& ratios) const;
+				//!<In parallel, ratio is -1 where nothing is hit
+
+    void			createContours(const std::vector<float>& levels,
+					osg::Vec3Array& vertices,
+					std::vector<osg::ref_ptr<osg::PrimitiveSet> >&
+					    polyLines,
+					std::vector<int>* levelIdxs=0) const;
+				/*!<Contour lines at all levels, as LINE_STRIP
+				    primitive sets on the vertex array, ready
+				    for PolyLineNode. Closed contours repeat
+				    their first vertex. Lines end at undefined
+				    nodes. Marching squares run in parallel
+				    over tiles of chunk size; only tiles
+				    edited since the last call with the same
+				    levels are redone. */
+
+    void			setPalette(const Palette&);
+    const Palette&		getPalette() const	{ return _palette; }
 
+    bool			getHeightRange(float& min,float& max) const;
+				//!<Returns false if no node is defined
+
+    bool			computeNormalMap(osg::Image&,
+					const Vec2i& start=Vec2i(0,0),
+					const Vec2i& stop=Vec2i(-1,-1)) const;
+				/*!<Packs the normal of every grid node as
+				    GL_RGB/GL_UNSIGNED_BYTE (n+1)/2, from
+				    central differences of the heights over
+				    the node spacing. One-sided at holes and
+				    borders, upward at undefined nodes. Only
+				    the rectangle of nodes is updated, unless
+				    the image must be (re)allocated at grid
+				    size. Rows are computed in parallel. */
+    const osg::Image*		getNormalMap() const	{ return _normalMap.get(); }
+
+    void			traverse(osg::NodeVisitor&) override;
+    osg::BoundingSphere		computeBound() const override;
+
+    void			forceRedraw(bool=true);
 
 protected:
-				~HeightField();
-    virtual osg::BoundingSphere	computeBound() const;
+    virtual			~HeightField();
+
+    bool			hasHeightData() const;
+				//!<In memory, as floats or quantized
+    bool			isDefined(float height) const;
+    float			getHeight(int col,int row) const;
+				//!<Clamped to grid
+    float			getNodeHeight(int nodeIdx) const;
+				//!<Undef value if undefined
+    const float*		getHeightRow(int row,int firstCol,int lastCol,
+					     float* buffer) const;
+				/*!<Heights from firstCol on. Quantized rows are
+				    decoded into buffer, which must hold all of
+				    them. */
+    int				nrLevels() const;
+    int				getChunkIdx(int level,int cx,int cy) const;
+    int				getChunkSpan(int level) const;
+				//!<In grid nodes
+    int				getParentIdx(const Chunk&) const;
+				//!<-1 for the root chunk
+
+    void			buildQuadTree();
+    void			updateQuadTree(const Vec2i& start,
+					       const Vec2i& stop);
+				//!<Chunks touching the nodes in between
+    void			updateChunk(int chunkIdx);
+				//!<Height range and error, children first
+    void			buildChunkGeometry(int chunkIdx);
+    void			loadCoarseLevels();
+    void			fetchTile(int chunkIdx,
+					  OpenThreads::BlockCount* ready);
+    void			applyTile(TileRequest&);
+				/*!<Refines the error and bounds of the chunk
+				    and its ancestors, estimates its children */
+    void			applyFetchedTiles();
+    void			evictTiles(unsigned int frameNr);
+				//!<Least recently used first, down to budget
+    void			updateSkirtDepth(Chunk&);
+    void			setChunkBound(Chunk&,float zMin,
+					      float zMax) const;
+    void			computeNormalRow(int row,int startCol,
+						 int stopCol,unsigned char* rgb,
+						 std::vector<float>& buffer) const;
+    void			updateNormalMap(const Vec2i& start,
+						const Vec2i& stop);
+    void			updateChunkIndices(Chunk&,
+					const std::vector<unsigned char>& defined,
+					bool allDefined);
+				/*!<Triangles of fully defined vertices only.
+				    Mesh blocks of unchanged definedness are
+				    reused. */
+    void			releaseChunkGeometry(Chunk&);
+    osg::Array*			createHeightArray(const std::vector<float>&,
+						  float& offset,
+						  float& scale,
+						  float& undef) const;
+				/*!<Height is offset + scale * array value.
+				    Undefined heights read as undef, or NaN. */
+    void			updatePickPyramid(const Vec2i& start,
+						  const Vec2i& stop);
+    void			updatePickBlock(int bx,int by);
+    bool			intersectBlock(int level,int bx,int by,
+					       const osg::Vec3& start,
+					       const osg::Vec3& dir,float& ratio,
+					       Vec2i& cell,
+					       bool& upperTriangle) const;
+    bool			intersectCells(int bx,int by,
+					       const osg::Vec3& start,
+					       const osg::Vec3& dir,float& ratio,
+					       Vec2i& cell,
+					       bool& upperTriangle) const;
+				//!<In grid space, ratio shrinks to nearest hit
+    void			dirtyContours(const Vec2i& start=Vec2i(0,0),
+					      const Vec2i& stop=Vec2i(-1,-1));
+    void			contourTile(int tileIdx,
+					    const std::vector<float>& levels) const;
+    void			decimateChunk(DecimationChunk&,int task,
+					      float tolerance) const;
+    void			runDecimationTasks(
+					std::vector<DecimationChunk>&,
+					int task,float tolerance) const;
+    void			runChunkTasks(const std::vector<int>& chunkIdxs,
+					      int task);
+    void			updateSharedGeometry();
+    void			updateStateSet();
+    void			updateChunks(unsigned int frameNr);
+				//!<Builds requested geometries, releases unused
+
+    void			selectChunks(int chunkIdx,osgUtil::CullVisitor&,
+					     std::vector<int>& drawIdxs,
+					     unsigned int frameNr);
+    float			getScreenError(const Chunk&,
+					       osgUtil::CullVisitor&) const;
+    void			requestChunk(int chunkIdx);
+    void			prefetchChunk(int chunkIdx);
+
+    void			setUpdateVar(bool& var,bool yn);
+				//! Will trigger redraw request if necessary
+
+    osg::ref_ptr<osg::FloatArray>	_heights;
+    osg::ref_ptr<osg::UShortArray>	_quantizedHeights;
+    float				_quantizedOffset;
+    float				_quantizedScale;
+    int					_nrRows;
+    int					_nrCols;
+    osg::Vec2				_origin;
+    osg::Vec2				_nodeStep;
+    float				_undefValue;
+    int					_chunkSize;
+    float				_maxScreenError;
+    float				_decimationTolerance;
+    HeightFormat			_heightFormat;
+    Palette				_palette;
+
+    osg::ref_ptr<HeightTileSource>	_source;
+    osg::ref_ptr<TileQueue>		_tileQueue;	// One per quadtree
+    int					_firstResidentLevel;
+    unsigned int			_residentBudget;	// MB
+    size_t				_residentBytes;
 
+    std::vector<Chunk>			_chunks;	// Level-major
+    std::vector<int>			_levelOffsets;	// First chunk idx
+    std::vector<Vec2i>			_levelSizes;	// Chunks per dim
+    Vec2i				_dirtyStart;
+    Vec2i				_dirtyStop;
 
-    osg::ref_ptr<osg::Vec2Array>	_heightfield;
+    osg::ref_ptr<osg::Vec3Array>	_sharedVertices; // Grid pos, skirt
+    osg::ref_ptr<osg::DrawElementsUShort> _sharedIndices;	// Strips
+    std::vector<int>			_sharedBlockStarts;
 
-    osg::ref_ptr<osg::Geometry>		_geometry;
-    osg::ref_ptr<osg::Vec3Array>	_coordinates;
-    osg::ref_ptr<osg::Shader>		_vertexshader;
-    osg::ref_ptr<osg::Image>		_heighttexture;
+    osg::ref_ptr<osg::Image>		_normalMap;
+    osg::ref_ptr<osg::Texture2D>	_normalTexture;
+    osg::ref_ptr<osg::Texture1D>	_paletteTexture;
+
+    std::vector<std::vector<osg::Vec2> > _pickPyramid;	// Min, max
+    std::vector<Vec2i>			_pickPyramidSizes; // Blocks per dim
+
+    mutable std::vector<ContourTile>	_contourTiles;
+    mutable std::vector<float>		_contourLevels;	// Sorted
+    mutable OpenThreads::Mutex		_contourLock;
+
+    osg::BoundingBox			_bbox;
+    osg::ref_ptr<osg::StateSet>		_stateset;	// Horizon shaders
+
+    bool				_needsUpdate;	// Only set via setUpdateVar(.)
+    bool				_needsStateSetUpdate;	// Idem
+    bool				_needsPaletteUpdate;
+
+    OpenThreads::Mutex			_requestLock;
+    std::vector<int>			_requestedChunks;
+    std::vector<int>			_prefetchChunks;
+
+    OpenThreads::Mutex			_redrawLock;
+    bool				_isRedrawing;
+
+    osg::ref_ptr<ThreadGroup<ChunkThread> > _chunkThreads;
+    mutable osg::ref_ptr<ThreadGroup<NormalMapThread> > _normalMapThreads;
+    mutable osg::ref_ptr<ThreadGroup<DecimationThread> > _decimationThreads;
+    osg::ref_ptr<ThreadGroup<PyramidThread> > _pyramidThreads;
+    mutable osg::ref_ptr<ThreadGroup<PickThread> > _pickThreads;
+    mutable osg::ref_ptr<ThreadGroup<ContourThread> > _contourThreads;
+    osg::ref_ptr<ThreadGroup<TileFetchThread> > _fetchThreads;
+    std::vector<osg::ref_ptr<TileFetchThread> > _fetchTasks; // Not yet idle
 };
 
-} // namespace
+
+} // namespace vsgGeo
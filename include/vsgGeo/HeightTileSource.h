@@ -0,0 +1,80 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+#include <vsgGeo/Vec2i.h>
+
+#include <string>
+#include <vector>
+
+
+namespace vsgGeo
+{
+
+/*!Read-only grid of heights that HeightField streams in tiles, for grids
+   too large to keep in memory. Tiles are read from the fetch threads, so
+   readTile(.) must be safe to call concurrently. */
+
+class VSGGEO_EXPORT HeightTileSource : public osg::Referenced
+{
+public:
+    virtual int		nrRows() const				= 0;
+    virtual int		nrCols() const				= 0;
+
+    virtual bool	readTile(const Vec2i& firstNode,int step,
+				 const Vec2i& size,
+				 std::vector<float>& heights) const	= 0;
+			/*!<size.x() by size.y() heights row-major, of every
+			    step-th node from firstNode (col,row). Nodes
+			    outside the grid are clamped to its border. */
+
+protected:
+    virtual		~HeightTileSource()			{}
+};
+
+
+/*!Heights stored as a row-major grid of native float32 values in a file,
+   after an optional header. Every tile read opens its own stream. */
+
+class VSGGEO_EXPORT RawHeightFileSource : public HeightTileSource
+{
+public:
+			RawHeightFileSource(const std::string& fileName,
+					    int nrRows,int nrCols,
+					    unsigned int headerBytes=0);
+
+    int			nrRows() const override		{ return _nrRows; }
+    int			nrCols() const override		{ return _nrCols; }
+
+    bool		readTile(const Vec2i& firstNode,int step,
+				 const Vec2i& size,
+				 std::vector<float>& heights) const override;
+			/*!<Reads contiguous row segments at fine steps, and
+			    seeks to single nodes at coarse steps. */
+
+protected:
+    std::string		_fileName;
+    int			_nrRows;
+    int			_nrCols;
+    unsigned int	_headerBytes;
+};
+
+
+} // namespace vsgGeo
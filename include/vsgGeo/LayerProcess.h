@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <vsgGeo/Callback.h>
 
 #include <string>
+#include <vector>
 
 
 namespace vsgGeo
@@ -66,6 +67,21 @@ protected:
 class LayeredTexture;
 
 
+/*!Screen-space derivatives of a global texture coordinate. Passed to the CPU
+   evaluation of layer processes to emulate mipmapped texture lookups. */
+
+struct TexelFootprint
+{
+			TexelFootprint(const osg::Vec2f& dx,
+				       const osg::Vec2f& dy)
+			    : _dx( dx ), _dy( dy )
+			{}
+
+    osg::Vec2f		_dx;
+    osg::Vec2f		_dy;
+};
+
+
 class VSGGEO_EXPORT LayerProcess : public osg::Referenced
 {
 public:
@@ -76,7 +92,8 @@ public:
     virtual TransparencyType	getTransparencyType(
 					bool imageOnly=false) const	= 0;
     virtual void		doProcess(osg::Vec4f& fragColor,float stackUdf,
-					  const osg::Vec2f& globalCoord)= 0;
+					  const osg::Vec2f& globalCoord,
+					  const TexelFootprint* =0)	= 0;
 
     virtual bool		isOn(int=0) const	      { return true; }
 
@@ -87,6 +104,18 @@ public:
     virtual int			getColorSequenceUndefIdx() const { return -1; }
     void			setColorSequenceTextureSampling(float start,
 								float step);
+
+    void			updateColorScaleSpace();
+				/*! Enables the mipmapped color sequence lookup
+				    of the shader in doProcess(.) if a footprint
+				    is passed. Only call with the texture write
+				    locked, see LayeredTexture::
+				    updateColorScaleSpaces(). */
+    static int			nrColorScales()			{ return 10; }
+    static void			createColorScaleSpace(unsigned char* rows,
+						      int udfIdx);
+				/*! First of nrColorScales() rows of 256 RGBA
+				    values holds color sequence at input. */
     void			setOpacity(float opacity);
     float			getOpacity() const;
 
@@ -105,6 +134,10 @@ protected:
     float			_colSeqTexSamplingStep;
     osg::Vec4f			_newUndefColor;
     float			_opacity;
+    std::vector<unsigned char>	_colorScaleSpace;
+
+    osg::Vec4f			getColorScaleSpaceColor(float colIdx,
+							float scale) const;
 
     void			getHeaderCode(std::string& code,
 					      int& nrUdf,int id,
@@ -115,7 +148,8 @@ protected:
     void			processHeader(osg::Vec4f& col,float& udf,
 					float stackUdf,const osg::Vec2f& coord,
 					int id,int toIdx=-1,int fromIdx=0,
-					float* orgCol3=0) const;
+					float* orgCol3=0,
+					const TexelFootprint* =0) const;
     void			processFooter(osg::Vec4f& fragColor,
 					      osg::Vec4f col,float udf) const;
 
@@ -159,7 +193,8 @@ public:
     TransparencyType		getTransparencyType(bool imageOnly=false)
 								const override;
     void			doProcess(osg::Vec4f& fragColor,float stackUdf,
-					  const osg::Vec2f& globalCoord) override;
+					  const osg::Vec2f& globalCoord,
+					  const TexelFootprint* =0) override;
 protected:
     int				_id[3];
     int				_textureChannel[3];
@@ -196,7 +231,8 @@ public:
     TransparencyType		getTransparencyType(bool imageOnly=false)
 								const override;
     void			doProcess(osg::Vec4f& fragColor,float stackUdf,
-				      const osg::Vec2f& globalCoord) override;
+				      const osg::Vec2f& globalCoord,
+				      const TexelFootprint* =0) override;
 protected:
     int			_id[4];
     int				_textureChannel[4];
@@ -218,7 +254,8 @@ public:
     TransparencyType		getTransparencyType(bool imageOnly=false)
 								const override;
     void			doProcess(osg::Vec4f& fragColor,float stackUdf,
-				      const osg::Vec2f& globalCoord) override;
+				      const osg::Vec2f& globalCoord,
+				      const TexelFootprint* =0) override;
 protected:
     int				_id;
 };
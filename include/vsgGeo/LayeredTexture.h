@@ -30,6 +30,7 @@ namespace vsgGeo
 {
 
 enum FilterType		{ Nearest, Linear };
+enum RescaleFilter	{ Box, Bilinear, Lanczos };
 enum ImageDataOrder	{ STR, SRT, TRS, TSR, RST, RTS };
 
 
@@ -37,8 +38,12 @@ struct LayeredTextureData;
 struct TilingInfo;
 struct TextureInfo;
 
+class CompositeBorderThread;
 class CompositeTextureThread;
 class PowerEncodingThread;
+class ResampleThread;
+class VirtualTextureAtlas;
+class VolumeTextureCache;
 
 
 class VSGGEO_EXPORT LayeredTexture : public vsgGeo::CallbackObject
@@ -113,11 +118,19 @@ public:
     int			getTextureUnitLayerId(int unit) const;
     int			getTextureUnitNrDims(int unit) const;
     void		addAssignTexCrdLine(std::string& code,int unit) const;
+    void		addTextureLookup(std::string& code,int unit) const;
+			/*!Adds shader expression sampling texture unit at
+			   texcrd, via the page table if its layer is paged. */
 
     TransparencyType	getDataLayerTransparencyType(int id,
 						     int channel=3) const;
     osg::Vec4f		getDataLayerTextureVec(int id,
-					const osg::Vec2f& globalCoord) const;
+					const osg::Vec2f& globalCoord,
+					const TexelFootprint* =0) const;
+			/*!Emulates mipmapping by averaging over the footprint
+			   if mipmapping is enabled and a footprint is passed */
+    float		getDataLayerMipLevel(int id,
+					     const TexelFootprint&) const;
 
     void		setDataLayerUndefLayerID(int id,int undef_id);
     int			getDataLayerUndefLayerID(int id) const;
@@ -139,6 +152,9 @@ public:
 
     void		transformDataLayerCoord(osg::Vec2f& local,
 						int fromId, int toId);
+    osg::Vec2f		getDataLayerCoord(int id,
+					  const osg::Vec2f& globalCoord) const;
+			//!Image coordinate in pixel units
 
     void		setDataLayerVertex2TextureTransform(int id,
 							const osg::Matrixf*);
@@ -159,6 +175,15 @@ public:
     void		useNormalizedTexCoords(bool);
 			/* Enables repeated use of one single tile geometry at
 			   the cost of a few extra computations in the shader */
+    void		useSharedBrickGeometry(bool);
+			/* Normalizes the texture coordinates of every cutout
+			   to the unit square, and places the vertices of one
+			   shared unit-square brick geometry by the mat4
+			   uniform "brickvertextrans" of each cutout stateset.
+			   Only effective if shaders are used. Supported by
+			   TexturePlaneNode. TexturePanelStripNode keeps its
+			   panel geometries by an identity transform. */
+    bool		isSharedBrickGeometryUsed() const;
 
     void		setVertexOffsetLayerID(int id);
     int			getVertexOffsetLayerID() const;
@@ -168,6 +193,9 @@ public:
     float		getVertexOffsetFactor() const;
     void		setVertexOffsetBias(float);
     float		getVertexOffsetBias() const;
+    bool		isVertexOffsetUsed() const;
+			/* The shader may move vertices along their normal,
+			   beyond the bounds of the flat geometry. */
     void		setVertexOffsetTexelSpanVectors(const osg::Vec3f& v0,
 							const osg::Vec3f& v1);
     const osg::Vec3f&	getVertexOffsetTexelSpanVector(int dim) const;
@@ -237,6 +265,8 @@ public:
 
     osg::Vec2f		tilingPlanResolution() const;
 			//!Reciprocal of the scale of highest-resolution layer
+    osg::Vec2f		getGlobalCoord(const osg::Vec2f& tilingCoord) const;
+			//!Maps tick mark coordinates of planTiling(.)
 
     osg::StateSet*	createCutoutStateSet(const osg::Vec2f& origin,
 			    const osg::Vec2f& opposite,
@@ -244,11 +274,37 @@ public:
 			    const VertexOffsetCutoutInfo* info=0) const;
 			/*!If needsRetiling() is true, call reInitTiling(.)
 			   first, followed by the optional planTiling(.),
-			   and next (re)create your CutoutStateSets. */
+			   and next (re)create your CutoutStateSets. These
+			   may be created concurrently from multiple threads. */
 
     osg::StateSet*	getSetupStateSet();
     void		updateSetupStateSet();
 
+    void		setVirtualTextureAtlas(VirtualTextureAtlas*);
+			/*!Enables virtual texturing if atlas is set. Data
+			   layers with 2D GL_UNSIGNED_BYTE images are then
+			   paged into the (shareable) atlas instead of being
+			   cut into tile textures, which keeps GPU memory
+			   bounded by the page budget. Requires shaders and
+			   one extra texture unit. Paged layers are sampled
+			   at full resolution without mipmapping. */
+    VirtualTextureAtlas* getVirtualTextureAtlas()  { return _vtAtlas.get(); }
+    bool		isVirtualTexturingEnabled() const;
+
+    void		setVolumeTextureCache(VolumeTextureCache*);
+			/*!3D data layers (with vertex-to-texture transform)
+			   then bind the (shareable) cached texture of their
+			   volume image, instead of creating their own. */
+    VolumeTextureCache*	getVolumeTextureCache()	{ return _volCache.get(); }
+
+    bool /*resident*/	requestVirtualPages(const osg::Vec2f& origin,
+					    const osg::Vec2f& opposite) const;
+			/*!Feedback of a visible cutout, specified like in
+			   createCutoutStateSet(.). Returns false if pages
+			   still need to be loaded, so redraw is requested. */
+    void		updateVirtualPages();
+			//!<Loads requested pages. Call from update traversal.
+
     void		setAnisotropicPower(int power);
 			/*!Default power=-1 will disable anisotropic filtering.
 			   If supported by hardware, power=0 already corrects
@@ -290,6 +346,31 @@ public:
 			   size policies. Therefore, a power-of-2 scaled copy
 			   is created for small non-power-of-2 textures. */
 
+    void		setRescaleFilter(RescaleFilter);
+			/*!Filter used to create the power-of-2 scaled copies.
+			   Images of type GL_UNSIGNED_BYTE, GL_SHORT,
+			   GL_UNSIGNED_SHORT and GL_FLOAT are resampled
+			   multi-threaded. Default is Bilinear. */
+    RescaleFilter	getRescaleFilter() const;
+
+    struct MemoryUsage
+    {
+			MemoryUsage()
+			    : _sourceBytes( 0 ), _copyBytes( 0 )
+			    , _sharedCopyBytes( 0 )
+			{}
+
+	unsigned long long	_sourceBytes;	  //!<Caller-owned layer images
+	unsigned long long	_copyBytes;	  //!<Private rescaled copies
+	unsigned long long	_sharedCopyBytes; //!<Copies shared with clones
+    };
+
+    void		getMemoryUsage(MemoryUsage&) const;
+			/*!Cloning with DEEP_COPY_ALL shares the rescaled and
+			   composite image copies copy-on-write. A private copy
+			   is made once either side modifies its layer data.
+			   Caller-owned images are always shared. */
+
     void		setGraphicsContextID(int id=-1);
 			/*!Without a valid ID, the texture hardware info is
 			   automatically derived from all known contexts. */
@@ -303,6 +384,34 @@ public:
     int			nrTextureUnits() const;
 
     const osg::Image*	getCompositeTextureImage();
+
+    bool		getCompositeBorders(const osg::Vec2f& origin,
+					    const osg::Vec2f& opposite,
+					    Vec2i& border0,Vec2i& border1);
+			/*!Border sizes needed to extend the composite image
+			   from origin to opposite (composite pixel units). */
+    bool		writeCompositeTextureImage(unsigned char* buffer,
+					const Vec2i& border0,
+					const Vec2i& border1);
+			/*!Writes composite image, extended with borders of
+			   its border color, into caller-provided buffer of
+			   unpadded GL_RGBA/GL_UNSIGNED_BYTE rows. Each row is
+			   written in one pass of memcpy's, rows in parallel. */
+
+    void		getActiveProcesses(std::vector<LayerProcess*>&,
+					   float& minOpacity) const;
+			/*!Processes contributing to the CPU composite, top
+			   first. Call updateColorScaleSpaces() before using
+			   footprints in getFragmentColor(.). */
+    void		updateColorScaleSpaces();
+			/*!Does its own (write) locking, so it must be called
+			   before taking the read lock for processing. */
+    osg::Vec4f		getFragmentColor(const osg::Vec2f& globalCoord,
+				    const std::vector<LayerProcess*>& procs,
+				    float minOpacity,
+				    const TexelFootprint* =0) const;
+			/*!CPU equivalent of the fragment shader. Caller must
+			   hold a read lock, see readLock(). */
     int			compositeLayerId()	{ return _compositeLayerId; }
 
     void		setCompositeSubsampleSteps(int);
@@ -329,6 +438,27 @@ protected:
     void		add3DTextureToStateSet(const LayeredTextureData&,
 				std::vector<LayeredTexture::TextureCoordData>&,
 				osg::StateSet&) const;
+    void		add3DTextureUniforms(const LayeredTextureData&,
+					     osg::StateSet&) const;
+    void		addPagedLayerToStateSet(const LayeredTextureData&,
+				const osg::Vec2f& globalOrigin,
+				const osg::Vec2f& globalOpposite,
+				std::vector<LayeredTexture::TextureCoordData>&,
+				osg::StateSet&) const;
+    void		normalizeTexCrds(int unit,
+				osg::Vec2f& tc00,osg::Vec2f& tc11,
+				const osg::Vec2f& globalOrigin,
+				const osg::Vec2f& globalOpposite,
+				osg::StateSet&) const;
+
+    bool		isPagedLayer(const LayeredTextureData&) const;
+    bool		isPagedUnit(int unit) const;
+    bool		areTexCoordsNormalized() const;
+    int			nrUsableTextureUnits() const;
+    void		fillVirtualPage(const LayeredTextureData&,
+					const Vec2i& pageNr,
+					unsigned char* dest,int rowSize) const;
+    void		getVirtualSampleCode(std::string& code,int unit) const;
 
     int /* nrProc */	getProcessInfo(std::vector<int>& orderedLayerIDs,
 				       int& nrUsedLayers,bool& useShaders,
@@ -390,6 +520,7 @@ protected:
     mutable TextureInfo*		_texInfo;
 
     bool				_useNormalizedTexCoords;
+    bool				_useSharedBrickGeometry;
     int					_vertexOffsetLayerId;
     int					_vertexOffsetChannel;
     float				_vertexOffsetFactor;
@@ -414,7 +545,13 @@ protected:
     bool				_reInitTiling;
 
     osg::ref_ptr<ThreadGroup<CompositeTextureThread> > _compositeThreads;
+    osg::ref_ptr<ThreadGroup<CompositeBorderThread> > _compositeBorderThreads;
     osg::ref_ptr<ThreadGroup<PowerEncodingThread> > _powerEncodingThreads;
+    osg::ref_ptr<ThreadGroup<ResampleThread> >	_resampleThreads;
+    RescaleFilter			_rescaleFilter;
+
+    osg::ref_ptr<VirtualTextureAtlas>	_vtAtlas;
+    osg::ref_ptr<VolumeTextureCache>	_volCache;
 };
 
 
@@ -19,8 +19,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 
 
+#include <vsgGeo/Common.h>
+
 #include <vector>
-#include <osg/Vec3>
 
 namespace vsgGeo
 {
@@ -44,19 +45,39 @@ struct ColorPoint
 
 typedef std::vector<ColorPoint> ColorPointList;
 
-class Palette
+/*!Colours are looked up in a table baked from the color points, with
+   LUTSize entries evenly spread over the relative range [0,1]. */
+
+class VSGGEO_EXPORT Palette
 {
 public:
+  enum { LUTSize = 4096 };
+
   Palette(const ColorPointList &colorPoints);
   Palette();
 
   osg::Vec3 get(float value, float min, float max) const;
 
+  void get(const float *values, int nrValues, float min, float max,
+           osg::Vec3 *colors) const;
+  void get(const float *values, int nrValues, float min, float max,
+           osg::Vec4ub *colors) const;
+  //!< Batched versions of get(), alpha is set to 255
+
   const ColorPointList &colorPoints() const { return _colorPoints; }
   void setColorPoints(const ColorPointList &cps);
 
+  const std::vector<osg::Vec3> &getLUT() const { return _lut; }
+  osg::Image *createLUTImage() const;
+  //!< LUTSize x 1 GL_RGB image, to be sampled at texel centres
+
 private:
+  void bakeLUT();
+  void getLUTIndices(const float *values, int nrValues, float min, float max,
+                     int *lutIndices) const;
+
   ColorPointList _colorPoints;
+  std::vector<osg::Vec3> _lut;
 };
 
 } // namespace vsgGeo
@@ -21,7 +21,7 @@
 #include <string>
 #include <set>
 
-#include <vsgGeo/Common>
+#include <vsgGeo/Common.h>
 
 namespace osg { class Program; }
 
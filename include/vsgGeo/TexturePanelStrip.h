@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 namespace vsgGeo
 {
 
+class BrickCullTree;
 class LayeredTexture;
 class Vec2i;
 
@@ -35,6 +36,7 @@ class Vec2i;
 class VSGGEO_EXPORT TexturePanelStripNode : public osg::Node
 {
     class BoundingGeometry;
+    class DisplayBuffer;
     class TextureCallbackHandler;
 
 public:
@@ -55,6 +57,17 @@ public:
 				    lengthy geometry and/or texture changes. */
     bool			isDisplayFrozen() const	{ return _frozen; }
 
+    void			useDoubleBuffering(bool yn=true);
+				/*!<If used (not by default), updated geometries
+				    and statesets are built into a back buffer,
+				    while the current ones stay on display. The
+				    buffers are swapped as soon as the virtual
+				    texture pages of the visible new panels are
+				    resident. No effect without virtual
+				    texturing. */
+    bool			isDoubleBufferingUsed() const
+						{ return _useDoubleBuffering; }
+
     void			setTextureBrickSize(int sz,bool strict=false);
 				/*!<If not strict, the actual brick size is
 				    allowed to be chosen smaller to optimize
@@ -108,30 +121,83 @@ public:
     bool			areNormalsSmoothed() const
 						{ return _smoothNormals; }
 
+    void			setPathLODTolerance(float texels);
+				/*!<Enables distance-dependent level of detail
+				    if positive. Coarser levels simplify the
+				    path of every panel with a growing error
+				    bound, starting at the given number of
+				    texels. The level drawn is the coarsest one
+				    whose error stays within a pixel on screen.
+				    Texture mapping is exact at retained knots.
+				    Only the vertex count drops: every panel
+				    keeps its own texture brick stateset, so
+				    the number of panels and draw calls is the
+				    same at all levels.*/
+    float			getPathLODTolerance() const
+						{ return _pathLODTolerance; }
+    static void			simplifyPath(const osg::Vec2Array& path,
+					     float tolerance,
+					     std::vector<int>& retained);
+				/*!<Douglas-Peucker selection of the knots
+				    within tolerance of the path, always
+				    retaining its first and last knot. */
+
     osg::BoundingSphere		computeBound() const override;
 
     void			forceRedraw(bool=true);
 
     std::vector<osg::Geometry*>& getGeometries()	{ return _geometries; }
+				//!<Full resolution geometries only
+
+    bool			getLocalGeomsAtTexOffsets(
+					const osg::FloatArray& texOffsets,
+					osg::Vec2Array& pathCoords,
+					osg::Vec3Array& normals,
+					osg::FloatArray* arcLengths=0) const;
+				/*!<Batched lookup of the path position, normal
+				    and optional arc length where texture column
+				    offsets (units of setPath2TextureMapping(.))
+				    are displayed. Binary search per offset, so
+				    O(m log n) for m offsets on n knots. Sorted
+				    offsets are cheapest. Requires the node to
+				    have been updated (traversed). */
 
     const osg::Image*		getCompositeTextureImage(bool addBorder=true);
+    bool			getCompositeTextureImageSize(int& s,int& t,
+						    bool addBorder=true);
+    bool			writeCompositeTextureImage(
+					unsigned char* buffer,
+					bool addBorder=true);
+				/*!<Zero-copy variant of getCompositeTexture-
+				    Image(.), writing unpadded GL_RGBA/
+				    GL_UNSIGNED_BYTE rows into a caller-provided
+				    buffer of getCompositeTextureImageSize(.). */
     const osg::Vec2Array*	getCompositeTextureCoords(int geomIdx) const;
 
 protected:
     virtual			~TexturePanelStripNode();
 
     void			cleanUp();
+    const osg::Image*		getCompositeBorders(Vec2i& border0,
+						    Vec2i& border1,bool addBorder);
     float			getTexelSizeRatio() const;
     void			traverse(osg::NodeVisitor&) override;
     bool			updateGeometry();
+    void			swapDisplayBuffer(DisplayBuffer&);
+				//!<Swaps with front buffer under _redrawLock
+    void			swapBackBufferIfReady();
 
-    int				getValidNormalIdx(int panelIdx,
-						  bool forward) const;
-    osg::Vec3			getAverageNormal(int knotIdx) const;
-    void			computeNormals();
+    osg::Vec3			getAverageNormal(int prevValidPanelIdx,
+						int nextValidPanelIdx) const;
+    void			computeNormals(int nrOldKnots=0);
+				/*!<Recomputes only what depends on knots
+				    appended to the first nrOldKnots. */
 
     float			calcZTexOffset(int idx) const;
     float			calcPathTexOffset(int idx) const;
+    void			updateTilingPathOffsets();
+    int				findPanelIdx(float tilingOffset,
+					     int guessPanelIdx=-1) const;
     bool			getLocalGeomAtTexOffset(
 				    osg::Vec2& pathCoord,osg::Vec3& normal,
 				    float texOffset,int guessPanelIdx=-1) const;
@@ -173,12 +239,37 @@ protected:
     int						_compositeCutoutTexUnit;
     osg::ref_ptr<osg::Image>			_compositeImageWithBorder;
     osg::Vec2f					_borderEnvelopeOffset;
+    osg::Vec2f					_borderEnvelopeGrowth;
     std::vector<osg::StateSet*>			_statesets;
+    std::vector<osg::Vec2f>			_brickOrigins;	 // Tiling coords,
+    std::vector<osg::Vec2f>			_brickOpposites; // one per stateset
+    osg::ref_ptr<BrickCullTree>			_cullTree;	 // Idem
     osg::ref_ptr<osg::FloatArray>		_panelWidths;
     osg::ref_ptr<osg::Vec3Array>		_panelNormals;
     osg::ref_ptr<osg::Vec3Array>		_knotNormals;
+    float					_pathLength;
+    std::vector<float>				_knotArcLengths;
+    int						_lastValidPanelIdx;
+    std::vector<float>				_panelDirX;	// SoA scratch
+    std::vector<float>				_panelDirY;	// of normals
+    std::vector<float>				_tilingPathOffsets;
+						// Per knot, by updateGeometry()
     osg::ref_ptr<BoundingGeometry>		_boundingGeometry;
 
+    float					_pathLODTolerance;
+    std::vector<float>				_lodTolerances; // World units
+    std::vector<std::vector<osg::ref_ptr<osg::Geometry> > > _lodGeometries;
+						// Coarser levels per stateset
+    osg::ref_ptr<osg::StateSet>			_setupStateSet;
+						/* Copy of the texture's setup
+						   stateset as it was before the
+						   pending retiling, or null if
+						   the current one applies. */
+
+    bool					_useDoubleBuffering;
+    osg::ref_ptr<DisplayBuffer>			_backBuffer;
+    bool					_isBackBufferPending;
+
 public:
 			// Testing purposes only
     int			_altTileMode;
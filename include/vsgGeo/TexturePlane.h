@@ -19,18 +19,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 
 #include <vsgGeo/Common.h>
+#include <vsgGeo/ThreadGroup.h>
 
 
 namespace vsgGeo
 {
 
+class BrickCullTree;
 class LayeredTexture;
 class Vec2i;
 
 class VSGGEO_EXPORT TexturePlaneNode : public osg::Node
 {
     class BoundingGeometry;
+    class BrickThread;
+    class DisplayBuffer;
     class TextureCallbackHandler;
+    struct Brick;
 
 public:
 
@@ -74,6 +79,16 @@ public:
 				    geometry and/or texture changes. */
     bool			isDisplayFrozen() const;
 
+    void			useDoubleBuffering(bool yn=true);
+				/*!<If used (not by default), updated geometries
+				    and statesets are built into a back buffer,
+				    while the current ones stay on display. The
+				    buffers are swapped as soon as the virtual
+				    texture pages of the visible new bricks are
+				    resident. No effect without virtual
+				    texturing. */
+    bool			isDoubleBufferingUsed() const;
+
     void			setTextureShift(const osg::Vec2&);
 				/*!<Shift of the texture envelope center
 				    (in pixel units) with regard to the
@@ -95,25 +110,78 @@ public:
 
     osg::Vec3f			getTexelSpanVector(int texdim);
 
+    bool			getTextureEnvelope(osg::Vec2f& tilingOrigin,
+					osg::Vec2f& tilingOpposite) const;
+				/*!<Tiling coords of the plane corners as used
+				    by the last geometry update, including the
+				    texture shift and growth. */
+
     std::vector<osg::Geometry*>& getGeometries()	{ return _geometries; }
+				/*!<Holds only the unit-square brick geometry
+				    if LayeredTexture::isSharedBrickGeometryUsed(),
+				    which is placed per brick by a uniform.
+				    Otherwise one geometry per brick if its
+				    quads are merged, else one per sub-quad. */
     const osg::Image*		getCompositeTextureImage(bool addBorder=true);
+    bool			getCompositeTextureImageSize(int& s,int& t,
+						    bool addBorder=true);
+    bool			writeCompositeTextureImage(
+					unsigned char* buffer,
+					bool addBorder=true);
+				/*!<Zero-copy variant of getCompositeTexture-
+				    Image(.), writing unpadded GL_RGBA/
+				    GL_UNSIGNED_BYTE rows into a caller-provided
+				    buffer of getCompositeTextureImageSize(.). */
     const osg::Vec2Array*	getCompositeTextureCoords(int geomIdx) const;
+				/*!<Per brick instead of per geometry if
+				    brick geometry is shared. */
 
 protected:
     virtual			~TexturePlaneNode();
 
     void			cleanUp();
+    const osg::Vec2Array*	getSharedBrickCompositeTextureCoords(
+					int brickIdx,
+					const osg::Vec2f& compositeSize) const;
+    const osg::Image*		getCompositeBorders(Vec2i& border0,
+						    Vec2i& border1,bool addBorder);
     float			getTexelSizeRatio() const;
     void			finalizeTiling(std::vector<float>& origins,
 					       int dim) const;
     bool			needsUpdate() const;
     bool			updateGeometry();
+    void			swapDisplayBuffer(DisplayBuffer&);
+				//!<Swaps with front buffer under _redrawLock
+    void			swapBackBufferIfReady();
+    bool			updateVertexCoords();
+				/*!<Moves the existing bricks in place, reusing
+				    their statesets and tiles. Hence brick
+				    geometries and shared-geometry statesets are
+				    DYNAMIC. Returns false if a full
+				    updateGeometry() is needed. */
+    osg::Vec3			getPlaneNormal(const osg::Matrix& rot) const;
+    void			computeBrickCorners(const osg::Vec2f& origin,
+					const osg::Vec2f& opposite,
+					const osg::Vec2f& envelopeOrigin,
+					const osg::Vec2f& envelopeOpposite,
+					const osg::Matrix& rot,
+					osg::Vec3Array& corners) const;
+    void			buildBrick(Brick&,osg::Vec3Array& normals,
+					   osg::Vec4Array& colors,
+					   bool shareGeometry) const;
+    int				nrGeometriesPerBrick() const;
+    osg::Geometry*		createSharedBrickGeometry(
+					const std::vector<int>& texUnits,
+					osg::Vec3Array& normals,
+					osg::Vec4Array& colors) const;
     float			getSense() const;
 
     void			setUpdateVar(bool& var,bool yn);
 				//! Will trigger redraw request if necessary
 
     bool			_needsUpdate;	// Only set via setUpdateVar(.)
+    bool			_needsGeometryUpdate;	// Idem
+    float			_tiledTexelSizeRatio;
     bool			_frozen;	// Only set via setUpdateVar(.)
 
     osg::ref_ptr<TextureCallbackHandler>	_textureCallbackHandler;
@@ -139,9 +207,24 @@ protected:
     int					_compositeCutoutTexUnit;
     osg::ref_ptr<osg::Image>		_compositeImageWithBorder;
     osg::Vec2f				_borderEnvelopeOffset;
+    osg::Vec2f				_borderEnvelopeGrowth;
     std::vector<osg::StateSet*>		_statesets;
+    std::vector<osg::Vec2f>		_brickOrigins;	// Tiling coords,
+    std::vector<osg::Vec2f>		_brickOpposites; // one per stateset
+    bool				_isBrickGeometryShared;
+    int					_nrGeometriesPerBrick;
+    osg::ref_ptr<BrickCullTree>		_cullTree;	// One brick per stateset
+    osg::ref_ptr<osg::StateSet>		_setupStateSet;
+				/* Copy of the texture's setup stateset as
+				   it was before the pending retiling, or null
+				   if the current one applies. */
+
+    bool				_useDoubleBuffering;
+    osg::ref_ptr<DisplayBuffer>		_backBuffer;
+    bool				_isBackBufferPending;
 
     osg::ref_ptr<BoundingGeometry>	_boundingGeometry;
+    osg::ref_ptr<ThreadGroup<BrickThread> > _brickThreads;
 
 public:
 			// Testing purposes only
@@ -164,11 +247,22 @@ public:
 				setUpdateVar( _needsUpdate, true );
 			    }
 			}
-			// TODO: Needs more efficient GL primitives if used
-			// for real high-resolution vertex offset shading
 
     int			getQuadsPerBrickSide() const
 			{ return _nrQuadsPerBrickSide; }
+
+    bool		_mergeBrickQuads;
+    void		mergeBrickQuads( bool yn )
+			{
+			    _mergeBrickQuads = yn;
+			    setUpdateVar( _needsUpdate, true );
+			}
+			/*!<One indexed triangle mesh per brick instead of
+			    one quad geometry per sub-quad. Saves draw calls
+			    for high-resolution vertex offset shading. Its
+			    strips are vertex-cache ordered. */
+    bool		areBrickQuadsMerged() const
+			{ return _mergeBrickQuads; }
 };
 
 } // namespace vsgGeo
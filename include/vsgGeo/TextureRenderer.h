@@ -0,0 +1,92 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+#include <vsgGeo/ThreadGroup.h>
+
+#include <vector>
+
+
+namespace vsgGeo
+{
+
+class LayerProcess;
+class TexturePlaneNode;
+class TexturePlaneRenderThread;
+
+/*!Headless CPU reference renderer of a TexturePlaneNode. Casts one ray per
+   output pixel onto the plane and evaluates the layer processes of its
+   LayeredTexture like the fragment shader does, including the mipmapped
+   color scale space lookup of color table processes. Meant for image
+   regression testing and servers without a GPU, not for interactive use.
+   The node must have been updated (traversed) before rendering, so that
+   its tiling is known. 3D texture layers are not supported. */
+
+class VSGGEO_EXPORT TexturePlaneRenderer : public osg::Referenced
+{
+friend class TexturePlaneRenderThread;
+
+public:
+			TexturePlaneRenderer(const TexturePlaneNode&);
+
+    void		setViewMatrix(const osg::Matrix& modelView);
+    void		setProjectionMatrix(const osg::Matrix&);
+    void		setCamera(const osg::Camera&);
+			//!<Takes view and projection matrix of camera
+
+    void		setBackgroundColor(const osg::Vec4f&);
+    const osg::Vec4f&	getBackgroundColor() const	{ return _bgColor; }
+
+    bool		render(osg::Image& image,int width,int height);
+			/*!Allocates image as GL_RGBA/GL_UNSIGNED_BYTE. Rows
+			   are rendered in parallel. Returns false if the
+			   node has no (tiled) texture or matrices are
+			   singular. */
+
+protected:
+			~TexturePlaneRenderer();
+
+    bool		initPlaneMapping();
+    bool /*onPlane*/	getGlobalCoord(float x,float y,osg::Vec2f& global,
+				       bool& inside) const;
+			//!<Pixel coords, center of pixel (0,0) at (0.5,0.5)
+    void		renderRow(unsigned char* rowPtr,int row) const;
+
+    osg::ref_ptr<const TexturePlaneNode> _node;
+    osg::Matrix				_modelView;
+    osg::Matrix				_projection;
+    osg::Vec4f				_bgColor;
+
+    // Only valid during render(.)
+    osg::Matrix				_inverseMVP;
+    osg::Matrix				_inverseRotation;
+    osg::Vec3				_planeNormal;
+    osg::Vec2f				_tilingOrigin;
+    osg::Vec2f				_tilingOpposite;
+    int					_width;
+    int					_height;
+    std::vector<LayerProcess*>		_processes;
+    float				_minOpacity;
+
+    osg::ref_ptr<ThreadGroup<TexturePlaneRenderThread> > _renderThreads;
+};
+
+
+} // namespace vsgGeo
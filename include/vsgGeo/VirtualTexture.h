@@ -0,0 +1,167 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+#include <vsgGeo/Vec2i.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+
+namespace vsgGeo
+{
+
+/*!Physical page atlas of a virtually textured LayeredTexture. Fixed-size
+   pages cut from the data layer images are stored side by side in one
+   shared RGBA texture, each surrounded by a one-texel gutter to keep linear
+   filtering seamless. Every paged data layer owns a small page table texture
+   mapping its page grid onto atlas slots. Pages are requested by feedback
+   from the visible bricks, and made resident during the update traversal
+   under a fixed budget. The least recently requested pages are evicted
+   first. One atlas may be shared by several LayeredTextures. */
+
+class VSGGEO_EXPORT VirtualTextureAtlas : public osg::Referenced
+{
+    class SubloadCallback;
+
+public:
+			VirtualTextureAtlas(int pageSize=128,int atlasSize=4096);
+			/*!Sizes in texels. The atlas is divided in slots of
+			   (pageSize+2)^2 texels, at most 255 per side. */
+
+    int			getPageSize() const		{ return _pageSize; }
+    int			getPaddedPageSize() const	{ return _pageSize+2; }
+    int			getAtlasSize() const		{ return _atlasSize; }
+    int			nrSlots() const;
+
+    void		setPageBudget(int nrPages);
+			//!<Max nr of resident pages, bounded by nrSlots()
+    int			getPageBudget() const		{ return _budget; }
+
+    osg::Texture2D*	getAtlasTexture()	{ return _atlasTexture.get(); }
+
+    void		setPageGrid(const void* owner,int layerId,
+				    const Vec2i& imageSize);
+			//!<Drops all resident pages of layer if grid changes
+    void		removePageGrid(const void* owner,int layerId);
+    void		invalidatePages(const void* owner,int layerId);
+			//!<Drops all resident pages of layer after data change
+    Vec2i		getPageGridSize(const void* owner,int layerId) const;
+    osg::Texture2D*	getPageTableTexture(const void* owner,int layerId);
+
+    bool /*resident*/	requestPages(const void* owner,int layerId,
+				     const Vec2i& firstPage,
+				     const Vec2i& lastPage);
+			/*!Feedback from a visible brick. Does its own locking,
+			   so it may be called from (multi-threaded) culling.
+			   Returns false if any page is not resident yet. */
+
+    struct PageLoad
+    {
+	const void*	_owner;
+	int		_layerId;
+	Vec2i		_pageNr;
+	int		_slot;
+    };
+
+    void		assignRequestedPages(const void* owner,
+					     std::vector<PageLoad>&);
+			/*!Assigns atlas slots to all requested non-resident
+			   pages of owner, evicting least recently requested pages if
+			   the budget is exceeded. Pages requested since the
+			   previous update traversal, by any owner, are never
+			   evicted. Fill the returned pages via getSlotData(.)
+			   before calling commitPages(.). */
+
+    unsigned char*	getSlotData(int slot);
+			//!<Upper-left gutter texel of padded page in atlas
+    int			getAtlasRowSizeInBytes() const;
+
+    void		commitPages(const std::vector<PageLoad>&);
+			//!<Publishes filled pages to page tables and GPU
+
+protected:
+			~VirtualTextureAtlas();
+
+    struct PageKey
+    {
+			PageKey(const void* owner=0,int layerId=-1,
+				const Vec2i& pageNr=Vec2i(0,0))
+			    : _owner( owner ), _layerId( layerId )
+			    , _pageNr( pageNr )
+			{}
+
+	bool		operator<(const PageKey&) const;
+
+	const void*	_owner;
+	int		_layerId;
+	Vec2i		_pageNr;
+    };
+
+    struct PageGrid
+    {
+	Vec2i				_nrPages;
+	osg::ref_ptr<osg::Image>	_table;
+	osg::ref_ptr<osg::Texture2D>	_tableTexture;
+    };
+
+    struct Slot
+    {
+			Slot() : _inUse( false ), _lastRequest( 0 ), _version( 0 ) {}
+
+	PageKey		_key;
+	bool		_inUse;
+	unsigned int	_lastRequest;
+	unsigned int	_version;
+    };
+
+    typedef std::pair<const void*,int>	GridKey;
+
+    void		evictSlot(int slot);
+    void		setPageTableEntry(const PageKey&,int slot);
+    void		touchSlot(int slot);
+
+    const int				_pageSize;
+    const int				_atlasSize;
+    int					_slotsPerSide;
+    int					_budget;
+
+    osg::ref_ptr<osg::Image>		_atlasImage;
+    osg::ref_ptr<osg::Texture2D>	_atlasTexture;
+
+    std::vector<Slot>			_slots;
+    std::list<int>			_lruSlots;	// Least recent first
+    std::vector<std::list<int>::iterator> _lruPositions;
+    std::vector<int>			_freeSlots;
+
+    std::map<PageKey,int>		_residentPages;
+    std::set<PageKey>			_requestedPages;
+    std::map<GridKey,PageGrid>		_pageGrids;
+    unsigned int			_requestStamp;
+    bool				_newRoundPending;
+    bool				_budgetWarning;
+
+    mutable OpenThreads::Mutex		_lock;
+};
+
+
+} //namespace
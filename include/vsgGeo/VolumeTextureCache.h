@@ -0,0 +1,104 @@
+#pragma once
+
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/Common.h>
+
+#include <list>
+#include <map>
+
+
+namespace vsgGeo
+{
+
+/*!Cache of 3D textures shared by all LayeredTextures sampling the same
+   volume image through a vertex-to-texture transform. Every cutout of
+   every plane slicing the volume, in any orientation, binds the same
+   texture object, so the volume is uploaded once per graphics context and
+   moving a slice neither extracts nor uploads data. Textures no longer
+   bound by any stateset stay cached for reuse, until the least recently
+   used ones are evicted when the memory budget is exceeded. */
+
+class VSGGEO_EXPORT VolumeTextureCache : public osg::Referenced
+{
+public:
+			VolumeTextureCache(unsigned int budgetMB=1024);
+
+    void		setMemoryBudget(unsigned int megaBytes);
+    unsigned int	getMemoryBudget() const		{ return _budgetMB; }
+    unsigned int	getMemoryUsage() const;
+			//!<In megabytes, image data of all cached volumes
+
+    osg::ref_ptr<osg::Texture3D> getTexture(osg::Image* volume,
+				   osg::Texture::FilterMode,
+				   const osg::Vec4f& borderColor);
+			/*!Returns the cached texture of volume with these
+			   sampling settings, or creates it. Negative border
+			   color clamps to edge. Does its own locking, so it
+			   may be called while creating cutouts concurrently.
+			   The reference is taken under the lock, and keeps
+			   the texture from eviction until it is bound. */
+
+    void		removeVolume(const osg::Image* volume);
+			//!<Drops all unbound textures of volume
+    void		releaseUnused();
+			//!<Drops all textures not bound by any stateset
+
+protected:
+			~VolumeTextureCache();
+
+    struct TextureKey
+    {
+			TextureKey(const osg::Image* volume,
+				   osg::Texture::FilterMode filter,
+				   const osg::Vec4f& borderColor)
+			    : _volume( volume ), _filter( filter )
+			    , _borderColor( borderColor )
+			{}
+
+	bool		operator<(const TextureKey&) const;
+
+	const osg::Image*	_volume;
+	osg::Texture::FilterMode _filter;
+	osg::Vec4f		_borderColor;
+    };
+
+    struct CacheEntry
+    {
+	osg::ref_ptr<osg::Texture3D>	_texture;
+	std::size_t			_sizeInBytes;
+	std::list<TextureKey>::iterator	_lruPos;
+    };
+
+    bool		isBound(const CacheEntry&) const;
+    void		evict(std::map<TextureKey,CacheEntry>::iterator);
+    void		evictToBudget();
+
+    unsigned int			_budgetMB;
+    std::size_t				_usedBytes;
+
+    std::map<TextureKey,CacheEntry>	_entries;
+    std::list<TextureKey>		_lruKeys;	// Least recent first
+    bool				_budgetWarning;
+
+    mutable OpenThreads::Mutex		_lock;
+};
+
+
+} //namespace
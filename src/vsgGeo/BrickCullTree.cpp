@@ -0,0 +1,207 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/BrickCullTree.h>
+#include <osgUtil/CullVisitor>
+
+#include <algorithm>
+
+
+namespace vsgGeo
+{
+
+BrickCullTree::BrickCullTree()
+{}
+
+
+BrickCullTree::~BrickCullTree()
+{}
+
+
+void BrickCullTree::clear()
+{
+    _brickBounds.clear();
+    _gridPositions.clear();
+    _nodes.clear();
+}
+
+
+void BrickCullTree::addBrick( const osg::BoundingBox& bb, const Vec2i& gridPos )
+{
+    _brickBounds.push_back( bb );
+    _gridPositions.push_back( gridPos );
+}
+
+
+void BrickCullTree::build()
+{
+    _nodes.clear();
+    if ( _brickBounds.empty() )
+	return;
+
+    Vec2i gridMin = _gridPositions.front();
+    Vec2i gridMax = gridMin;
+    std::vector<int> brickIdxs;
+
+    for ( int idx=0; idx<nrBricks(); idx++ )
+    {
+	const Vec2i& pos = _gridPositions[idx];
+	for ( int dim=0; dim<2; dim++ )
+	{
+	    if ( pos[dim]<gridMin[dim] )
+		gridMin[dim] = pos[dim];
+	    if ( pos[dim]>gridMax[dim] )
+		gridMax[dim] = pos[dim];
+	}
+	brickIdxs.push_back( idx );
+    }
+
+    buildNode( brickIdxs, gridMin, gridMax );
+}
+
+
+int BrickCullTree::buildNode( std::vector<int>& brickIdxs, const Vec2i& gridMin, const Vec2i& gridMax )
+{
+    const int nodeIdx = _nodes.size();
+    _nodes.push_back( TreeNode() );
+    _nodes[nodeIdx]._brickIdx = -1;
+
+    if ( brickIdxs.size()==1 )
+    {
+	_nodes[nodeIdx]._brickIdx = brickIdxs[0];
+	_nodes[nodeIdx]._bb = _brickBounds[brickIdxs[0]];
+	return nodeIdx;
+    }
+
+    // Halve every grid dimension spanning more than one position. Several
+    // bricks at one grid position (panel strip geometries) are split by list.
+    const Vec2i gridMid( (gridMin[0]+gridMax[0])/2, (gridMin[1]+gridMax[1])/2 );
+    const bool splitDim[2] = { gridMin[0]<gridMax[0], gridMin[1]<gridMax[1] };
+
+    std::vector<int> quadrants[4];
+    for ( int idx=0; idx<(int) brickIdxs.size(); idx++ )
+    {
+	const Vec2i& pos = _gridPositions[brickIdxs[idx]];
+	int quadrant = 0;
+
+	if ( splitDim[0] || splitDim[1] )
+	{
+	    if ( splitDim[0] && pos[0]>gridMid[0] )
+		quadrant += 1;
+	    if ( splitDim[1] && pos[1]>gridMid[1] )
+		quadrant += 2;
+	}
+	else
+	    quadrant = 2*idx>=(int) brickIdxs.size() ? 1 : 0;
+
+	quadrants[quadrant].push_back( brickIdxs[idx] );
+    }
+
+    brickIdxs.clear();
+
+    for ( int quadrant=0; quadrant<4; quadrant++ )
+    {
+	if ( quadrants[quadrant].empty() )
+	    continue;
+
+	const Vec2i subMin( splitDim[0] && quadrant%2 ? gridMid[0]+1 : gridMin[0],
+			    splitDim[1] && quadrant/2 ? gridMid[1]+1 : gridMin[1] );
+	const Vec2i subMax( splitDim[0] && !(quadrant%2) ? gridMid[0] : gridMax[0],
+			    splitDim[1] && !(quadrant/2) ? gridMid[1] : gridMax[1] );
+
+	const int childIdx = buildNode( quadrants[quadrant], subMin, subMax );
+	_nodes[nodeIdx]._children.push_back( childIdx );
+	_nodes[nodeIdx]._bb.expandBy( _nodes[childIdx]._bb );
+    }
+
+    return nodeIdx;
+}
+
+
+const osg::BoundingBox& BrickCullTree::getBrickBound( int brickIdx ) const
+{ return _brickBounds[brickIdx]; }
+
+
+void BrickCullTree::setBrickBound( int brickIdx, const osg::BoundingBox& bb )
+{
+    if ( brickIdx>=0 && brickIdx<nrBricks() )
+	_brickBounds[brickIdx] = bb;
+}
+
+
+void BrickCullTree::refit()
+{
+    if ( !_nodes.empty() )
+	refitNode( 0 );
+}
+
+
+void BrickCullTree::refitNode( int nodeIdx )
+{
+    TreeNode& node = _nodes[nodeIdx];
+    if ( node._children.empty() )
+    {
+	node._bb = _brickBounds[node._brickIdx];
+	return;
+    }
+
+    node._bb.init();
+    for ( int idx=0; idx<(int) node._children.size(); idx++ )
+    {
+	refitNode( node._children[idx] );
+	// Reference into _nodes stays valid, as no nodes are added here
+	node._bb.expandBy( _nodes[node._children[idx]]._bb );
+    }
+}
+
+
+void BrickCullTree::getVisibleBricks( osgUtil::CullVisitor& cv, std::vector<int>& brickIdxs, bool cullBricks ) const
+{
+    brickIdxs.clear();
+    if ( !cullBricks )
+    {
+	for ( int idx=0; idx<nrBricks(); idx++ )
+	    brickIdxs.push_back( idx );
+	return;
+    }
+
+    if ( !_nodes.empty() )
+	collectVisible( 0, cv, brickIdxs );
+
+    std::sort( brickIdxs.begin(), brickIdxs.end() );
+}
+
+
+void BrickCullTree::collectVisible( int nodeIdx, osgUtil::CullVisitor& cv, std::vector<int>& brickIdxs ) const
+{
+    const TreeNode& node = _nodes[nodeIdx];
+    if ( !node._bb.valid() || cv.isCulled(node._bb) )
+	return;
+
+    if ( node._children.empty() )
+    {
+	brickIdxs.push_back( node._brickIdx );
+	return;
+    }
+
+    for ( int idx=0; idx<(int) node._children.size(); idx++ )
+	collectVisible( node._children[idx], cv, brickIdxs );
+}
+
+
+} // namespace vsgGeo
@@ -0,0 +1,217 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/GridMeshBuilder.h>
+
+#include <algorithm>
+#include <utility>
+
+
+namespace vsgGeo
+{
+
+
+GridMeshBuilder::GridMeshBuilder( int nrCols, int nrRows )
+    : _nrCols( nrCols )
+    , _nrRows( nrRows )
+    , _blockSize( 1 )
+    , _defined( 0 )
+{
+    setVertexCacheSize( 16 );
+}
+
+
+/* A strip of w quads reuses the w+1 vertices it shares with the row below
+   after loading w+1 new ones, so these fit in a FIFO cache of w+2. This
+   only holds if the row below was loaded without misses in between, hence
+   the priming of every block's first row. */
+
+void GridMeshBuilder::setVertexCacheSize( int nrVertices )
+{
+    _blockSize = osg::maximum( nrVertices-2, 1 );
+    updateBlockOrder();
+}
+
+
+void GridMeshBuilder::setDefinedMask( const unsigned char* mask )
+{ _defined = mask; }
+
+
+static unsigned int getZOrderKey( int bx, int by )
+{
+    unsigned int key = 0;
+    for ( int bit=0; bit<16; bit++ )
+    {
+	key |= ((bx >> bit) & 1u) << (2*bit);
+	key |= ((by >> bit) & 1u) << (2*bit+1);
+    }
+
+    return key;
+}
+
+
+void GridMeshBuilder::updateBlockOrder()
+{
+    _blockOrder.clear();
+    if ( _nrCols<2 || _nrRows<2 )
+	return;
+
+    const int nrBlockCols = (_nrCols-2)/_blockSize + 1;
+    const int nrBlockRows = (_nrRows-2)/_blockSize + 1;
+
+    std::vector<std::pair<unsigned int,int> > keys;
+    for ( int by=0; by<nrBlockRows; by++ )
+    {
+	for ( int bx=0; bx<nrBlockCols; bx++ )
+	    keys.push_back( std::make_pair(getZOrderKey(bx,by),by*nrBlockCols+bx) );
+    }
+
+    std::sort( keys.begin(), keys.end() );
+
+    for ( unsigned int idx=0; idx<keys.size(); idx++ )
+	_blockOrder.push_back( Vec2i(keys[idx].second%nrBlockCols,keys[idx].second/nrBlockCols) );
+}
+
+
+void GridMeshBuilder::getBlockQuads( int blockIdx, Vec2i& first, Vec2i& last ) const
+{
+    const Vec2i& block = _blockOrder[blockIdx];
+    first = Vec2i( block.x()*_blockSize, block.y()*_blockSize );
+    last = Vec2i( osg::minimum(first.x()+_blockSize,_nrCols-1)-1,
+		  osg::minimum(first.y()+_blockSize,_nrRows-1)-1 );
+}
+
+
+void GridMeshBuilder::addStrips( osg::DrawElements& indices ) const
+{
+    // Strip rows of fully defined blocks cost 2(w+1) indices and a restart
+    const int nrQuadCols = _nrCols-1;
+    const int nrQuadRows = _nrRows-1;
+    const int nrBlockCols = nrQuadCols>0 ? (nrQuadCols-1)/_blockSize + 1 : 0;
+    const int nrBlockRows = nrQuadRows>0 ? (nrQuadRows-1)/_blockSize + 1 : 0;
+    const int nrStripRows = nrQuadRows + nrBlockRows;	// Priming included
+    indices.reserveElements( indices.getNumIndices() + nrStripRows*(2*nrQuadCols+3*nrBlockCols) );
+
+    for ( int blockIdx=0; blockIdx<nrBlocks(); blockIdx++ )
+	addBlockStrips( blockIdx, indices );
+}
+
+
+#define IS_DEFINED( idx ) (!_defined || _defined[idx])
+
+void GridMeshBuilder::addBlockStrips( int blockIdx, osg::DrawElements& indices ) const
+{
+    const unsigned int restart = getRestartIndex( indices.getType() );
+    Vec2i first, last;
+    getBlockQuads( blockIdx, first, last );
+
+    // Degenerate triangles only load the first vertex row into the cache
+    bool isPriming = false;
+    for ( int i=first.x(); i<=last.x()+1; i++ )
+    {
+	const unsigned int v = first.y()*_nrCols + i;
+	if ( IS_DEFINED(v) )
+	{
+	    indices.addElement( v );
+	    indices.addElement( v );
+	    isPriming = true;
+	}
+    }
+
+    if ( isPriming )
+	indices.addElement( restart );
+
+    for ( int j=first.y(); j<=last.y(); j++ )
+    {
+	bool inStrip = false;
+
+	for ( int i=first.x(); i<=last.x(); i++ )
+	{
+	    const unsigned int v00 = j*_nrCols + i;
+	    const unsigned int v01 = v00 + _nrCols;
+	    const bool d00 = IS_DEFINED( v00 );
+	    const bool d10 = IS_DEFINED( v00+1 );
+	    const bool d01 = IS_DEFINED( v01 );
+	    const bool d11 = IS_DEFINED( v01+1 );
+
+	    // Strip alternates between the upper and lower vertex row
+	    if ( d00 && d10 && d01 && d11 )
+	    {
+		if ( !inStrip )
+		{
+		    indices.addElement( v01 );
+		    indices.addElement( v00 );
+		    inStrip = true;
+		}
+
+		indices.addElement( v01+1 );
+		indices.addElement( v00+1 );
+		continue;
+	    }
+
+	    if ( inStrip )
+	    {
+		indices.addElement( restart );
+		inStrip = false;
+	    }
+
+	    // Lone triangles of partly defined quads
+	    if ( d00 && d11 )
+	    {
+		if ( d10 )
+		{
+		    indices.addElement( v00 );
+		    indices.addElement( v00+1 );
+		    indices.addElement( v01+1 );
+		    indices.addElement( restart );
+		}
+		if ( d01 )
+		{
+		    indices.addElement( v00 );
+		    indices.addElement( v01+1 );
+		    indices.addElement( v01 );
+		    indices.addElement( restart );
+		}
+	    }
+	}
+
+	if ( inStrip )
+	    indices.addElement( restart );
+    }
+}
+
+
+unsigned int GridMeshBuilder::getRestartIndex( osg::PrimitiveSet::Type type )
+{
+    if ( type==osg::PrimitiveSet::DrawElementsUBytePrimitiveType )
+	return 0xff;
+    if ( type==osg::PrimitiveSet::DrawElementsUShortPrimitiveType )
+	return 0xffff;
+
+    return 0xffffffff;
+}
+
+
+void GridMeshBuilder::enablePrimitiveRestart( osg::StateSet& stateset, osg::PrimitiveSet::Type type )
+{
+    stateset.setAttribute( new osg::PrimitiveRestartIndex(getRestartIndex(type)) );
+    stateset.setMode( GL_PRIMITIVE_RESTART, osg::StateAttribute::ON );
+}
+
+
+} // namespace vsgGeo
@@ -1,4 +1,4 @@
-/* vsgGeo - A collection of geoscientific extensions to OpenSceneGraph.
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
 Copyright 2025 dGB Beheer B.V.
 
 vsgGeo is free software; you can redistribute it and/or modify
@@ -16,308 +16,3384 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 */
 
-#include <vsgGeo/HeighField>
+#include <vsgGeo/HeightField.h>
+#include <vsgGeo/ComputeBoundsVisitor.h>
+#include <vsgGeo/GridMeshBuilder.h>
+#include <vsgGeo/ShaderUtility.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+
+
 namespace vsgGeo
 {
 
+#define HEIGHT_ATTRIB_LOC		6
+#define NORMAL_ATTRIB_LOC		7	// Streamed chunks only
+#define MAX_CHUNK_BUILDS_PER_FRAME	64
+#define CHUNK_RELEASE_FRAMES		300
+#define PICK_BLOCK_SIZE			8	// Quads per pyramid leaf
+#define MAX_RESIDENT_CHUNKS		16	// Coarse levels loaded at startup
+#define MEGABYTE			(1024*1024)
+#define HALF_FLOAT_UNDEF		0x7e00	// Quiet NaN
+
+enum ChunkTask { UpdateChunks, BuildGeometries };
+// Half floats as GL vertex attribute
+typedef osg::TemplateArray<GLushort,osg::Array::UShortArrayType,1,GL_HALF_FLOAT> HalfFloatArray;
+
+enum DecimationTask { ComputeErrors, PropagateErrors, ExtractTriangles };
+
+
+struct HeightField::Chunk
+{
+			Chunk()
+			    : _level( 0 )
+			    , _minHeight( 0.0f )
+			    , _maxHeight( 0.0f )
+			    , _isEmpty( true )
+			    , _error( 0.0f )
+			    , _skirtDepth( 0.0f )
+			    , _lastUsed( 0 )
+			    , _isRequested( false )
+			    , _isDirty( true )
+			    , _coarseDev( 0.0f )
+			    , _hasTile( false )
+			    , _isFetching( false )
+			{
+			    for ( int idx=0; idx<4; idx++ )
+				_children[idx] = -1;
+			}
+
+    size_t		tileBytes() const
+			{
+			    return _tileHeights.size()*sizeof(float) +
+				   _tileNormals.size()*sizeof(osg::Vec3b);
+			}
+
+    int				_level;
+    Vec2i			_firstNode;	// Grid (col,row) of vertex (0,0)
+    int				_children[4];	// -1 if none
+    float			_minHeight;
+    float			_maxHeight;
+    bool			_isEmpty;	// No defined nodes
+    float			_error;		// Max height deviation
+    float			_skirtDepth;
+    osg::BoundingBox		_bb;
+    osg::ref_ptr<osg::Geometry>	_geometry;
+    osg::ref_ptr<osg::DrawElementsUShort> _indices;	// Defined triangles
+    std::vector<unsigned int>	_definedBits;	// Rows padded to words
+    std::vector<int>		_blockStarts;	// Index of each mesh block
+    unsigned int		_lastUsed;	// Frame nr of last selection
+    bool			_isRequested;
+    bool			_isDirty;	// Geometry out of date
+
+    // Streamed chunks only
+    std::vector<float>		_tileHeights;	// Undefined as undef value
+    std::vector<osg::Vec3b>	_tileNormals;
+    float			_coarseDev;	// Of every other node
+    bool			_hasTile;
+    bool			_isFetching;
+};
+
+
+class HeightField::ChunkThread : public GroupThread<ChunkThread>
+{
+public:
+			ChunkThread(ThreadGroup<ChunkThread>& tg)
+			    : GroupThread<ChunkThread>(tg)
+			{}
+
+    void		set(HeightField* hf,const std::vector<int>& chunkIdxs,
+			    int task,int start,int stop,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _chunkIdxs = &chunkIdxs;
+			    _task = task;
+			    _start = start;
+			    _stop = stop;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    HeightField*		_hf;
+    const std::vector<int>*	_chunkIdxs;
+    int				_task;
+    int				_start;
+    int				_stop;
+};
+
 
-    void HeightField::setHeightData( osg::Vec2Array* arr )
+void HeightField::ChunkThread::doWork()
+{
+    for ( int idx=_start; _hf && idx<=_stop; idx++ )
     {
-	bool rebuildGeom = false;
-	if ( !_heightfield || !arr )
-	    rebuildGeom = true;
-	else if ( arr->getSize(0)!=_heightfield->getSize(0) || 
-		  arr->getSize(1)!=_heightfield->getSize(1) )
-	    rebuildGeom = true;
+	if ( _task==UpdateChunks )
+	    _hf->updateChunk( (*_chunkIdxs)[idx] );
+	else
+	    _hf->buildChunkGeometry( (*_chunkIdxs)[idx] );
+    }
+}
+
+
+class HeightField::NormalMapThread : public GroupThread<NormalMapThread>
+{
+public:
+			NormalMapThread(ThreadGroup<NormalMapThread>& tg)
+			    : GroupThread<NormalMapThread>(tg)
+			{}
+
+    void		set(const HeightField* hf,osg::Image* image,
+			    int startCol,int stopCol,int startRow,int stopRow,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _image = image;
+			    _startCol = startCol;
+			    _stopCol = stopCol;
+			    _start = startRow;
+			    _stop = stopRow;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const HeightField*		_hf;
+    osg::Image*			_image;
+    int				_startCol;
+    int				_stopCol;
+    int				_start;
+    int				_stop;
+};
+
+
+void HeightField::NormalMapThread::doWork()
+{
+    std::vector<float> buffer;
+    for ( int row=_start; _hf && row<=_stop; row++ )
+	_hf->computeNormalRow( row, _startCol, _stopCol, _image->data(_startCol,row), buffer );
+}
+
+
+//============================================================================
+
+
+/* Right-triangulated irregular network over a square grid of 2^k+1 nodes.
+   Triangles are split in half from the right angle to the middle of the
+   hypotenuse, down to legs of one node. The error at a hypotenuse middle
+   bounds the deviation of all nodes inside its triangles: the deviation
+   of the middle from the hypotenuse plus the largest error of the halves.
+   Keeping the largest triangles with an error within tolerance yields a
+   mesh without T-junctions, as parents never have less error than their
+   children. Triangles touching
+   an undefined node get an infinite error and are split to the finest
+   level, where only fully defined triangles are kept. */
+
+class RTIN
+{
+public:
+			RTIN(int gridSize)
+			    : _size( gridSize )
+			    , _nrTriangles( 2*(gridSize-1)*(gridSize-1)-2 )
+			{}
+
+    void		accumulateErrors(const float* heights,
+					 const unsigned char* defined,
+					 float* errors) const;
+			/*!<Errors must start at zero. Can be repeated after
+			    raising errors, to propagate them to the larger
+			    triangles. */
+    void		getTriangles(const float* errors,
+				     const unsigned char* defined,float tolerance,
+				     std::vector<int>& nodeIdxs) const;
+			//!<Counter-clockwise triangles in grid node indices
+
+protected:
+    void		getTriangle(int triangleIdx,int& ax,int& ay,
+				    int& bx,int& by,int& cx,int& cy) const;
+    void		addTriangle(int ax,int ay,int bx,int by,int cx,int cy,
+				    const float* errors,
+				    const unsigned char* defined,float tolerance,
+				    std::vector<int>& nodeIdxs) const;
+
+    int			_size;
+    int			_nrTriangles;
+};
 
-	if ( rebuildGeom )
+
+// Corners of a triangle from its index in the implicit binary tree
+
+void RTIN::getTriangle( int triangleIdx, int& ax, int& ay, int& bx, int& by, int& cx, int& cy ) const
+{
+    const int max = _size-1;
+    int id = triangleIdx+2;
+
+    ax = ay = bx = by = cx = cy = 0;
+    if ( id & 1 )
+	bx = by = cx = max;
+    else
+	ax = ay = cy = max;
+
+    while ( (id >>= 1) > 1 )
+    {
+	const int mx = (ax+bx) >> 1;
+	const int my = (ay+by) >> 1;
+	if ( id & 1 )
 	{
-	    for ( all idx )
-	    {
-		for ( all idy )
-		{
-		    _coords[idx*nry+idy] = osg::Vec3( idx, idy, 0 );
-		}
-	    }
+	    bx = ax; by = ay;
+	    ax = cx; ay = cy;
+	}
+	else
+	{
+	    ax = bx; ay = by;
+	    bx = cx; by = cy;
+	}
+	cx = mx; cy = my;
+    }
+}
+
 
-	    //Create triangle-strip for everything
+void RTIN::accumulateErrors( const float* heights, const unsigned char* defined, float* errors ) const
+{
+    const int nrSmallest = (_size-1)*(_size-1);
+
+    // Smallest triangles first, so that children precede their parent
+    for ( int idx=_nrTriangles-1; idx>=0; idx-- )
+    {
+	int ax, ay, bx, by, cx, cy;
+	getTriangle( idx, ax, ay, bx, by, cx, cy );
+
+	const int a = ay*_size + ax;
+	const int b = by*_size + bx;
+	const int c = cy*_size + cx;
+	const int m = ((ay+by) >> 1)*_size + ((ax+bx) >> 1);
+
+	float error = FLT_MAX;
+	if ( defined[a] && defined[b] && defined[c] && defined[m] )
+	    error = fabs( heights[m] - 0.5f*(heights[a]+heights[b]) );
+
+	if ( idx < _nrTriangles-nrSmallest )
+	{
+	    const float leftError = errors[((ay+cy) >> 1)*_size + ((ax+cx) >> 1)];
+	    const float rightError = errors[((by+cy) >> 1)*_size + ((bx+cx) >> 1)];
+	    error += osg::maximum( leftError, rightError );
 	}
 
-	heightfield_ = arr;
+	if ( error>errors[m] )
+	    errors[m] = error;
     }
+}
 
 
-    
-    , _revScale( wl._revScale )
-    , _logWidth( wl._logWidth )
-    , _minShapeValue( wl._minShapeValue )
-    , _minFillValue( wl._minFillValue )
-    , _maxShapeValue( wl._maxShapeValue )
-    , _maxFillValue( wl._maxFillValue )
-    , _geode( new osg::Geode )
-    , _forceCoordReCalculation ( true )
-    , _nonShadingGroup( new osg::Group )
-    , _logWidthChanged( false )
-    , _colorTableChanged( false )
-    , _forceReBuild( false )
-{}
+void RTIN::addTriangle( int ax, int ay, int bx, int by, int cx, int cy, const float* errors, const unsigned char* defined, float tolerance, std::vector<int>& nodeIdxs ) const
+{
+    const int mx = (ax+bx) >> 1;
+    const int my = (ay+by) >> 1;
+    const bool isSmallest = abs(ax-cx) + abs(ay-cy) <= 1;
 
+    if ( !isSmallest && errors[my*_size+mx]>tolerance )
+    {
+	addTriangle( cx, cy, ax, ay, mx, my, errors, defined, tolerance, nodeIdxs );
+	addTriangle( bx, by, cx, cy, mx, my, errors, defined, tolerance, nodeIdxs );
+	return;
+    }
 
+    const int a = ay*_size + ax;
+    int b = by*_size + bx;
+    int c = cy*_size + cx;
+    if ( !defined[a] || !defined[b] || !defined[c] )
+	return;
 
-WellLog::~WellLog()
-{
-    clearDraw();
+    if ( (bx-ax)*(cy-ay) - (by-ay)*(cx-ax) < 0 )
+	std::swap( b, c );
+
+    nodeIdxs.push_back( a );
+    nodeIdxs.push_back( b );
+    nodeIdxs.push_back( c );
 }
 
 
-void WellLog::traverse(osg::NodeVisitor& nv)
+void RTIN::getTriangles( const float* errors, const unsigned char* defined, float tolerance, std::vector<int>& nodeIdxs ) const
 {
-    if ( _logPath && _logPath->size() && _nonShadingGroup ) 
-	_nonShadingGroup->accept(nv);
+    const int max = _size-1;
+    addTriangle( 0, 0, max, max, max, 0, errors, defined, tolerance, nodeIdxs );
+    addTriangle( max, max, 0, 0, 0, max, errors, defined, tolerance, nodeIdxs );
 }
 
 
-void WellLog::setPath( osg::Vec3Array* vtxarraypath )
+//============================================================================
+
+
+/* Level 0 chunk decimated for HeightField::createDecimatedMesh(). Nodes
+   beyond the grid are undefined. */
+
+struct HeightField::DecimationChunk
 {
-    _logPath = vtxarraypath;
-    _forceReBuild = true;
+    Vec2i			_firstNode;
+    std::vector<float>		_heights;
+    std::vector<unsigned char>	_defined;
+    std::vector<float>		_errors;
+    std::vector<int>		_nodeIdxs;	// Chunk-local triangles
+};
+
+
+class HeightField::DecimationThread : public GroupThread<DecimationThread>
+{
+public:
+			DecimationThread(ThreadGroup<DecimationThread>& tg)
+			    : GroupThread<DecimationThread>(tg)
+			{}
+
+    void		set(const HeightField* hf,
+			    std::vector<DecimationChunk>& chunks,
+			    int task,float tolerance,int start,int stop,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _chunks = &chunks;
+			    _task = task;
+			    _tolerance = tolerance;
+			    _start = start;
+			    _stop = stop;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const HeightField*		_hf;
+    std::vector<DecimationChunk>* _chunks;
+    int				_task;
+    float			_tolerance;
+    int				_start;
+    int				_stop;
+};
+
+
+void HeightField::DecimationThread::doWork()
+{
+    for ( int idx=_start; _hf && idx<=_stop; idx++ )
+	_hf->decimateChunk( (*_chunks)[idx], _task, _tolerance );
 }
 
 
-void WellLog::setShapeLog( osg::FloatArray* shapelog )
+class HeightField::PyramidThread : public GroupThread<PyramidThread>
 {
-    _shapeLog = shapelog;
-    _forceReBuild = true;
+public:
+			PyramidThread(ThreadGroup<PyramidThread>& tg)
+			    : GroupThread<PyramidThread>(tg)
+			{}
+
+    void		set(HeightField* hf,int firstBlock,int lastBlock,
+			    int startRow,int stopRow,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _firstBlock = firstBlock;
+			    _lastBlock = lastBlock;
+			    _start = startRow;
+			    _stop = stopRow;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    HeightField*		_hf;
+    int				_firstBlock;
+    int				_lastBlock;
+    int				_start;
+    int				_stop;
+};
+
+
+void HeightField::PyramidThread::doWork()
+{
+    for ( int by=_start; _hf && by<=_stop; by++ )
+    {
+	for ( int bx=_firstBlock; bx<=_lastBlock; bx++ )
+	    _hf->updatePickBlock( bx, by );
+    }
 }
 
 
-void WellLog::setFillLogValues( osg::FloatArray* filllog )
+class HeightField::PickThread : public GroupThread<PickThread>
+{
+public:
+			PickThread(ThreadGroup<PickThread>& tg)
+			    : GroupThread<PickThread>(tg)
+			{}
+
+    void		set(const HeightField* hf,const osg::Vec3Array& starts,
+			    const osg::Vec3Array& ends,std::vector<float>& ratios,
+			    int start,int stop,OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _starts = &starts;
+			    _ends = &ends;
+			    _ratios = &ratios;
+			    _start = start;
+			    _stop = stop;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const HeightField*		_hf;
+    const osg::Vec3Array*	_starts;
+    const osg::Vec3Array*	_ends;
+    std::vector<float>*		_ratios;
+    int				_start;
+    int				_stop;
+};
+
+
+void HeightField::PickThread::doWork()
 {
-    _fillLog = filllog;
-    _forceReBuild = true;
+    for ( int idx=_start; _hf && idx<=_stop; idx++ )
+    {
+	float ratio;
+	if ( !_hf->intersectRay((*_starts)[idx],(*_ends)[idx],ratio) )
+	    ratio = -1.0f;
+
+	(*_ratios)[idx] = ratio;
+    }
 }
 
 
-void WellLog::setMaxShapeValue( float maxvalue )
+//============================================================================
+
+
+/* Contour lines are pieced together by their crossings of cell edges.
+   At a given level, a contour crosses a cell edge at most once, so its
+   key joins exactly two segments, or two pieces from neighbouring tiles.
+   Crossings are always interpolated between the same ordered nodes, so
+   that both sides compute identical points. */
+
+typedef unsigned long long ContourKey;
+
+struct ContourSegment
+{
+    int				_levelIdx;
+    ContourKey			_keys[2];
+    osg::Vec3			_points[2];
+};
+
+
+struct ContourPiece
+{
+				ContourPiece()
+				    : _levelIdx( -1 )
+				    , _isClosed( false )
+				{ _keys[0] = _keys[1] = 0; }
+
+    int				_levelIdx;
+    ContourKey			_keys[2];	// Of first and last point
+    bool			_isClosed;	// Last point repeats first
+    std::vector<osg::Vec3>	_points;
+};
+
+
+struct HeightField::ContourTile
+{
+				ContourTile()
+				    : _isValid( false )
+				{}
+
+    std::vector<ContourPiece>	_pieces;
+    bool			_isValid;
+};
+
+
+static bool isClosed( const ContourSegment& )
+{ return false; }
+
+static bool isClosed( const ContourPiece& piece )
+{ return piece._isClosed; }
+
+static void appendPoints( const osg::Vec3* points, int nrPoints, bool forward, bool skipFirst, std::vector<osg::Vec3>& chain )
 {
-    _maxShapeValue = maxvalue;
-    _forceReBuild = true;
+    for ( int idx=skipFirst ? 1 : 0; idx<nrPoints; idx++ )
+	chain.push_back( points[forward ? idx : nrPoints-1-idx] );
 }
 
+static void appendPoints( const ContourSegment& segment, bool forward, bool skipFirst, std::vector<osg::Vec3>& chain )
+{ appendPoints( segment._points, 2, forward, skipFirst, chain ); }
 
-void WellLog::setMinShapeValue( float minvalue )
+static void appendPoints( const ContourPiece& piece, bool forward, bool skipFirst, std::vector<osg::Vec3>& chain )
+{ appendPoints( &piece._points[0], piece._points.size(), forward, skipFirst, chain ); }
+
+
+/* Joins segments or pieces at their common keys. Chains with a loose end
+   are started there, the remaining ones are closed loops. */
+
+template <class T>
+static void chainPieces( const std::vector<T>& pieces, std::vector<ContourPiece>& chains )
 {
-    _minShapeValue = minvalue;
-    _forceReBuild = true;
+    typedef std::unordered_map<ContourKey,std::pair<int,int> > EndMap;
+    EndMap ends;	// Two piece ends per key, as 2*pieceIdx+end
+
+    const int nrPieces = pieces.size();
+    for ( int idx=0; idx<nrPieces; idx++ )
+    {
+	for ( int end=0; end<2 && !isClosed(pieces[idx]); end++ )
+	{
+	    EndMap::iterator it = ends.find( pieces[idx]._keys[end] );
+	    if ( it==ends.end() )
+		ends[pieces[idx]._keys[end]] = std::pair<int,int>( 2*idx+end, -1 );
+	    else
+		it->second.second = 2*idx+end;
+	}
+    }
+
+    std::vector<bool> done( nrPieces, false );
+    for ( int pass=0; pass<2; pass++ )
+    {
+	for ( int idx=0; idx<nrPieces; idx++ )
+	{
+	    if ( done[idx] )
+		continue;
+
+	    const T& piece = pieces[idx];
+	    int entry = 0;
+	    if ( isClosed(piece) )
+	    {
+		ContourPiece chain;
+		chain._levelIdx = piece._levelIdx;
+		chain._isClosed = true;
+		appendPoints( piece, true, false, chain._points );
+		chains.push_back( chain );
+		done[idx] = true;
+		continue;
+	    }
+	    else if ( pass==0 )
+	    {
+		if ( ends[piece._keys[1]].second<0 )
+		    entry = 1;
+		else if ( ends[piece._keys[0]].second>=0 )
+		    continue;
+	    }
+
+	    ContourPiece chain;
+	    chain._levelIdx = piece._levelIdx;
+	    chain._keys[0] = piece._keys[entry];
+
+	    int cur = idx;
+	    while ( true )
+	    {
+		done[cur] = true;
+		appendPoints( pieces[cur], entry==0, !chain._points.empty(), chain._points );
+
+		const int exit = 1-entry;
+		chain._keys[1] = pieces[cur]._keys[exit];
+
+		const std::pair<int,int>& pair = ends[chain._keys[1]];
+		const int next = pair.first==2*cur+exit ? pair.second : pair.first;
+		if ( next<0 )
+		    break;
+
+		if ( done[next/2] )
+		{
+		    chain._isClosed = next/2==idx;
+		    break;
+		}
+
+		cur = next/2;
+		entry = next%2;
+	    }
+
+	    chains.push_back( chain );
+	}
+    }
 }
 
 
-void WellLog::setMaxFillValue( float maxfillvalue )
+class HeightField::ContourThread : public GroupThread<ContourThread>
+{
+public:
+			ContourThread(ThreadGroup<ContourThread>& tg)
+			    : GroupThread<ContourThread>(tg)
+			{}
+
+    void		set(const HeightField* hf,const std::vector<int>& tileIdxs,
+			    const std::vector<float>& levels,int start,int stop,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _hf = hf;
+			    _tileIdxs = &tileIdxs;
+			    _levels = &levels;
+			    _start = start;
+			    _stop = stop;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const HeightField*		_hf;
+    const std::vector<int>*	_tileIdxs;
+    const std::vector<float>*	_levels;
+    int				_start;
+    int				_stop;
+};
+
+
+void HeightField::ContourThread::doWork()
 {
-    _maxFillValue = maxfillvalue;
-    _forceReBuild = true;
+    for ( int idx=_start; _hf && idx<=_stop; idx++ )
+	_hf->contourTile( (*_tileIdxs)[idx], *_levels );
 }
 
 
-void WellLog::setMinFillValue( float minFillValue )
+struct HeightField::TileRequest
+{
+    bool			operator<(const TileRequest& req) const
+				{ return _chunkIdx>req._chunkIdx; }
+				// Coarser levels first
+
+    int				_chunkIdx;
+    Vec2i			_firstNode;
+    int				_step;
+    bool			_isValid;
+    float			_coarseDev;
+    std::vector<float>		_heights;
+    std::vector<osg::Vec3b>	_normals;
+};
+
+
+/* Holds everything the fetch threads need, so that they never touch the
+   HeightField, which may rebuild its quadtree while tiles are in flight.
+   Each quadtree gets its own queue, so stale tiles are never taken. */
+
+class HeightField::TileQueue : public osg::Referenced
+{
+public:
+			TileQueue(HeightTileSource* source,int chunkSize,
+				  const osg::Vec2& nodeStep,float undefValue)
+			    : _source( source )
+			    , _chunkSize( chunkSize )
+			    , _nodeStep( nodeStep )
+			    , _undefValue( undefValue )
+			{}
+
+    void		fetch(TileRequest&) const;
+    void		addResult(TileRequest& request)
+			{
+			    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+			    _results.push_back( std::move(request) );
+			}
+    void		takeResults(std::vector<TileRequest>& results)
+			{
+			    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+			    results.swap( _results );
+			}
+
+protected:
+    bool		isDefined(float height) const
+			{ return height==height && height!=_undefValue; }
+
+    osg::ref_ptr<HeightTileSource>	_source;
+    int					_chunkSize;
+    osg::Vec2				_nodeStep;
+    float				_undefValue;
+
+    OpenThreads::Mutex			_lock;
+    std::vector<TileRequest>		_results;
+};
+
+
+class HeightField::TileFetchThread : public GroupThread<TileFetchThread>
+{
+public:
+			TileFetchThread(ThreadGroup<TileFetchThread>& tg)
+			    : GroupThread<TileFetchThread>(tg)
+			{}
+
+    void		set(TileQueue* queue,const TileRequest& request,
+			    OpenThreads::BlockCount* ready)
+			{
+			    beginSetFunction( ready );
+
+			    _queue = queue;
+			    _request = request;
+			    endSetFunction();
+			}
+
+    bool		isIdle()
+			{
+			    // The thread only releases its lock while waiting
+			    if ( _lock.trylock() )
+				return false;
+
+			    const bool idle = !_isSet;
+			    _lock.unlock();
+			    return idle;
+			}
+
+protected:
+
+    void			doWork() override;
+
+    osg::ref_ptr<TileQueue>	_queue;
+    TileRequest			_request;
+};
+
+
+void HeightField::TileFetchThread::doWork()
 {
-    _minFillValue = minFillValue;
-    _forceReBuild = true;
+    _queue->fetch( _request );
+    _queue->addResult( _request );
+    _queue = 0;
 }
 
 
-void WellLog::setLogWidth( float logWidth )
+//============================================================================
+
+
+/* Skirt quads below the edges, in vertex order of updateSharedGeometry().
+   Strips of defined edge runs, ended by the restart index like those of
+   GridMeshBuilder, or separate triangles. */
+
+static void addSkirtIndices( const unsigned char* defined, int n, osg::DrawElementsUShort& indices )
 {
-    _logWidth = logWidth;
-    _forceReBuild = true;
-    _logWidthChanged = true;
+    const bool strips = indices.getMode()==GL_TRIANGLE_STRIP;
+    const unsigned short restart = GridMeshBuilder::getRestartIndex( indices.getType() );
+
+    for ( int edge=0; edge<4; edge++ )
+    {
+	const int skirt0 = n*n + edge*n;
+	bool inStrip = false;
+
+	for ( int k=0; k<n-1; k++ )
+	{
+	    const int v0 = edge==0 ? k : edge==1 ? (n-1)*n+k : edge==2 ? k*n : k*n+n-1;
+	    const int v1 = edge<2 ? v0+1 : v0+n;
+	    if ( !defined[v0] || !defined[v1] )
+	    {
+		if ( inStrip )
+		    indices.push_back( restart );
+
+		inStrip = false;
+		continue;
+	    }
+
+	    if ( strips )
+	    {
+		if ( !inStrip )
+		{
+		    indices.push_back( skirt0+k );
+		    indices.push_back( v0 );
+		    inStrip = true;
+		}
+
+		indices.push_back( skirt0+k+1 );
+		indices.push_back( v1 );
+		continue;
+	    }
+
+	    indices.push_back( v0 );
+	    indices.push_back( v1 );
+	    indices.push_back( skirt0+k+1 );
+	    indices.push_back( v0 );
+	    indices.push_back( skirt0+k+1 );
+	    indices.push_back( skirt0+k );
+	}
+
+	if ( inStrip )
+	    indices.push_back( restart );
+    }
 }
 
 
-bool WellLog::eyeChanged( const osg::Vec3 projdir )
+//============================================================================
+
+
+/* Chunk geometries hold grid positions as vertices, which are placed in
+   the vertex shader. Their bounding box is known beforehand. */
+
+class ChunkBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback
+{
+public:
+			ChunkBoundCallback(const osg::BoundingBox& bb)
+			    : _bb( bb )
+			{}
+
+    osg::BoundingBox	computeBound(const osg::Drawable&) const override
+			{ return _bb; }
+
+protected:
+    osg::BoundingBox	_bb;
+};
+
+
+//============================================================================
+
+
+HeightField::HeightField()
+    : _quantizedOffset( 0.0f )
+    , _quantizedScale( 1.0f )
+    , _nrRows( 0 )
+    , _nrCols( 0 )
+    , _origin( 0.0f, 0.0f )
+    , _nodeStep( 1.0f, 1.0f )
+    , _undefValue( 1e30f )
+    , _chunkSize( 64 )
+    , _maxScreenError( 2.0f )
+    , _decimationTolerance( 0.0f )
+    , _heightFormat( QuantizedHeights )
+    , _firstResidentLevel( 0 )
+    , _residentBudget( 256 )
+    , _residentBytes( 0 )
+    , _dirtyStart( 0, 0 )
+    , _dirtyStop( -1, -1 )
+    , _needsUpdate( false )
+    , _needsStateSetUpdate( false )
+    , _needsPaletteUpdate( true )
+    , _isRedrawing( false )
 {
-    return ( projdir != _preProjDir ? true : false );
+    setUpdateVar( _needsStateSetUpdate, true );
+    setDataVariance( DYNAMIC );
 }
 
 
-void WellLog::setFillLogColorTab( osg::Vec4Array* logcolortable )
+HeightField::HeightField( const HeightField& hf, const osg::CopyOp& co )
+    : osg::Node( hf, co )
+    , _heights( osg::clone(hf._heights.get(),co) )
+    , _quantizedHeights( osg::clone(hf._quantizedHeights.get(),co) )
+    , _quantizedOffset( hf._quantizedOffset )
+    , _quantizedScale( hf._quantizedScale )
+    , _nrRows( hf._nrRows )
+    , _nrCols( hf._nrCols )
+    , _origin( hf._origin )
+    , _nodeStep( hf._nodeStep )
+    , _undefValue( hf._undefValue )
+    , _chunkSize( hf._chunkSize )
+    , _maxScreenError( hf._maxScreenError )
+    , _decimationTolerance( hf._decimationTolerance )
+    , _heightFormat( hf._heightFormat )
+    , _palette( hf._palette )
+    , _source( hf._source )
+    , _firstResidentLevel( 0 )
+    , _residentBudget( hf._residentBudget )
+    , _residentBytes( 0 )
+    , _dirtyStart( 0, 0 )
+    , _dirtyStop( -1, -1 )
+    , _needsUpdate( false )
+    , _needsStateSetUpdate( false )
+    , _needsPaletteUpdate( true )
+    , _isRedrawing( false )
 {
-    _colorTable = logcolortable;
-    _colorTableChanged = true;
+    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsStateSetUpdate, true );
 }
 
 
-bool WellLog::getDisplayStatus()
+HeightField::~HeightField()
 {
-    return ( _nonShadingGroup->getNumChildren() > 0 ? true : 0 );
+    // Fetch threads must be back in their pool before being unreffed
+    for ( unsigned int idx=0; idx<_fetchTasks.size(); idx++ )
+    {
+	while ( !_fetchTasks[idx]->isIdle() )
+	    OpenThreads::Thread::YieldCurrentThread();
+    }
 }
 
 
-void WellLog::setShowLog( bool showlog )
+void HeightField::forceRedraw( bool yn )
 {
-    _showLog = showlog;
-    if( _showLog )
-	_forceCoordReCalculation = true;
-    _forceReBuild = true;
+    _redrawLock.lock();
+    if ( _isRedrawing != yn )
+    {
+	_isRedrawing = yn;
+	int num = getNumChildrenRequiringUpdateTraversal();
+	num += yn ? 1 : -1;
+	setNumChildrenRequiringUpdateTraversal( num );
+    }
+    _redrawLock.unlock();
 }
 
 
-void WellLog::setFillLogDepths( osg::FloatArray* depths )
+void HeightField::setUpdateVar( bool& variable, bool yn )
 {
-    _fillLogDepths = depths; 
+    if ( yn )
+	forceRedraw( true );
+
+    variable = yn;
 }
 
 
-void WellLog::clearLog()
+void HeightField::setHeightData( osg::FloatArray* heights, int nrRows, int nrCols )
 {
-    _colorTable->clear();
-    _logPath->clear();	
-    _shapeLog->clear();
-    _fillLog->clear();
-    _fillLogDepths->clear();
-    _minShapeValue =  mMAX ;
-    _minFillValue  =  mMAX ;
-    _maxShapeValue = -mMAX ;
-    _maxFillValue  = -mMAX;
+    if ( heights && (nrRows<1 || nrCols<1 || (int)heights->size()<nrRows*nrCols) )
+    {
+	std::cerr << "HeightField: height array smaller than grid" << std::endl;
+	return;
+    }
 
+    _heights = heights;
+    _quantizedHeights = 0;
+    _source = 0;
+    _nrRows = heights ? nrRows : 0;
+    _nrCols = heights ? nrCols : 0;
+    dirtyContours();
+    setUpdateVar( _needsUpdate, true );
 }
 
 
-void WellLog::setLineColor( const osg::Vec4& lineColor)
+void HeightField::setHeightSource( HeightTileSource* source )
 {
-    (*_lineColor)[0] = lineColor;
-    _lineColor->dirty();
+    _source = source;
+    _heights = 0;
+    _quantizedHeights = 0;
+    _nrRows = source ? source->nrRows() : 0;
+    _nrCols = source ? source->nrCols() : 0;
+    dirtyContours();
+    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsStateSetUpdate, true );
 }
 
 
-const osg::Vec4& WellLog::getLineColor() const
+void HeightField::setResidentBudget( unsigned int megaBytes )
 {
-    return _lineColor->at(0);
+    _residentBudget = megaBytes;
+    forceRedraw( true );
 }
 
 
-void WellLog::setLineWidth(float lineWidth)
+const osg::FloatArray* HeightField::getHeightData() const
+{ return _heights.get(); }
+
+
+void HeightField::setQuantizedHeightData( osg::UShortArray* heights, int nrRows, int nrCols, float offset, float scale )
 {
-    _lineWidth->setWidth( lineWidth );
+    if ( heights && (nrRows<1 || nrCols<1 || (int)heights->size()<nrRows*nrCols) )
+    {
+	std::cerr << "HeightField: height array smaller than grid" << std::endl;
+	return;
+    }
+
+    _quantizedHeights = heights;
+    _quantizedOffset = offset;
+    _quantizedScale = scale;
+    _heights = 0;
+    _source = 0;
+    _nrRows = heights ? nrRows : 0;
+    _nrCols = heights ? nrCols : 0;
+    dirtyContours();
+    setUpdateVar( _needsUpdate, true );
 }
 
 
-float WellLog::getLineWidth() const
+const osg::UShortArray* HeightField::getQuantizedHeightData() const
+{ return _quantizedHeights.get(); }
+
+
+bool HeightField::quantizeHeights( const osg::FloatArray& heights, float undefValue, osg::UShortArray& quantized, float& offset, float& scale )
 {
-    return _lineWidth->getWidth();
+    float min = FLT_MAX, max = -FLT_MAX;
+    for ( unsigned int idx=0; idx<heights.size(); idx++ )
+    {
+	const float height = heights[idx];
+	if ( height!=height || height==undefValue )
+	    continue;
+
+	min = osg::minimum( min, height );
+	max = osg::maximum( max, height );
+    }
+
+    quantized.assign( heights.size(), quantizedUndefValue() );
+    if ( min>max )
+	return false;
+
+    const float maxValue = quantizedUndefValue()-1;
+    offset = min;
+    scale = max>min ? (max-min)/maxValue : 1.0f;
+
+    for ( unsigned int idx=0; idx<heights.size(); idx++ )
+    {
+	const float height = heights[idx];
+	if ( height!=height || height==undefValue )
+	    continue;
+
+	const float value = std::floor( (height-offset)/scale + 0.5f );
+	quantized[idx] = (unsigned short) osg::clampBetween( value, 0.0f, maxValue );
+    }
+
+    return true;
 }
 
 
-void WellLog::clearDraw()
+void HeightField::dirtyHeightData( const Vec2i& start, const Vec2i& stop )
 {
-    _nonShadingGroup->removeChildren( 0, _nonShadingGroup->getNumChildren() );
+    if ( _source )
+	return;
+
+    Vec2i newStop( stop.x()<0 ? _nrCols-1 : stop.x(),
+		   stop.y()<0 ? _nrRows-1 : stop.y() );
+
+    if ( _dirtyStop.x()<_dirtyStart.x() )	// Nothing dirty yet
+    {
+	_dirtyStart = start;
+	_dirtyStop = newStop;
+    }
+    else
+    {
+	for ( int dim=0; dim<=1; dim++ )
+	{
+	    _dirtyStart[dim] = osg::minimum( _dirtyStart[dim], start[dim] );
+	    _dirtyStop[dim] = osg::maximum( _dirtyStop[dim], newStop[dim] );
+	}
+    }
+
+    dirtyContours( start, newStop );
+    forceRedraw( true );
 }
 
 
-float WellLog::getShapeFactor(float val, float minval, float maxval )const
+void HeightField::setGridGeometry( const osg::Vec2& origin, const osg::Vec2& nodeStep )
 {
-    float res = (val-minval)/(maxval-minval);
-    if ( res<0 ) res = 0;
-    else if ( res>1 ) res = 1;
+    _origin = origin;
+    _nodeStep = nodeStep;
+    dirtyContours();
+    setUpdateVar( _needsUpdate, true );
+}
+
 
-    return res;
+void HeightField::setUndefValue( float undefValue )
+{
+    _undefValue = undefValue;
+    dirtyContours();
+    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsStateSetUpdate, true );
 }
 
 
-osg::Vec3 WellLog::getPrjDirection( const osgUtil::CullVisitor* cv ) const
+void HeightField::setChunkSize( int nrQuads )
 {
-    osg::Vec3 projdir( 0, 0, 0 );
-    if( !cv ) return projdir;
-    const osg::Camera* ca = 
-	const_cast<osgUtil::CullVisitor*>(cv)->getCurrentCamera();
-    osg::Vec3 up;
-    osg::Vec3 eye;
-    osg::Vec3 center;
-    ca->getViewMatrixAsLookAt( eye,center,up );
-    projdir = center - eye;
-    projdir.normalize();
-    return projdir;
+    int size = 8;
+    while ( size<128 && size*2<=nrQuads )
+	size *= 2;
+
+    if ( _chunkSize != size )
+    {
+	_chunkSize = size;
+	dirtyContours();
+	setUpdateVar( _needsUpdate, true );
+    }
 }
 
 
-void WellLog::setFillRevScale( bool yn )
+void HeightField::setMaxScreenError( float pixels )
 {
-    _fillRevScale = yn; 
+    _maxScreenError = pixels>0.0f ? pixels : 0.0f;
+    forceRedraw( true );
 }
 
 
-void WellLog::setRevScale( bool yn ) 
+void HeightField::setHeightFormat( HeightFormat format )
 {
-    _revScale = yn; 
+    if ( _heightFormat != format )
+    {
+	_heightFormat = format;
+	setUpdateVar( _needsUpdate, true );
+    }
 }
 
 
-struct ClosestCmp 
+void HeightField::setDecimationTolerance( float tolerance )
 {
-    bool operator()(const float &val1, const float& val2) 
+    tolerance = tolerance>0.0f ? tolerance : 0.0f;
+    if ( _decimationTolerance != tolerance )
     {
-	return val1 > val2;
+	_decimationTolerance = tolerance;
+	setUpdateVar( _needsUpdate, true );
     }
-};
+}
+
+
+void HeightField::setPalette( const Palette& palette )
+{
+    _palette = palette;
+    _needsPaletteUpdate = true;
+    setUpdateVar( _needsStateSetUpdate, true );
+}
+
+
+bool HeightField::getHeightRange( float& min, float& max ) const
+{
+    if ( _chunks.empty() || _chunks.back()._isEmpty )
+	return false;
+
+    min = _chunks.back()._minHeight;
+    max = _chunks.back()._maxHeight;
+    return true;
+}
+
 
+bool HeightField::hasHeightData() const
+{ return _heights.valid() || _quantizedHeights.valid(); }
 
-int WellLog::getClosestIndex(const osg::FloatArray& arr, float val)
+
+bool HeightField::isDefined( float height ) const
 {
-    osg::FloatArray::const_iterator it =
-	std::lower_bound(arr.begin(), arr.end(), val, ClosestCmp());
+    return height==height && height!=_undefValue;	// Not NaN
+}
 
-    if (it != arr.end()) 
-	return std::distance(arr.begin(),it);
 
-    return -1;
+float HeightField::getHeight( int col, int row ) const
+{
+    if ( col>=_nrCols ) col = _nrCols-1;
+    if ( row>=_nrRows ) row = _nrRows-1;
+
+    return getNodeHeight( row*_nrCols+col );
 }
 
-}// Namespace
 
-#include <osgDB/ObjectWrapper>
-#include <osgDB/Registry>
-#include <osgDB/Serializer>
+float HeightField::getNodeHeight( int nodeIdx ) const
+{
+    if ( _heights )
+	return (*_heights)[nodeIdx];
+
+    const unsigned short value = (*_quantizedHeights)[nodeIdx];
+    return value==quantizedUndefValue() ? _undefValue : _quantizedOffset + _quantizedScale*value;
+}
 
 
-REGISTER_OBJECT_WRAPPER( WellLog_Wrapper,
-                        0,
-                        vsgGeo::WellLog,
-                        "osg::Object osg::Node vsgGeo::WellLog")
+const float* HeightField::getHeightRow( int row, int firstCol, int lastCol, float* buffer ) const
 {
-    ADD_OBJECT_SERIALIZER( Path, osg::Vec3Array, NULL );
+    if ( _heights )
+	return &(*_heights)[row*_nrCols+firstCol];
 
-    ADD_OBJECT_SERIALIZER( ShapeLog, osg::FloatArray, NULL );
-    ADD_FLOAT_SERIALIZER( MaxShapeValue, -mMAX );
-    ADD_FLOAT_SERIALIZER( MinShapeValue, mMAX );
+    const unsigned short* values = &(*_quantizedHeights)[row*_nrCols];
+    for ( int col=firstCol; col<=lastCol; col++ )
+    {
+	const unsigned short value = values[col];
+	buffer[col-firstCol] = value==quantizedUndefValue() ? _undefValue : _quantizedOffset + _quantizedScale*value;
+    }
 
-    ADD_OBJECT_SERIALIZER( FillLogValues, osg::FloatArray, NULL );
-    ADD_FLOAT_SERIALIZER( MaxFillValue, -mMAX );
-    ADD_FLOAT_SERIALIZER( MinFillValue, mMAX );
+    return buffer;
+}
 
-    ADD_OBJECT_SERIALIZER(FillLogColorTab, osg::Vec4Array, NULL );
 
-    ADD_BOOL_SERIALIZER(ShowLog, true );
+int HeightField::nrLevels() const
+{ return _levelSizes.size(); }
 
-    ADD_FLOAT_SERIALIZER( LogWidth, 250 );
 
-    ADD_BOOL_SERIALIZER( RevScale, false );
-    ADD_BOOL_SERIALIZER( FillRevScale, false );
+int HeightField::getChunkIdx( int level, int cx, int cy ) const
+{ return _levelOffsets[level] + cy*_levelSizes[level].x() + cx; }
 
-    BEGIN_ENUM_SERIALIZER( DisplaySide, Right );
-    	ADD_ENUM_VALUE( Left );
-    	ADD_ENUM_VALUE( Right );
-    END_ENUM_SERIALIZER();
 
-    ADD_UINT_SERIALIZER(RepeatNumber, 0);
-    ADD_FLOAT_SERIALIZER(RepeatGap, 1 );
+int HeightField::getChunkSpan( int level ) const
+{ return _chunkSize << level; }
 
-    ADD_BOOL_SERIALIZER( FullFilled, true);
-    ADD_BOOL_SERIALIZER( SeisLogStyle, false );
 
-    ADD_BOOL_SERIALIZER( LogFill, true );
-    ADD_FLOAT_SERIALIZER( LineWidth, 1 );
+int HeightField::getParentIdx( const Chunk& chunk ) const
+{
+    if ( chunk._level+1>=nrLevels() )
+	return -1;
 
-    ADD_VEC4_SERIALIZER( LineColor, osg::Vec4(1,0,0,0) );
-    ADD_INT_SERIALIZER(Resolution, 1);
+    const int span = getChunkSpan( chunk._level+1 );
+    return getChunkIdx( chunk._level+1, chunk._firstNode.x()/span, chunk._firstNode.y()/span );
 }
 
+
+void HeightField::traverse( osg::NodeVisitor& nv )
+{
+    if ( nv.getVisitorType()==osg::NodeVisitor::UPDATE_VISITOR )
+    {
+	forceRedraw( false );
+
+	if ( _needsUpdate )
+	{
+	    buildQuadTree();
+	    _needsUpdate = false;
+	    _dirtyStop = Vec2i( -1, -1 );
+	}
+	else if ( _dirtyStop.x()>=_dirtyStart.x() )
+	{
+	    updateQuadTree( _dirtyStart, _dirtyStop );
+	    _dirtyStop = Vec2i( -1, -1 );
+	}
+
+	if ( _needsStateSetUpdate )
+	{
+	    updateStateSet();
+	    _needsStateSetUpdate = false;
+	}
+
+	const osg::FrameStamp* fs = nv.getFrameStamp();
+	updateChunks( fs ? fs->getFrameNumber() : 0 );
+    }
+    else if ( nv.getVisitorType()==osg::NodeVisitor::CULL_VISITOR )
+    {
+	osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(&nv);
+	if ( !cv || _chunks.empty() )
+	    return;
+
+	const osg::FrameStamp* fs = cv->getFrameStamp();
+	std::vector<int> drawIdxs;
+	selectChunks( _levelOffsets.back(), *cv, drawIdxs, fs ? fs->getFrameNumber() : 0 );
+
+	if ( _stateset )
+	    cv->pushStateSet( _stateset.get() );
+
+	for ( unsigned int idx=0; idx<drawIdxs.size(); idx++ )
+	{
+	    osg::Geometry* geometry = _chunks[drawIdxs[idx]]._geometry.get();
+	    const osg::BoundingBox& bb = _chunks[drawIdxs[idx]]._bb;
+
+	    cv->pushStateSet( geometry->getStateSet() );
+	    const float depth = cv->getDistanceFromEyePoint(bb.center(),false);
+	    cv->addDrawableAndDepth( geometry, cv->getModelViewMatrix(), depth );
+	    cv->popStateSet();
+	}
+
+	if ( _stateset )
+	    cv->popStateSet();
+
+	if ( _bbox.valid() )
+	    cv->updateCalculatedNearFar( *cv->getModelViewMatrix(), _bbox );
+
+	_requestLock.lock();
+	const bool buildsPending = !_requestedChunks.empty();
+	_requestLock.unlock();
+
+	if ( buildsPending )
+	    forceRedraw( true );
+    }
+    else
+    {
+	osgUtil::IntersectionVisitor* iv =
+			dynamic_cast<osgUtil::IntersectionVisitor*>( &nv );
+	if ( iv )
+	{
+	    /* Chunk geometries are placed by the shader, so line segments
+	       are intersected against the height pyramid instead */
+	    osg::ref_ptr<osgUtil::Intersector> intersec = iv->getIntersector()->clone( *iv );
+	    osgUtil::LineSegmentIntersector* lsi =
+		dynamic_cast<osgUtil::LineSegmentIntersector*>( intersec.get() );
+
+	    float ratio;
+	    osg::Vec3 normal;
+	    if ( lsi && intersectRay(lsi->getStart(),lsi->getEnd(),ratio,&normal) )
+	    {
+		osgUtil::LineSegmentIntersector::Intersection intersection;
+		intersection.ratio = ratio;
+		intersection.nodePath = iv->getNodePath();
+		intersection.matrix = iv->getModelMatrix();
+		intersection.localIntersectionPoint = lsi->getStart()*(1.0f-ratio) + lsi->getEnd()*ratio;
+		intersection.localIntersectionNormal = normal;
+		lsi->insertIntersection( intersection );
+	    }
+
+	    return;
+	}
+
+	vsgGeo::ComputeBoundsVisitor* cbv =
+	    dynamic_cast<vsgGeo::ComputeBoundsVisitor*>( &nv );
+	if ( cbv && _bbox.valid() )
+	    cbv->applyBoundingBox( _bbox );
+    }
+}
+
+
+osg::BoundingSphere HeightField::computeBound() const
+{
+    return _bbox.valid() ? osg::BoundingSphere(_bbox) : osg::BoundingSphere();
+}
+
+
+void HeightField::buildQuadTree()
+{
+    _chunks.clear();
+    _levelOffsets.clear();
+    _levelSizes.clear();
+
+    _requestLock.lock();
+    _requestedChunks.clear();
+    _prefetchChunks.clear();
+    _requestLock.unlock();
+
+    _tileQueue = 0;
+    _residentBytes = 0;
+    updateSharedGeometry();
+
+    if ( (!hasHeightData() && !_source) || _nrRows<1 || _nrCols<1 )
+    {
+	_pickPyramid.clear();
+	_pickPyramidSizes.clear();
+	_bbox.init();
+	dirtyBound();
+	return;
+    }
+
+    // Level 0 at full resolution, up to one root chunk covering all
+    for ( int level=0; level<31; level++ )
+    {
+	const int span = getChunkSpan( level );
+	const Vec2i size( osg::maximum((_nrCols-2)/span+1,1),
+			  osg::maximum((_nrRows-2)/span+1,1) );
+
+	_levelOffsets.push_back( _chunks.size() );
+	_levelSizes.push_back( size );
+
+	for ( int cy=0; cy<size.y(); cy++ )
+	{
+	    for ( int cx=0; cx<size.x(); cx++ )
+	    {
+		Chunk chunk;
+		chunk._level = level;
+		chunk._firstNode = Vec2i( cx*span, cy*span );
+
+		for ( int idx=0; level>0 && idx<4; idx++ )
+		{
+		    const Vec2i& childSize = _levelSizes[level-1];
+		    const int ccx = 2*cx + idx%2;
+		    const int ccy = 2*cy + idx/2;
+		    if ( ccx<childSize.x() && ccy<childSize.y() )
+			chunk._children[idx] = getChunkIdx( level-1, ccx, ccy );
+		}
+
+		_chunks.push_back( chunk );
+	    }
+	}
+
+	if ( size.x()==1 && size.y()==1 )
+	    break;
+    }
+
+    if ( _source )
+    {
+	// Only features on in-memory heights use these
+	_pickPyramid.clear();
+	_pickPyramidSizes.clear();
+	_normalMap = 0;
+	_normalTexture = 0;
+
+	loadCoarseLevels();
+	return;
+    }
+
+    updateQuadTree( Vec2i(0,0), Vec2i(_nrCols-1,_nrRows-1) );
+}
+
+
+void HeightField::updateQuadTree( const Vec2i& start, const Vec2i& stop )
+{
+    if ( _chunks.empty() )
+	return;
+
+    std::vector<int> chunkIdxs;
+
+    // Bottom-up, as chunks are bounded by their children
+    for ( int level=0; level<nrLevels(); level++ )
+    {
+	const int span = getChunkSpan( level );
+	const Vec2i& size = _levelSizes[level];
+
+	// Neighbouring chunks share their border nodes
+	Vec2i first, last;
+	for ( int dim=0; dim<=1; dim++ )
+	{
+	    first[dim] = start[dim]>0 ? (start[dim]-1)/span : 0;
+	    last[dim] = osg::minimum( stop[dim]/span, size[dim]-1 );
+	}
+
+	chunkIdxs.clear();
+	for ( int cy=first.y(); cy<=last.y(); cy++ )
+	{
+	    for ( int cx=first.x(); cx<=last.x(); cx++ )
+	    {
+		const int chunkIdx = getChunkIdx( level, cx, cy );
+		_chunks[chunkIdx]._isDirty = true;
+		chunkIdxs.push_back( chunkIdx );
+	    }
+	}
+
+	runChunkTasks( chunkIdxs, UpdateChunks );
+    }
+
+    _bbox.init();
+    for ( unsigned int idx=0; idx<_chunks.size(); idx++ )
+    {
+	Chunk& chunk = _chunks[idx];
+	updateSkirtDepth( chunk );
+
+	chunk._bb.init();
+	if ( !chunk._isEmpty )
+	    setChunkBound( chunk, chunk._minHeight-chunk._skirtDepth, chunk._maxHeight );
+    }
+
+    _bbox = _chunks.back()._bb;
+    updateNormalMap( start, stop );
+    updatePickPyramid( start, stop );
+    setUpdateVar( _needsStateSetUpdate, true );
+    dirtyBound();
+}
+
+
+void HeightField::updateSkirtDepth( Chunk& chunk )
+{
+    // Skirts must cover the cracks towards the coarser neighbours
+    float skirtDepth = chunk._error + _decimationTolerance;
+    const int parentIdx = getParentIdx( chunk );
+    if ( parentIdx>=0 )
+	skirtDepth = osg::maximum( skirtDepth, _chunks[parentIdx]._error+_decimationTolerance );
+
+    if ( chunk._skirtDepth!=skirtDepth && chunk._geometry )
+	chunk._geometry->getStateSet()->getUniform("skirtDepth")->set( skirtDepth );
+
+    chunk._skirtDepth = skirtDepth;
+}
+
+
+void HeightField::setChunkBound( Chunk& chunk, float zMin, float zMax ) const
+{
+    const int span = getChunkSpan( chunk._level );
+    const int lastCol = osg::minimum( chunk._firstNode.x()+span, _nrCols-1 );
+    const int lastRow = osg::minimum( chunk._firstNode.y()+span, _nrRows-1 );
+
+    chunk._bb.init();
+    chunk._bb.expandBy( _origin.x() + chunk._firstNode.x()*_nodeStep.x(),
+			_origin.y() + chunk._firstNode.y()*_nodeStep.y(), zMin );
+    chunk._bb.expandBy( _origin.x() + lastCol*_nodeStep.x(),
+			_origin.y() + lastRow*_nodeStep.y(), zMax );
+}
+
+
+void HeightField::updatePickBlock( int bx, int by )
+{
+    const int lastCol = osg::minimum( (bx+1)*PICK_BLOCK_SIZE, _nrCols-1 );
+    const int lastRow = osg::minimum( (by+1)*PICK_BLOCK_SIZE, _nrRows-1 );
+
+    const int firstCol = bx*PICK_BLOCK_SIZE;
+    std::vector<float> buffer( lastCol-firstCol+1 );
+
+    osg::Vec2 minMax( FLT_MAX, -FLT_MAX );
+    for ( int row=by*PICK_BLOCK_SIZE; row<=lastRow; row++ )
+    {
+	const float* heights = getHeightRow( row, firstCol, lastCol, &buffer[0] );
+	for ( int col=firstCol; col<=lastCol; col++ )
+	{
+	    const float height = heights[col-firstCol];
+	    if ( !isDefined(height) )
+		continue;
+
+	    minMax.x() = osg::minimum( minMax.x(), height );
+	    minMax.y() = osg::maximum( minMax.y(), height );
+	}
+    }
+
+    _pickPyramid[0][by*_pickPyramidSizes[0].x()+bx] = minMax;
+}
+
+
+void HeightField::updatePickPyramid( const Vec2i& start, const Vec2i& stop )
+{
+    if ( _nrRows<2 || _nrCols<2 )
+    {
+	_pickPyramid.clear();
+	_pickPyramidSizes.clear();
+	return;
+    }
+
+    Vec2i size( (_nrCols-2)/PICK_BLOCK_SIZE+1, (_nrRows-2)/PICK_BLOCK_SIZE+1 );
+    Vec2i first( 0, 0 );
+    Vec2i last = size - Vec2i( 1, 1 );
+
+    if ( _pickPyramidSizes.empty() || _pickPyramidSizes[0]!=size )
+    {
+	_pickPyramid.clear();
+	_pickPyramidSizes.clear();
+	while ( true )
+	{
+	    _pickPyramidSizes.push_back( size );
+	    _pickPyramid.push_back( std::vector<osg::Vec2>(size.x()*size.y()) );
+	    if ( size.x()==1 && size.y()==1 )
+		break;
+
+	    size = Vec2i( (size.x()+1)/2, (size.y()+1)/2 );
+	}
+    }
+    else
+    {
+	// Blocks share their border nodes
+	for ( int dim=0; dim<=1; dim++ )
+	{
+	    first[dim] = start[dim]>0 ? (start[dim]-1)/PICK_BLOCK_SIZE : 0;
+	    last[dim] = osg::minimum( stop[dim]/PICK_BLOCK_SIZE, last[dim] );
+	}
+    }
+
+    const int nrRows = last.y()-first.y()+1;
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrRows )
+	nrTasks = nrRows;
+
+    if ( !_pyramidThreads )
+	_pyramidThreads = ThreadGroup<PyramidThread>::getInst();
+
+    std::vector<osg::ref_ptr<PyramidThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrRows%nrTasks;
+    int startRow = first.y();
+
+    while ( startRow<=last.y() )
+    {
+	int stopRow = startRow + nrRows/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stopRow--;
+
+	osg::ref_ptr<PyramidThread> task = _pyramidThreads->getThread();
+	task->set( this, first.x(), last.x(), startRow, stopRow, readyCount );
+
+	tasks.push_back( task.get() );
+
+	startRow = stopRow+1;
+    }
+
+    readyCount.block();
+
+    // Coarser levels are small enough to update sequentially
+    for ( int level=1; level<(int)_pickPyramidSizes.size(); level++ )
+    {
+	first = first / 2;
+	last = last / 2;
+
+	const Vec2i& childSize = _pickPyramidSizes[level-1];
+	const int width = _pickPyramidSizes[level].x();
+
+	for ( int by=first.y(); by<=last.y(); by++ )
+	{
+	    for ( int bx=first.x(); bx<=last.x(); bx++ )
+	    {
+		osg::Vec2 minMax( FLT_MAX, -FLT_MAX );
+		for ( int idx=0; idx<4; idx++ )
+		{
+		    const int cx = 2*bx + idx%2;
+		    const int cy = 2*by + idx/2;
+		    if ( cx>=childSize.x() || cy>=childSize.y() )
+			continue;
+
+		    const osg::Vec2& child = _pickPyramid[level-1][cy*childSize.x()+cx];
+		    minMax.x() = osg::minimum( minMax.x(), child.x() );
+		    minMax.y() = osg::maximum( minMax.y(), child.y() );
+		}
+
+		_pickPyramid[level][by*width+bx] = minMax;
+	    }
+	}
+    }
+}
+
+
+#define UPDATE_DEVIATION( h, h0, h1 ) \
+    if ( isDefined(h) && isDefined(h0) && isDefined(h1) ) \
+    { \
+	const float dev = fabs( (h) - 0.5f*((h0)+(h1)) ); \
+	if ( dev>maxDev ) \
+	    maxDev = dev; \
+    }
+
+void HeightField::updateChunk( int chunkIdx )
+{
+    Chunk& chunk = _chunks[chunkIdx];
+    chunk._isEmpty = true;
+    chunk._error = 0.0f;
+
+    if ( !chunk._level )
+    {
+	const int firstCol = chunk._firstNode.x();
+	const int lastCol = osg::minimum( firstCol+_chunkSize, _nrCols-1 );
+	const int lastRow = osg::minimum( chunk._firstNode.y()+_chunkSize, _nrRows-1 );
+	std::vector<float> buffer( lastCol-firstCol+1 );
+
+	for ( int row=chunk._firstNode.y(); row<=lastRow; row++ )
+	{
+	    const float* heights = getHeightRow( row, firstCol, lastCol, &buffer[0] );
+	    for ( int col=firstCol; col<=lastCol; col++ )
+	    {
+		const float height = heights[col-firstCol];
+		if ( !isDefined(height) )
+		    continue;
+
+		if ( chunk._isEmpty || height<chunk._minHeight )
+		    chunk._minHeight = height;
+		if ( chunk._isEmpty || height>chunk._maxHeight )
+		    chunk._maxHeight = height;
+
+		chunk._isEmpty = false;
+	    }
+	}
+
+	return;
+    }
+
+    for ( int idx=0; idx<4; idx++ )
+    {
+	if ( chunk._children[idx]<0 )
+	    continue;
+
+	const Chunk& child = _chunks[chunk._children[idx]];
+	chunk._error = osg::maximum( chunk._error, child._error );
+	if ( child._isEmpty )
+	    continue;
+
+	if ( chunk._isEmpty || child._minHeight<chunk._minHeight )
+	    chunk._minHeight = child._minHeight;
+	if ( chunk._isEmpty || child._maxHeight>chunk._maxHeight )
+	    chunk._maxHeight = child._maxHeight;
+
+	chunk._isEmpty = false;
+    }
+
+    if ( chunk._isEmpty )
+	return;
+
+    /* Deviation of the child vertices from the coarse triangles, whose
+       diagonal runs from vertex (i,j) to (i+1,j+1) */
+    const int step = 1 << chunk._level;
+    const int half = step/2;
+    float maxDev = 0.0f;
+
+    for ( int j=0; j<=_chunkSize; j++ )
+    {
+	const int row = chunk._firstNode.y() + j*step;
+	if ( row>=_nrRows )
+	    break;
+
+	for ( int i=0; i<=_chunkSize; i++ )
+	{
+	    const int col = chunk._firstNode.x() + i*step;
+	    if ( col>=_nrCols )
+		break;
+
+	    const float h00 = getHeight( col, row );
+	    const bool hasCol = i<_chunkSize && col+half<_nrCols;
+	    const bool hasRow = j<_chunkSize && row+half<_nrRows;
+
+	    if ( hasCol )
+		UPDATE_DEVIATION( getHeight(col+half,row), h00, getHeight(col+step,row) );
+	    if ( hasRow )
+		UPDATE_DEVIATION( getHeight(col,row+half), h00, getHeight(col,row+step) );
+	    if ( hasCol && hasRow )
+		UPDATE_DEVIATION( getHeight(col+half,row+half), h00, getHeight(col+step,row+step) );
+	}
+    }
+
+    chunk._error += maxDev;
+}
+
+
+/* Tiles are read with a border of one node, for central differences at
+   their edges. Differences over grid borders span the clamped nodes. */
+
+void HeightField::TileQueue::fetch( TileRequest& request ) const
+{
+    const int n = _chunkSize+1;
+    const int m = n+2;
+    const int step = request._step;
+    const Vec2i& first = request._firstNode;
+
+    std::vector<float> bordered;
+    request._isValid = _source->readTile( first-Vec2i(step,step), step, Vec2i(m,m), bordered ) && (int)bordered.size()>=m*m;
+    if ( !request._isValid )
+	return;
+
+    std::vector<int> cols( m ), rows( m );
+    for ( int k=0; k<m; k++ )
+    {
+	cols[k] = osg::clampBetween( first.x()+(k-1)*step, 0, _source->nrCols()-1 );
+	rows[k] = osg::clampBetween( first.y()+(k-1)*step, 0, _source->nrRows()-1 );
+    }
+
+    request._heights.resize( n*n );
+    request._normals.resize( n*n );
+
+    for ( int j=0; j<n; j++ )
+    {
+	for ( int i=0; i<n; i++ )
+	{
+	    const float* mid = &bordered[(j+1)*m+i+1];
+	    const float h = *mid;
+	    const bool defined = isDefined( h );
+	    request._heights[j*n+i] = defined ? h : _undefValue;
+
+	    const bool hasLeft = cols[i]<cols[i+1] && isDefined(mid[-1]);
+	    const bool hasRight = cols[i+2]>cols[i+1] && isDefined(mid[1]);
+	    const bool hasUp = rows[j]<rows[j+1] && isDefined(mid[-m]);
+	    const bool hasDown = rows[j+2]>rows[j+1] && isDefined(mid[m]);
+
+	    const int dx = (hasRight ? cols[i+2] : cols[i+1]) - (hasLeft ? cols[i] : cols[i+1]);
+	    const int dy = (hasDown ? rows[j+2] : rows[j+1]) - (hasUp ? rows[j] : rows[j+1]);
+	    const float dhdx = dx ? ((hasRight ? mid[1] : h) - (hasLeft ? mid[-1] : h)) / (dx*_nodeStep.x()) : 0.0f;
+	    const float dhdy = dy ? ((hasDown ? mid[m] : h) - (hasUp ? mid[-m] : h)) / (dy*_nodeStep.y()) : 0.0f;
+
+	    // Flat at undefined nodes, like the normal map
+	    const float nx = defined ? -dhdx : 0.0f;
+	    const float ny = defined ? -dhdy : 0.0f;
+	    const float scale = 127.0f / std::sqrt( nx*nx + ny*ny + 1.0f );
+	    request._normals[j*n+i] = osg::Vec3b( (signed char) (nx*scale), (signed char) (ny*scale), (signed char) scale );
+	}
+    }
+
+    // Deviation of the parent's triangles from this tile, as in updateChunk()
+    const float* h = &request._heights[0];
+    float maxDev = 0.0f;
+
+    for ( int j=0; j<n; j+=2 )
+    {
+	for ( int i=0; i<n; i+=2 )
+	{
+	    const float h00 = h[j*n+i];
+	    const bool hasCol = i<_chunkSize;
+	    const bool hasRow = j<_chunkSize;
+
+	    if ( hasCol )
+		UPDATE_DEVIATION( h[j*n+i+1], h00, h[j*n+i+2] );
+	    if ( hasRow )
+		UPDATE_DEVIATION( h[(j+1)*n+i], h00, h[(j+2)*n+i] );
+	    if ( hasCol && hasRow )
+		UPDATE_DEVIATION( h[(j+1)*n+i+1], h00, h[(j+2)*n+i+2] );
+	}
+    }
+
+    request._coarseDev = maxDev;
+}
+
+
+void HeightField::loadCoarseLevels()
+{
+    _tileQueue = new TileQueue( _source.get(), _chunkSize, _nodeStep, _undefValue );
+
+    // The coarsest levels up to a fixed number of chunks stay resident
+    _firstResidentLevel = nrLevels()-1;
+    while ( _firstResidentLevel>0 && (int)_chunks.size()-_levelOffsets[_firstResidentLevel-1]<=MAX_RESIDENT_CHUNKS )
+	_firstResidentLevel--;
+
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+    if ( nrTasks<1 )
+	nrTasks = 1;
+
+    const int nrChunks = _chunks.size();
+    for ( int start=_levelOffsets[_firstResidentLevel]; start<nrChunks; start+=nrTasks )
+    {
+	const int stop = osg::minimum( start+nrTasks, nrChunks );
+	OpenThreads::BlockCount readyCount( stop-start );
+	readyCount.reset();
+
+	for ( int idx=start; idx<stop; idx++ )
+	    fetchTile( idx, &readyCount );
+
+	readyCount.block();
+    }
+
+    applyFetchedTiles();
+    setUpdateVar( _needsStateSetUpdate, true );
+}
+
+
+void HeightField::fetchTile( int chunkIdx, OpenThreads::BlockCount* ready )
+{
+    Chunk& chunk = _chunks[chunkIdx];
+    chunk._isFetching = true;
+
+    TileRequest request;
+    request._chunkIdx = chunkIdx;
+    request._firstNode = chunk._firstNode;
+    request._step = 1 << chunk._level;
+    request._isValid = false;
+    request._coarseDev = 0.0f;
+
+    if ( !_fetchThreads )
+	_fetchThreads = ThreadGroup<TileFetchThread>::getInst();
+
+    osg::ref_ptr<TileFetchThread> thread = _fetchThreads->getThread();
+    thread->set( _tileQueue.get(), request, ready );
+    _fetchTasks.push_back( thread );
+}
+
+
+/* Finer levels of streamed grids are unknown until fetched. A chunk's
+   error is estimated by the deviation of its every other node, and raised
+   as its children arrive. Unfetched children take the height range of
+   their parent. */
+
+void HeightField::applyTile( TileRequest& request )
+{
+    Chunk& chunk = _chunks[request._chunkIdx];
+    chunk._isFetching = false;
+    if ( !request._isValid )	// Fetched again on the next request
+	return;
+
+    _residentBytes -= chunk.tileBytes();
+    chunk._tileHeights.swap( request._heights );
+    chunk._tileNormals.swap( request._normals );
+    _residentBytes += chunk.tileBytes();
+    chunk._coarseDev = request._coarseDev;
+    chunk._hasTile = true;
+    chunk._isDirty = true;
+
+    chunk._isEmpty = true;
+    for ( unsigned int idx=0; idx<chunk._tileHeights.size(); idx++ )
+    {
+	const float height = chunk._tileHeights[idx];
+	if ( !isDefined(height) )
+	    continue;
+
+	if ( chunk._isEmpty || height<chunk._minHeight )
+	    chunk._minHeight = height;
+	if ( chunk._isEmpty || height>chunk._maxHeight )
+	    chunk._maxHeight = height;
+
+	chunk._isEmpty = false;
+    }
+
+    if ( chunk._level )
+	chunk._error = osg::maximum( chunk._error, chunk._coarseDev );
+
+    updateSkirtDepth( chunk );
+    chunk._bb.init();
+    if ( !chunk._isEmpty )
+	setChunkBound( chunk, chunk._minHeight-chunk._skirtDepth, chunk._maxHeight );
+
+    for ( int idx=0; idx<4; idx++ )
+    {
+	if ( chunk._children[idx]<0 )
+	    continue;
+
+	Chunk& child = _chunks[chunk._children[idx]];
+	if ( child._hasTile )
+	{
+	    if ( child._bb.valid() )
+		chunk._bb.expandBy( child._bb );
+	    continue;
+	}
+
+	child._isEmpty = chunk._isEmpty;
+	if ( !chunk._isEmpty )
+	    setChunkBound( child, chunk._bb.zMin(), chunk._bb.zMax() );
+    }
+
+    // The parent's own deviation over this chunk comes on top of its error
+    Chunk* child = &chunk;
+    for ( int parentIdx=getParentIdx(chunk); parentIdx>=0; parentIdx=getParentIdx(*child) )
+    {
+	Chunk& parent = _chunks[parentIdx];
+	const float error = child->_error + child->_coarseDev;
+
+	osg::BoundingBox bb = parent._bb;
+	if ( child->_bb.valid() )
+	    bb.expandBy( child->_bb );
+
+	if ( error<=parent._error && bb==parent._bb )
+	    break;
+
+	parent._error = osg::maximum( parent._error, error );
+	parent._bb = bb;
+
+	updateSkirtDepth( parent );
+	for ( int idx=0; idx<4; idx++ )
+	{
+	    if ( parent._children[idx]>=0 )
+		updateSkirtDepth( _chunks[parent._children[idx]] );
+	}
+
+	child = &parent;
+    }
+}
+
+
+void HeightField::applyFetchedTiles()
+{
+    std::vector<TileRequest> results;
+    _tileQueue->takeResults( results );
+
+    // Parents first, as they estimate the bounds of their children
+    std::sort( results.begin(), results.end() );
+    for ( unsigned int idx=0; idx<results.size(); idx++ )
+	applyTile( results[idx] );
+
+    for ( int idx=_fetchTasks.size()-1; idx>=0; idx-- )
+    {
+	if ( _fetchTasks[idx]->isIdle() )
+	    _fetchTasks.erase( _fetchTasks.begin()+idx );
+    }
+
+    if ( !_chunks.empty() && _bbox!=_chunks.back()._bb )
+    {
+	_bbox = _chunks.back()._bb;
+	dirtyBound();
+    }
+}
+
+
+void HeightField::evictTiles( unsigned int frameNr )
+{
+    const size_t budget = size_t(_residentBudget) * MEGABYTE;
+    if ( _residentBytes<=budget )
+	return;
+
+    // Least recently used first, and finer levels first among those
+    std::vector<std::pair<unsigned int,int> > candidates;
+    for ( int idx=0; idx<_levelOffsets[_firstResidentLevel]; idx++ )
+    {
+	const Chunk& chunk = _chunks[idx];
+	if ( chunk._hasTile && !chunk._isRequested && chunk._lastUsed+1<frameNr )
+	    candidates.push_back( std::make_pair(chunk._lastUsed,idx) );
+    }
+
+    std::sort( candidates.begin(), candidates.end() );
+
+    for ( unsigned int idx=0; idx<candidates.size() && _residentBytes>budget; idx++ )
+    {
+	Chunk& chunk = _chunks[candidates[idx].second];
+	_residentBytes -= chunk.tileBytes();
+	std::vector<float>().swap( chunk._tileHeights );
+	std::vector<osg::Vec3b>().swap( chunk._tileNormals );
+	chunk._hasTile = false;
+	releaseChunkGeometry( chunk );
+    }
+}
+
+
+void HeightField::computeNormalRow( int row, int startCol, int stopCol, unsigned char* rgb, std::vector<float>& buffer ) const
+{
+    const int nrCols = stopCol-startCol+1;
+    const int firstCol = osg::maximum( startCol-1, 0 );
+    const int lastCol = osg::minimum( stopCol+1, _nrCols-1 );
+    const int rowSize = lastCol-firstCol+1;
+    buffer.resize( 2*nrCols + 3*rowSize );
+    float* dhdx = &buffer[0];
+    float* dhdy = &buffer[nrCols];
+
+    // Rows are indexed relative to firstCol
+    float* rowBuffer = &buffer[2*nrCols];
+    const float* mid = getHeightRow( row, firstCol, lastCol, rowBuffer+rowSize );
+    const float* up = row>0 ? getHeightRow(row-1,firstCol,lastCol,rowBuffer) : 0;
+    const float* down = row<_nrRows-1 ? getHeightRow(row+1,firstCol,lastCol,rowBuffer+2*rowSize) : 0;
+
+    /* Central differences, one-sided next to holes and grid borders.
+       Selects instead of branches keep the loops vectorizable. */
+    for ( int idx=0; idx<nrCols; idx++ )
+    {
+	const int col = startCol+idx-firstCol;
+	const float h = mid[col];
+	const bool hasLeft = startCol+idx>0 && isDefined(mid[col-1]);
+	const bool hasRight = startCol+idx<_nrCols-1 && isDefined(mid[col+1]);
+	const float left = hasLeft ? mid[col-1] : h;
+	const float right = hasRight ? mid[col+1] : h;
+	const float span = hasLeft && hasRight ? 2.0f : 1.0f;
+	dhdx[idx] = (right-left) / (span*_nodeStep.x());
+    }
+
+    for ( int idx=0; idx<nrCols; idx++ )
+    {
+	const int col = startCol+idx-firstCol;
+	const float h = mid[col];
+	const bool hasUp = up && isDefined(up[col]);
+	const bool hasDown = down && isDefined(down[col]);
+	const float prev = hasUp ? up[col] : h;
+	const float next = hasDown ? down[col] : h;
+	const float span = hasUp && hasDown ? 2.0f : 1.0f;
+	dhdy[idx] = (next-prev) / (span*_nodeStep.y());
+    }
+
+    // Packed as (n+1)/2 per component, flat at undefined nodes
+    for ( int idx=0; idx<nrCols; idx++, rgb+=3 )
+    {
+	const bool defined = isDefined( mid[startCol+idx-firstCol] );
+	const float nx = defined ? -dhdx[idx] : 0.0f;
+	const float ny = defined ? -dhdy[idx] : 0.0f;
+	const float scale = 127.5f / std::sqrt( nx*nx + ny*ny + 1.0f );
+
+	rgb[0] = (unsigned char) (nx*scale + 127.5f);
+	rgb[1] = (unsigned char) (ny*scale + 127.5f);
+	rgb[2] = (unsigned char) (scale + 127.5f);
+    }
+}
+
+
+bool HeightField::computeNormalMap( osg::Image& image, const Vec2i& start, const Vec2i& stop ) const
+{
+    if ( !hasHeightData() || _nrRows<1 || _nrCols<1 || !_nodeStep.x() || !_nodeStep.y() )
+	return false;
+
+    Vec2i first( osg::maximum(start.x(),0), osg::maximum(start.y(),0) );
+    Vec2i last( stop.x()<0 || stop.x()>=_nrCols ? _nrCols-1 : stop.x(),
+		stop.y()<0 || stop.y()>=_nrRows ? _nrRows-1 : stop.y() );
+
+    if ( image.s()!=_nrCols || image.t()!=_nrRows || image.getPixelFormat()!=GL_RGB || image.getDataType()!=GL_UNSIGNED_BYTE )
+    {
+	image.allocateImage( _nrCols, _nrRows, 1, GL_RGB, GL_UNSIGNED_BYTE, 1 );
+	image.setInternalTextureFormat( GL_RGB8 );
+	first = Vec2i( 0, 0 );
+	last = Vec2i( _nrCols-1, _nrRows-1 );
+    }
+
+    if ( last.x()<first.x() || last.y()<first.y() )
+	return true;
+
+    const int nrRows = last.y()-first.y()+1;
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrRows )
+	nrTasks = nrRows;
+
+    if ( !_normalMapThreads )
+	_normalMapThreads = ThreadGroup<NormalMapThread>::getInst();
+
+    std::vector<osg::ref_ptr<NormalMapThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrRows%nrTasks;
+    int startRow = first.y();
+
+    while ( startRow<=last.y() )
+    {
+	int stopRow = startRow + nrRows/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stopRow--;
+
+	osg::ref_ptr<NormalMapThread> task = _normalMapThreads->getThread();
+	task->set( this, &image, first.x(), last.x(), startRow, stopRow, readyCount );
+
+	tasks.push_back( task.get() );
+
+	startRow = stopRow+1;
+    }
+
+    readyCount.block();
+
+    image.dirty();
+    return true;
+}
+
+
+void HeightField::updateNormalMap( const Vec2i& start, const Vec2i& stop )
+{
+    if ( !_normalMap )
+    {
+	_normalMap = new osg::Image;
+	_normalTexture = new osg::Texture2D;
+	_normalTexture->setResizeNonPowerOfTwoHint( false );
+	_normalTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR );
+	_normalTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+	_normalTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+	_normalTexture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+	_normalTexture->setDataVariance( osg::Object::DYNAMIC );
+    }
+
+    // Normals of the neighbours of edited nodes change as well
+    if ( !computeNormalMap(*_normalMap,start-Vec2i(1,1),stop+Vec2i(1,1)) )
+	return;
+
+    if ( _normalTexture->getImage()!=_normalMap.get() )
+	_normalTexture->setImage( _normalMap.get() );
+}
+
+
+void HeightField::decimateChunk( DecimationChunk& chunk, int task, float tolerance ) const
+{
+    const int n = _chunkSize+1;
+    const RTIN rtin( n );
+
+    if ( task==ComputeErrors )
+    {
+	chunk._heights.resize( n*n );
+	chunk._defined.resize( n*n );
+	chunk._errors.assign( n*n, 0.0f );
+
+	for ( int j=0; j<n; j++ )
+	{
+	    const int row = chunk._firstNode.y() + j;
+	    for ( int i=0; i<n; i++ )
+	    {
+		const int col = chunk._firstNode.x() + i;
+		const bool inGrid = col<_nrCols && row<_nrRows;
+		const float height = inGrid ? getNodeHeight(row*_nrCols+col) : _undefValue;
+		chunk._heights[j*n+i] = height;
+		chunk._defined[j*n+i] = inGrid && isDefined(height);
+	    }
+	}
+    }
+
+    if ( task==ComputeErrors || task==PropagateErrors )
+	rtin.accumulateErrors( &chunk._heights[0], &chunk._defined[0], &chunk._errors[0] );
+
+    if ( task==ExtractTriangles )
+    {
+	chunk._nodeIdxs.clear();
+	rtin.getTriangles( &chunk._errors[0], &chunk._defined[0], tolerance, chunk._nodeIdxs );
+    }
+}
+
+
+void HeightField::runDecimationTasks( std::vector<DecimationChunk>& chunks, int task, float tolerance ) const
+{
+    const int nrChunks = chunks.size();
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrChunks )
+	nrTasks = nrChunks;
+
+    if ( !_decimationThreads )
+	_decimationThreads = ThreadGroup<DecimationThread>::getInst();
+
+    std::vector<osg::ref_ptr<DecimationThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrChunks%nrTasks;
+    int start = 0;
+
+    while ( start<nrChunks )
+    {
+	int stop = start + nrChunks/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<DecimationThread> thread = _decimationThreads->getThread();
+	thread->set( this, chunks, task, tolerance, start, stop, readyCount );
+
+	tasks.push_back( thread.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+}
+
+
+bool HeightField::createDecimatedMesh( float tolerance, osg::Vec3Array& vertices, osg::DrawElementsUInt& triangles ) const
+{
+    if ( !hasHeightData() || _nrRows<2 || _nrCols<2 )
+	return false;
+
+    const int n = _chunkSize+1;
+    const Vec2i size( (_nrCols-2)/_chunkSize+1, (_nrRows-2)/_chunkSize+1 );
+
+    std::vector<DecimationChunk> chunks( size.x()*size.y() );
+    for ( int cy=0; cy<size.y(); cy++ )
+    {
+	for ( int cx=0; cx<size.x(); cx++ )
+	    chunks[cy*size.x()+cx]._firstNode = Vec2i( cx*_chunkSize, cy*_chunkSize );
+    }
+
+    runDecimationTasks( chunks, ComputeErrors, tolerance );
+
+    /* Neighbouring chunks must split their common border alike. Errors
+       at border nodes are maximized over both sides and propagated again,
+       until they agree. */
+    while ( true )
+    {
+	bool changed = false;
+	for ( int cy=0; cy<size.y(); cy++ )
+	{
+	    for ( int cx=0; cx<size.x(); cx++ )
+	    {
+		std::vector<float>& errors = chunks[cy*size.x()+cx]._errors;
+		for ( int dim=0; dim<=1; dim++ )
+		{
+		    if ( (dim==0 && cx+1>=size.x()) || (dim==1 && cy+1>=size.y()) )
+			continue;
+
+		    const int nbIdx = dim==0 ? cy*size.x()+cx+1 : (cy+1)*size.x()+cx;
+		    std::vector<float>& nbErrors = chunks[nbIdx]._errors;
+
+		    for ( int k=1; k<n-1; k++ )
+		    {
+			const int node = dim==0 ? k*n+n-1 : (n-1)*n+k;
+			const int nbNode = dim==0 ? k*n : k;
+			if ( errors[node]==nbErrors[nbNode] )
+			    continue;
+
+			errors[node] = nbErrors[nbNode] = osg::maximum( errors[node], nbErrors[nbNode] );
+			changed = true;
+		    }
+		}
+	    }
+	}
+
+	if ( !changed )
+	    break;
+
+	runDecimationTasks( chunks, PropagateErrors, tolerance );
+    }
+
+    runDecimationTasks( chunks, ExtractTriangles, tolerance );
+
+    // Vertices shared along chunk borders are merged
+    std::vector<int> vertexIdxs( _nrRows*_nrCols, -1 );
+    vertices.clear();
+    triangles.clear();
+    triangles.setMode( GL_TRIANGLES );
+
+    for ( unsigned int chunkIdx=0; chunkIdx<chunks.size(); chunkIdx++ )
+    {
+	const DecimationChunk& chunk = chunks[chunkIdx];
+	for ( unsigned int idx=0; idx<chunk._nodeIdxs.size(); idx++ )
+	{
+	    const int col = chunk._firstNode.x() + chunk._nodeIdxs[idx]%n;
+	    const int row = chunk._firstNode.y() + chunk._nodeIdxs[idx]/n;
+	    int& vertexIdx = vertexIdxs[row*_nrCols+col];
+
+	    if ( vertexIdx<0 )
+	    {
+		vertexIdx = vertices.size();
+		vertices.push_back( osg::Vec3(_origin.x() + col*_nodeStep.x(),
+					      _origin.y() + row*_nodeStep.y(),
+					      getNodeHeight(row*_nrCols+col)) );
+	    }
+
+	    triangles.push_back( vertexIdx );
+	}
+    }
+
+    return true;
+}
+
+
+/* Segment start+ratio*dir against an axis-aligned box, clipped to the
+   ratios already in [ratio0,ratio1]. */
+
+static bool clipToBox( const osg::Vec3& start, const osg::Vec3& dir, const osg::Vec3& min, const osg::Vec3& max, float& ratio0, float& ratio1 )
+{
+    for ( int dim=0; dim<3; dim++ )
+    {
+	if ( dir[dim]==0.0f )
+	{
+	    if ( start[dim]<min[dim] || start[dim]>max[dim] )
+		return false;
+
+	    continue;
+	}
+
+	float r0 = (min[dim]-start[dim]) / dir[dim];
+	float r1 = (max[dim]-start[dim]) / dir[dim];
+	if ( r0>r1 )
+	    std::swap( r0, r1 );
+
+	ratio0 = osg::maximum( ratio0, r0 );
+	ratio1 = osg::minimum( ratio1, r1 );
+	if ( ratio0>ratio1 )
+	    return false;
+    }
+
+    return true;
+}
+
+
+// Moller-Trumbore, two-sided
+
+static bool intersectTriangle( const osg::Vec3& start, const osg::Vec3& dir, const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2, float& ratio )
+{
+    const osg::Vec3 edge1 = v1 - v0;
+    const osg::Vec3 edge2 = v2 - v0;
+    const osg::Vec3 p = dir ^ edge2;
+    const float det = edge1 * p;
+    if ( det==0.0f )
+	return false;
+
+    const osg::Vec3 t = start - v0;
+    const float u = (t*p) / det;
+    if ( u<0.0f || u>1.0f )
+	return false;
+
+    const osg::Vec3 q = t ^ edge1;
+    const float v = (dir*q) / det;
+    if ( v<0.0f || u+v>1.0f )
+	return false;
+
+    ratio = (edge2*q) / det;
+    return true;
+}
+
+
+bool HeightField::intersectCells( int bx, int by, const osg::Vec3& start, const osg::Vec3& dir, float& ratio, Vec2i& cell, bool& upperTriangle ) const
+{
+    const int lastCol = osg::minimum( (bx+1)*PICK_BLOCK_SIZE, _nrCols-1 );
+    const int lastRow = osg::minimum( (by+1)*PICK_BLOCK_SIZE, _nrRows-1 );
+    bool found = false;
+
+    for ( int row=by*PICK_BLOCK_SIZE; row<lastRow; row++ )
+    {
+	for ( int col=bx*PICK_BLOCK_SIZE; col<lastCol; col++ )
+	{
+	    float r0 = 0.0f;
+	    float r1 = ratio;
+	    if ( !clipToBox(start,dir,osg::Vec3(col,row,-FLT_MAX),osg::Vec3(col+1,row+1,FLT_MAX),r0,r1) )
+		continue;
+
+	    const float h00 = getNodeHeight( row*_nrCols+col );
+	    const float h10 = getNodeHeight( row*_nrCols+col+1 );
+	    const float h01 = getNodeHeight( (row+1)*_nrCols+col );
+	    const float h11 = getNodeHeight( (row+1)*_nrCols+col+1 );
+	    if ( !isDefined(h00) || !isDefined(h11) )
+		continue;
+
+	    // Diagonal from (col,row) to (col+1,row+1), as drawn
+	    const osg::Vec3 v00( col, row, h00 );
+	    const osg::Vec3 v11( col+1, row+1, h11 );
+	    float triangleRatio;
+
+	    if ( isDefined(h10) && intersectTriangle(start,dir,v00,osg::Vec3(col+1,row,h10),v11,triangleRatio) &&
+		 triangleRatio>=0.0f && triangleRatio<=ratio )
+	    {
+		ratio = triangleRatio;
+		cell = Vec2i( col, row );
+		upperTriangle = false;
+		found = true;
+	    }
+
+	    if ( isDefined(h01) && intersectTriangle(start,dir,v00,v11,osg::Vec3(col,row+1,h01),triangleRatio) &&
+		 triangleRatio>=0.0f && triangleRatio<=ratio )
+	    {
+		ratio = triangleRatio;
+		cell = Vec2i( col, row );
+		upperTriangle = true;
+		found = true;
+	    }
+	}
+    }
+
+    return found;
+}
+
+
+bool HeightField::intersectBlock( int level, int bx, int by, const osg::Vec3& start, const osg::Vec3& dir, float& ratio, Vec2i& cell, bool& upperTriangle ) const
+{
+    if ( !level )
+	return intersectCells( bx, by, start, dir, ratio, cell, upperTriangle );
+
+    // Children front to back, skipping empty ones and those out of range
+    const Vec2i& childSize = _pickPyramidSizes[level-1];
+    const int span = PICK_BLOCK_SIZE << (level-1);
+    std::pair<float,int> children[4];
+    int nrChildren = 0;
+
+    for ( int idx=0; idx<4; idx++ )
+    {
+	const int cx = 2*bx + idx%2;
+	const int cy = 2*by + idx/2;
+	if ( cx>=childSize.x() || cy>=childSize.y() )
+	    continue;
+
+	const osg::Vec2& minMax = _pickPyramid[level-1][cy*childSize.x()+cx];
+	if ( minMax.x()>minMax.y() )
+	    continue;
+
+	const osg::Vec3 min( cx*span, cy*span, minMax.x() );
+	const osg::Vec3 max( osg::minimum((cx+1)*span,_nrCols-1),
+			     osg::minimum((cy+1)*span,_nrRows-1), minMax.y() );
+	float r0 = 0.0f;
+	float r1 = ratio;
+	if ( clipToBox(start,dir,min,max,r0,r1) )
+	    children[nrChildren++] = std::pair<float,int>( r0, cy*childSize.x()+cx );
+    }
+
+    std::sort( children, children+nrChildren );
+
+    bool found = false;
+    for ( int idx=0; idx<nrChildren && children[idx].first<=ratio; idx++ )
+    {
+	const int childIdx = children[idx].second;
+	if ( intersectBlock(level-1,childIdx%childSize.x(),childIdx/childSize.x(),start,dir,ratio,cell,upperTriangle) )
+	    found = true;
+    }
+
+    return found;
+}
+
+
+bool HeightField::intersectRay( const osg::Vec3& start, const osg::Vec3& end, float& ratio, osg::Vec3* normal ) const
+{
+    if ( _pickPyramid.empty() || !_nodeStep.x() || !_nodeStep.y() )
+	return false;
+
+    const osg::Vec2& minMax = _pickPyramid.back().front();
+    if ( minMax.x()>minMax.y() )
+	return false;
+
+    // In grid space, where ratios along the segment are the same
+    const osg::Vec3 gridStart( (start.x()-_origin.x())/_nodeStep.x(),
+			       (start.y()-_origin.y())/_nodeStep.y(), start.z() );
+    const osg::Vec3 gridEnd( (end.x()-_origin.x())/_nodeStep.x(),
+			     (end.y()-_origin.y())/_nodeStep.y(), end.z() );
+    const osg::Vec3 dir = gridEnd - gridStart;
+
+    float r0 = 0.0f;
+    float r1 = 1.0f;
+    const osg::Vec3 gridMax( _nrCols-1, _nrRows-1, minMax.y() );
+    if ( !clipToBox(gridStart,dir,osg::Vec3(0.0f,0.0f,minMax.x()),gridMax,r0,r1) )
+	return false;
+
+    ratio = 1.0f;
+    Vec2i cell;
+    bool upperTriangle;
+    if ( !intersectBlock(_pickPyramid.size()-1,0,0,gridStart,dir,ratio,cell,upperTriangle) )
+	return false;
+
+    if ( normal )
+    {
+	const int col = cell.x();
+	const int row = cell.y();
+	const osg::Vec3 v00( _origin.x()+col*_nodeStep.x(), _origin.y()+row*_nodeStep.y(), getHeight(col,row) );
+	const osg::Vec3 v11( v00.x()+_nodeStep.x(), v00.y()+_nodeStep.y(), getHeight(col+1,row+1) );
+	const osg::Vec3 v10( v11.x(), v00.y(), getHeight(col+1,row) );
+	const osg::Vec3 v01( v00.x(), v11.y(), getHeight(col,row+1) );
+
+	*normal = upperTriangle ? (v11-v00) ^ (v01-v00) : (v10-v00) ^ (v11-v00);
+	normal->normalize();
+    }
+
+    return true;
+}
+
+
+void HeightField::intersectRays( const osg::Vec3Array& starts, const osg::Vec3Array& ends, std::vector<float>& ratios ) const
+{
+    const int nrRays = osg::minimum( starts.size(), ends.size() );
+    ratios.assign( nrRays, -1.0f );
+    if ( !nrRays )
+	return;
+
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrRays )
+	nrTasks = nrRays;
+
+    if ( !_pickThreads )
+	_pickThreads = ThreadGroup<PickThread>::getInst();
+
+    std::vector<osg::ref_ptr<PickThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrRays%nrTasks;
+    int start = 0;
+
+    while ( start<nrRays )
+    {
+	int stop = start + nrRays/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<PickThread> thread = _pickThreads->getThread();
+	thread->set( this, starts, ends, ratios, start, stop, readyCount );
+
+	tasks.push_back( thread.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+}
+
+
+void HeightField::dirtyContours( const Vec2i& start, const Vec2i& stop )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _contourLock );
+
+    if ( stop.x()<0 || stop.y()<0 )
+    {
+	_contourTiles.clear();
+	return;
+    }
+
+    if ( _contourTiles.empty() )
+	return;
+
+    // Nodes are shared by the cells, and tiles, on either side
+    const int nrTilesX = (_nrCols-2)/_chunkSize + 1;
+    const int nrTilesY = (_nrRows-2)/_chunkSize + 1;
+    const int firstX = start.x()>0 ? (start.x()-1)/_chunkSize : 0;
+    const int firstY = start.y()>0 ? (start.y()-1)/_chunkSize : 0;
+    const int lastX = osg::minimum( stop.x()/_chunkSize, nrTilesX-1 );
+    const int lastY = osg::minimum( stop.y()/_chunkSize, nrTilesY-1 );
+
+    for ( int ty=firstY; ty<=lastY; ty++ )
+    {
+	for ( int tx=firstX; tx<=lastX; tx++ )
+	    _contourTiles[ty*nrTilesX+tx]._isValid = false;
+    }
+}
+
+
+/* Marching squares, with cell corners v0=(col,row), v1=(col+1,row),
+   v2=(col+1,row+1) and v3=(col,row+1). Edge e0 runs from v0 to v1, e1 from
+   v1 to v2, e2 from v3 to v2 and e3 from v0 to v3. */
+
+static const int sCellSegments[16][4] =
+{
+    { -1, -1, -1, -1 }, { 3, 0, -1, -1 }, { 0, 1, -1, -1 }, { 3, 1, -1, -1 },
+    { 1, 2, -1, -1 }, { 3, 0, 1, 2 }, { 0, 2, -1, -1 }, { 3, 2, -1, -1 },
+    { 2, 3, -1, -1 }, { 0, 2, -1, -1 }, { 0, 1, 2, 3 }, { 1, 2, -1, -1 },
+    { 3, 1, -1, -1 }, { 0, 1, -1, -1 }, { 3, 0, -1, -1 }, { -1, -1, -1, -1 }
+};
+
+static const int sEdgeStarts[4] = { 0, 1, 3, 0 };
+static const int sEdgeStops[4] = { 1, 2, 2, 3 };
+
+void HeightField::contourTile( int tileIdx, const std::vector<float>& levels ) const
+{
+    ContourTile& tile = _contourTiles[tileIdx];
+    tile._pieces.clear();
+
+    const int nrTilesX = (_nrCols-2)/_chunkSize + 1;
+    const int firstCol = (tileIdx%nrTilesX) * _chunkSize;
+    const int firstRow = (tileIdx/nrTilesX) * _chunkSize;
+    const int stopCol = osg::minimum( firstCol+_chunkSize, _nrCols-1 );
+    const int stopRow = osg::minimum( firstRow+_chunkSize, _nrRows-1 );
+    const ContourKey nrEdgeKeys = 2 * (ContourKey) _nrRows * _nrCols;
+
+    std::vector<ContourSegment> segments;
+    for ( int row=firstRow; row<stopRow; row++ )
+    {
+	for ( int col=firstCol; col<stopCol; col++ )
+	{
+	    const int nodes[4] = { row*_nrCols+col, row*_nrCols+col+1,
+				   (row+1)*_nrCols+col+1, (row+1)*_nrCols+col };
+	    float h[4];
+	    bool defined = true;
+	    for ( int idx=0; idx<4; idx++ )
+	    {
+		h[idx] = getNodeHeight( nodes[idx] );
+		defined = defined && isDefined( h[idx] );
+	    }
+
+	    if ( !defined )	// Contours end at holes
+		continue;
+
+	    const float min = osg::minimum( osg::minimum(h[0],h[1]), osg::minimum(h[2],h[3]) );
+	    const float max = osg::maximum( osg::maximum(h[0],h[1]), osg::maximum(h[2],h[3]) );
+
+	    // Node heights at a level count as above it
+	    int levelIdx = std::upper_bound( levels.begin(), levels.end(), min ) - levels.begin();
+	    for ( ; levelIdx<(int)levels.size() && levels[levelIdx]<=max; levelIdx++ )
+	    {
+		const float level = levels[levelIdx];
+		int caseIdx = 0;
+		for ( int idx=0; idx<4; idx++ )
+		{
+		    if ( h[idx]>=level )
+			caseIdx |= 1 << idx;
+		}
+
+		// Saddles are resolved by the cell center
+		const int* cellSegments = sCellSegments[caseIdx];
+		static const int sInvertedSaddles[2][4] = { { 0, 1, 2, 3 }, { 3, 0, 1, 2 } };
+		if ( (caseIdx==5 || caseIdx==10) && 0.25f*(h[0]+h[1]+h[2]+h[3])>=level )
+		    cellSegments = sInvertedSaddles[caseIdx==10];
+
+		for ( int seg=0; seg<2 && cellSegments[2*seg]>=0; seg++ )
+		{
+		    ContourSegment segment;
+		    segment._levelIdx = levelIdx;
+
+		    for ( int end=0; end<2; end++ )
+		    {
+			const int edge = cellSegments[2*seg+end];
+			const int v0 = sEdgeStarts[edge];
+			const int v1 = sEdgeStops[edge];
+			const float frac = (level-h[v0]) / (h[v1]-h[v0]);
+
+			const float col0 = col + (v0==1 || v0==2);
+			const float row0 = row + (v0>=2);
+			const float col1 = col + (v1==1 || v1==2);
+			const float row1 = row + (v1>=2);
+			segment._points[end] = osg::Vec3( _origin.x() + (col0+frac*(col1-col0))*_nodeStep.x(),
+							 _origin.y() + (row0+frac*(row1-row0))*_nodeStep.y(),
+							 level );
+
+			const bool isVertical = edge==1 || edge==3;
+			segment._keys[end] = levelIdx*nrEdgeKeys + 2*(ContourKey)nodes[v0] + isVertical;
+		    }
+
+		    segments.push_back( segment );
+		}
+	    }
+	}
+    }
+
+    chainPieces( segments, tile._pieces );
+    tile._isValid = true;
+}
+
+
+void HeightField::createContours( const std::vector<float>& levels, osg::Vec3Array& vertices, std::vector<osg::ref_ptr<osg::PrimitiveSet> >& polyLines, std::vector<int>* levelIdxs ) const
+{
+    vertices.clear();
+    polyLines.clear();
+    if ( levelIdxs )
+	levelIdxs->clear();
+
+    if ( !hasHeightData() || _nrRows<2 || _nrCols<2 || levels.empty() )
+	return;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _contourLock );
+
+    std::vector<int> order( levels.size() );
+    for ( unsigned int idx=0; idx<order.size(); idx++ )
+	order[idx] = idx;
+    std::sort( order.begin(), order.end(), [&levels](int a,int b) { return levels[a]<levels[b]; } );
+
+    std::vector<float> sortedLevels( levels.size() );
+    for ( unsigned int idx=0; idx<order.size(); idx++ )
+	sortedLevels[idx] = levels[order[idx]];
+
+    // Tiles are only redone after edits, or for other levels
+    const int nrTiles = ((_nrCols-2)/_chunkSize+1) * ((_nrRows-2)/_chunkSize+1);
+    if ( (int)_contourTiles.size()!=nrTiles || _contourLevels!=sortedLevels )
+    {
+	_contourTiles.assign( nrTiles, ContourTile() );
+	_contourLevels = sortedLevels;
+    }
+
+    std::vector<int> tileIdxs;
+    for ( int idx=0; idx<nrTiles; idx++ )
+    {
+	if ( !_contourTiles[idx]._isValid )
+	    tileIdxs.push_back( idx );
+    }
+
+    const int nrTileIdxs = tileIdxs.size();
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrTileIdxs )
+	nrTasks = nrTileIdxs;
+
+    if ( nrTasks>0 )
+    {
+	if ( !_contourThreads )
+	    _contourThreads = ThreadGroup<ContourThread>::getInst();
+
+	std::vector<osg::ref_ptr<ContourThread> > tasks;
+	OpenThreads::BlockCount readyCount( nrTasks );
+	readyCount.reset();
+
+	int remainder = nrTileIdxs%nrTasks;
+	int start = 0;
+
+	while ( start<nrTileIdxs )
+	{
+	    int stop = start + nrTileIdxs/nrTasks;
+	    if ( remainder )
+		remainder--;
+	    else
+		stop--;
+
+	    osg::ref_ptr<ContourThread> thread = _contourThreads->getThread();
+	    thread->set( this, tileIdxs, _contourLevels, start, stop, readyCount );
+
+	    tasks.push_back( thread.get() );
+
+	    start = stop+1;
+	}
+
+	readyCount.block();
+    }
+
+    // Pieces ending at tile borders continue in the neighbouring tile
+    std::vector<ContourPiece> pieces;
+    for ( int idx=0; idx<nrTiles; idx++ )
+    {
+	const std::vector<ContourPiece>& tilePieces = _contourTiles[idx]._pieces;
+	pieces.insert( pieces.end(), tilePieces.begin(), tilePieces.end() );
+    }
+
+    std::vector<ContourPiece> chains;
+    chainPieces( pieces, chains );
+
+    for ( unsigned int idx=0; idx<chains.size(); idx++ )
+    {
+	const std::vector<osg::Vec3>& points = chains[idx]._points;
+	polyLines.push_back( new osg::DrawArrays(osg::PrimitiveSet::LINE_STRIP,vertices.size(),points.size()) );
+	vertices.insert( vertices.end(), points.begin(), points.end() );
+
+	if ( levelIdxs )
+	    levelIdxs->push_back( order[chains[idx]._levelIdx] );
+    }
+}
+
+
+void HeightField::runChunkTasks( const std::vector<int>& chunkIdxs, int task )
+{
+    const int nrChunks = chunkIdxs.size();
+    if ( !nrChunks )
+	return;
+
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrChunks )
+	nrTasks = nrChunks;
+
+    if ( !_chunkThreads )
+	_chunkThreads = ThreadGroup<ChunkThread>::getInst();
+
+    std::vector<osg::ref_ptr<ChunkThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrChunks%nrTasks;
+    int start = 0;
+
+    while ( start<nrChunks )
+    {
+	int stop = start + nrChunks/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<ChunkThread> thread = _chunkThreads->getThread();
+	thread->set( this, chunkIdxs, task, start, stop, readyCount );
+
+	tasks.push_back( thread.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+}
+
+
+void HeightField::updateSharedGeometry()
+{
+    const int n = _chunkSize+1;
+
+    _sharedVertices = new osg::Vec3Array;
+    for ( int j=0; j<n; j++ )
+    {
+	for ( int i=0; i<n; i++ )
+	    _sharedVertices->push_back( osg::Vec3(i,j,0.0f) );
+    }
+
+    // Skirt vertices (z=1) below the bottom, top, left and right edges
+    for ( int k=0; k<n; k++ )
+	_sharedVertices->push_back( osg::Vec3(k,0.0f,1.0f) );
+    for ( int k=0; k<n; k++ )
+	_sharedVertices->push_back( osg::Vec3(k,n-1,1.0f) );
+    for ( int k=0; k<n; k++ )
+	_sharedVertices->push_back( osg::Vec3(0.0f,k,1.0f) );
+    for ( int k=0; k<n; k++ )
+	_sharedVertices->push_back( osg::Vec3(n-1,k,1.0f) );
+
+    // Shared by all fully defined chunks, as every level has the same resolution
+    const std::vector<unsigned char> allDefined( n*n, 1 );
+    const GridMeshBuilder builder( n, n );
+    _sharedIndices = new osg::DrawElementsUShort( GL_TRIANGLE_STRIP );
+    _sharedBlockStarts.resize( builder.nrBlocks()+1 );
+    for ( int blockIdx=0; blockIdx<builder.nrBlocks(); blockIdx++ )
+    {
+	_sharedBlockStarts[blockIdx] = _sharedIndices->size();
+	builder.addBlockStrips( blockIdx, *_sharedIndices );
+    }
+
+    _sharedBlockStarts.back() = _sharedIndices->size();
+    addSkirtIndices( &allDefined[0], n, *_sharedIndices );
+}
+
+
+static void packDefinedBits( const std::vector<unsigned char>& defined, int n, std::vector<unsigned int>& bits )
+{
+    const int rowWords = (n+31) / 32;
+    bits.assign( n*rowWords, 0 );
+
+    for ( int j=0; j<n; j++ )
+    {
+	unsigned int* row = &bits[j*rowWords];
+	for ( int i=0; i<n; i++ )
+	{
+	    if ( defined[j*n+i] )
+		row[i/32] |= 1u << (i%32);
+	}
+    }
+}
+
+
+void HeightField::updateChunkIndices( Chunk& chunk, const std::vector<unsigned char>& defined, bool allDefined )
+{
+    const int n = _chunkSize+1;
+    std::vector<unsigned int> definedBits;
+    packDefinedBits( defined, n, definedBits );
+
+    if ( allDefined )
+    {
+	chunk._indices = _sharedIndices;
+	chunk._definedBits.swap( definedBits );
+	chunk._blockStarts = _sharedBlockStarts;
+	return;
+    }
+
+    GridMeshBuilder builder( n, n );
+    builder.setDefinedMask( &defined[0] );
+    const int nrBlocks = builder.nrBlocks();
+    std::vector<int> blockStarts( nrBlocks+1 );
+
+    // Blocks whose vertices kept their definedness are copied
+    const int rowWords = (n+31) / 32;
+    const bool canReuse = chunk._indices && chunk._definedBits.size()==definedBits.size() && (int)chunk._blockStarts.size()==nrBlocks+1;
+    osg::ref_ptr<osg::DrawElementsUShort> indices = new osg::DrawElementsUShort( GL_TRIANGLE_STRIP );
+    indices->reserve( canReuse ? chunk._indices->size() : _sharedIndices->size() );
+
+    for ( int blockIdx=0; blockIdx<nrBlocks; blockIdx++ )
+    {
+	blockStarts[blockIdx] = indices->size();
+
+	Vec2i first, last;
+	builder.getBlockQuads( blockIdx, first, last );
+	bool unchanged = canReuse;
+	for ( int j=first.y(); unchanged && j<=last.y()+1; j++ )
+	{
+	    const int word0 = j*rowWords + first.x()/32;
+	    const int word1 = j*rowWords + (last.x()+1)/32;
+	    unchanged = std::equal( definedBits.begin()+word0, definedBits.begin()+word1+1, chunk._definedBits.begin()+word0 );
+	}
+
+	if ( unchanged )
+	{
+	    const osg::DrawElementsUShort& oldIndices = *chunk._indices;
+	    indices->insert( indices->end(), oldIndices.begin()+chunk._blockStarts[blockIdx], oldIndices.begin()+chunk._blockStarts[blockIdx+1] );
+	}
+	else
+	    builder.addBlockStrips( blockIdx, *indices );
+    }
+
+    blockStarts[nrBlocks] = indices->size();
+    addSkirtIndices( &defined[0], n, *indices );
+
+    chunk._indices = indices;
+    chunk._definedBits.swap( definedBits );
+    chunk._blockStarts.swap( blockStarts );
+}
+
+
+static unsigned short floatToHalf( float value )
+{
+    unsigned int bits;
+    memcpy( &bits, &value, sizeof(bits) );
+
+    const unsigned short sign = (bits >> 16) & 0x8000;
+    const int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if ( exponent>=31 )		// Overflow to infinity
+	return sign | 0x7c00;
+
+    if ( exponent<=0 )		// Subnormal or zero
+    {
+	if ( exponent<-10 )
+	    return sign;
+
+	mantissa |= 0x800000;
+	const int shift = 14 - exponent;
+	unsigned short half = mantissa >> shift;
+	if ( (mantissa >> (shift-1)) & 1 )
+	    half++;
+	return sign | half;
+    }
+
+    // Rounding may carry into the exponent, which is still correct
+    unsigned short half = (exponent << 10) | (mantissa >> 13);
+    if ( mantissa & 0x1000 )
+	half++;
+    return sign | half;
+}
+
+
+/* Heights are relative to the chunk's lowest height, to make the most of
+   the half float and 16-bit precision. The vertex shader adds the offset
+   and scale back. Undefined heights are written as a reserved value, which
+   the shaders discard: half float NaN or quantizedUndefValue(). */
+
+osg::Array* HeightField::createHeightArray( const std::vector<float>& heights, float& offset, float& scale, float& undef ) const
+{
+    const int nrHeights = heights.size();
+    float min = 0.0f, max = 0.0f;
+    bool found = false;
+
+    for ( int idx=0; idx<nrHeights; idx++ )
+    {
+	const float height = heights[idx];
+	if ( !isDefined(height) )
+	    continue;
+
+	if ( !found || height<min )
+	    min = height;
+	if ( !found || height>max )
+	    max = height;
+
+	found = true;
+    }
+
+    if ( _heightFormat==HalfFloatHeights )
+    {
+	offset = min;
+	scale = 1.0f;
+
+	undef = -1.0f;	// NaN, no relative height is negative
+
+	HalfFloatArray* array = new HalfFloatArray( nrHeights );
+	for ( int idx=0; idx<nrHeights; idx++ )
+	    (*array)[idx] = isDefined(heights[idx]) ? floatToHalf( heights[idx]-min ) : HALF_FLOAT_UNDEF;
+
+	return array;
+    }
+
+    if ( _heightFormat==QuantizedHeights )
+    {
+	// Defined heights map onto 0-65534, normalized to [0,1] in the shader
+	const float maxValue = quantizedUndefValue()-1;
+	offset = min;
+	scale = (max-min) * quantizedUndefValue() / maxValue;
+	undef = 1.0f;
+
+	const float factor = max>min ? maxValue/(max-min) : 0.0f;
+	osg::UShortArray* array = new osg::UShortArray( nrHeights );
+	for ( int idx=0; idx<nrHeights; idx++ )
+	    (*array)[idx] = isDefined(heights[idx]) ? (unsigned short) ((heights[idx]-min)*factor + 0.5f) : quantizedUndefValue();
+
+	array->setNormalize( true );
+	return array;
+    }
+
+    offset = 0.0f;
+    scale = 1.0f;
+    undef = _undefValue;
+    return new osg::FloatArray( heights.begin(), heights.end() );
+}
+
+
+void HeightField::buildChunkGeometry( int chunkIdx )
+{
+    Chunk& chunk = _chunks[chunkIdx];
+    chunk._isDirty = false;
+
+    if ( chunk._isEmpty )
+    {
+	releaseChunkGeometry( chunk );
+	return;
+    }
+
+    const int n = _chunkSize+1;
+    const int step = 1 << chunk._level;
+    const Vec2i& first = chunk._firstNode;
+
+    std::vector<float> heights( _sharedVertices->size() );
+    float* ptr = &heights.front();
+
+    if ( _source )
+	ptr = std::copy( chunk._tileHeights.begin(), chunk._tileHeights.end(), ptr );
+    else
+    {
+	for ( int j=0; j<n; j++ )
+	{
+	    for ( int i=0; i<n; i++, ptr++ )
+	    {
+		const float height = getHeight( first.x()+i*step, first.y()+j*step );
+		*ptr = isDefined(height) ? height : _undefValue;
+	    }
+	}
+    }
+
+    // Skirt vertices repeat the edge heights, in order of updateSharedGeometry()
+    const float* grid = &heights.front();
+    for ( int k=0; k<n; k++ )
+	*ptr++ = grid[k];
+    for ( int k=0; k<n; k++ )
+	*ptr++ = grid[(n-1)*n+k];
+    for ( int k=0; k<n; k++ )
+	*ptr++ = grid[k*n];
+    for ( int k=0; k<n; k++ )
+	*ptr++ = grid[k*n+n-1];
+
+    // Only fully defined triangles are drawn
+    std::vector<unsigned char> defined( n*n );
+    bool allDefined = true;
+    for ( int k=0; k<n*n; k++ )
+    {
+	defined[k] = isDefined( grid[k] );
+	allDefined = allDefined && defined[k];
+    }
+
+    if ( _decimationTolerance>0.0f )
+    {
+	const RTIN rtin( n );
+	std::vector<float> errors( n*n, 0.0f );
+	rtin.accumulateErrors( grid, &defined[0], &errors[0] );
+
+	std::vector<int> nodeIdxs;
+	rtin.getTriangles( &errors[0], &defined[0], _decimationTolerance, nodeIdxs );
+
+	chunk._indices = new osg::DrawElementsUShort( GL_TRIANGLES, nodeIdxs.begin(), nodeIdxs.end() );
+	addSkirtIndices( &defined[0], n, *chunk._indices );
+	chunk._definedBits.clear();	// Nothing to reuse blocks from
+	chunk._blockStarts.clear();
+    }
+    else
+	updateChunkIndices( chunk, defined, allDefined );
+
+    float heightOffset, heightScale, heightUndef;
+    osg::ref_ptr<osg::Array> heightArray = createHeightArray( heights, heightOffset, heightScale, heightUndef );
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setUseDisplayList( false );
+    geometry->setUseVertexBufferObjects( true );
+    geometry->setDataVariance( osg::Object::STATIC );
+    geometry->setVertexArray( _sharedVertices.get() );
+    geometry->setVertexAttribArray( HEIGHT_ATTRIB_LOC, heightArray.get(), osg::Array::BIND_PER_VERTEX );
+
+    // Streamed grids have no normal map
+    if ( _source )
+    {
+	const std::vector<osg::Vec3b>& tileNormals = chunk._tileNormals;
+	osg::ref_ptr<osg::Vec3bArray> normals = new osg::Vec3bArray( tileNormals.begin(), tileNormals.end() );
+	for ( int k=0; k<n; k++ )
+	    normals->push_back( tileNormals[k] );
+	for ( int k=0; k<n; k++ )
+	    normals->push_back( tileNormals[(n-1)*n+k] );
+	for ( int k=0; k<n; k++ )
+	    normals->push_back( tileNormals[k*n] );
+	for ( int k=0; k<n; k++ )
+	    normals->push_back( tileNormals[k*n+n-1] );
+
+	normals->setNormalize( true );
+	geometry->setVertexAttribArray( NORMAL_ATTRIB_LOC, normals.get(), osg::Array::BIND_PER_VERTEX );
+    }
+
+    geometry->addPrimitiveSet( chunk._indices.get() );
+    geometry->setComputeBoundingBoxCallback( new ChunkBoundCallback(chunk._bb) );
+
+    osg::StateSet* stateset = geometry->getOrCreateStateSet();
+    const osg::Vec2 chunkOrigin( _origin.x() + first.x()*_nodeStep.x(),
+				 _origin.y() + first.y()*_nodeStep.y() );
+    stateset->addUniform( new osg::Uniform("chunkOrigin",chunkOrigin) );
+    stateset->addUniform( new osg::Uniform("chunkStep",_nodeStep*step) );
+    stateset->addUniform( new osg::Uniform("chunkFirstNode",osg::Vec2(first.x(),first.y())) );
+    stateset->addUniform( new osg::Uniform("chunkNodeStep",float(step)) );
+    stateset->addUniform( new osg::Uniform("heightOffset",heightOffset) );
+    stateset->addUniform( new osg::Uniform("heightScale",heightScale) );
+    stateset->addUniform( new osg::Uniform("heightUndef",heightUndef) );
+
+    // Set in place by updateSkirtDepth(.) while the chunk is on display
+    osg::ref_ptr<osg::Uniform> skirtDepth = new osg::Uniform( "skirtDepth", chunk._skirtDepth );
+    skirtDepth->setDataVariance( osg::Object::DYNAMIC );
+    stateset->addUniform( skirtDepth.get() );
+    stateset->setDataVariance( osg::Object::DYNAMIC );
+
+    chunk._geometry = geometry;
+}
+
+
+static osg::Uniform* getOrCreateDynamicUniform( osg::StateSet& stateset, const char* name, osg::Uniform::Type type )
+{
+    osg::Uniform* uniform = stateset.getOrCreateUniform( name, type );
+    uniform->setDataVariance( osg::Object::DYNAMIC );
+    return uniform;
+}
+
+
+void HeightField::updateStateSet()
+{
+    // Only the normal map shaders sample "normals"
+    if ( _stateset && _source.valid()==(_stateset->getUniform("normals")!=0) )
+	_stateset = 0;
+
+    if ( !_stateset )
+    {
+	ShaderUtility shaderUtility;
+	if ( _source )
+	    shaderUtility.addDefinition( "hasChunkNormals" );
+
+	osg::ref_ptr<osg::Program> program = shaderUtility.createProgram( "horizon3d_vert.glsl", "horizon3d_frag.glsl", "" );
+
+	for ( unsigned int idx=0; idx<program->getNumShaders(); idx++ )
+	{
+	    if ( program->getShader(idx)->getShaderSource().empty() )
+	    {
+		std::cerr << "HeightField: horizon3d shaders not found in ShaderUtility root path" << std::endl;
+		break;
+	    }
+	}
+
+	program->addBindAttribLocation( "chunkHeight", HEIGHT_ATTRIB_LOC );
+	if ( _source )
+	    program->addBindAttribLocation( "chunkNormal", NORMAL_ATTRIB_LOC );
+
+	// Uniforms and textures below are updated in place
+	_stateset = new osg::StateSet;
+	_stateset->setDataVariance( osg::Object::DYNAMIC );
+	_stateset->setAttributeAndModes( program.get() );
+	if ( !_source )
+	    _stateset->addUniform( new osg::Uniform("normals",0) );
+	_stateset->addUniform( new osg::Uniform("palette",1) );
+	GridMeshBuilder::enablePrimitiveRestart( *_stateset, osg::PrimitiveSet::DrawElementsUShortPrimitiveType );
+	_needsPaletteUpdate = true;
+
+	_paletteTexture = new osg::Texture1D;
+	_paletteTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR );
+	_paletteTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+	_paletteTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+	_paletteTexture->setDataVariance( osg::Object::DYNAMIC );
+	_stateset->setTextureAttributeAndModes( 1, _paletteTexture.get() );
+    }
+
+    if ( _normalTexture )
+	_stateset->setTextureAttributeAndModes( 0, _normalTexture.get() );
+
+    float min = 0.0f, max = 0.0f;
+    getHeightRange( min, max );
+
+    // Grid border clamps the vertices of chunks sticking out
+    const osg::Vec2 lastNode( _origin.x() + (_nrCols-1)*_nodeStep.x(),
+			      _origin.y() + (_nrRows-1)*_nodeStep.y() );
+    const osg::Vec2 gridMin( osg::minimum(_origin.x(),lastNode.x()),
+			     osg::minimum(_origin.y(),lastNode.y()) );
+    const osg::Vec2 gridMax( osg::maximum(_origin.x(),lastNode.x()),
+			     osg::maximum(_origin.y(),lastNode.y()) );
+
+    getOrCreateDynamicUniform( *_stateset, "depthMin", osg::Uniform::FLOAT )->set( min );
+    getOrCreateDynamicUniform( *_stateset, "depthDiff", osg::Uniform::FLOAT )->set( max-min );
+    getOrCreateDynamicUniform( *_stateset, "gridMin", osg::Uniform::FLOAT_VEC2 )->set( gridMin );
+    getOrCreateDynamicUniform( *_stateset, "gridMax", osg::Uniform::FLOAT_VEC2 )->set( gridMax );
+    getOrCreateDynamicUniform( *_stateset, "gridSize", osg::Uniform::FLOAT_VEC2 )->set( osg::Vec2(_nrCols,_nrRows) );
+
+    // Baked palette, looked up with a single fetch per fragment
+    if ( _needsPaletteUpdate )
+    {
+	_paletteTexture->setImage( _palette.createLUTImage() );
+	_needsPaletteUpdate = false;
+    }
+}
+
+
+void HeightField::updateChunks( unsigned int frameNr )
+{
+    std::vector<int> buildIdxs;
+
+    _requestLock.lock();
+    const int nrBuilds = osg::minimum( (int)_requestedChunks.size(), MAX_CHUNK_BUILDS_PER_FRAME );
+    buildIdxs.assign( _requestedChunks.begin(), _requestedChunks.begin()+nrBuilds );
+    _requestedChunks.erase( _requestedChunks.begin(), _requestedChunks.begin()+nrBuilds );
+    for ( int idx=0; idx<nrBuilds; idx++ )
+	_chunks[buildIdxs[idx]]._isRequested = false;
+    const bool morePending = !_requestedChunks.empty();
+    std::vector<int> prefetchIdxs;
+    prefetchIdxs.swap( _prefetchChunks );
+    _requestLock.unlock();
+
+    if ( _source && _tileQueue )
+    {
+	applyFetchedTiles();
+
+	/* Requested chunks without tile are fetched first, prefetches after.
+	   The next cull requests them again to build their geometry. */
+	const unsigned int maxFetches = 2*osg::maximum( OpenThreads::GetNumberOfProcessors(), 1 );
+	std::vector<int> tiledIdxs;
+	buildIdxs.insert( buildIdxs.end(), prefetchIdxs.begin(), prefetchIdxs.end() );
+
+	for ( unsigned int idx=0; idx<buildIdxs.size(); idx++ )
+	{
+	    Chunk& chunk = _chunks[buildIdxs[idx]];
+	    if ( chunk._hasTile )
+	    {
+		if ( (int)idx<nrBuilds )
+		    tiledIdxs.push_back( buildIdxs[idx] );
+	    }
+	    else if ( !chunk._isFetching && _fetchTasks.size()<maxFetches )
+		fetchTile( buildIdxs[idx], 0 );
+	}
+
+	buildIdxs.swap( tiledIdxs );
+	if ( !_fetchTasks.empty() )
+	    forceRedraw( true );
+    }
+
+    runChunkTasks( buildIdxs, BuildGeometries );
+
+    if ( morePending )
+	forceRedraw( true );
+
+    // Root chunk is kept as a fallback for every view
+    for ( int idx=0; idx+1<(int)_chunks.size(); idx++ )
+    {
+	Chunk& chunk = _chunks[idx];
+	if ( chunk._geometry && !chunk._isRequested && frameNr>chunk._lastUsed+CHUNK_RELEASE_FRAMES )
+	    releaseChunkGeometry( chunk );
+    }
+
+    if ( _source && !_chunks.empty() )
+	evictTiles( frameNr );
+}
+
+
+void HeightField::releaseChunkGeometry( Chunk& chunk )
+{
+    chunk._geometry = 0;
+    chunk._indices = 0;
+    chunk._definedBits.clear();
+    chunk._blockStarts.clear();
+}
+
+
+void HeightField::requestChunk( int chunkIdx )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _requestLock );
+
+    if ( !_chunks[chunkIdx]._isRequested )
+    {
+	_chunks[chunkIdx]._isRequested = true;
+	_requestedChunks.push_back( chunkIdx );
+    }
+}
+
+
+void HeightField::prefetchChunk( int chunkIdx )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _requestLock );
+    _prefetchChunks.push_back( chunkIdx );
+}
+
+
+float HeightField::getScreenError( const Chunk& chunk, osgUtil::CullVisitor& cv ) const
+{
+    const osg::Vec3 eye = cv.getEyeLocal();
+    const osg::BoundingBox& bb = chunk._bb;
+
+    const osg::Vec3 nearest( osg::clampBetween(eye.x(),bb.xMin(),bb.xMax()),
+			     osg::clampBetween(eye.y(),bb.yMin(),bb.yMax()),
+			     osg::clampBetween(eye.z(),bb.zMin(),bb.zMax()) );
+
+    // Decimated chunks deviate up to the tolerance from the full grid
+    const float error = chunk._error + _decimationTolerance;
+
+    if ( nearest==eye )		// Eye inside chunk
+	return error>0.0f ? FLT_MAX : 0.0f;
+
+    return cv.clampedPixelSize( nearest, error );
+}
+
+
+void HeightField::selectChunks( int chunkIdx, osgUtil::CullVisitor& cv, std::vector<int>& drawIdxs, unsigned int frameNr )
+{
+    Chunk& chunk = _chunks[chunkIdx];
+    if ( chunk._isEmpty )
+	return;
+
+    if ( cv.isCulled(chunk._bb) )
+    {
+	// Streamed tiles just outside the view are ready when turning
+	const float eyeDist = (chunk._bb.center()-cv.getEyeLocal()).length();
+	if ( _source && !chunk._hasTile && eyeDist<2.0f*chunk._bb.radius() )
+	    prefetchChunk( chunkIdx );
+
+	return;
+    }
+
+    chunk._lastUsed = frameNr;
+    const float screenError = chunk._level>0 ? getScreenError(chunk,cv) : 0.0f;
+
+    // Streamed children are fetched before their refinement is due
+    if ( _source && screenError>0.5f*_maxScreenError )
+    {
+	for ( int idx=0; idx<4; idx++ )
+	{
+	    const int childIdx = chunk._children[idx];
+	    if ( childIdx>=0 && !_chunks[childIdx]._hasTile )
+		prefetchChunk( childIdx );
+	}
+    }
+
+    // Refine only if all visible children can be shown at once
+    if ( screenError>_maxScreenError )
+    {
+	bool childrenReady = true;
+	for ( int idx=0; idx<4; idx++ )
+	{
+	    const int childIdx = chunk._children[idx];
+	    if ( childIdx<0 )
+		continue;
+
+	    Chunk& child = _chunks[childIdx];
+	    if ( child._isEmpty || child._geometry || cv.isCulled(child._bb) )
+		continue;
+
+	    child._lastUsed = frameNr;
+	    requestChunk( childIdx );
+	    childrenReady = false;
+	}
+
+	if ( childrenReady )
+	{
+	    for ( int idx=0; idx<4; idx++ )
+	    {
+		if ( chunk._children[idx]>=0 )
+		    selectChunks( chunk._children[idx], cv, drawIdxs, frameNr );
+	    }
+
+	    return;
+	}
+    }
+
+    if ( !chunk._geometry || chunk._isDirty )
+	requestChunk( chunkIdx );
+
+    if ( chunk._geometry )
+	drawIdxs.push_back( chunkIdx );
+}
+
+
+} // namespace vsgGeo
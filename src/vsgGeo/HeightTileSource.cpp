@@ -0,0 +1,106 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/HeightTileSource.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+
+namespace vsgGeo
+{
+
+#define MAX_SEGMENT_STEP	8	// Coarser steps seek node by node
+
+
+RawHeightFileSource::RawHeightFileSource( const std::string& fileName, int nrRows, int nrCols, unsigned int headerBytes )
+    : _fileName( fileName )
+    , _nrRows( nrRows>0 ? nrRows : 0 )
+    , _nrCols( nrCols>0 ? nrCols : 0 )
+    , _headerBytes( headerBytes )
+{}
+
+
+bool RawHeightFileSource::readTile( const Vec2i& firstNode, int step, const Vec2i& size, std::vector<float>& heights ) const
+{
+    if ( !_nrRows || !_nrCols || step<1 || size.x()<1 || size.y()<1 )
+	return false;
+
+    std::ifstream file( _fileName.c_str(), std::ios::in | std::ios::binary );
+    if ( !file )
+    {
+	std::cerr << "RawHeightFileSource: cannot open " << _fileName << std::endl;
+	return false;
+    }
+
+    std::vector<int> cols( size.x() );
+    for ( int i=0; i<size.x(); i++ )
+	cols[i] = osg::clampBetween( firstNode.x()+i*step, 0, _nrCols-1 );
+
+    const int firstCol = cols.front();
+    const bool readSegments = step<=MAX_SEGMENT_STEP;
+    std::vector<float> segment( readSegments ? cols.back()-firstCol+1 : 1 );
+
+    heights.resize( size.x()*size.y() );
+    int prevRow = -1;
+
+    for ( int j=0; j<size.y(); j++ )
+    {
+	float* tileRow = &heights[j*size.x()];
+	const int row = osg::clampBetween( firstNode.y()+j*step, 0, _nrRows-1 );
+
+	if ( row==prevRow )	// Clamped beyond the grid border
+	{
+	    std::copy( tileRow-size.x(), tileRow, tileRow );
+	    continue;
+	}
+
+	const std::streamoff rowOffset = std::streamoff(_headerBytes) + std::streamoff(row)*_nrCols*sizeof(float);
+
+	if ( readSegments )
+	{
+	    file.seekg( rowOffset + std::streamoff(firstCol)*sizeof(float) );
+	    file.read( (char*) &segment[0], segment.size()*sizeof(float) );
+
+	    for ( int i=0; i<size.x(); i++ )
+		tileRow[i] = segment[cols[i]-firstCol];
+	}
+	else
+	{
+	    for ( int i=0; i<size.x(); i++ )
+	    {
+		file.seekg( rowOffset + std::streamoff(cols[i])*sizeof(float) );
+		file.read( (char*) &tileRow[i], sizeof(float) );
+	    }
+	}
+
+	if ( !file )
+	{
+	    std::cerr << "RawHeightFileSource: cannot read row " << row << " of " << _fileName << std::endl;
+	    return false;
+	}
+
+	prevRow = row;
+    }
+
+    return true;
+}
+
+
+} // namespace vsgGeo
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <vsgGeo/LayeredTexture.h>
 
 #include <cstdio>
+#include <string.h>
 
 #if defined _MSC_VER && __cplusplus < 201103L
 # define snprintf( a, n, ... ) _snprintf_s( a, n, _TRUNCATE, __VA_ARGS__ )
@@ -153,6 +154,97 @@ void LayerProcess::setColorSequenceTextureSampling( float start, float step )
 }
 
 
+void LayerProcess::createColorScaleSpace( unsigned char* rows, int udfIdx )
+{
+    const int rowSize = 256*4;
+    unsigned char* ptr = rows + rowSize;
+
+    // Exclude undef color from smoothing when at far end of color sequence
+    const int start = udfIdx==0 ? 1 : 0;
+    const int stop = udfIdx==255 ? 254 : 255;
+
+    // Use uniform smoothing kernel to create color scale space recursively
+    int stepout = 0;
+    for ( int scale=1; scale<nrColorScales(); scale++ )
+    {
+	stepout = scale>2 ? stepout*2 : 1;
+
+	for ( int pivot=0; pivot<256; pivot++ )
+	{
+	    const int idx1 = pivot-stepout<start ? start : pivot-stepout;
+	    const int offset1 = 4*(idx1-pivot) - rowSize;
+
+	    const int idx2 = pivot+stepout>stop ? stop : pivot+stepout;
+	    const int offset2 = 4*(idx2-pivot) - rowSize;
+	    
+	    for ( int channel=0; channel<4; channel++ )
+	    {
+		int val = *(ptr-rowSize);
+
+		if ( pivot>=start && pivot<=stop )
+		{
+		    const int sum = *(ptr+offset1) + *(ptr+offset2);
+		    val = scale>1 ? sum : val+sum/2;
+
+		    // Alternate truncation to preserve signal strength
+		    val = scale%2 ? (val+1)/2 : val/2;
+		}
+
+		(*ptr++) = (unsigned char) val;
+	    }
+	}
+    }
+}
+
+
+void LayerProcess::updateColorScaleSpace()
+{
+    const unsigned char* colSeqPtr = getColorSequencePtr();
+    if ( !colSeqPtr )
+    {
+	_colorScaleSpace.clear();
+	return;
+    }
+
+    _colorScaleSpace.resize( nrColorScales()*256*4 );
+    memcpy( &_colorScaleSpace[0], colSeqPtr, 256*4 );
+    createColorScaleSpace( &_colorScaleSpace[0], getColorSequenceUndefIdx() );
+}
+
+
+osg::Vec4f LayerProcess::getColorScaleSpaceColor( float colIdx, float scale ) const
+{
+    // Bilinear lookup like the shader does in the color sequence texture
+    float s = 255.0f * colIdx;
+    s = s<=0.0f ? 0.0f : (s>=255.0f ? 255.0f : s);
+    float t = scale<=0.0f ? 0.0f : scale;
+    if ( t>nrColorScales()-1 )
+	t = nrColorScales()-1;
+
+    const int s0 = (int) floor( s );
+    const int t0 = (int) floor( t );
+    const int s1 = s0<255 ? s0+1 : s0;
+    const int t1 = t0<nrColorScales()-1 ? t0+1 : t0;
+    const float sFrac = s-s0;
+    const float tFrac = t-t0;
+
+    const unsigned char* ptr00 = &_colorScaleSpace[4*(t0*256+s0)];
+    const unsigned char* ptr10 = &_colorScaleSpace[4*(t0*256+s1)];
+    const unsigned char* ptr01 = &_colorScaleSpace[4*(t1*256+s0)];
+    const unsigned char* ptr11 = &_colorScaleSpace[4*(t1*256+s1)];
+
+    osg::Vec4f col;
+    for ( int idx=0; idx<4; idx++ )
+    {
+	const float val0 = ptr00[idx]*(1.0f-sFrac) + ptr10[idx]*sFrac;
+	const float val1 = ptr01[idx]*(1.0f-sFrac) + ptr11[idx]*sFrac;
+	col[idx] = (val0*(1.0f-tFrac) + val1*tFrac) / 255.0f;
+    }
+
+    return col;
+}
+
+
 float LayerProcess::getOpacity() const
 { return _opacity; }
 
@@ -199,7 +291,6 @@ void LayerProcess::assignOrgCol3IfNeeded( std::string& code, int toIdx ) const
 void LayerProcess::getHeaderCode( std::string& code, int& nrUdf, int id, int toIdx, int fromIdx ) const
 {
     const int unit = _layTex.getDataLayerTextureUnit(id);
-    const int nrDims = _layTex.getTextureUnitNrDims(unit);
     const int udfId = _layTex.getDataLayerUndefLayerID(id);
 
     char line[100];
@@ -228,8 +319,9 @@ void LayerProcess::getHeaderCode( std::string& code, int& nrUdf, int id, int toI
 	_layTex.addAssignTexCrdLine( code, udfUnit );
 
 	const int udfChannel = _layTex.getDataLayerUndefChannel(id);
-	const int udfDims = _layTex.getTextureUnitNrDims( udfUnit );
-	snprintf( line, 100, "        udf = texture%dD( texture%d, texcrd.%.*s )[%d];\n", udfDims, udfUnit, udfDims, "stp", udfChannel );
+	code += "        udf = ";
+	_layTex.addTextureLookup( code, udfUnit );
+	snprintf( line, 100, "[%d];\n", udfChannel );
 	code += line;
 	if ( _layTex.areUndefLayersInverted() )
 	    code += "        udf = 1.0 - udf;\n";
@@ -243,7 +335,10 @@ void LayerProcess::getHeaderCode( std::string& code, int& nrUdf, int id, int toI
 	    code += "            ";
 	    _layTex.addAssignTexCrdLine( code, unit );
 	}
-	snprintf( line, 100, "            col%s = texture%dD( texture%d, texcrd.%.*s )%s;\n", to, nrDims, unit, nrDims, "stp", from );
+	snprintf( line, 100, "            col%s = ", to );
+	code += line;
+	_layTex.addTextureLookup( code, unit );
+	snprintf( line, 100, "%s;\n", from );
 	code += line;
 
 	const osg::Vec4f& udfColor = _layTex.getDataLayerImageUndefColor(id);
@@ -318,7 +413,10 @@ void LayerProcess::getHeaderCode( std::string& code, int& nrUdf, int id, int toI
     {
 	code += "        ";
 	_layTex.addAssignTexCrdLine( code, unit );
-	snprintf( line, 100, "        col%s = texture%dD( texture%d, texcrd.%.*s )%s;\n", to, nrDims, unit, nrDims, "stp", from );
+	snprintf( line, 100, "        col%s = ", to );
+	code += line;
+	_layTex.addTextureLookup( code, unit );
+	snprintf( line, 100, "%s;\n", from );
 	code += line;
 	assignOrgCol3IfNeeded( code, toIdx );
     }
@@ -382,7 +480,7 @@ void LayerProcess::getFooterCode( std::string& code, int& nrUdf, int stage ) con
 }
 
 
-void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, const osg::Vec2f& coord, int id, int toIdx, int fromIdx, float* orgCol3 ) const
+void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, const osg::Vec2f& coord, int id, int toIdx, int fromIdx, float* orgCol3, const TexelFootprint* footprint ) const
 {
     if ( udf>=1.0f )
 	return;
@@ -393,7 +491,7 @@ void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, c
     {
 	const float oldUdf = udf;
 	const int udfChannel = _layTex.getDataLayerUndefChannel(id);
-	udf = _layTex.getDataLayerTextureVec(udfId,coord)[udfChannel];
+	udf = _layTex.getDataLayerTextureVec(udfId,coord,footprint)[udfChannel];
 	if ( _layTex.areUndefLayersInverted() )
 	    udf = 1.0-udf;
 
@@ -403,7 +501,7 @@ void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, c
 
 	    if ( toIdx<0 )
 	    {
-		col = _layTex.getDataLayerTextureVec( id, coord );
+		col = _layTex.getDataLayerTextureVec( id, coord, footprint );
 		for ( int idx=0; idx<4; idx++ )
 		{
 		    if ( udf>0.0f && udfCol[idx]>=0.0f )
@@ -412,7 +510,7 @@ void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, c
 	    }
 	    else
 	    {
-		col[toIdx] = _layTex.getDataLayerTextureVec(id,coord)[fromIdx];
+		col[toIdx] = _layTex.getDataLayerTextureVec(id,coord,footprint)[fromIdx];
 		if ( udf>0.0f && udfCol[fromIdx]>=0.0f )
 		    col[toIdx] = (col[toIdx]-udfCol[fromIdx]*udf) / (1.0f-udf);
 	    }
@@ -452,12 +550,12 @@ void LayerProcess::processHeader( osg::Vec4f& col, float& udf, float stackUdf, c
     }
     else if ( toIdx>=0 )
     {
-	col[toIdx] = _layTex.getDataLayerTextureVec(id,coord)[fromIdx];
+	col[toIdx] = _layTex.getDataLayerTextureVec(id,coord,footprint)[fromIdx];
 	if ( orgCol3 && toIdx==3 )
 	    *orgCol3 = col[3];
     }
     else
-	col = _layTex.getDataLayerTextureVec( id, coord );
+	col = _layTex.getDataLayerTextureVec( id, coord, footprint );
 }
 
 
@@ -700,7 +798,7 @@ TransparencyType ColTabLayerProcess::getTransparencyType( bool imageOnly ) const
 }
 
 
-void ColTabLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord )
+void ColTabLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord, const TexelFootprint* footprint )
 {
     if ( !_colorSequence || !_layTex.isDataLayerOK(_id[0]) )
 	return;
@@ -708,6 +806,32 @@ void ColTabLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const
     osg::Vec4f col;
     float udf = 0.0f;
 
+    int nrChannels = 1;
+    while ( footprint && nrChannels<3 && _layTex.isDataLayerOK(getDataLayerID(nrChannels)) )
+	nrChannels++;
+
+    if ( footprint && nrChannels>1 && !_colorScaleSpace.empty() )
+    {
+	for ( int idx=nrChannels-1; idx>=0; idx-- )
+	    processHeader( col, udf, stackUdf, globalCoord, _id[idx], idx, _textureChannel[idx], 0, footprint );
+
+	// Same mipmap-dependent color scale selection as shader code
+	float mip = _layTex.getDataLayerMipLevel( _id[0], *footprint );
+	mip = mip<=0.0f ? 0.0f : (mip>=1.0f ? 1.0f : mip);
+
+	float var = col[1] - col[0]*col[0];
+	if ( nrChannels>2 )
+	    var += col[2]/255.0f;
+
+	const float stddev = 255.0f * mip * sqrt( var>0.0001f ? var : 0.0001f );
+	const float scale = stddev>0.5f ? log(stddev)/log(2.0f)+2.0f : stddev*2.0f;
+
+	col = getColorScaleSpaceColor( col[0], scale );
+	processFooter( fragColor, col, udf );
+	return;
+    }
+
+    // Color indices of one channel are not averaged, but select the nearest color
     processHeader( col, udf, stackUdf, globalCoord, _id[0], 0, _textureChannel[0] );
 
     const int val = (int) floor( 255.0f*col[0] + 0.5 );
@@ -838,7 +962,7 @@ TransparencyType RGBALayerProcess::getTransparencyType( bool imageOnly ) const
 }
 
 
-void RGBALayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord )
+void RGBALayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord, const TexelFootprint* footprint )
 {
     osg::Vec4f col( 0.0f, 0.0f, 0.0f, 1.0f );
     float orgCol3 = col[3];
@@ -848,7 +972,7 @@ void RGBALayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const o
     {
 	if ( _isOn[idx] && _layTex.isDataLayerOK(_id[idx]) )
 	{
-	    processHeader( col, udf, stackUdf, globalCoord, _id[idx], idx, _textureChannel[idx], &orgCol3 );
+	    processHeader( col, udf, stackUdf, globalCoord, _id[idx], idx, _textureChannel[idx], &orgCol3, footprint );
 	}
     }
 
@@ -898,7 +1022,7 @@ TransparencyType IdentityLayerProcess::getTransparencyType( bool imageOnly ) con
 }
 
 
-void IdentityLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord )
+void IdentityLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, const osg::Vec2f& globalCoord, const TexelFootprint* footprint )
 {
     if ( !_layTex.isDataLayerOK(_id) )
 	return;
@@ -906,7 +1030,7 @@ void IdentityLayerProcess::doProcess( osg::Vec4f& fragColor, float stackUdf, con
     osg::Vec4f col;
     float udf = 0.0f;
 
-    processHeader( col, udf, stackUdf, globalCoord, _id );
+    processHeader( col, udf, stackUdf, globalCoord, _id, -1, 0, 0, footprint );
     processFooter( fragColor, col, udf );
 }
 
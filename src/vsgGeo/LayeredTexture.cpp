@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include <vsgGeo/LayeredTexture.h>
 #include <vsgGeo/Vec2i.h>
+#include <vsgGeo/VirtualTexture.h>
+#include <vsgGeo/VolumeTextureCache.h>
 
 #include <string.h>
 #include <iostream>
@@ -220,15 +222,10 @@ static TransparencyType getImageTransparencyType( const osg::Image* image, int t
 }
 
 
-static void copyImageTile( const osg::Image& srcImage, osg::Image& tileImage, const Vec2i& tileOrigin, const Vec2i& tileSize, int sliceNr=0, ImageDataOrder dataOrder=vsgGeo::STR )
+static void getImageSteps( const osg::Image& srcImage, ImageDataOrder dataOrder, int& xStep, int& yStep, int& zStep )
 {
-    const int xSize = tileSize.x();
-    const int ySize = tileSize.y();
-
-    tileImage.allocateImage( xSize, ySize, 1, srcImage.getPixelFormat(), srcImage.getDataType(), srcImage.getPacking() );
-
     const int pixelSize = srcImage.getPixelSizeInBits()/8;
-    int xStep = pixelSize; int yStep = pixelSize; int zStep = pixelSize;
+    xStep = pixelSize; yStep = pixelSize; zStep = pixelSize;
 
     if ( dataOrder==vsgGeo::STR )
     {
@@ -254,6 +251,19 @@ static void copyImageTile( const osg::Image& srcImage, osg::Image& tileImage, co
     {
 	yStep *= srcImage.r(); xStep *= srcImage.r()*srcImage.t();
     }
+}
+
+
+static void copyImageTile( const osg::Image& srcImage, osg::Image& tileImage, const Vec2i& tileOrigin, const Vec2i& tileSize, int sliceNr=0, ImageDataOrder dataOrder=vsgGeo::STR )
+{
+    const int xSize = tileSize.x();
+    const int ySize = tileSize.y();
+
+    tileImage.allocateImage( xSize, ySize, 1, srcImage.getPixelFormat(), srcImage.getDataType(), srcImage.getPacking() );
+
+    const int pixelSize = srcImage.getPixelSizeInBits()/8;
+    int xStep, yStep, zStep;
+    getImageSteps( srcImage, dataOrder, xStep, yStep, zStep );
 
     unsigned char* tilePtr = tileImage.data();
     const unsigned char* imagePtr = srcImage.data();
@@ -278,6 +288,295 @@ static void copyImageTile( const osg::Image& srcImage, osg::Image& tileImage, co
 //============================================================================
 
 
+/* Separable resampling of one image slice, reading directly from the source
+   data order. Horizontal pass resamples source rows into a float buffer, the
+   vertical pass resamples its columns into the destination image. */
+
+struct ResampleKernel
+{
+    void			init(int srcSize,int destSize,
+				     RescaleFilter filter);
+
+    int				_nrTaps;
+    std::vector<int>		_srcIdx;	// _nrTaps per dest index
+    std::vector<float>		_weights;	// idem
+};
+
+
+static float getFilterWeight( float dist, RescaleFilter filter )
+{
+    dist = fabs( dist );
+
+    if ( filter==Box )
+	return dist<0.5f ? 1.0f : (dist==0.5f ? 0.5f : 0.0f);
+
+    if ( filter==Bilinear )
+	return dist<1.0f ? 1.0f-dist : 0.0f;
+
+    if ( dist<1e-5f )
+	return 1.0f;
+    if ( dist>=3.0f )
+	return 0.0f;
+
+    const float x = M_PI*dist;
+    return 3.0f * sin(x) * sin(x/3.0f) / (x*x);
+}
+
+
+void ResampleKernel::init( int srcSize, int destSize, RescaleFilter filter )
+{
+    const float scale = float(srcSize) / float(destSize);
+    const float stretch = scale>1.0f ? scale : 1.0f;	// Widen when shrinking
+
+    float radius = filter==Box ? 0.5f : (filter==Bilinear ? 1.0f : 3.0f);
+    radius *= stretch;
+
+    _nrTaps = (int) ceil( 2.0f*radius ) + 1;
+    _srcIdx.resize( destSize*_nrTaps );
+    _weights.resize( destSize*_nrTaps );
+
+    for ( int destIdx=0; destIdx<destSize; destIdx++ )
+    {
+	const float center = (destIdx+0.5f)*scale - 0.5f;
+	const int first = (int) ceil( center-radius );
+	float sum = 0.0f;
+
+	for ( int tap=0; tap<_nrTaps; tap++ )
+	{
+	    int srcIdx = first+tap;
+	    const float weight = getFilterWeight( (srcIdx-center)/stretch, filter );
+
+	    if ( srcIdx<0 ) srcIdx = 0;
+	    if ( srcIdx>=srcSize ) srcIdx = srcSize-1;
+
+	    _srcIdx[destIdx*_nrTaps+tap] = srcIdx;
+	    _weights[destIdx*_nrTaps+tap] = weight;
+	    sum += weight;
+	}
+
+	for ( int tap=0; sum!=0.0f && tap<_nrTaps; tap++ )
+	    _weights[destIdx*_nrTaps+tap] /= sum;
+    }
+}
+
+
+struct ResampleInfo
+{
+    const unsigned char*	_srcData;	// Start of slice
+    int				_xStep;
+    int				_yStep;
+    osg::Image*			_destImage;
+    GLenum			_dataType;
+    int				_nrComponents;
+    ResampleKernel		_xKernel;
+    ResampleKernel		_yKernel;
+    std::vector<float>		_buffer;	// srcHeight x destWidth
+};
+
+
+template<class T> static inline void writeResampled( unsigned char* ptr, float val, float minVal, float maxVal )
+{
+    val = floor( val+0.5f );
+    *((T*) ptr) = (T) (val<=minVal ? minVal : (val>=maxVal ? maxVal : val));
+}
+
+
+class ResampleThread : public GroupThread<ResampleThread>
+{
+public:
+			ResampleThread(ThreadGroup<ResampleThread>& tg)
+			    : GroupThread<ResampleThread>(tg)
+			{}
+
+    void		set(ResampleInfo& info,bool verticalPass,
+			    int startRow,int stopRow,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+			    _info = &info;
+			    _verticalPass = verticalPass;
+			    _startRow = startRow;
+			    _stopRow = stopRow;
+			    endSetFunction();
+			}
+
+protected:
+
+    void		doWork() override;
+    template<class T>
+    void		resampleRows();
+    void		resampleColumns();
+
+    ResampleInfo*	_info;
+    bool		_verticalPass;
+    int			_startRow;
+    int			_stopRow;
+};
+
+
+void ResampleThread::doWork()
+{
+    if ( _verticalPass )
+	resampleColumns();
+    else if ( _info->_dataType==GL_UNSIGNED_BYTE )
+	resampleRows<unsigned char>();
+    else if ( _info->_dataType==GL_SHORT )
+	resampleRows<short>();
+    else if ( _info->_dataType==GL_UNSIGNED_SHORT )
+	resampleRows<unsigned short>();
+    else if ( _info->_dataType==GL_FLOAT )
+	resampleRows<float>();
+}
+
+
+template<class T> void ResampleThread::resampleRows()
+{
+    const ResampleKernel& kernel = _info->_xKernel;
+    const int nrComp = _info->_nrComponents;
+    const int destWidth = _info->_destImage->s();
+
+    for ( int row=_startRow; row<=_stopRow; row++ )
+    {
+	const unsigned char* rowPtr = _info->_srcData + (pixel_uint) row*_info->_yStep;
+	float* bufPtr = &_info->_buffer[(pixel_uint) row*destWidth*nrComp];
+
+	const int* srcIdx = &kernel._srcIdx[0];
+	const float* weights = &kernel._weights[0];
+
+	for ( int x=0; x<destWidth; x++ )
+	{
+	    for ( int comp=0; comp<nrComp; comp++ )
+		bufPtr[comp] = 0.0f;
+
+	    for ( int tap=0; tap<kernel._nrTaps; tap++, srcIdx++, weights++ )
+	    {
+		const T* srcPtr = (const T*) (rowPtr + (pixel_uint) (*srcIdx)*_info->_xStep);
+		for ( int comp=0; comp<nrComp; comp++ )
+		    bufPtr[comp] += (*weights) * float(srcPtr[comp]);
+	    }
+
+	    bufPtr += nrComp;
+	}
+    }
+}
+
+
+void ResampleThread::resampleColumns()
+{
+    const ResampleKernel& kernel = _info->_yKernel;
+    osg::Image& dest = *_info->_destImage;
+    const int rowSize = dest.s() * _info->_nrComponents;
+    const GLenum dataType = _info->_dataType;
+
+    std::vector<float> accu( rowSize );
+
+    for ( int row=_startRow; row<=_stopRow; row++ )
+    {
+	std::fill( accu.begin(), accu.end(), 0.0f );
+
+	for ( int tap=0; tap<kernel._nrTaps; tap++ )
+	{
+	    const float weight = kernel._weights[row*kernel._nrTaps+tap];
+	    const int srcRow = kernel._srcIdx[row*kernel._nrTaps+tap];
+	    const float* bufPtr = &_info->_buffer[(pixel_uint) srcRow*rowSize];
+
+	    for ( int idx=0; idx<rowSize; idx++ )
+		accu[idx] += weight * bufPtr[idx];
+	}
+
+	unsigned char* destPtr = dest.data( 0, row );
+	for ( int idx=0; idx<rowSize; idx++ )
+	{
+	    if ( dataType==GL_UNSIGNED_BYTE )
+		writeResampled<unsigned char>( destPtr+idx, accu[idx], 0.0f, 255.0f );
+	    else if ( dataType==GL_SHORT )
+		writeResampled<short>( destPtr+2*idx, accu[idx], -32768.0f, 32767.0f );
+	    else if ( dataType==GL_UNSIGNED_SHORT )
+		writeResampled<unsigned short>( destPtr+2*idx, accu[idx], 0.0f, 65535.0f );
+	    else
+		((float*) destPtr)[idx] = accu[idx];
+	}
+    }
+}
+
+
+static void runResamplePass( ResampleInfo& info, bool verticalPass, int nrRows, ThreadGroup<ResampleThread>& threads )
+{
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrRows )
+	nrTasks = nrRows;
+
+    std::vector<osg::ref_ptr<ResampleThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = nrRows%nrTasks;
+    int start = 0;
+
+    while ( start<nrRows )
+    {
+	int stop = start + nrRows/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<ResampleThread> task = threads.getThread();
+	task->set( info, verticalPass, start, stop, readyCount );
+	tasks.push_back( task.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+}
+
+
+static bool canResampleImage( const osg::Image& image )
+{
+    const GLenum dataType = image.getDataType();
+    if ( dataType!=GL_UNSIGNED_BYTE && dataType!=GL_SHORT &&
+	 dataType!=GL_UNSIGNED_SHORT && dataType!=GL_FLOAT )
+	return false;
+
+    return osg::Image::computeNumComponents( image.getPixelFormat() )>0;
+}
+
+
+static void resampleImageSlice( const osg::Image& srcImage, int sliceNr, ImageDataOrder dataOrder, osg::Image& destImage, RescaleFilter filter, ThreadGroup<ResampleThread>& threads )
+{
+    const GLenum dataType = srcImage.getDataType();
+    const int nrComponents = osg::Image::computeNumComponents( srcImage.getPixelFormat() );
+
+    ResampleInfo info;
+    int zStep;
+    getImageSteps( srcImage, dataOrder, info._xStep, info._yStep, zStep );
+    if ( dataOrder==STR )	// Respects packing of rows
+    {
+	info._yStep = srcImage.getRowStepInBytes();
+	zStep = srcImage.getImageStepInBytes();
+    }
+
+    info._srcData = srcImage.data() + (pixel_uint) sliceNr*zStep;
+    info._destImage = &destImage;
+    info._dataType = dataType;
+    info._nrComponents = nrComponents;
+    info._xKernel.init( srcImage.s(), destImage.s(), filter );
+    info._yKernel.init( srcImage.t(), destImage.t(), filter );
+    info._buffer.resize( (pixel_uint) srcImage.t()*destImage.s()*nrComponents );
+
+    runResamplePass( info, false, srcImage.t(), threads );
+    runResamplePass( info, true, destImage.t(), threads );
+
+    destImage.dirty();
+}
+
+
+//============================================================================
+
+
 struct LayeredTextureData : public osg::Referenced
 {
 			LayeredTextureData(int id)
@@ -317,13 +616,20 @@ struct LayeredTextureData : public osg::Referenced
     void		cleanUp();
     void		updateTileImagesIfNeeded() const;
     bool		hasRescaledImage() const;
-    void		rescaleImage(int sNew,int tNew,bool inPlace=false);
+    bool		isImageShared() const;
+    void		rescaleImage(int sNew,int tNew,RescaleFilter,
+				     ThreadGroup<ResampleThread>&,
+				     bool inPlace=false);
     bool		do3D() const;
 
     const int					_id;
     osg::Vec2f					_origin;
     osg::Vec2f					_scale;
     osg::ref_ptr<osg::Image>			_image;
+    osg::ref_ptr<osg::Referenced>		_imageShareToken;
+				/* Held by all clones sharing _image copy-on-
+				   write. Created along with every new _image,
+				   so cloning never writes to the original. */
     osg::ref_ptr<osg::Image>			_imageSource;
     Vec2i					_imageSourceSize;
     const unsigned char*			_imageSourceData;
@@ -348,7 +654,15 @@ struct LayeredTextureData : public osg::Referenced
     TransparencyType				_transparency[4];
 
     mutable std::vector<osg::Image*>		_tileImages;
+    mutable OpenThreads::Mutex			_tileImageLock;
+				/* Own mutex instead of the texture-wide write
+				   lock: cut-outs are created concurrently, and
+				   possibly while a read lock is held. */
     mutable bool				_dirtyTileImages;
+    mutable OpenThreads::Mutex			_imageLock;
+				/* Guards _image and _sliceNr against virtual
+				   page fills, which run under the same read
+				   lock as image updates from the setup. */
 };
 
 
@@ -376,10 +690,12 @@ LayeredTextureData* LayeredTextureData::clone() const
     res->_imageSource = _imageSource.get();
     res->_vertex2TextureTrans = _vertex2TextureTrans ? new osg::Matrixf(*_vertex2TextureTrans) : 0;
 
-    if ( _image.get()==_imageSource.get() )
+    // Share image copy-on-write instead of deep copying it
+    if ( _image.get() )
+    {
 	res->_image = _image.get();
-    else
-	res->_image = (osg::Image*) _image->clone(osg::CopyOp::DEEP_COPY_ALL);
+	res->_imageShareToken = _imageShareToken.get();
+    }
 
     res->_borderColor = _borderColor;
     res->_borderColor = _borderColorSource;
@@ -556,6 +872,7 @@ osg::Vec4f LayeredTextureData::getTextureVec( const osg::Vec2f& globalCoord ) co
 
 void LayeredTextureData::cleanUp()
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _tileImageLock );
     std::vector<osg::Image*>::iterator it = _tileImages.begin();
     for ( ; it!=_tileImages.end(); it++ )
 	(*it)->unref();
@@ -568,6 +885,7 @@ void LayeredTextureData::updateTileImagesIfNeeded() const
 {
     if ( _dirtyTileImages )
     {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _tileImageLock );
 	std::vector<osg::Image*>::iterator it = _tileImages.begin();
 	for ( ; it!=_tileImages.end(); it++ )
 	    (*it)->dirty();
@@ -581,12 +899,39 @@ bool LayeredTextureData::hasRescaledImage() const
 { return _image && _image!=_imageSource; }
 
 
-void LayeredTextureData::rescaleImage( int sNew, int tNew, bool inPlace )
+bool LayeredTextureData::isImageShared() const
+{ return _imageShareToken.valid() && _imageShareToken->referenceCount()>1; }
+
+
+void LayeredTextureData::rescaleImage( int sNew, int tNew, RescaleFilter filter, ThreadGroup<ResampleThread>& threads, bool inPlace )
 {
     if ( sNew<1 || tNew<1 || !_imageSource )
 	return;
 
     const int sliceNr = _sliceNr>=_imageSource->r() ? _imageSource->r()-1 : _sliceNr;
+
+    inPlace = inPlace && !isImageShared();
+    const bool reuseImage = inPlace && _image && _image!=_imageSource && sNew==_image->s() && tNew==_image->t() && _image->getPixelFormat()==_imageSource->getPixelFormat() && _image->getDataType()==_imageSource->getDataType();
+
+    if ( canResampleImage(*_imageSource) )
+    {
+	osg::ref_ptr<osg::Image> scaledImage = reuseImage ? _image.get() : new osg::Image;
+	if ( !reuseImage )
+	{
+	    scaledImage->allocateImage( sNew, tNew, 1, _imageSource->getPixelFormat(), _imageSource->getDataType(), _imageSource->getPacking() );
+	    scaledImage->setInternalTextureFormat( _imageSource->getInternalTextureFormat() );
+	}
+
+	resampleImageSlice( *_imageSource, sliceNr, _imageDataOrder, *scaledImage, filter, threads );
+	if ( !reuseImage )
+	{
+	    _image = scaledImage;
+	    _imageShareToken = new osg::Referenced;
+	}
+	return;
+    }
+
+    // Fallback for data types not supported by native resampler
     osg::ref_ptr<osg::Image> imageToScale = new osg::Image();
 
     if ( _imageDataOrder==STR  )
@@ -604,7 +949,10 @@ void LayeredTextureData::rescaleImage( int sNew, int tNew, bool inPlace )
     if ( inPlace && _image && sNew==_image->s() && tNew==_image->t() )
 	_image->copySubImage( 0, 0, 0, imageToScale ); 
     else
+    {
 	_image = imageToScale;
+	_imageShareToken = new osg::Referenced;
+    }
 }
 
 
@@ -680,6 +1028,7 @@ LayeredTexture::LayeredTexture()
     , _tilingInfo( new TilingInfo )
     , _texInfo( new TextureInfo )
     , _useNormalizedTexCoords( false )
+    , _useSharedBrickGeometry( false )
     , _vertexOffsetLayerId( -1 )
     , _vertexOffsetChannel( 0 )
     , _vertexOffsetFactor( 1.0f )
@@ -699,6 +1048,7 @@ LayeredTexture::LayeredTexture()
     , _reInitTiling( false )
     , _isOn( true )
     , _compositeSubsampleSteps( 1 )
+    , _rescaleFilter( Bilinear )
 {
     _id2idxTable.push_back( -1 );	// ID=0 used to represent ColSeqTexture
 
@@ -719,6 +1069,7 @@ LayeredTexture::LayeredTexture( const LayeredTexture& lt,
     , _tilingInfo( new TilingInfo(*lt._tilingInfo) )
     , _texInfo( new TextureInfo(*lt._texInfo) )
     , _useNormalizedTexCoords( lt._useNormalizedTexCoords )
+    , _useSharedBrickGeometry( lt._useSharedBrickGeometry )
     , _vertexOffsetLayerId( lt._vertexOffsetLayerId )
     , _vertexOffsetChannel( lt._vertexOffsetChannel )
     , _vertexOffsetFactor( lt._vertexOffsetFactor )
@@ -738,6 +1089,9 @@ LayeredTexture::LayeredTexture( const LayeredTexture& lt,
     , _reInitTiling( false )
     , _isOn( lt._isOn )
     , _compositeSubsampleSteps( lt._compositeSubsampleSteps )
+    , _rescaleFilter( lt._rescaleFilter )
+    , _vtAtlas( lt._vtAtlas )
+    , _volCache( lt._volCache )
 {
     for ( unsigned int idx=0; idx<lt._dataLayers.size(); idx++ )
     {
@@ -759,6 +1113,13 @@ LayeredTexture::LayeredTexture( const LayeredTexture& lt,
 
 LayeredTexture::~LayeredTexture()
 {
+    if ( _vtAtlas )
+    {
+	std::vector<LayeredTextureData*>::iterator lit = _dataLayers.begin();
+	for ( ; lit!=_dataLayers.end(); lit++ )
+	    _vtAtlas->removePageGrid( this, (*lit)->_id );
+    }
+
     std::for_each( _dataLayers.begin(), _dataLayers.end(),
 	    	   osg::intrusive_ptr_release );
 
@@ -885,6 +1246,9 @@ void LayeredTexture::removeDataLayer( int id )
 
 	if (  id==_vertexOffsetLayerId )
 	    _vertexOffsetLayerId = -1;
+
+	if ( _vtAtlas )
+	    _vtAtlas->removePageGrid( this, id );
     }
 
     _lock.writeUnlock();
@@ -946,6 +1310,20 @@ void LayeredTexture::addAssignTexCrdLine( std::string& code, int unit ) const
 }
 
 
+void LayeredTexture::addTextureLookup( std::string& code, int unit ) const
+{
+    char line[50];
+    const int nrDims = getTextureUnitNrDims( unit );
+
+    if ( isPagedUnit(unit) )
+	snprintf( line, 50, "vtsample%d( texcrd.st )", unit );
+    else
+	snprintf( line, 50, "texture%dD( texture%d, texcrd.%.*s )", nrDims, unit, nrDims, "stp" );
+
+    code += line;
+}
+
+
 void LayeredTexture::setDataLayerOrigin( int id, const osg::Vec2f& origin )
 {
     const int idx = getDataLayerIndex( id );
@@ -1040,7 +1418,8 @@ void LayeredTexture::setDataLayerImage( int id, osg::Image* image, bool freezewh
 	Vec2i newImageSize( image->s(), image->t() );
 
 #ifdef USE_IMAGE_STRIDE
-	const bool retile = layer._imageSource.get()!=image || layer._imageSourceData!=image->data() || layer._imageSourceSize!=newImageSize || !layer._tileImages.size();
+	// Tiles with stride still point into rescaled copy shared with clone
+	const bool retile = layer._imageSource.get()!=image || layer._imageSourceData!=image->data() || layer._imageSourceSize!=newImageSize || !layer._tileImages.size() || (layer.hasRescaledImage() && layer.isImageShared());
 #else
 	const bool retile = true;
 #endif
@@ -1058,19 +1437,30 @@ void LayeredTexture::setDataLayerImage( int id, osg::Image* image, bool freezewh
 
 	if ( rescaleImage && !layer.do3D() && _textureSizePolicy!=AnySize && id!=_compositeLayerId )
 	{
-	    layer.rescaleImage( s, t, !retile );
+	    if ( !_resampleThreads )
+		_resampleThreads = ThreadGroup<ResampleThread>::getInst();
+
+	    layer._imageLock.lock();
+	    layer.rescaleImage( s, t, _rescaleFilter, *_resampleThreads, !retile );
+	    layer._imageLock.unlock();
 	    layer._imageScale.x() = float(image->s()) / float(s);
 	    layer._imageScale.y() = float(image->t()) / float(t);
 	}
 	else
 	{
+	    layer._imageLock.lock();
 	    layer._image = image;
+	    layer._imageLock.unlock();
+	    layer._imageShareToken = new osg::Referenced;
 	    layer._imageScale = osg::Vec2f( 1.0f, 1.0f );
 	}
 
 	layer._imageModifiedCount = image->getModifiedCount();
 	layer.clearTransparencyType();
 
+	if ( _vtAtlas )
+	    _vtAtlas->invalidatePages( this, id );
+
 	if ( retile || layer.do3D() )
 	{
 	    layer.adaptColors();
@@ -1081,7 +1471,10 @@ void LayeredTexture::setDataLayerImage( int id, osg::Image* image, bool freezewh
     }
     else if ( layer._image )
     {
+	layer._imageLock.lock();
 	layer._image = 0; 
+	layer._imageLock.unlock();
+	layer._imageShareToken = 0;
 	layer._imageSource = 0;
 	layer._nrPowerChannels = 0;
 	layer.adaptColors();
@@ -1206,12 +1599,19 @@ void LayeredTexture::setDataLayerSliceNr( int id, int nr )
     const int idx = getDataLayerIndex( id );
     if ( idx!=-1 && _dataLayers[idx]->_sliceNr!=nr )
     {
+	if ( !_resampleThreads )
+	    _resampleThreads = ThreadGroup<ResampleThread>::getInst();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _dataLayers[idx]->_imageLock );
 	_dataLayers[idx]->_sliceNr = nr;
 	if ( _dataLayers[idx]->hasRescaledImage() )
 	{
 	    osg::Image* image = _dataLayers[idx]->_image;
-	    _dataLayers[idx]->rescaleImage( image->s(), image->t() );
+	    _dataLayers[idx]->rescaleImage( image->s(), image->t(), _rescaleFilter, *_resampleThreads );
 	}
+
+	if ( _vtAtlas )
+	    _vtAtlas->invalidatePages( this, id );
 	if ( _dataLayers[idx]->_textureUnit>=0 )
 	    setUpdateVar( _tilingInfo->_retilingNeeded, true );
     }
@@ -1255,6 +1655,25 @@ void LayeredTexture::useNormalizedTexCoords( bool yn )
 }
 
 
+void LayeredTexture::useSharedBrickGeometry( bool yn )
+{
+    if ( _useSharedBrickGeometry != yn )
+    {
+	setUpdateVar( _tilingInfo->_retilingNeeded, true );
+	setUpdateVar( _updateSetupStateSet, true );
+	_useSharedBrickGeometry = yn;
+    }
+}
+
+
+bool LayeredTexture::isSharedBrickGeometryUsed() const
+{ return _useSharedBrickGeometry && _useShaders; }
+
+
+bool LayeredTexture::areTexCoordsNormalized() const
+{ return _useNormalizedTexCoords || isSharedBrickGeometryUsed(); }
+
+
 void LayeredTexture::setVertexOffsetLayerID( int id )
 {
     setUpdateVar( _updateSetupStateSet, true );
@@ -1313,6 +1732,10 @@ float LayeredTexture::getVertexOffsetBias() const
 { return _vertexOffsetBias; }
 
 
+bool LayeredTexture::isVertexOffsetUsed() const
+{ return _allowShaders && isDataLayerOK(_vertexOffsetLayerId); }
+
+
 const osg::Vec3f& LayeredTexture::getVertexOffsetTexelSpanVector( int dim ) const
 {
     return dim<1 ? _vertexOffsetSpanVec0 : _vertexOffsetSpanVec1;
@@ -1528,13 +1951,54 @@ TransparencyType LayeredTexture::getDataLayerTransparencyType( int id, int chann
 }
 
 
-osg::Vec4f LayeredTexture::getDataLayerTextureVec( int id, const osg::Vec2f& globalCoord ) const
+osg::Vec4f LayeredTexture::getDataLayerTextureVec( int id, const osg::Vec2f& globalCoord, const TexelFootprint* footprint ) const
 {
     const int idx = getDataLayerIndex( id );
     if ( idx==-1 )
 	return osg::Vec4f( -1.0f, -1.0f, -1.0f, -1.0f );
 
-    return _dataLayers[idx]->getTextureVec( globalCoord );
+    const LayeredTextureData& layer = *_dataLayers[idx];
+
+    if ( !footprint || !_enableMipmapping || layer._filterType==Nearest )
+	return layer.getTextureVec( globalCoord );
+
+    const float mip = getDataLayerMipLevel( id, *footprint );
+    if ( mip<=0.0f )
+	return layer.getTextureVec( globalCoord );
+
+    // Box average over the footprint instead of a real mipmap pyramid
+    int nrSamples = (int) ceil( powf(2.0f,mip) );
+    if ( nrSamples>8 )
+	nrSamples = 8;
+
+    osg::Vec4f sum( 0.0f, 0.0f, 0.0f, 0.0f );
+    for ( int i=0; i<nrSamples; i++ )
+    {
+	const float fx = (i+0.5f)/nrSamples - 0.5f;
+	for ( int j=0; j<nrSamples; j++ )
+	{
+	    const float fy = (j+0.5f)/nrSamples - 0.5f;
+	    sum += layer.getTextureVec( globalCoord + footprint->_dx*fx + footprint->_dy*fy );
+	}
+    }
+
+    return sum / float(nrSamples*nrSamples);
+}
+
+
+float LayeredTexture::getDataLayerMipLevel( int id, const TexelFootprint& footprint ) const
+{
+    const int idx = getDataLayerIndex( id );
+    if ( idx==-1 )
+	return 0.0f;
+
+    const LayeredTextureData& layer = *_dataLayers[idx];
+    const osg::Vec2f zero = layer.getLayerCoord( osg::Vec2f(0.0f,0.0f) );
+    const float dx = (layer.getLayerCoord(footprint._dx)-zero).length();
+    const float dy = (layer.getLayerCoord(footprint._dy)-zero).length();
+    const float maxDelta = dx>dy ? dx : dy;
+
+    return maxDelta>0.0f ? log2f( maxDelta ) : 0.0f;
 }
 
 
@@ -1552,6 +2016,13 @@ void LayeredTexture::transformDataLayerCoord( osg::Vec2f& local,
 }
 
 
+osg::Vec2f LayeredTexture::getDataLayerCoord( int id, const osg::Vec2f& globalCoord ) const
+{
+    const int idx = getDataLayerIndex( id );
+    return idx<0 ? globalCoord : _dataLayers[idx]->getLayerCoord( globalCoord );
+}
+
+
 LayerProcess* LayeredTexture::getProcess( int idx )
 { return idx>=0 && idx<(int) _processes.size() ? _processes[idx] : 0;  }
 
@@ -1874,8 +2345,19 @@ void LayeredTexture::reInitTiling( float texelSizeRatio )
 
     std::vector<LayeredTextureData*>::iterator lit = _dataLayers.begin();
     for ( ; lit!=_dataLayers.end(); lit++ )
+    {
 	(*lit)->cleanUp();
 
+	if ( !_vtAtlas )
+	    continue;
+
+	const osg::Image* image = (*lit)->_image;
+	if ( isPagedLayer(**lit) )
+	    _vtAtlas->setPageGrid( this, (*lit)->_id, Vec2i(image->s(),image->t()) );
+	else
+	    _vtAtlas->removePageGrid( this, (*lit)->_id );
+    }
+
     setUpdateVar( _tilingInfo->_retilingNeeded, false );
     _externalTexelSizeRatio = texelSizeRatio; 
     _reInitTiling = false;
@@ -2082,19 +2564,23 @@ osg::Vec2 LayeredTexture::tilingPlanResolution() const
 }
 
 
+osg::Vec2f LayeredTexture::getGlobalCoord( const osg::Vec2f& tilingCoord ) const
+{
+    const osg::Vec2f smallestScale = _tilingInfo->_smallestScale;
+    osg::Vec2f globalCoord( smallestScale.x() * (tilingCoord.x()+0.5),
+			    smallestScale.y() * (tilingCoord.y()+0.5) );
+
+    return globalCoord + _tilingInfo->_envelopeOrigin;
+}
+
+
 osg::StateSet* LayeredTexture::createCutoutStateSet( const osg::Vec2f& origin, const osg::Vec2f& opposite, std::vector<LayeredTexture::TextureCoordData>& tcData, const VertexOffsetCutoutInfo* vertexOffsetInfo ) const
 {
     tcData.clear();
     osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
 
-    const osg::Vec2f smallestScale = _tilingInfo->_smallestScale;
-    osg::Vec2f globalOrigin( smallestScale.x() * (origin.x()+0.5),
-			     smallestScale.y() * (origin.y()+0.5) );
-    globalOrigin += _tilingInfo->_envelopeOrigin;
-
-    osg::Vec2f globalOpposite( smallestScale.x() * (opposite.x()+0.5),
-			       smallestScale.y() * (opposite.y()+0.5) );
-    globalOpposite += _tilingInfo->_envelopeOrigin;
+    const osg::Vec2f globalOrigin = getGlobalCoord( origin );
+    const osg::Vec2f globalOpposite = getGlobalCoord( opposite );
 
     for ( int idx=nrDataLayers()-1; idx>=0; idx-- )
     {
@@ -2108,6 +2594,12 @@ osg::StateSet* LayeredTexture::createCutoutStateSet( const osg::Vec2f& origin, c
 	    continue;
 	}
 
+	if ( isPagedLayer(*layer) )
+	{
+	    addPagedLayerToStateSet( *layer, globalOrigin, globalOpposite, tcData, *stateset );
+	    continue;
+	}
+
 	const osg::Vec2f localOrigin = layer->getLayerCoord( globalOrigin );
 	const osg::Vec2f localOpposite = layer->getLayerCoord( globalOpposite );
 
@@ -2239,9 +2731,9 @@ osg::StateSet* LayeredTexture::createCutoutStateSet( const osg::Vec2f& origin, c
 	    tileImage->setImage( tileSize.x(), tileSize.y(), 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), dataOrigin, osg::Image::NO_DELETE, image->getPacking(), rowLength ); 
 
 	    tileImage->ref();
-	    const_cast<LayeredTexture*>(this)->_lock.writeLock();
+	    layer->_tileImageLock.lock();
 	    layer->_tileImages.push_back( tileImage );
-	    const_cast<LayeredTexture*>(this)->_lock.writeUnlock();
+	    layer->_tileImageLock.unlock();
 	}
 	else
 #endif
@@ -2261,26 +2753,8 @@ osg::StateSet* LayeredTexture::createCutoutStateSet( const osg::Vec2f& origin, c
 	tc11.x() = (localOpposite.x()-tileOrigin.x()) / tileSize.x();
 	tc11.y() = (localOpposite.y()-tileOrigin.y()) / tileSize.y();
 
-	char uniformName[20];
-	if ( _useNormalizedTexCoords )
-	{
-	    const osg::Vec4f texCrdBias( tc00.x(), tc00.y(), 0.0f, 0.0f );
-	    osg::Vec4f texCrdFactor( tc11.x(), tc11.y(), 1.0f, 1.0f );
-	    texCrdFactor -= texCrdBias;
-
-	    tc00.x() = 0.0f;
-	    tc00.y() = 0.0f;
-	    tc11.x() = (globalOpposite.x()-globalOrigin.x()) / _tilingInfo->_envelopeSize.x();
-	    tc11.y() = (globalOpposite.y()-globalOrigin.y()) / _tilingInfo->_envelopeSize.y();
-
-	    texCrdFactor.x() /= tc11.x();
-	    texCrdFactor.y() /= tc11.y();
-
-	    snprintf( uniformName, 20, "texcrdfactor%d", layer->_textureUnit );
-	    stateset->addUniform( new osg::Uniform(uniformName,texCrdFactor) );
-	    snprintf( uniformName, 20, "texcrdbias%d", layer->_textureUnit );
-	    stateset->addUniform( new osg::Uniform(uniformName,texCrdBias) );
-	}
+	if ( areTexCoordsNormalized() )
+	    normalizeTexCrds( layer->_textureUnit, tc00, tc11, globalOrigin, globalOpposite, *stateset );
 
 	tc01 = osg::Vec2f( tc11.x(), tc00.y() );
 	tc10 = osg::Vec2f( tc00.x(), tc11.y() );
@@ -2305,6 +2779,7 @@ osg::StateSet* LayeredTexture::createCutoutStateSet( const osg::Vec2f& origin, c
 	texture->setBorderColor( layer->_borderColor );
 
 	stateset->setTextureAttributeAndModes( layer->_textureUnit, texture.get() );
+	char uniformName[20];
 	snprintf( uniformName, 20, "texsize%d", layer->_textureUnit );
 	const osg::Vec2 texSize( tileSize.x(), tileSize.y() );
 	stateset->addUniform( new osg::Uniform(uniformName,texSize) );
@@ -2348,7 +2823,20 @@ void LayeredTexture::add3DTextureToStateSet( const LayeredTextureData& layer, st
     const Vec2i iDummy( 0, 0 );
     tcData.push_back( TextureCoordData( layer._textureUnit, fDummy, fDummy, fDummy, fDummy, iDummy, iDummy ) );
 
-    osg::ref_ptr<osg::Texture3D> texture = new osg::Texture3D( image );
+    osg::ref_ptr<osg::Texture3D> texture;
+    if ( _volCache )
+    {
+	const osg::Texture::FilterMode filterMode = layer._filterType==Nearest ? osg::Texture::NEAREST : osg::Texture::LINEAR;
+	texture = _volCache->getTexture( image, filterMode, layer._borderColor );
+	if ( texture )
+	{
+	    stateset.setTextureAttributeAndModes( layer._textureUnit, texture.get() );
+	    add3DTextureUniforms( layer, stateset );
+	    return;
+	}
+    }
+
+    texture = new osg::Texture3D( image );
     texture->setResizeNonPowerOfTwoHint( false );
 
     osg::Texture::WrapMode wrapMode = osg::Texture::CLAMP_TO_EDGE;
@@ -2372,6 +2860,13 @@ void LayeredTexture::add3DTextureToStateSet( const LayeredTextureData& layer, st
     texture->setBorderColor( layer._borderColor );
 
     stateset.setTextureAttributeAndModes( layer._textureUnit, texture.get() );
+    add3DTextureUniforms( layer, stateset );
+}
+
+
+void LayeredTexture::add3DTextureUniforms( const LayeredTextureData& layer, osg::StateSet& stateset ) const
+{
+    const osg::Image* image = layer._image;
 
     char uniformName[20];
     snprintf( uniformName, 20, "texsize%d", layer._textureUnit );
@@ -2383,9 +2878,325 @@ void LayeredTexture::add3DTextureToStateSet( const LayeredTextureData& layer, st
 }
 
 
-void LayeredTexture::updateSetupStateSet()
+void LayeredTexture::normalizeTexCrds( int unit, osg::Vec2f& tc00, osg::Vec2f& tc11, const osg::Vec2f& globalOrigin, const osg::Vec2f& globalOpposite, osg::StateSet& stateset ) const
 {
-    setUpdateVar( _updateSetupStateSet, true );
+    const osg::Vec4f texCrdBias( tc00.x(), tc00.y(), 0.0f, 0.0f );
+    osg::Vec4f texCrdFactor( tc11.x(), tc11.y(), 1.0f, 1.0f );
+    texCrdFactor -= texCrdBias;
+
+    tc00.x() = 0.0f;
+    tc00.y() = 0.0f;
+    tc11.x() = (globalOpposite.x()-globalOrigin.x()) / _tilingInfo->_envelopeSize.x();
+    tc11.y() = (globalOpposite.y()-globalOrigin.y()) / _tilingInfo->_envelopeSize.y();
+
+    // Shared brick geometry spans a unit square for every brick
+    if ( isSharedBrickGeometryUsed() )
+	tc11 = osg::Vec2f( 1.0f, 1.0f );
+
+    texCrdFactor.x() /= tc11.x();
+    texCrdFactor.y() /= tc11.y();
+
+    char uniformName[20];
+    snprintf( uniformName, 20, "texcrdfactor%d", unit );
+    stateset.addUniform( new osg::Uniform(uniformName,texCrdFactor) );
+    snprintf( uniformName, 20, "texcrdbias%d", unit );
+    stateset.addUniform( new osg::Uniform(uniformName,texCrdBias) );
+}
+
+
+void LayeredTexture::addPagedLayerToStateSet( const LayeredTextureData& layer, const osg::Vec2f& globalOrigin, const osg::Vec2f& globalOpposite, std::vector<LayeredTexture::TextureCoordData>& tcData, osg::StateSet& stateset ) const
+{
+    const osg::Image* image = layer._image;
+    osg::Texture2D* pageTable = _vtAtlas->getPageTableTexture( this, layer._id );
+    if ( !pageTable )
+	return;
+
+    // Page table covers the whole image, so no tile cut-out needed
+    const Vec2i imageSize( image->s(), image->t() );
+    const osg::Vec2f localOrigin = layer.getLayerCoord( globalOrigin );
+    const osg::Vec2f localOpposite = layer.getLayerCoord( globalOpposite );
+
+    osg::Vec2f tc00( localOrigin.x()/imageSize.x(), localOrigin.y()/imageSize.y() );
+    osg::Vec2f tc11( localOpposite.x()/imageSize.x(), localOpposite.y()/imageSize.y() );
+
+    if ( areTexCoordsNormalized() )
+	normalizeTexCrds( layer._textureUnit, tc00, tc11, globalOrigin, globalOpposite, stateset );
+
+    const osg::Vec2f tc01( tc11.x(), tc00.y() );
+    const osg::Vec2f tc10( tc00.x(), tc11.y() );
+    tcData.push_back( TextureCoordData( layer._textureUnit, tc00, tc01, tc10, tc11, Vec2i(0,0), imageSize ) );
+
+    stateset.setTextureAttributeAndModes( layer._textureUnit, pageTable );
+
+    char uniformName[20];
+    snprintf( uniformName, 20, "texsize%d", layer._textureUnit );
+    const osg::Vec2 texSize( imageSize.x(), imageSize.y() );
+    stateset.addUniform( new osg::Uniform(uniformName,texSize) );
+
+    const Vec2i nrPages = _vtAtlas->getPageGridSize( this, layer._id );
+    snprintf( uniformName, 20, "vtpages%d", layer._textureUnit );
+    stateset.addUniform( new osg::Uniform(uniformName,osg::Vec2(nrPages.x(),nrPages.y())) );
+}
+
+
+void LayeredTexture::setVirtualTextureAtlas( VirtualTextureAtlas* atlas )
+{
+    if ( _vtAtlas.get()==atlas )
+	return;
+
+    _lock.writeLock();
+
+    if ( _vtAtlas )
+    {
+	std::vector<LayeredTextureData*>::iterator lit = _dataLayers.begin();
+	for ( ; lit!=_dataLayers.end(); lit++ )
+	    _vtAtlas->removePageGrid( this, (*lit)->_id );
+    }
+
+    _vtAtlas = atlas;
+
+    _lock.writeUnlock();
+
+    setUpdateVar( _tilingInfo->_retilingNeeded, true );
+    setUpdateVar( _updateSetupStateSet, true );
+}
+
+
+void LayeredTexture::setVolumeTextureCache( VolumeTextureCache* cache )
+{
+    if ( _volCache.get()==cache )
+	return;
+
+    _lock.writeLock();
+    _volCache = cache;
+    _lock.writeUnlock();
+
+    setUpdateVar( _tilingInfo->_retilingNeeded, true );
+}
+
+
+bool LayeredTexture::isVirtualTexturingEnabled() const
+{
+    return _vtAtlas && _useShaders && _texInfo->_nrUnits>2;
+}
+
+
+int LayeredTexture::nrUsableTextureUnits() const
+{
+    // Last texture unit is reserved for virtual texture atlas shaders
+    return isVirtualTexturingEnabled() ? _texInfo->_nrUnits-1 : _texInfo->_nrUnits;
+}
+
+
+bool LayeredTexture::isPagedLayer( const LayeredTextureData& layer ) const
+{
+    if ( !isVirtualTexturingEnabled() || layer._textureUnit<0 || layer.do3D() )
+	return false;
+
+    // Vertex offset (undef) layers are sampled at lod in vertex shader
+    if ( layer._id==_compositeLayerId || layer._id==_vertexOffsetLayerId )
+	return false;
+    if ( isDataLayerOK(_vertexOffsetLayerId) && layer._id==getDataLayerUndefLayerID(_vertexOffsetLayerId) )
+	return false;
+
+    const osg::Image* image = layer._image;
+    if ( !image || !image->s() || !image->t() || image->getDataType()!=GL_UNSIGNED_BYTE )
+	return false;
+
+    return texture2ImageChannel( 0, image->getPixelFormat() )>=0;
+}
+
+
+bool LayeredTexture::isPagedUnit( int unit ) const
+{
+    const int idx = getDataLayerIndex( getTextureUnitLayerId(unit) );
+    return idx>=0 && isPagedLayer( *_dataLayers[idx] );
+}
+
+
+bool LayeredTexture::requestVirtualPages( const osg::Vec2f& origin, const osg::Vec2f& opposite ) const
+{
+    if ( !isVirtualTexturingEnabled() )
+	return true;
+
+    const osg::Vec2f globalOrigin = getGlobalCoord( origin );
+    const osg::Vec2f globalOpposite = getGlobalCoord( opposite );
+
+    const int pageSize = _vtAtlas->getPageSize();
+    bool allResident = true;
+
+    const_cast<LayeredTexture*>(this)->_lock.readLock();
+
+    std::vector<LayeredTextureData*>::const_iterator lit = _dataLayers.begin();
+    for ( ; lit!=_dataLayers.end(); lit++ )
+    {
+	if ( !isPagedLayer(**lit) )
+	    continue;
+
+	const osg::Vec2f localOrigin = (*lit)->getLayerCoord( globalOrigin );
+	const osg::Vec2f localOpposite = (*lit)->getLayerCoord( globalOpposite );
+
+	// One texel margin covers linear filtering across page borders
+	Vec2i firstPage, lastPage;
+	for ( int dim=0; dim<=1; dim++ )
+	{
+	    const float minCoord = osg::minimum( localOrigin[dim], localOpposite[dim] );
+	    const float maxCoord = osg::maximum( localOrigin[dim], localOpposite[dim] );
+	    firstPage[dim] = (int) floor( (minCoord-1.0f) / pageSize );
+	    lastPage[dim] = (int) floor( (maxCoord+1.0f) / pageSize );
+	}
+
+	if ( !_vtAtlas->requestPages(this,(*lit)->_id,firstPage,lastPage) )
+	    allResident = false;
+    }
+
+    const_cast<LayeredTexture*>(this)->_lock.readUnlock();
+
+    return allResident;
+}
+
+
+void LayeredTexture::updateVirtualPages()
+{
+    if ( !_vtAtlas )
+	return;
+
+    std::vector<VirtualTextureAtlas::PageLoad> loads;
+    _vtAtlas->assignRequestedPages( this, loads );
+    if ( loads.empty() )
+	return;
+
+    _lock.readLock();
+
+    std::vector<VirtualTextureAtlas::PageLoad>::const_iterator it = loads.begin();
+    for ( ; it!=loads.end(); it++ )
+    {
+	const int idx = getDataLayerIndex( it->_layerId );
+	if ( idx>=0 && isPagedLayer(*_dataLayers[idx]) )
+	    fillVirtualPage( *_dataLayers[idx], it->_pageNr, _vtAtlas->getSlotData(it->_slot), _vtAtlas->getAtlasRowSizeInBytes() );
+    }
+
+    _lock.readUnlock();
+
+    _vtAtlas->commitPages( loads );
+}
+
+
+void LayeredTexture::fillVirtualPage( const LayeredTextureData& layer, const Vec2i& pageNr, unsigned char* dest, int rowSize ) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( layer._imageLock );
+    if ( !layer._image )	// Removed since paged check
+	return;
+
+    const osg::Image& image = *layer._image;
+
+    int sliceNr = layer._sliceNr;
+    if ( sliceNr>=image.r() )
+	sliceNr = image.r()-1;
+
+    ImageDataOrder dataOrder( STR );
+    if ( !layer.hasRescaledImage() )
+	dataOrder = layer._imageDataOrder;
+
+    int xStep, yStep, zStep;
+    getImageSteps( image, dataOrder, xStep, yStep, zStep );
+    const unsigned char* slicePtr = image.data() + (pixel_uint) sliceNr*zStep;
+
+    int channels[4];
+    for ( int tc=0; tc<4; tc++ )
+	channels[tc] = texture2ImageChannel( tc, image.getPixelFormat() );
+
+    // Padded page includes a one-texel gutter of clamped edge pixels
+    const int pageSize = _vtAtlas->getPageSize();
+    const int paddedSize = _vtAtlas->getPaddedPageSize();
+    const int s0 = pageNr.x()*pageSize - 1;
+    const int t0 = pageNr.y()*pageSize - 1;
+
+    for ( int y=0; y<paddedSize; y++ )
+    {
+	int t = t0+y;
+	if ( t<0 ) t = 0;
+	if ( t>=image.t() ) t = image.t()-1;
+
+	unsigned char* destPtr = dest + y*rowSize;
+	const unsigned char* rowPtr = slicePtr + (pixel_uint) t*yStep;
+
+	for ( int x=0; x<paddedSize; x++ )
+	{
+	    int s = s0+x;
+	    if ( s<0 ) s = 0;
+	    if ( s>=image.s() ) s = image.s()-1;
+
+	    const unsigned char* pixelPtr = rowPtr + (pixel_uint) s*xStep;
+	    for ( int tc=0; tc<4; tc++ )
+	    {
+		const int ic = channels[tc];
+		if ( ic==ONE_CHANNEL )
+		    *destPtr++ = 255;
+		else if ( ic==ZERO_CHANNEL || ic<0 )
+		    *destPtr++ = 0;
+		else
+		    *destPtr++ = pixelPtr[ic];
+	    }
+	}
+    }
+}
+
+
+void LayeredTexture::getVirtualSampleCode( std::string& code, int unit ) const
+{
+    const int idx = getDataLayerIndex( getTextureUnitLayerId(unit) );
+    if ( idx<0 )
+	return;
+
+    const LayeredTextureData& layer = *_dataLayers[idx];
+    const float pageSize = _vtAtlas->getPageSize();
+    const float paddedSize = _vtAtlas->getPaddedPageSize();
+    const float atlasSize = _vtAtlas->getAtlasSize();
+
+    char line[100];
+    snprintf( line, 100, "vec4 vtsample%d( vec2 tc )\n", unit );
+    code += line;
+    code += "{\n";
+    snprintf( line, 100, "    vec2 pix = tc * texsize%d;\n", unit );
+    code += line;
+
+    const osg::Vec4f& border = layer._borderColor;
+    if ( border[0]>=0.0f )
+    {
+	snprintf( line, 100, "    if ( any(lessThan(pix,vec2(0.0))) || any(greaterThan(pix,texsize%d)) )\n", unit );
+	code += line;
+	snprintf( line, 100, "        return vec4(%.6f,%.6f,%.6f,%.6f);\n", border[0], border[1], border[2], border[3] );
+	code += line;
+    }
+
+    snprintf( line, 100, "    pix = clamp( pix, vec2(0.5), texsize%d-vec2(0.5) );\n", unit );
+    code += line;
+
+    if ( layer._filterType==Nearest )
+	code += "    pix = floor( pix ) + vec2(0.5);\n";
+
+    snprintf( line, 100, "    vec2 page = min( floor(pix/%.1f), vtpages%d-vec2(1.0) );\n", pageSize, unit );
+    code += line;
+    snprintf( line, 100, "    vec4 entry = texture2D( texture%d, (page+vec2(0.5))/vtpages%d );\n", unit, unit );
+    code += line;
+
+    // Not yet resident pages show transparent until loaded
+    code += "    if ( entry.a < 0.5 )\n"
+	    "        return vec4(0.0,0.0,0.0,0.0);\n";
+
+    snprintf( line, 100, "    pix += floor(entry.rg*255.0+0.5)*%.1f + vec2(1.0) - page*%.1f;\n", paddedSize, pageSize );
+    code += line;
+    snprintf( line, 100, "    return texture2D( vtatlas, pix/%.1f );\n", atlasSize );
+    code += line;
+    code += "}\n"
+	    "\n";
+}
+
+
+void LayeredTexture::updateSetupStateSet()
+{
+    setUpdateVar( _updateSetupStateSet, true );
 }
 
 
@@ -2532,11 +3343,22 @@ void LayeredTexture::buildShaders()
     program->addShader( fragmentShader.get() );
     _setupStateSet->setAttributeAndModes( program.get() );
 
+    bool hasPagedUnits = false;
     char samplerName[20];
     for ( it=activeUnits.begin(); it!=activeUnits.end(); it++ )
     {
 	snprintf( samplerName, 20, "texture%d", *it );
 	_setupStateSet->addUniform( new osg::Uniform(samplerName, *it) );
+
+	if ( isPagedUnit(*it) )
+	    hasPagedUnits = true;
+    }
+
+    if ( hasPagedUnits )
+    {
+	const int atlasUnit = nrUsableTextureUnits();
+	_setupStateSet->setTextureAttributeAndModes( atlasUnit, _vtAtlas->getAtlasTexture() );
+	_setupStateSet->addUniform( new osg::Uniform("vtatlas", atlasUnit) );
     }
 
     setRenderingHint( stackIsOpaque );
@@ -2650,7 +3472,7 @@ int LayeredTexture::getProcessInfo( std::vector<int>& layerIDs, int& nrUsedLayer
 	if ( nrUsedLayers<0 )
 	{
 	    const int sz = layerIDs.size();
-	    if ( sz > _texInfo->_nrUnits )
+	    if ( sz > nrUsableTextureUnits() )
 	    {
 		nrUsedLayers = sz-nrPushed;
 		if ( !nrProc || !_maySkipEarlyProcesses )
@@ -2681,7 +3503,7 @@ int LayeredTexture::getProcessInfo( std::vector<int>& layerIDs, int& nrUsedLayer
 void LayeredTexture::createColSeqTexture()
 {
     const int nrProc = nrProcesses();
-    const int nrScales = 10;	// stddev = 0, 0.5, 1, 2, 4, 8, 16, 32, 64, 128
+    const int nrScales = LayerProcess::nrColorScales(); // stddev = 0, 0.5, 1, 2, 4, 8, 16, 32, 64, 128
     const int nrRows = powerOf2Ceil( nrProc*nrScales );
 
     osg::ref_ptr<osg::Image> colSeqImage = new osg::Image();
@@ -2700,44 +3522,7 @@ void LayeredTexture::createColSeqTexture()
 
 	unsigned char* ptr = colSeqImage->data( 0, row );
 	memcpy( ptr, colSeqPtr, rowSize );
-	ptr += rowSize;
-
-	// Exclude undef color from smoothing when at far end of color sequence
-	const int udfIdx = (*it)->getColorSequenceUndefIdx();
-	const int start = udfIdx==0 ? 1 : 0;
-	const int stop = udfIdx==255 ? 254 : 255;
-
-	// Use uniform smoothing kernel to create color scale space recursively
-	int stepout = 0;
-	for ( int scale=1; scale<nrScales; scale++ )
-	{
-	    stepout = scale>2 ? stepout*2 : 1;
-
-	    for ( int pivot=0; pivot<256; pivot++ )
-	    {
-		const int idx1 = pivot-stepout<start ? start : pivot-stepout;
-		const int offset1 = 4*(idx1-pivot) - rowSize;
-
-		const int idx2 = pivot+stepout>stop ? stop : pivot+stepout;
-		const int offset2 = 4*(idx2-pivot) - rowSize;
-		
-		for ( int channel=0; channel<4; channel++ )
-		{
-		    int val = *(ptr-rowSize);
-
-		    if ( pivot>=start && pivot<=stop )
-		    {
-			const int sum = *(ptr+offset1) + *(ptr+offset2);
-			val = scale>1 ? sum : val+sum/2;
-
-			// Alternate truncation to preserve signal strength
-			val = scale%2 ? (val+1)/2 : val/2;
-		    }
-
-		    (*ptr++) = (unsigned char) val;
-		}
-	    }
-	}
+	LayerProcess::createColorScaleSpace( ptr, (*it)->getColorSequenceUndefIdx() );
     }
 
     osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D( colSeqImage );
@@ -2748,7 +3533,7 @@ void LayeredTexture::createColSeqTexture()
     const osg::Vec2 texSize( 256, nrRows );
     _setupStateSet->addUniform( new osg::Uniform("texsize0",texSize) );
 
-    if ( _useNormalizedTexCoords )
+    if ( areTexCoordsNormalized() )
     {
 	const osg::Vec4 texCrdFactor( 1.0f, 1.0f, 1.0f, 1.0f );
 	_setupStateSet->addUniform( new osg::Uniform("texcrdfactor0",texCrdFactor) );
@@ -2787,7 +3572,7 @@ void LayeredTexture::assignTextureUnits()
 	for ( ; iit!=orderedLayerIDs.end() && nrUsedLayers>0; iit++ )
 	{
 	    if ( (*iit)>0 )
-		setDataLayerTextureUnit( *iit, (++unit)%_texInfo->_nrUnits );
+		setDataLayerTextureUnit( *iit, (++unit)%nrUsableTextureUnits() );
 
 	    nrUsedLayers--;
 	}
@@ -2817,7 +3602,11 @@ void LayeredTexture::getVertexShaderCode( std::string& code, const std::vector<i
     code = "varying vec4 vertexpos;\n"
 	   "\n";
 
-    if ( _useNormalizedTexCoords )
+    if ( isSharedBrickGeometryUsed() )
+	code += "uniform mat4 brickvertextrans;\n"
+		"\n";
+
+    if ( areTexCoordsNormalized() )
     {
 	std::vector<int>::const_iterator iit = activeUnits.begin();
 	for ( ; iit!=activeUnits.end(); iit++ )
@@ -2909,8 +3698,14 @@ void LayeredTexture::getVertexShaderCode( std::string& code, const std::vector<i
 
     code += "void main(void)\n"
 	    "{\n"
-	    "    vec3 normal;\n"
-	    "\n";
+	    "    vec3 normal;\n";
+
+    if ( isSharedBrickGeometryUsed() )
+	code += "    vec4 vertex = brickvertextrans * gl_Vertex;\n";
+    else
+	code += "    vec4 vertex = gl_Vertex;\n";
+
+    code += "\n";
 
     std::vector<int>::const_iterator it = activeUnits.begin();
     for ( ; it!=activeUnits.end(); it++ )
@@ -2918,7 +3713,7 @@ void LayeredTexture::getVertexShaderCode( std::string& code, const std::vector<i
 	snprintf( line, 100, "    gl_TexCoord[%d] = gl_TextureMatrix[%d] * gl_MultiTexCoord%d;\n", *it, *it, *it );
 	code += line;
 
-	if ( _useNormalizedTexCoords )
+	if ( areTexCoordsNormalized() )
 	{
 	    snprintf( line, 100, "    gl_TexCoord[%d] = texcrdbias%d + texcrdfactor%d * gl_TexCoord[%d];\n", *it, *it, *it, *it );
 	    code += line;
@@ -3003,7 +3798,7 @@ void LayeredTexture::getVertexShaderCode( std::string& code, const std::vector<i
 	}
 	code += "pivot;\n";
 
-	code += "    vertexpos = vec4(normal*pivot, 0.0) + gl_Vertex;\n"
+	code += "    vertexpos = vec4(normal*pivot, 0.0) + vertex;\n"
 		"    gl_Position = gl_ModelViewProjectionMatrix * vertexpos;\n"
 		"\n";
 
@@ -3022,8 +3817,12 @@ void LayeredTexture::getVertexShaderCode( std::string& code, const std::vector<i
 
 	code += "    normal = normalize( cross(v0,v1) );\n";
     }
+    else if ( isSharedBrickGeometryUsed() )
+	code += "    vertexpos = vertex;\n"
+		"    gl_Position = gl_ModelViewProjectionMatrix * vertexpos;\n"
+		"    normal = gl_Normal;\n";
     else
-	code += "    vertexpos = gl_Vertex;\n"
+	code += "    vertexpos = vertex;\n"
 		"    gl_Position = ftransform();\n"
 		"    normal = gl_Normal;\n";
 
@@ -3077,11 +3876,12 @@ void LayeredTexture::getFragmentShaderCode( std::string& code, const std::vector
 	&& _stackUndefChannel==getDataLayerUndefChannel(_vertexOffsetLayerId);
 
     const int udfUnit = getDataLayerTextureUnit( _stackUndefLayerId );
+    bool hasPagedUnits = false;
 
     std::vector<int>::const_iterator iit = activeUnits.begin();
     for ( ; iit!=activeUnits.end(); iit++ )
     {
-	if ( _useNormalizedTexCoords )
+	if ( areTexCoordsNormalized() )
 	{
 	    snprintf( line, 100, "uniform vec4 texcrdfactor%d;\n", *iit );
 	    code += line;
@@ -3106,6 +3906,25 @@ void LayeredTexture::getFragmentShaderCode( std::string& code, const std::vector
 	    snprintf( line, 100, "uniform float lod%d;\n", *iit );
 	    code += line;
 	}
+
+	if ( isPagedUnit(*iit) )
+	{
+	    snprintf( line, 100, "uniform vec2 vtpages%d;\n", *iit );
+	    code += line;
+	    hasPagedUnits = true;
+	}
+    }
+
+    if ( hasPagedUnits )
+    {
+	code += "uniform sampler2D vtatlas;\n"
+		"\n";
+
+	for ( iit=activeUnits.begin(); iit!=activeUnits.end(); iit++ )
+	{
+	    if ( isPagedUnit(*iit) )
+		getVirtualSampleCode( code, *iit );
+	}
     }
 
     code += "\n";
@@ -3168,7 +3987,11 @@ void LayeredTexture::getFragmentShaderCode( std::string& code, const std::vector
 	    snprintf( line, 100, "    float udf = texture%dDLod( texture%d, texcrd.%.*s, lod%d )[%d];\n", udfDims, udfUnit, udfDims, "stp", udfUnit, _stackUndefChannel );
 	}
 	else
-	    snprintf( line, 100, "    float udf = texture%dD( texture%d, texcrd.%.*s )[%d];\n", udfDims, udfUnit, udfDims, "stp", _stackUndefChannel );
+	{
+	    code += "    float udf = ";
+	    addTextureLookup( code, udfUnit );
+	    snprintf( line, 100, "[%d];\n", _stackUndefChannel );
+	}
 
 	code += line;
 	if ( _invertUndefLayers )
@@ -3287,6 +4110,62 @@ void LayeredTexture::setMaxTextureCopySize( unsigned int width_x_height )
 }
 
 
+void LayeredTexture::setRescaleFilter( RescaleFilter filter )
+{
+    if ( _rescaleFilter==filter )
+	return;
+
+    _rescaleFilter = filter;
+
+    bool rescaledLayers = false;
+    std::vector<LayeredTextureData*>::iterator it = _dataLayers.begin();
+    for ( ; it!=_dataLayers.end(); it++ )
+    {
+	if ( (*it)->hasRescaledImage() )
+	{
+	    (*it)->_imageModifiedCount = -1;
+	    rescaledLayers = true;
+	}
+    }
+
+    if ( rescaledLayers )
+	triggerRedrawRequest();
+}
+
+
+RescaleFilter LayeredTexture::getRescaleFilter() const
+{
+    return _rescaleFilter;
+}
+
+
+void LayeredTexture::getMemoryUsage( MemoryUsage& usage ) const
+{
+    usage = MemoryUsage();
+
+    const_cast<LayeredTexture*>(this)->_lock.readLock();
+
+    std::vector<LayeredTextureData*>::const_iterator it = _dataLayers.begin();
+    for ( ; it!=_dataLayers.end(); it++ )
+    {
+	const osg::Image* image = (*it)->_image.get();
+	if ( image )
+	{
+	    const unsigned long long bytes = image->getTotalSizeInBytes();
+
+	    if ( !(*it)->hasRescaledImage() && (*it)->_id!=_compositeLayerId )
+		usage._sourceBytes += bytes;
+	    else if ( (*it)->isImageShared() )
+		usage._sharedCopyBytes += bytes;
+	    else
+		usage._copyBytes += bytes;
+	}
+    }
+
+    const_cast<LayeredTexture*>(this)->_lock.readUnlock();
+}
+
+
 void LayeredTexture::invertUndefLayers( bool yn )
 { _invertUndefLayers = yn; }
 
@@ -3347,75 +4226,22 @@ void CompositeTextureThread::doWork()
 	const osg::Vec2f& origin = _lt->_dataLayers[idx]->_origin;
 	const osg::Vec2f& scale = _lt->_dataLayers[idx]->_scale;
 
-	const LayeredTextureData* udfLayer = 0;
-	const int udfIdx = _lt->getDataLayerIndex( _lt->_stackUndefLayerId );
-	if ( udfIdx>=0 )
-	    udfLayer = _lt->_dataLayers[udfIdx];
-
-	const osg::Vec4f& udfColor = _lt->_stackUndefColor;
-	const int udfChannel = _lt->_stackUndefChannel;
-	float udf = 0.0f;
-
-	std::vector<LayerProcess*>::const_reverse_iterator it;
 	unsigned char* imagePtr = _image->data() + _start*4;
 	const int width = _image->s();
 	const pixel_uint nrImagePixels = width * _image->t();
 
 	for ( pixel_uint pixelNr=_start; pixelNr<=_stop; pixelNr++ )
 	{
-	    osg::Vec2f globalCoord( origin.x()+scale.x()*(pixelNr%width+0.5),
-				    origin.y()+scale.y()*(pixelNr/width+0.5) );
-
-	    osg::Vec4f fragColor( -1.0f, -1.0f, -1.0f, -1.0f );
-
-	    if ( udfLayer && !_dummyTexture )
-	    {
-		udf = udfLayer->getTextureVec(globalCoord)[udfChannel];
-		if ( _lt->_invertUndefLayers )
-		    udf = 1.0-udf;
-	    }
+	    osg::Vec4f fragColor( 0.0f, 0.0f, 0.0f, 0.0f );
 
-	    if ( udf<1.0 )
+	    if ( !_dummyTexture )
 	    {
-		for ( it=_processList->rbegin(); it!=_processList->rend(); it++ )
-		{
-		    (*it)->doProcess( fragColor, udf, globalCoord );
-
-		    if ( fragColor[3]>=1.0f )
-			break;
-		}
-
-		if ( _dummyTexture )
-		    fragColor = osg::Vec4f( 0.0f, 0.0f, 0.0f, 0.0f );
-		else if ( fragColor[0]==-1.0f )
-		    fragColor = osg::Vec4f( 1.0f, 1.0f, 1.0f, _minOpacity );
-	    }
+		osg::Vec2f globalCoord( origin.x()+scale.x()*(pixelNr%width+0.5),
+					origin.y()+scale.y()*(pixelNr/width+0.5) );
 
-	    if ( udf>=1.0f )
-		fragColor = udfColor;
-	    else if ( udf>0.0 )
-	    {
-		if ( udfColor[3]<=0.0f )
-		    fragColor[3] *= 1.0f-udf;
-		else if ( udfColor[3]>=1.0f && fragColor[3]>=1.0f )
-		    fragColor = fragColor*(1.0f-udf) + udfColor*udf;
-		else if ( fragColor[3]>0.0f )
-		{
-		    const float a = fragColor[3]*(1.0f-udf);
-		    const float b = udfColor[3]*udf;
-		    fragColor = (fragColor*a + udfColor*b) / (a+b);
-		    fragColor[3] = a+b;
-		}
-		else
-		{
-		    fragColor = udfColor;
-		    fragColor[3] *= udf;
-		}
+		fragColor = _lt->getFragmentColor( globalCoord, *_processList, _minOpacity );
 	    }
 
-	    if ( fragColor[3]<0.5f/255.0f )
-		fragColor = osg::Vec4f( 0.0f, 0.0f, 0.0f, 0.0f );
-
 	    if ( pixelNr<nrImagePixels )
 	    {
 		fragColor *= 255.0f;
@@ -3435,6 +4261,95 @@ void CompositeTextureThread::doWork()
 }
 
 
+void LayeredTexture::getActiveProcesses( std::vector<LayerProcess*>& processList, float& minOpacity ) const
+{
+    processList.clear();
+    minOpacity = 1.0f;
+
+    std::vector<LayerProcess*>::const_iterator it = _processes.begin();
+    for ( ; _isOn && it!=_processes.end(); it++ )
+    {
+	if ( (*it)->getTransparencyType()!=FullyTransparent )
+	    processList.push_back( *it );
+
+	if ( (*it)->getOpacity() < minOpacity )
+	    minOpacity = (*it)->getOpacity();
+    }
+}
+
+
+void LayeredTexture::updateColorScaleSpaces()
+{
+    // Readers of the scale spaces all hold the read lock
+    _lock.writeLock();
+
+    std::vector<LayerProcess*>::iterator it = _processes.begin();
+    for ( ; it!=_processes.end(); it++ )
+	(*it)->updateColorScaleSpace();
+
+    _lock.writeUnlock();
+}
+
+
+osg::Vec4f LayeredTexture::getFragmentColor( const osg::Vec2f& globalCoord, const std::vector<LayerProcess*>& processList, float minOpacity, const TexelFootprint* footprint ) const
+{
+    float udf = 0.0f;
+    const int udfIdx = getDataLayerIndex( _stackUndefLayerId );
+    if ( udfIdx>=0 )
+    {
+	udf = getDataLayerTextureVec( _stackUndefLayerId, globalCoord, footprint )[_stackUndefChannel];
+	if ( _invertUndefLayers )
+	    udf = 1.0-udf;
+    }
+
+    osg::Vec4f fragColor( -1.0f, -1.0f, -1.0f, -1.0f );
+
+    if ( udf<1.0 )
+    {
+	std::vector<LayerProcess*>::const_reverse_iterator it;
+	for ( it=processList.rbegin(); it!=processList.rend(); it++ )
+	{
+	    (*it)->doProcess( fragColor, udf, globalCoord, footprint );
+
+	    if ( fragColor[3]>=1.0f )
+		break;
+	}
+
+	if ( fragColor[0]==-1.0f )
+	    fragColor = osg::Vec4f( 1.0f, 1.0f, 1.0f, minOpacity );
+    }
+
+    const osg::Vec4f& udfColor = _stackUndefColor;
+
+    if ( udf>=1.0f )
+	fragColor = udfColor;
+    else if ( udf>0.0 )
+    {
+	if ( udfColor[3]<=0.0f )
+	    fragColor[3] *= 1.0f-udf;
+	else if ( udfColor[3]>=1.0f && fragColor[3]>=1.0f )
+	    fragColor = fragColor*(1.0f-udf) + udfColor*udf;
+	else if ( fragColor[3]>0.0f )
+	{
+	    const float a = fragColor[3]*(1.0f-udf);
+	    const float b = udfColor[3]*udf;
+	    fragColor = (fragColor*a + udfColor*b) / (a+b);
+	    fragColor[3] = a+b;
+	}
+	else
+	{
+	    fragColor = udfColor;
+	    fragColor[3] *= udf;
+	}
+    }
+
+    if ( fragColor[3]<0.5f/255.0f )
+	fragColor = osg::Vec4f( 0.0f, 0.0f, 0.0f, 0.0f );
+
+    return fragColor;
+}
+
+
 void LayeredTexture::createCompositeTexture( bool dummyTexture, bool triggerProgress )
 {
     if ( !_compositeLayerUpdate )
@@ -3465,24 +4380,15 @@ void LayeredTexture::createCompositeTexture( bool dummyTexture, bool triggerProg
 
     osg::Image* image = const_cast<osg::Image*>(_dataLayers[idx]->_image.get());
 
-    if ( !image || width!=image->s() || height!=image->t() )
+    if ( !image || width!=image->s() || height!=image->t() || _dataLayers[idx]->isImageShared() )
     {
 	image = new osg::Image;
 	image->allocateImage( width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE );
     }
 
     std::vector<LayerProcess*> processList;
-    float minOpacity = 1.0f;
-
-    std::vector<LayerProcess*>::const_iterator it = _processes.begin();
-    for ( ; _isOn && it!=_processes.end(); it++ )
-    {
-	if ( (*it)->getTransparencyType()!=FullyTransparent )
-	    processList.push_back( *it );
-
-	if ( (*it)->getOpacity() < minOpacity )
-	    minOpacity = (*it)->getOpacity();
-    }
+    float minOpacity;
+    getActiveProcesses( processList, minOpacity );
 
     pixel_uint nrPixels = height*width;
 
@@ -3556,6 +4462,161 @@ const osg::Image* LayeredTexture::getCompositeTextureImage()
 }
 
 
+bool LayeredTexture::getCompositeBorders( const osg::Vec2f& origin, const osg::Vec2f& opposite, Vec2i& border0, Vec2i& border1 )
+{
+    border0 = Vec2i( 0, 0 );
+    border1 = Vec2i( 0, 0 );
+
+    const osg::Image* compositeImage = getCompositeTextureImage();
+    if ( !compositeImage )
+	return false;
+
+    for ( int dim=0; dim<2; dim++ )
+    {
+	const int size = dim ? compositeImage->t() : compositeImage->s();
+	border0[dim] = (int) ceil( -origin[dim] - 0.5 );
+	border1[dim] = (int) ceil( opposite[dim] - size + 0.5 );
+
+	if ( border0[dim] < 0 ) border0[dim] = 0;
+	if ( border1[dim] < 0 ) border1[dim] = 0;
+    }
+
+    return true;
+}
+
+
+class CompositeBorderThread : public GroupThread<CompositeBorderThread>
+{
+public:
+			CompositeBorderThread(ThreadGroup<CompositeBorderThread>& tg)
+			    : GroupThread<CompositeBorderThread>(tg)
+			{}
+
+    void		set(const osg::Image* image,unsigned char* buffer,
+			    const unsigned char* borderRow,
+			    const Vec2i& border0,int sSize,
+			    int startRow,int stopRow,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _image = image;
+			    _buffer = buffer;
+			    _borderRow = borderRow;
+			    _border0 = border0;
+			    _sSize = sSize;
+			    _start = startRow;
+			    _stop = stopRow;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const osg::Image*		_image;
+    unsigned char*		_buffer;
+    const unsigned char*	_borderRow;	// Border color, sSize wide
+    Vec2i			_border0;
+    int				_sSize;
+    int				_start;
+    int				_stop;
+};
+
+
+void CompositeBorderThread::doWork()
+{
+    const pixel_uint rowBytes = _sSize*4;
+    const pixel_uint leftBytes = _border0[0]*4;
+    const pixel_uint imageBytes = _image->s()*4;
+    const pixel_uint rightBytes = rowBytes - leftBytes - imageBytes;
+
+    for ( int row=_start; row<=_stop; row++ )
+    {
+	unsigned char* dest = _buffer + row*rowBytes;
+	const int t = row - _border0[1];
+
+	if ( t<0 || t>=_image->t() )
+	{
+	    memcpy( dest, _borderRow, rowBytes );
+	    continue;
+	}
+
+	memcpy( dest, _borderRow, leftBytes );
+	memcpy( dest+leftBytes, _image->data(0,t), imageBytes );
+	memcpy( dest+leftBytes+imageBytes, _borderRow, rightBytes );
+    }
+}
+
+
+bool LayeredTexture::writeCompositeTextureImage( unsigned char* buffer, const Vec2i& border0, const Vec2i& border1 )
+{
+    const osg::Image* compositeImage = getCompositeTextureImage();
+    if ( !buffer || !compositeImage )
+	return false;
+
+    if ( compositeImage->getPixelFormat()!=GL_RGBA || compositeImage->getDataType()!=GL_UNSIGNED_BYTE )
+    {
+	std::cerr << "Composite texture image not of type GL_RGBA/GL_UNSIGNED_BYTE" << std::endl;
+	return false;
+    }
+
+    const int sSize = border0[0] + compositeImage->s() + border1[0];
+    const int tSize = border0[1] + compositeImage->t() + border1[1];
+    if ( sSize<=0 || tSize<=0 )
+	return true;
+
+    const osg::Vec4f& borderColor = getDataLayerBorderColor( _compositeLayerId );
+    unsigned char borderPixel[4];
+    for ( int channel=0; channel<=3; channel++ )
+    {
+	int val = (int) floor( 255.0f*borderColor[channel] + 0.5 );
+	val = val<=0 ? 0 : (val>=255 ? 255 : val);
+	borderPixel[channel] = (unsigned char) val;
+    }
+
+    std::vector<unsigned char> borderRow( sSize*4 );
+    for ( int s=0; s<sSize; s++ )
+	memcpy( &borderRow[s*4], borderPixel, 4 );
+
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>tSize )
+	nrTasks = tSize;
+
+    if ( !_compositeBorderThreads )
+	_compositeBorderThreads = ThreadGroup<CompositeBorderThread>::getInst();
+
+    std::vector<osg::ref_ptr<CompositeBorderThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = tSize%nrTasks;
+    int start = 0;
+
+    while ( start<tSize )
+    {
+	int stop = start + tSize/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<CompositeBorderThread> task = _compositeBorderThreads->getThread();
+	task->set( compositeImage, buffer, &borderRow[0], border0, sSize, start, stop, readyCount );
+
+	tasks.push_back( task.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+    return true;
+}
+
+
 void LayeredTexture::setCompositeSubsampleSteps( int steps )
 { 
     if ( steps>0 && steps!=_compositeSubsampleSteps )
@@ -27,6 +27,7 @@ namespace vsgGeo
 Palette::Palette(const ColorPointList &cp)
 {
     _colorPoints = cp;
+    bakeLUT();
 }
 
 osg::Vec3 makeColor(int r, int g, int b)
@@ -45,6 +46,14 @@ Palette::Palette()
     _colorPoints.push_back(ColorPoint( (float) 0.5, makeColor(243, 243, 243)));
     _colorPoints.push_back(ColorPoint( (float) 0.883249, makeColor(56, 70, 127)));
     _colorPoints.push_back(ColorPoint( (float) 1.0, makeColor(0, 0, 0)));
+    bakeLUT();
+}
+
+// Color points outside [0,1] must not wrap around in the byte conversion
+static inline unsigned char toByte(float channel)
+{
+    const float val = channel * 255.0f + 0.5f;
+    return val <= 0.0f ? 0 : (val >= 255.0f ? 255 : (unsigned char) val);
 }
 
 static inline bool fuzzyCompare(float p1, float p2)
@@ -62,44 +71,119 @@ static inline bool fuzzyCompare(float p1, float p2)
 */
 osg::Vec3 Palette::get(float value, float min, float max) const
 {
-    if(value < min)
-        return _colorPoints[0].color;
-    else if(value > max)
-        return _colorPoints[_colorPoints.size() - 1].color;
-    else
+    int lutIdx;
+    getLUTIndices(&value, 1, min, max, &lutIdx);
+    return _lut[lutIdx];
+}
+
+/*!
+  Maps values to the nearest LUT entries. The loops have no branches
+  nor dependencies between iterations, so that they vectorize. Values
+  below min and NaNs give the first entry, values above max the last.
+*/
+void Palette::getLUTIndices(const float *values, int nrValues, float min, float max, int *lutIndices) const
+{
+    if(fuzzyCompare(max, min))
     {
-        const ColorPoint *cPoints = &_colorPoints[0];
+        for(int ii = 0; ii < nrValues; ++ii)
+            lutIndices[ii] = values[ii] > min ? LUTSize - 1 : 0;
+        return;
+    }
+
+    const float scale = (LUTSize - 1) / (max - min);
+    const float offset = 0.5f - min * scale;
+    for(int ii = 0; ii < nrValues; ++ii)
+    {
+        float pos = values[ii] * scale + offset;
+        pos = pos > 0.0f ? pos : 0.0f;
+        pos = pos < LUTSize - 0.5f ? pos : LUTSize - 0.5f;
+        lutIndices[ii] = (int) pos;
+    }
+}
+
+#define PALETTE_BATCH_SIZE 256
+
+void Palette::get(const float *values, int nrValues, float min, float max, osg::Vec3 *colors) const
+{
+    int lutIndices[PALETTE_BATCH_SIZE];
+    for(int start = 0; start < nrValues; start += PALETTE_BATCH_SIZE)
+    {
+        const int nr = std::min(nrValues - start, PALETTE_BATCH_SIZE);
+        getLUTIndices(values + start, nr, min, max, lutIndices);
+        for(int ii = 0; ii < nr; ++ii)
+            colors[start + ii] = _lut[lutIndices[ii]];
+    }
+}
 
-        float relativeValue;
-        if(fuzzyCompare(max, min))
+void Palette::get(const float *values, int nrValues, float min, float max, osg::Vec4ub *colors) const
+{
+    int lutIndices[PALETTE_BATCH_SIZE];
+    for(int start = 0; start < nrValues; start += PALETTE_BATCH_SIZE)
+    {
+        const int nr = std::min(nrValues - start, PALETTE_BATCH_SIZE);
+        getLUTIndices(values + start, nr, min, max, lutIndices);
+        for(int ii = 0; ii < nr; ++ii)
         {
-            relativeValue = (value - min) > 0 ? 1.0 : 0.0;
+            const osg::Vec3 &color = _lut[lutIndices[ii]];
+            colors[start + ii].set(toByte(color.x()), toByte(color.y()),
+                                   toByte(color.z()), 255);
         }
+    }
+}
+
+/*!
+  Interpolates the color points at every LUT position. Positions below
+  the second color point extrapolate the first segment, like the former
+  per-value search did.
+*/
+void Palette::bakeLUT()
+{
+    _lut.assign(LUTSize, osg::Vec3(0.0f, 0.0f, 0.0f));
+    if(_colorPoints.empty())
+        return;
+
+    const int nrPoints = _colorPoints.size();
+    int segment = 0;
+    for(int idx = 0; idx < LUTSize; ++idx)
+    {
+        const float relativeValue = float(idx) / (LUTSize - 1);
+        while(segment < nrPoints - 1 && relativeValue >= _colorPoints[segment + 1].pos)
+            segment++;
+
+        if(segment == nrPoints - 1)
+            _lut[idx] = _colorPoints[nrPoints - 1].color;
         else
         {
-            relativeValue = (value - min) / (max - min);
+            const ColorPoint &cp1 = _colorPoints[segment];
+            const ColorPoint &cp2 = _colorPoints[segment + 1];
+            const float factor = (relativeValue - cp1.pos) / (cp2.pos - cp1.pos);
+            _lut[idx] = cp1.color + (cp2.color - cp1.color) * factor;
         }
-        for( unsigned int ii = 0; ii < _colorPoints.size() - 1; ++ii)
-        {
-            const ColorPoint &cp1 = cPoints[ii];
-            const ColorPoint &cp2 = cPoints[ii + 1];
+    }
+}
 
-            if(relativeValue < cp2.pos)
-            {
-                osg::Vec3 color1 = cp1.color;
-                osg::Vec3 color2 = cp2.color;
+osg::Image *Palette::createLUTImage() const
+{
+    osg::Image *image = new osg::Image;
+    image->allocateImage(LUTSize, 1, 1, GL_RGB, GL_UNSIGNED_BYTE);
+    image->setInternalTextureFormat(GL_RGB8);
 
-                const float factor = (relativeValue - cp1.pos) / (cp2.pos - cp1.pos);
-                return color1 + (color2 - color1) * factor;
-            }
-        }
+    unsigned char *ptr = image->data();
+    for(int idx = 0; idx < LUTSize; ++idx)
+    {
+        const osg::Vec3 &color = _lut[idx];
+        *ptr++ = toByte(color.x());
+        *ptr++ = toByte(color.y());
+        *ptr++ = toByte(color.z());
     }
-    return _colorPoints[_colorPoints.size() - 1].color;
+
+    return image;
 }
 
 void Palette::setColorPoints(const ColorPointList &cps)
 {
     _colorPoints = cps;
+    bakeLUT();
 }
 
 }
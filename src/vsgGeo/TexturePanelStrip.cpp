@@ -20,10 +20,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 
 #include <vsgGeo/TexturePanelStrip.h>
+#include <vsgGeo/BrickCullTree.h>
 #include <vsgGeo/LayeredTexture.h>
 #include <vsgGeo/ComputeBoundsVisitor.h>
 #include <vsgGeo/Vec2i.h>
 
+#include <OpenThreads/Atomic>
+
+#include <algorithm>
 #include <iostream>
 
 namespace vsgGeo
@@ -111,6 +115,67 @@ protected:
 //============================================================================
 
 
+#define MAX_BACK_BUFFER_WAIT_FRAMES	60
+
+class TexturePanelStripNode::DisplayBuffer : public osg::Referenced
+{
+/* DisplayBuffer holds everything the cull traversal draws, such that a
+   complete update can be swapped with what is on display at once. */
+
+public:
+    DisplayBuffer()
+	: _compositeCutoutTexUnit( -1 )
+	, _cullTree( new BrickCullTree )
+	, _pagesChecked( 0 )
+	, _pagesResident( 1 )
+	, _nrWaitFrames( 0 )
+    {}
+
+    void clear()
+    {
+	for ( unsigned int idx=0; idx<_geometries.size(); idx++ )
+	    _geometries[idx]->unref();
+	for ( unsigned int idx=0; idx<_statesets.size(); idx++ )
+	    _statesets[idx]->unref();
+
+	_geometries.clear();
+	_statesets.clear();
+	_compositeCutoutOrigins.clear();
+	_compositeCutoutSizes.clear();
+	_brickOrigins.clear();
+	_brickOpposites.clear();
+	_cullTree->clear();
+	_lodTolerances.clear();
+	_lodGeometries.clear();
+	_setupStateSet = 0;
+    }
+
+    std::vector<osg::Geometry*>		_geometries;
+    std::vector<Vec2i>			_compositeCutoutOrigins;
+    std::vector<Vec2i>			_compositeCutoutSizes;
+    int					_compositeCutoutTexUnit;
+    std::vector<osg::StateSet*>		_statesets;
+    std::vector<osg::Vec2f>		_brickOrigins;
+    std::vector<osg::Vec2f>		_brickOpposites;
+    osg::ref_ptr<BrickCullTree>		_cullTree;
+    std::vector<float>			_lodTolerances;
+    std::vector<std::vector<osg::ref_ptr<osg::Geometry> > > _lodGeometries;
+    osg::ref_ptr<osg::StateSet>		_setupStateSet;
+
+    // Page residency of visible panels while pending as back buffer,
+    // set by (parallel) cull traversals under the read lock only
+    OpenThreads::Atomic			_pagesChecked;
+    OpenThreads::Atomic			_pagesResident;
+    int					_nrWaitFrames;
+
+protected:
+    ~DisplayBuffer()			{ clear(); }
+};
+
+
+//============================================================================
+
+
 TexturePanelStripNode::TexturePanelStripNode()
     : _texture( 0 )
     , _textureBrickSize( 64 )
@@ -129,9 +194,15 @@ TexturePanelStripNode::TexturePanelStripNode()
     , _smoothNormals( false )
     , _compositeCutoutTexUnit( -1 )
     , _borderEnvelopeOffset( 0.0f, 0.0f )
+    , _borderEnvelopeGrowth( 0.0f, 0.0f )
     , _panelWidths( new osg::FloatArray )
     , _panelNormals( new osg::Vec3Array )
     , _knotNormals( new osg::Vec3Array )
+    , _pathLength( 0.0f )
+    , _lastValidPanelIdx( -1 )
+    , _pathLODTolerance( 0.0f )
+    , _useDoubleBuffering( false )
+    , _isBackBufferPending( false )
     , _needsUpdate( false )
     , _frozen( false )
     , _isRedrawing( false )
@@ -146,6 +217,7 @@ TexturePanelStripNode::TexturePanelStripNode()
 
     _boundingGeometry = new BoundingGeometry( *this );
     _boundingGeometry->update();
+    _cullTree = new BrickCullTree;
 
      _textureCallbackHandler = new TextureCallbackHandler( *this );
 }
@@ -170,9 +242,15 @@ TexturePanelStripNode::TexturePanelStripNode( const TexturePanelStripNode& node,
     , _swapTextureAxes( node._swapTextureAxes )
     , _compositeCutoutTexUnit( node._compositeCutoutTexUnit )
     , _borderEnvelopeOffset( node._borderEnvelopeOffset )
+    , _borderEnvelopeGrowth( node._borderEnvelopeGrowth )
     , _panelWidths( new osg::FloatArray )
     , _panelNormals( new osg::Vec3Array )
     , _knotNormals( new osg::Vec3Array )
+    , _pathLength( 0.0f )
+    , _lastValidPanelIdx( -1 )
+    , _pathLODTolerance( node._pathLODTolerance )
+    , _useDoubleBuffering( node._useDoubleBuffering )
+    , _isBackBufferPending( false )
     , _needsUpdate( false )
     , _frozen( false )
     , _isRedrawing( false )
@@ -191,6 +269,7 @@ TexturePanelStripNode::TexturePanelStripNode( const TexturePanelStripNode& node,
 
     _boundingGeometry = new BoundingGeometry( *this );
     _boundingGeometry->update();
+    _cullTree = new BrickCullTree;
     
     setPath( *node._pathCoords );
     setPath2TextureMapping( *node._pathTexOffsets );
@@ -219,6 +298,12 @@ void TexturePanelStripNode::cleanUp()
 	(*it)->unref();
 
     _statesets.clear();
+    _brickOrigins.clear();
+    _brickOpposites.clear();
+    _cullTree->clear();
+    _lodGeometries.clear();
+    _lodTolerances.clear();
+    _setupStateSet = 0;
 
     _compositeCutoutOrigins.clear();
     _compositeCutoutSizes.clear();
@@ -254,9 +339,23 @@ void TexturePanelStripNode::setTextureBrickSize( int sz, bool strict )
 
 void TexturePanelStripNode::setPath( const osg::Vec2Array& coords )
 {
+    // Interactive drawing mostly appends knots to the previous path
+    unsigned int nrOldKnots = _pathCoords->size();
+    if ( nrOldKnots>=coords.size() )
+	nrOldKnots = 0;
+
+    for ( unsigned int idx=0; idx<nrOldKnots; idx++ )
+    {
+	if ( (*_pathCoords)[idx]!=coords[idx] )
+	    nrOldKnots = 0;
+    }
+
+    _redrawLock.writeLock();
     *_pathCoords = coords;
+    computeNormals( nrOldKnots );
+    _redrawLock.writeUnlock();
+
     _boundingGeometry->update();
-    computeNormals();
     setUpdateVar( _needsUpdate, true );
 }
 
@@ -358,25 +457,23 @@ void TexturePanelStripNode::smoothNormals( bool yn )
 }
 
 
-int TexturePanelStripNode::getValidNormalIdx( int idx, bool forward ) const
+void TexturePanelStripNode::setPathLODTolerance( float texels )
 {
-    if ( idx<0 || idx>=(int)_panelWidths->size() )
-	return -1;
+    if ( texels<0.0f )
+	texels = 0.0f;
 
-    if ( (*_panelWidths)[idx]<=0.0f )	// Normal undefined
-	return getValidNormalIdx( (forward ? idx+1 : idx-1), forward );
-
-    return idx;
+    if ( _pathLODTolerance != texels )
+    {
+	_pathLODTolerance = texels;
+	setUpdateVar( _needsUpdate, true );
+    }
 }
 
 
 #define WEIGHTED_AVERAGE true
 
-osg::Vec3 TexturePanelStripNode::getAverageNormal( int idx ) const
+osg::Vec3 TexturePanelStripNode::getAverageNormal( int idx0, int idx1 ) const
 {
-    const int idx0 = getValidNormalIdx( idx-1, false );
-    const int idx1 = getValidNormalIdx( idx, true );
-
     if ( idx0>=0 && idx1>=0 )
     {
 	const float w0 = WEIGHTED_AVERAGE ? (*_panelWidths)[idx0] : 1.0f;
@@ -400,26 +497,89 @@ osg::Vec3 TexturePanelStripNode::getAverageNormal( int idx ) const
 }
 
 
-void TexturePanelStripNode::computeNormals()
+void TexturePanelStripNode::computeNormals( int nrOldKnots )
 {
-    _panelWidths->clear();
-    _panelNormals->clear();
-    _knotNormals->clear();
+    const int nrKnots = _pathCoords->size();
+    const int nrPanels = nrKnots>1 ? nrKnots-1 : 0;
+
+    if ( nrOldKnots<1 || nrOldKnots>nrKnots )
+    {
+	nrOldKnots = 0;
+	_pathLength = 0.0f;
+	_lastValidPanelIdx = -1;
+    }
+
+    /* Only the normals of knots after the last valid (non-zero width)
+       panel of the old path depend on the appended knots */
+    const int firstPanel = nrOldKnots ? nrOldKnots-1 : 0;
+    const int firstKnot = _lastValidPanelIdx+1;
 
-    for ( unsigned int idx=1; idx<_pathCoords->size(); idx++ )
+    _panelWidths->resize( nrPanels );
+    _panelNormals->resize( nrPanels );
+    _knotNormals->resize( nrKnots );
+    _knotArcLengths.resize( nrKnots );
+    _panelDirX.resize( nrPanels );
+    _panelDirY.resize( nrPanels );
+
+    if ( !nrKnots )
+	return;
+
+    if ( !nrOldKnots )
+	_knotArcLengths[0] = 0.0f;
+
+    // Branch-free passes over plain arrays, so these loops vectorize
+    const osg::Vec2* crds = &_pathCoords->front();
+    float* dirX = _panelDirX.data();
+    float* dirY = _panelDirY.data();
+    float* widths = nrPanels ? &_panelWidths->front() : 0;
+
+    for ( int idx=firstPanel; idx<nrPanels; idx++ )
+    {
+	dirX[idx] = crds[idx+1].x() - crds[idx].x();
+	dirY[idx] = crds[idx+1].y() - crds[idx].y();
+    }
+
+    for ( int idx=firstPanel; idx<nrPanels; idx++ )
+	widths[idx] = sqrt( dirX[idx]*dirX[idx] + dirY[idx]*dirY[idx] );
+
+    for ( int idx=firstPanel; idx<nrPanels; idx++ )
+    {
+	const float scale = widths[idx]>0.0f ? 1.0f/widths[idx] : 0.0f;
+	dirX[idx] *= scale;
+	dirY[idx] *= scale;
+    }
+
+    for ( int idx=firstPanel; idx<nrPanels; idx++ )
+    {
+	(*_panelNormals)[idx].set( -dirY[idx], dirX[idx], 0.0f );
+	_pathLength += widths[idx];
+	_knotArcLengths[idx+1] = _pathLength;
+    }
+
+    // Next valid panel at or after every knot, by one backward sweep
+    std::vector<int> nextValidIdxs( nrKnots-firstKnot );
+    int nextValidIdx = -1;
+    for ( int idx=nrKnots-1; idx>=firstKnot; idx-- )
+    {
+	if ( idx<nrPanels && widths[idx]>0.0f )
+	    nextValidIdx = idx;
+
+	nextValidIdxs[idx-firstKnot] = nextValidIdx;
+    }
+
+    int prevValidIdx = _lastValidPanelIdx;
+    for ( int idx=firstKnot; idx<nrKnots; idx++ )
     {
-	osg::Vec2 dif = (*_pathCoords)[idx] - (*_pathCoords)[idx-1];
-	_panelWidths->push_back( dif.length() );
-	dif.normalize();
-	_panelNormals->push_back( osg::Vec3(-dif[1], dif[0], 0.0f) );
+	(*_knotNormals)[idx] = getAverageNormal( prevValidIdx, nextValidIdxs[idx-firstKnot] );
+	if ( idx<nrPanels && widths[idx]>0.0f )
+	    prevValidIdx = idx;
     }
 
-    for ( unsigned int idx=0; idx<_pathCoords->size(); idx++ )
-	_knotNormals->push_back( getAverageNormal(idx) );
+    _lastValidPanelIdx = prevValidIdx;
 
-    for ( unsigned int idx=0; idx<_panelNormals->size(); idx++ )
+    for ( int idx=firstKnot; idx<nrPanels; idx++ )
     {
-	if ( (*_panelWidths)[idx]<=0.0f )
+	if ( widths[idx]<=0.0f )
 	    (*_panelNormals)[idx] = (*_knotNormals)[idx];
     }
 }
@@ -454,11 +614,17 @@ void TexturePanelStripNode::traverse( osg::NodeVisitor& nv )
     {
 	forceRedraw( false );
 
+	if ( !_frozen && _texture )
+	    _texture->updateVirtualPages();
+
 	if ( _texture && _texture->needsRetiling() )
 	    setUpdateVar( _needsUpdate, true );
 
 	if ( !_frozen && _needsUpdate && updateGeometry() )
 	    setUpdateVar( _needsUpdate, false );
+
+	if ( !_frozen )
+	    swapBackBufferIfReady();
     }
     else if ( nv.getVisitorType()==osg::NodeVisitor::CULL_VISITOR )
     {
@@ -467,24 +633,73 @@ void TexturePanelStripNode::traverse( osg::NodeVisitor& nv )
 	if ( getStateSet() )
 	    cv->pushStateSet( getStateSet() );
 
-	if ( _texture && _texture->getSetupStateSet() )
-	    cv->pushStateSet( _texture->getSetupStateSet() );
+	osg::ref_ptr<osg::StateSet> setupStateSet = _texture ? _texture->getSetupStateSet() : 0;
 
-	for ( unsigned int idx=0; idx<_geometries.size(); idx++ )
+	const bool pageFeedback = _texture && _texture->isVirtualTexturingEnabled();
+	bool pagesResident = true;
+
+	// Vertex offsets may move panels out of their flat bounds
+	const bool cullBricks = !_texture || !_texture->isVertexOffsetUsed();
+
+	_redrawLock.readLock();
+
+	// Front buffer built before a pending retiling keeps its own setup
+	if ( _setupStateSet )
+	    setupStateSet = _setupStateSet;
+	if ( setupStateSet )
+	    cv->pushStateSet( setupStateSet.get() );
+
+	// Off-screen panels are rejected hierarchically along the path
+	std::vector<int> visibleBricks;
+	_cullTree->getVisibleBricks( *cv, visibleBricks, cullBricks );
+
+	for ( unsigned int vidx=0; vidx<visibleBricks.size(); vidx++ )
 	{
+	    const int idx = visibleBricks[vidx];
 	    cv->pushStateSet( _statesets[idx] );
-#if OSG_MIN_VERSION_REQUIRED(3,3,2)
-	    const osg::BoundingBox bb = _geometries[idx]->getBoundingBox();
-#else
-	    const osg::BoundingBox bb = _geometries[idx]->getBound();
-#endif
+
+	    const osg::BoundingBox& bb = _cullTree->getBrickBound( idx );
+	    if ( pageFeedback &&
+		 !_texture->requestVirtualPages(_brickOrigins[idx],_brickOpposites[idx]) )
+		pagesResident = false;
+
+	    // Coarsest level whose path error stays within one pixel
+	    osg::Geometry* geometry = _geometries[idx];
+	    for ( unsigned int lvl=0; idx<(int) _lodGeometries.size() && lvl<_lodGeometries[idx].size(); lvl++ )
+	    {
+		if ( cv->pixelSize(bb.center(),_lodTolerances[lvl]) > 1.0f )
+		    break;
+
+		geometry = _lodGeometries[idx][lvl].get();
+	    }
+
 	    const float depth = cv->getDistanceFromEyePoint(bb.center(),false);
-	    cv->addDrawableAndDepth( _geometries[idx], cv->getModelViewMatrix(), depth );
+	    cv->addDrawableAndDepth( geometry, cv->getModelViewMatrix(), depth );
 
 	    cv->popStateSet();
 	}
 
-	if ( _texture && _texture->getSetupStateSet() )
+	// Page in what a pending back buffer will show, before swapping
+	if ( pageFeedback && _isBackBufferPending )
+	{
+	    DisplayBuffer& back = *_backBuffer;
+	    back._cullTree->getVisibleBricks( *cv, visibleBricks, cullBricks );
+	    for ( unsigned int vidx=0; vidx<visibleBricks.size(); vidx++ )
+	    {
+		const int idx = visibleBricks[vidx];
+		if ( !_texture->requestVirtualPages(back._brickOrigins[idx],back._brickOpposites[idx]) )
+		    back._pagesResident.exchange( 0 );
+	    }
+
+	    back._pagesChecked.exchange( 1 );
+	}
+
+	_redrawLock.readUnlock();
+
+	if ( !pagesResident )	// Load missing pages at next update
+	    forceRedraw( true );
+
+	if ( setupStateSet )
 	    cv->popStateSet();
 
 	if ( getStateSet() )
@@ -571,26 +786,50 @@ float TexturePanelStripNode::calcPathTexOffset( int idx ) const
 }
 
 
-bool TexturePanelStripNode::getLocalGeomAtTexOffset( osg::Vec2& pathCoord, osg::Vec3& normal, float texOffset, int guessPanelIdx ) const
+void TexturePanelStripNode::updateTilingPathOffsets()
 {
-    int nrKnots = _pathTexOffsets->size();
+    _tilingPathOffsets.clear();
+    for ( unsigned int idx=0; idx<_pathTexOffsets->size(); idx++ )
+	_tilingPathOffsets.push_back( calcPathTexOffset(idx) );
+}
+
+
+int TexturePanelStripNode::findPanelIdx( float texOffset, int guessPanelIdx ) const
+{
+    int nrKnots = _tilingPathOffsets.size();
     if ( nrKnots>(int)_pathCoords->size() )
 	nrKnots = _pathCoords->size();
 
     if ( nrKnots<2 )
-	return false;
+	return -1;
+
+    const std::vector<float>& offsets = _tilingPathOffsets;
+
+    // Guess suffices if it brackets the offset, as for consecutive queries
+    if ( guessPanelIdx>=0 && guessPanelIdx<nrKnots-1 &&
+	 (guessPanelIdx==0 || texOffset>=offsets[guessPanelIdx]) &&
+	 (guessPanelIdx==nrKnots-2 || texOffset<offsets[guessPanelIdx+1]) )
+	return guessPanelIdx;
 
-    int knot = nrKnots/2;
-    if ( guessPanelIdx>=0 && guessPanelIdx<nrKnots-1 )
-	knot = guessPanelIdx;
+    // Last knot with offset not beyond texOffset, clamped to a panel
+    int knot = std::upper_bound( offsets.begin(), offsets.begin()+nrKnots, texOffset ) - offsets.begin() - 1;
+    if ( knot<0 )
+	knot = 0;
+    if ( knot>nrKnots-2 )
+	knot = nrKnots-2;
+
+    return knot;
+}
 
-    while ( knot>0 && texOffset<calcPathTexOffset(knot) )
-	knot--;
-    while ( knot<nrKnots-2 && texOffset>=calcPathTexOffset(knot+1) )
-	knot++;
 
-    const float num = texOffset - calcPathTexOffset(knot);
-    const float denom = calcPathTexOffset(knot+1) - calcPathTexOffset(knot);
+bool TexturePanelStripNode::getLocalGeomAtTexOffset( osg::Vec2& pathCoord, osg::Vec3& normal, float texOffset, int guessPanelIdx ) const
+{
+    const int knot = findPanelIdx( texOffset, guessPanelIdx );
+    if ( knot<0 )
+	return false;
+
+    const float num = texOffset - _tilingPathOffsets[knot];
+    const float denom = _tilingPathOffsets[knot+1] - _tilingPathOffsets[knot];
     const float frac = denom==0.0f ? 0.0f : num/denom;
 
     pathCoord = (*_pathCoords)[knot]*(1.0f-frac) + (*_pathCoords)[knot+1]*frac;
@@ -603,6 +842,56 @@ bool TexturePanelStripNode::getLocalGeomAtTexOffset( osg::Vec2& pathCoord, osg::
 }
 
 
+bool TexturePanelStripNode::getLocalGeomsAtTexOffsets( const osg::FloatArray& texOffsets, osg::Vec2Array& pathCoords, osg::Vec3Array& normals, osg::FloatArray* arcLengths ) const
+{
+    pathCoords.clear();
+    normals.clear();
+    if ( arcLengths )
+	arcLengths->clear();
+
+    if ( !_texture )
+	return false;
+
+    // Path and tiling offsets are updated under the write lock
+    const_cast<TexturePanelStripNode*>(this)->_redrawLock.readLock();
+
+    // Same transformation as calcPathTexOffset(.), except for knot shift
+    const osg::Vec2f origin = _texture->envelopeCenter() -
+			      _texture->textureEnvelopeSize() * 0.5f;
+    const osg::Vec2 resolution = _texture->tilingPlanResolution();
+    const int dim = _swapTextureAxes ? 1 : 0;
+
+    bool res = _tilingPathOffsets.size()>=2;
+    int knot = -1;
+    for ( unsigned int idx=0; res && idx<texOffsets.size(); idx++ )
+    {
+	const float tilingOffset = (texOffsets[idx]-origin[dim]) * resolution[dim];
+
+	knot = findPanelIdx( tilingOffset, knot );
+	res = knot>=0;
+	if ( !res )
+	    break;
+
+	osg::Vec2 coord;
+	osg::Vec3 normal;
+	getLocalGeomAtTexOffset( coord, normal, tilingOffset, knot );
+	pathCoords.push_back( coord );
+	normals.push_back( normal );
+
+	if ( arcLengths )
+	{
+	    const float num = tilingOffset - _tilingPathOffsets[knot];
+	    const float denom = _tilingPathOffsets[knot+1] - _tilingPathOffsets[knot];
+	    const float frac = denom==0.0f ? 0.0f : num/denom;
+	    arcLengths->push_back( _knotArcLengths[knot]*(1.0f-frac) + _knotArcLengths[knot+1]*frac );
+	}
+    }
+
+    const_cast<TexturePanelStripNode*>(this)->_redrawLock.readUnlock();
+    return res;
+}
+
+
 #define EPS	1e-5
 
 
@@ -651,31 +940,181 @@ float TexturePanelStripNode::getTexelSizeRatio() const
     if ( zTextureSize==0.0f || zLength==0.0f || pathTextureSize==0.0f )
 	return 0.0f;
 
-    float pathLength = 0.0f;
-    for ( unsigned int idx=1; idx<_pathCoords->size(); idx++ )
-	pathLength += ((*_pathCoords)[idx]-(*_pathCoords)[idx-1]).length();
-
-    if ( pathLength==0.0 )
+    // Path length is updated by computeNormals()
+    if ( _pathLength==0.0 )
 	return 0.0f;
 
-    const float ratio = zTextureSize*pathLength / (pathTextureSize*zLength);
+    const float ratio = zTextureSize*_pathLength / (pathTextureSize*zLength);
     return _swapTextureAxes ? 1.0f/ratio : ratio;
 }
 
 
+#define NR_PATH_LOD_LEVELS	6
+
+void TexturePanelStripNode::simplifyPath( const osg::Vec2Array& path, float tolerance, std::vector<int>& retained )
+{
+    retained.clear();
+    const int last = path.size()-1;
+    if ( last<1 )
+	return;
+
+    std::vector<bool> keep( path.size(), false );
+    keep[0] = true;
+    keep[last] = true;
+
+    std::vector<std::pair<int,int> > ranges;
+    ranges.push_back( std::pair<int,int>(0,last) );
+
+    while ( !ranges.empty() )
+    {
+	const int first = ranges.back().first;
+	const int stop = ranges.back().second;
+	ranges.pop_back();
+
+	osg::Vec2 dir = path[stop] - path[first];
+	const float len = dir.normalize();
+
+	float maxDist = tolerance;
+	int maxIdx = -1;
+
+	for ( int idx=first+1; idx<stop; idx++ )
+	{
+	    // Distance to segment rather than line, as paths may fold back
+	    const osg::Vec2 dif = path[idx] - path[first];
+	    float proj = dif * dir;
+	    proj = proj<0.0f ? 0.0f : (proj>len ? len : proj);
+
+	    const float dist = (dif - dir*proj).length();
+	    if ( dist>maxDist )
+	    {
+		maxDist = dist;
+		maxIdx = idx;
+	    }
+	}
+
+	if ( maxIdx>=0 )
+	{
+	    keep[maxIdx] = true;
+	    ranges.push_back( std::pair<int,int>(first,maxIdx) );
+	    ranges.push_back( std::pair<int,int>(maxIdx,stop) );
+	}
+    }
+
+    for ( int idx=0; idx<=last; idx++ )
+    {
+	if ( keep[idx] )
+	    retained.push_back( idx );
+    }
+}
+
+
+static osg::Geometry* createPanelGeometry( const osg::Vec2Array& tilePath, const osg::FloatArray& tileOffsets, const osg::Vec3Array& tileNormals, float z0, float z1, const std::vector<LayeredTexture::TextureCoordData>& tcData, bool smoothNormals, bool swapTextureAxes, float sense, osg::Vec4Array& colors )
+{
+    const int last = tileOffsets.size()-1;
+    const float firstOffset = tileOffsets[0];
+    const float lastOffset = tileOffsets[last];
+
+    osg::ref_ptr<osg::Vec3Array> coords = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+
+    for ( int idx=0; idx<=last; idx++ )
+    {
+	for ( int cnt = (smoothNormals || idx ? 0 : 2);
+	      cnt < (smoothNormals || idx==last ? 2 : 4);
+	      cnt++ )
+	{
+	    const float z = cnt==1 || cnt==2 ? z1 : z0;
+	    coords->push_back( osg::Vec3(tilePath[idx], z) );
+
+	    const osg::Vec3 normal = tileNormals[smoothNormals || cnt>1 ? idx : idx-1];
+	    normals->push_back( normal*sense );
+	}
+    }
+
+    std::vector<LayeredTexture::TextureCoordData>::const_iterator it = tcData.begin();
+    for ( ; it!=tcData.end(); it++ )
+    {
+	osg::ref_ptr<osg::Vec2Array> texCoords = new osg::Vec2Array;
+
+	for ( int idx=0; idx<=last; idx++ )
+	{
+	    const float num = tileOffsets[idx] - firstOffset; 
+	    const float denom = lastOffset - firstOffset;
+	    const float frac = denom==0.0f ? 0.0f : num/denom;
+
+	    osg::Vec2 tc0 = it->_tc00 * (1.0f-frac);
+	    tc0 += (swapTextureAxes ? it->_tc10 : it->_tc01) * frac;
+	    osg::Vec2 tc1 = it->_tc11 * frac;
+	    tc1 += (swapTextureAxes ? it->_tc01 : it->_tc10) * (1.0f-frac);
+
+	    for ( int cnt = (smoothNormals || idx ? 0 : 2);
+		  cnt < (smoothNormals || idx==last ? 2 : 4);
+		  cnt++ )
+	    {
+		texCoords->push_back( cnt==0 || cnt==3 ? tc0 : tc1 );
+	    }
+	}
+	geometry->setTexCoordArray( it->_textureUnit, texCoords.get() );
+    }
+
+    geometry->setVertexArray( coords.get() );
+    geometry->setNormalArray( normals.get() );
+    geometry->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
+    geometry->setColorArray( &colors );
+    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+
+    GLenum primitive = smoothNormals ? GL_TRIANGLE_STRIP : GL_QUADS;
+    geometry->addPrimitiveSet( new osg::DrawArrays(primitive,0,coords->size()) );
+
+    // Precalculate bounding sphere for (multi-threaded) cull traversal
+    geometry->getBound();
+
+    return geometry.release();
+}
+
+
 bool TexturePanelStripNode::updateGeometry()
 {
-    cleanUp();
+    if ( _backBuffer )
+	_backBuffer->clear();
+
+    _isBackBufferPending = false;
 
     int nrKnots = _pathTexOffsets->size();
     if ( nrKnots>(int)_pathCoords->size() )
 	nrKnots = _pathCoords->size();
 
     if ( !_texture || nrKnots<2 )
+    {
+	cleanUp();
 	return false;
+    }
+
+    // Without page feedback, a back buffer would be swapped in at once
+    const bool useBackBuffer = _useDoubleBuffering && _texture->isVirtualTexturingEnabled();
+    if ( useBackBuffer )
+    {
+	// Park front buffer, so that the members serve as back buffer
+	if ( !_backBuffer )
+	    _backBuffer = new DisplayBuffer;
+
+	swapDisplayBuffer( *_backBuffer );
+
+	// Retiling rebuilds the setup in place, not for the parked buffer
+	osg::StateSet* setupStateSet = _texture->getSetupStateSet();
+	if ( !_backBuffer->_setupStateSet && setupStateSet )
+	    _backBuffer->_setupStateSet = new osg::StateSet( *setupStateSet, osg::CopyOp::SHALLOW_COPY );
+    }
+
+    cleanUp();
 
     _texture->reInitTiling( getTexelSizeRatio() );
 
+    _redrawLock.writeLock();
+    updateTilingPathOffsets();
+    _redrawLock.writeUnlock();
+
     std::vector<float> xTicks, yTicks, zCoords, zOffsets;
     _texture->planTiling(_textureBrickSize, xTicks, yTicks, _isBrickSizeStrict);
     finalizeZTiling( (_swapTextureAxes ? xTicks : yTicks), zCoords, zOffsets );
@@ -686,6 +1125,17 @@ bool TexturePanelStripNode::updateGeometry()
 
     const std::vector<float>& sOrigins = _swapTextureAxes ? yTicks : xTicks;
 
+    const float pathTextureSize = fabs( _tilingPathOffsets[nrKnots-1]-_tilingPathOffsets[0] );
+    if ( _pathLODTolerance>0.0f && pathTextureSize>0.0f )
+    {
+	float tolerance = _pathLODTolerance * _pathLength/pathTextureSize;
+	for ( int lvl=0; lvl<NR_PATH_LOD_LEVELS; lvl++ )
+	{
+	    _lodTolerances.push_back( tolerance );
+	    tolerance *= 4.0f;
+	}
+    }
+
     osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
     colors->push_back( osg::Vec4(1.0f,1.0f,1.0f,1.0f) );
 
@@ -699,7 +1149,7 @@ bool TexturePanelStripNode::updateGeometry()
 
     for ( int sIdx=1; sIdx<=sLast; sIdx++ )
     {
-	if ( sIdx!=sLast && calcPathTexOffset(0)>sOrigins[sIdx]-EPS )
+	if ( sIdx!=sLast && _tilingPathOffsets[0]>sOrigins[sIdx]-EPS )
 	    continue;
 
 	while ( tileOffsets->size()>1 )
@@ -711,9 +1161,9 @@ bool TexturePanelStripNode::updateGeometry()
 
 	while ( knot<nrKnots )
 	{
-	    if ( sIdx==sLast || calcPathTexOffset(knot)<sOrigins[sIdx]+EPS )
+	    if ( sIdx==sLast || _tilingPathOffsets[knot]<sOrigins[sIdx]+EPS )
 	    {
-		tileOffsets->push_back( calcPathTexOffset(knot) );
+		tileOffsets->push_back( _tilingPathOffsets[knot] );
 		tilePath->push_back( (*_pathCoords)[knot] );
 		if ( _smoothNormals )
 		    tileNormals->push_back( (*_knotNormals)[knot] );
@@ -745,29 +1195,55 @@ bool TexturePanelStripNode::updateGeometry()
 	if ( last<1 )
 	    continue;
 
-	const float firstOffset = (*tileOffsets)[0];
-	const float lastOffset = (*tileOffsets)[last];
+	// Coarser levels only keep knots needed within their error bound
+	std::vector<osg::ref_ptr<osg::Vec2Array> > lodPaths;
+	std::vector<osg::ref_ptr<osg::FloatArray> > lodOffsets;
+	std::vector<osg::ref_ptr<osg::Vec3Array> > lodNormals;
+	int prevNrKnots = tilePath->size();
 
-	for ( unsigned int zIdx=1; zIdx<zCoords.size(); zIdx++ )
+	for ( unsigned int lvl=0; lvl<_lodTolerances.size(); lvl++ )
 	{
-	    osg::ref_ptr<osg::Vec3Array> coords = new osg::Vec3Array;
-	    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
-	    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	    std::vector<int> retained;
+	    simplifyPath( *tilePath, _lodTolerances[lvl], retained );
 
-	    for ( int idx=0; idx<=last; idx++ )
+	    if ( (int) retained.size()==prevNrKnots )
 	    {
-		for ( int cnt = (_smoothNormals || idx ? 0 : 2);
-		      cnt < (_smoothNormals || idx==last ? 2 : 4);
-		      cnt++ )
+		// Same as previous level
+		lodPaths.push_back( lvl ? lodPaths.back() : tilePath );
+		lodOffsets.push_back( lvl ? lodOffsets.back() : tileOffsets );
+		lodNormals.push_back( lvl ? lodNormals.back() : tileNormals );
+		continue;
+	    }
+
+	    prevNrKnots = retained.size();
+	    lodPaths.push_back( new osg::Vec2Array );
+	    lodOffsets.push_back( new osg::FloatArray );
+	    lodNormals.push_back( new osg::Vec3Array );
+
+	    for ( unsigned int idx=0; idx<retained.size(); idx++ )
+	    {
+		lodPaths.back()->push_back( (*tilePath)[retained[idx]] );
+		lodOffsets.back()->push_back( (*tileOffsets)[retained[idx]] );
+
+		if ( _smoothNormals )
+		    lodNormals.back()->push_back( (*tileNormals)[retained[idx]] );
+		else if ( idx+1<retained.size() )
 		{
-		    const float z = zCoords[cnt==1 || cnt==2 ? zIdx : zIdx-1];
-		    coords->push_back( osg::Vec3((*tilePath)[idx], z) );
+		    const osg::Vec2 dif = (*tilePath)[retained[idx+1]] - (*tilePath)[retained[idx]];
+		    osg::Vec3 normal( -dif[1], dif[0], 0.0f );
+		    if ( !normal.normalize() )
+			normal = (*tileNormals)[retained[idx]];
 
-		    const osg::Vec3 normal = (*tileNormals)[_smoothNormals || cnt>1 ? idx : idx-1];
-		    normals->push_back( normal*sense );
+		    lodNormals.back()->push_back( normal );
 		}
 	    }
+	}
 
+	const float firstOffset = (*tileOffsets)[0];
+	const float lastOffset = (*tileOffsets)[last];
+
+	for ( unsigned int zIdx=1; zIdx<zCoords.size(); zIdx++ )
+	{
 	    std::vector<LayeredTexture::TextureCoordData> tcData;
 	    osg::Vec2f origin, opposite;
 	    if ( _swapTextureAxes )
@@ -783,43 +1259,11 @@ bool TexturePanelStripNode::updateGeometry()
 
 	    osg::ref_ptr<osg::StateSet> stateset = _texture->createCutoutStateSet( origin, opposite, tcData );
 
-	    std::vector<LayeredTexture::TextureCoordData>::const_iterator it = tcData.begin();
-	    for ( ; it!=tcData.end(); it++ )
-	    {
-		osg::ref_ptr<osg::Vec2Array> texCoords = new osg::Vec2Array;
-
-		for ( int idx=0; idx<=last; idx++ )
-		{
-		    const float num = (*tileOffsets)[idx] - firstOffset; 
-		    const float denom = lastOffset - firstOffset;
-		    const float frac = denom==0.0f ? 0.0f : num/denom;
-
-		    osg::Vec2 tc0 = it->_tc00 * (1.0f-frac);
-		    tc0 += (_swapTextureAxes ? it->_tc10 : it->_tc01) * frac;
-		    osg::Vec2 tc1 = it->_tc11 * frac;
-		    tc1 += (_swapTextureAxes ? it->_tc01 : it->_tc10) * (1.0f-frac);
-
-		    for ( int cnt = (_smoothNormals || idx ? 0 : 2);
-			  cnt < (_smoothNormals || idx==last ? 2 : 4);
-			  cnt++ )
-		    {
-			texCoords->push_back( cnt==0 || cnt==3 ? tc0 : tc1 );
-		    }
-		}
-		geometry->setTexCoordArray( it->_textureUnit, texCoords.get() );
-	    }
-
-	    geometry->setVertexArray( coords.get() );
-	    geometry->setNormalArray( normals.get() );
-	    geometry->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
-	    geometry->setColorArray( colors.get() );
-	    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+	    // Panels keep their own vertices if the texture shares brick geometry
+	    if ( _texture->isSharedBrickGeometryUsed() )
+		stateset->addUniform( new osg::Uniform("brickvertextrans",osg::Matrixf()) );
 
-	    GLenum primitive = _smoothNormals ? GL_TRIANGLE_STRIP : GL_QUADS;
-	    geometry->addPrimitiveSet( new osg::DrawArrays(primitive,0,coords->size()) );
-
-	    // Precalculate bounding sphere for (multi-threaded) cull traversal
-	    geometry->getBound();
+	    osg::ref_ptr<osg::Geometry> geometry = createPanelGeometry( *tilePath, *tileOffsets, *tileNormals, zCoords[zIdx-1], zCoords[zIdx], tcData, _smoothNormals, _swapTextureAxes, sense, *colors );
 
 	    if ( !_altTileMode || (_altTileMode+sIdx+zIdx)%2 )
 	    {
@@ -827,6 +1271,25 @@ bool TexturePanelStripNode::updateGeometry()
 		_geometries.push_back( geometry );
 		stateset->ref();
 		_statesets.push_back( stateset );
+		_brickOrigins.push_back( origin );
+		_brickOpposites.push_back( opposite );
+#if OSG_MIN_VERSION_REQUIRED(3,3,2)
+		_cullTree->addBrick( geometry->getBoundingBox(), Vec2i(sIdx,zIdx-1) );
+#else
+		_cullTree->addBrick( geometry->getBound(), Vec2i(sIdx,zIdx-1) );
+#endif
+
+		_lodGeometries.push_back( std::vector<osg::ref_ptr<osg::Geometry> >() );
+		for ( unsigned int lvl=0; lvl<lodPaths.size(); lvl++ )
+		{
+		    osg::ref_ptr<osg::Geometry> lodGeometry = geometry;
+		    if ( lvl && lodPaths[lvl]==lodPaths[lvl-1] )
+			lodGeometry = _lodGeometries.back().back();
+		    else if ( lodPaths[lvl]!=tilePath )
+			lodGeometry = createPanelGeometry( *lodPaths[lvl], *lodOffsets[lvl], *lodNormals[lvl], zCoords[zIdx-1], zCoords[zIdx], tcData, _smoothNormals, _swapTextureAxes, sense, *colors );
+
+		    _lodGeometries.back().push_back( lodGeometry );
+		}
 
 		_compositeCutoutTexUnit = tcData.size() ? tcData.begin()->_textureUnit : -1;
 		_compositeCutoutOrigins.push_back( tcData.size() ? tcData.begin()->_cutoutOrigin : Vec2i(0,0) );
@@ -834,11 +1297,88 @@ bool TexturePanelStripNode::updateGeometry()
 	    }
 	}
     }
-   
+
+    _cullTree->build();
+
+    if ( useBackBuffer )
+    {
+	// Front buffer back on display, until new one is ready
+	swapDisplayBuffer( *_backBuffer );
+	_backBuffer->_pagesChecked.exchange( 0 );
+	_backBuffer->_pagesResident.exchange( 1 );
+	_backBuffer->_nrWaitFrames = 0;
+	_isBackBufferPending = true;
+    }
+
     return true;
 }
 
 
+void TexturePanelStripNode::swapDisplayBuffer( DisplayBuffer& buffer )
+{
+    _redrawLock.writeLock();
+
+    _geometries.swap( buffer._geometries );
+    _compositeCutoutOrigins.swap( buffer._compositeCutoutOrigins );
+    _compositeCutoutSizes.swap( buffer._compositeCutoutSizes );
+    std::swap( _compositeCutoutTexUnit, buffer._compositeCutoutTexUnit );
+    _statesets.swap( buffer._statesets );
+    _brickOrigins.swap( buffer._brickOrigins );
+    _brickOpposites.swap( buffer._brickOpposites );
+    _cullTree.swap( buffer._cullTree );
+    _lodTolerances.swap( buffer._lodTolerances );
+    _lodGeometries.swap( buffer._lodGeometries );
+    _setupStateSet.swap( buffer._setupStateSet );
+
+    _redrawLock.writeUnlock();
+}
+
+
+void TexturePanelStripNode::swapBackBufferIfReady()
+{
+    if ( !_isBackBufferPending )
+	return;
+
+    DisplayBuffer& back = *_backBuffer;
+    const bool pageFeedback = _texture && _texture->isVirtualTexturingEnabled();
+
+    // Not culled since previous update implies not visible
+    bool ready = !pageFeedback || back._nrWaitFrames>=MAX_BACK_BUFFER_WAIT_FRAMES;
+    if ( !ready )
+	ready = back._pagesChecked ? back._pagesResident!=0 : back._nrWaitFrames>0;
+
+    if ( !ready )
+    {
+	back._nrWaitFrames++;
+	back._pagesChecked.exchange( 0 );
+	back._pagesResident.exchange( 1 );
+	forceRedraw( true );
+	return;
+    }
+
+    swapDisplayBuffer( back );
+    back.clear();
+    _isBackBufferPending = false;
+}
+
+
+void TexturePanelStripNode::useDoubleBuffering( bool yn )
+{
+    if ( _useDoubleBuffering == yn )
+	return;
+
+    _useDoubleBuffering = yn;
+
+    if ( !yn && _isBackBufferPending )
+    {
+	swapDisplayBuffer( *_backBuffer );
+	_backBuffer->clear();
+	_isBackBufferPending = false;
+	forceRedraw( true );
+    }
+}
+
+
 osg::BoundingSphere TexturePanelStripNode::computeBound() const
 { return _boundingGeometry->getBound(); }
 
@@ -855,24 +1395,21 @@ void TexturePanelStripNode::freezeDisplay( bool yn )
 }
 
 
-const osg::Image* TexturePanelStripNode::getCompositeTextureImage( bool addBorder )
+const osg::Image* TexturePanelStripNode::getCompositeBorders( Vec2i& border0, Vec2i& border1, bool addBorder )
 {
     _borderEnvelopeOffset = osg::Vec2f( 0.0f, 0.0f );
+    _borderEnvelopeGrowth = osg::Vec2f( 0.0f, 0.0f );
+    border0 = Vec2i( 0, 0 );
+    border1 = Vec2i( 0, 0 );
 
     if ( !_texture || !_texture->isEnvelopeDefined() )
-    {
-	_compositeImageWithBorder = 0;
 	return 0;
-    }
 
     const int nrOffsets = _pathTexOffsets->size();
     const osg::Image* compositeImage = _texture->getCompositeTextureImage();
 
     if ( !nrOffsets || !compositeImage || !addBorder )
-    {
-	_compositeImageWithBorder = 0;
 	return compositeImage;
-    }
 
     const float sOffset0 = _swapTextureAxes ? calcZTexOffset(0)
 					    : calcPathTexOffset(0);
@@ -883,17 +1420,22 @@ const osg::Image* TexturePanelStripNode::getCompositeTextureImage( bool addBorde
     const float tOffset1 = _swapTextureAxes ? calcPathTexOffset(nrOffsets-1)
 					    : calcZTexOffset(1);
 
-    int sBorder0 = (int) ceil( -sOffset0 - 0.5 );
-    int tBorder0 = (int) ceil( -tOffset0 - 0.5 );
-    int sBorder1 = (int) ceil(  sOffset1 - compositeImage->s() + 0.5 );
-    int tBorder1 = (int) ceil(  tOffset1 - compositeImage->t() + 0.5 );
+    _texture->getCompositeBorders( osg::Vec2f(sOffset0,tOffset0),
+				   osg::Vec2f(sOffset1,tOffset1),
+				   border0, border1 );
+
+    _borderEnvelopeOffset = osg::Vec2f( border0[0], border0[1] );
+    _borderEnvelopeGrowth = osg::Vec2f( border0[0]+border1[0], border0[1]+border1[1] );
+    return compositeImage;
+}
+
 
-    if ( sBorder0 < 0 ) sBorder0 = 0;
-    if ( tBorder0 < 0 ) tBorder0 = 0;
-    if ( sBorder1 < 0 ) sBorder1 = 0;
-    if ( tBorder1 < 0 ) tBorder1 = 0;
+const osg::Image* TexturePanelStripNode::getCompositeTextureImage( bool addBorder )
+{
+    Vec2i border0, border1;
+    const osg::Image* compositeImage = getCompositeBorders( border0, border1, addBorder );
 
-    if ( !sBorder0 && !tBorder0 && !sBorder1 && !tBorder1 )
+    if ( !compositeImage || (border0==Vec2i(0,0) && border1==Vec2i(0,0)) )
     {
 	_compositeImageWithBorder = 0;
 	return compositeImage;
@@ -902,43 +1444,42 @@ const osg::Image* TexturePanelStripNode::getCompositeTextureImage( bool addBorde
     if ( !_compositeImageWithBorder )
 	_compositeImageWithBorder = new osg::Image;
 
-    const int sSize = sBorder0 + compositeImage->s() + sBorder1;
-    const int tSize = tBorder0 + compositeImage->t() + tBorder1;
+    const int sSize = border0[0] + compositeImage->s() + border1[0];
+    const int tSize = border0[1] + compositeImage->t() + border1[1];
 
     if ( _compositeImageWithBorder->s()!=sSize || _compositeImageWithBorder->t()!=tSize )
     {
 	_compositeImageWithBorder->allocateImage( sSize, tSize, 1, GL_RGBA, GL_UNSIGNED_BYTE );
     }
 
-    const int id = _texture->compositeLayerId();
-    const osg::Vec4f& borderColor = _texture->getDataLayerBorderColor( id );
+    _texture->writeCompositeTextureImage( _compositeImageWithBorder->data(), border0, border1 );
+    _compositeImageWithBorder->dirty();
 
-#if OSG_MIN_VERSION_REQUIRED(3,3,0)
-    for ( int s=0; s<sSize; s++ )
-    {
-	for ( int t=0; t<tSize; t++ )
-	    _compositeImageWithBorder->setColor( borderColor, s, t, 0 );
-    }
-#else
-    // Assuming contiguous data of type GL_RGBA
-    unsigned char* imagePtr = _compositeImageWithBorder->data();
-    for ( int count=0; count<sSize*tSize; count++ )
-    {
-	for ( int channel=0; channel<=3; channel++ )
-	{
-	    int val = (int) floor( 255.0f*borderColor[channel] + 0.5 );
-	    val = val<=0 ? 0 : (val>=255 ? 255 : val);
-	    *imagePtr = (unsigned char) val;
-	    imagePtr++;
-	}
-    }
-#endif
+    return _compositeImageWithBorder;
+}
 
-    _compositeImageWithBorder->copySubImage( sBorder0, tBorder0, 0, compositeImage );
 
-    _borderEnvelopeOffset = osg::Vec2f( sBorder0, tBorder0 );
+bool TexturePanelStripNode::getCompositeTextureImageSize( int& sSize, int& tSize, bool addBorder )
+{
+    Vec2i border0, border1;
+    const osg::Image* compositeImage = getCompositeBorders( border0, border1, addBorder );
+    if ( !compositeImage )
+	return false;
 
-    return _compositeImageWithBorder;
+    sSize = border0[0] + compositeImage->s() + border1[0];
+    tSize = border0[1] + compositeImage->t() + border1[1];
+    return true;
+}
+
+
+bool TexturePanelStripNode::writeCompositeTextureImage( unsigned char* buffer, bool addBorder )
+{
+    Vec2i border0, border1;
+    if ( !getCompositeBorders(border0,border1,addBorder) )
+	return false;
+
+    _compositeImageWithBorder = 0;
+    return _texture->writeCompositeTextureImage( buffer, border0, border1 );
 }
 
 
@@ -948,12 +1489,12 @@ const osg::Vec2Array* TexturePanelStripNode::getCompositeTextureCoords( int geom
 	return 0;
 
     const osg::Image* compositeImage = _texture->getCompositeTextureImage();
-    if ( _compositeImageWithBorder )
-	compositeImage = _compositeImageWithBorder;
-
     if ( !compositeImage )
 	return 0;
 
+    const osg::Vec2f compositeSize( compositeImage->s() + _borderEnvelopeGrowth[0],
+				    compositeImage->t() + _borderEnvelopeGrowth[1] );
+
     const osg::Geometry* geom = _geometries[geomIdx];
     const osg::Array* arr = geom->getTexCoordArray( _compositeCutoutTexUnit );
     const osg::Vec2Array* texCoords = dynamic_cast<const osg::Vec2Array*>(arr);
@@ -977,8 +1518,8 @@ const osg::Vec2Array* TexturePanelStripNode::getCompositeTextureCoords( int geom
 
 	local += _borderEnvelopeOffset;
 
-	const osg::Vec2 texCoord( local[0] / compositeImage->s(),
-				  local[1] / compositeImage->t() );
+	const osg::Vec2 texCoord( local[0] / compositeSize[0],
+				  local[1] / compositeSize[1] );
 	compositeCoords->push_back( texCoord );
     }
 
@@ -18,9 +18,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 
 #include <vsgGeo/TexturePlane.h>
+#include <vsgGeo/BrickCullTree.h>
 #include <vsgGeo/ComputeBoundsVisitor.h>
+#include <vsgGeo/GridMeshBuilder.h>
 #include <vsgGeo/LayeredTexture.h>
 
+#include <OpenThreads/Atomic>
+
 
 namespace vsgGeo
 {
@@ -111,6 +115,71 @@ protected:
 //============================================================================
 
 
+#define MAX_BACK_BUFFER_WAIT_FRAMES	60
+
+class TexturePlaneNode::DisplayBuffer : public osg::Referenced
+{
+/* DisplayBuffer holds everything the cull traversal draws, such that a
+   complete update can be swapped with what is on display at once. */
+
+public:
+    DisplayBuffer()
+	: _compositeCutoutTexUnit( -1 )
+	, _isBrickGeometryShared( false )
+	, _nrGeometriesPerBrick( 0 )
+	, _cullTree( new BrickCullTree )
+	, _tiledTexelSizeRatio( 0.0f )
+	, _pagesChecked( 0 )
+	, _pagesResident( 1 )
+	, _nrWaitFrames( 0 )
+    {}
+
+    void clear()
+    {
+	for ( unsigned int idx=0; idx<_geometries.size(); idx++ )
+	    _geometries[idx]->unref();
+	for ( unsigned int idx=0; idx<_statesets.size(); idx++ )
+	    _statesets[idx]->unref();
+
+	_geometries.clear();
+	_statesets.clear();
+	_compositeCutoutOrigins.clear();
+	_compositeCutoutSizes.clear();
+	_brickOrigins.clear();
+	_brickOpposites.clear();
+	_cullTree->clear();
+	_isBrickGeometryShared = false;
+	_nrGeometriesPerBrick = 0;
+	_setupStateSet = 0;
+    }
+
+    std::vector<osg::Geometry*>		_geometries;
+    std::vector<Vec2i>			_compositeCutoutOrigins;
+    std::vector<Vec2i>			_compositeCutoutSizes;
+    int					_compositeCutoutTexUnit;
+    std::vector<osg::StateSet*>		_statesets;
+    std::vector<osg::Vec2f>		_brickOrigins;
+    std::vector<osg::Vec2f>		_brickOpposites;
+    bool				_isBrickGeometryShared;
+    int					_nrGeometriesPerBrick;
+    osg::ref_ptr<BrickCullTree>		_cullTree;
+    float				_tiledTexelSizeRatio;
+    osg::ref_ptr<osg::StateSet>		_setupStateSet;
+
+    // Page residency of visible bricks while pending as back buffer,
+    // set by (parallel) cull traversals under the read lock only
+    OpenThreads::Atomic			_pagesChecked;
+    OpenThreads::Atomic			_pagesResident;
+    int					_nrWaitFrames;
+
+protected:
+    ~DisplayBuffer()			{ clear(); }
+};
+
+
+//============================================================================
+
+
 TexturePlaneNode::TexturePlaneNode()
     : _center( 0, 0, 0 )
     , _width( 1, 1, 0 )
@@ -118,15 +187,23 @@ TexturePlaneNode::TexturePlaneNode()
     , _textureBrickSize( 64 )
     , _isBrickSizeStrict( false )
     , _needsUpdate( false )
+    , _needsGeometryUpdate( false )
+    , _tiledTexelSizeRatio( 0.0f )
     , _swapTextureAxes( false )
     , _textureShift( 0.0f, 0.0f )
     , _textureGrowth( 0.0f, 0.0f )
     , _compositeCutoutTexUnit( -1 )
     , _borderEnvelopeOffset( 0.0f, 0.0f )
+    , _borderEnvelopeGrowth( 0.0f, 0.0f )
+    , _isBrickGeometryShared( false )
+    , _nrGeometriesPerBrick( 0 )
+    , _useDoubleBuffering( false )
+    , _isBackBufferPending( false )
     , _frozen( false )
     , _isRedrawing( false )
     , _disperseFactor( 0 )
     , _nrQuadsPerBrickSide( 1 )
+    , _mergeBrickQuads( false )
 {
     setUpdateVar( _needsUpdate, true );
 
@@ -137,6 +214,7 @@ TexturePlaneNode::TexturePlaneNode()
 
     _boundingGeometry = new BoundingGeometry( *this );
     _boundingGeometry->update();
+    _cullTree = new BrickCullTree;
 
     _textureCallbackHandler = new TextureCallbackHandler( *this );  
 }
@@ -149,16 +227,24 @@ TexturePlaneNode::TexturePlaneNode( const TexturePlaneNode& node, const osg::Cop
     , _rotation( node._rotation )
     , _textureBrickSize( node._textureBrickSize )
     , _needsUpdate( false )
+    , _needsGeometryUpdate( false )
+    , _tiledTexelSizeRatio( 0.0f )
     , _isBrickSizeStrict( node._isBrickSizeStrict )
     , _swapTextureAxes( node._swapTextureAxes )
     , _textureShift( node._textureShift )
     , _textureGrowth( node._textureGrowth )
     , _compositeCutoutTexUnit( node._compositeCutoutTexUnit )
     , _borderEnvelopeOffset( node._borderEnvelopeOffset )
+    , _borderEnvelopeGrowth( node._borderEnvelopeGrowth )
+    , _isBrickGeometryShared( false )
+    , _nrGeometriesPerBrick( 0 )
+    , _useDoubleBuffering( node._useDoubleBuffering )
+    , _isBackBufferPending( false )
     , _frozen( false )
     , _isRedrawing( false )
     , _disperseFactor( node._disperseFactor )
     , _nrQuadsPerBrickSide( node._nrQuadsPerBrickSide )
+    , _mergeBrickQuads( node._mergeBrickQuads )
 {
     setUpdateVar( _needsUpdate, true );
     setUpdateVar( _frozen, node._frozen );
@@ -173,6 +259,7 @@ TexturePlaneNode::TexturePlaneNode( const TexturePlaneNode& node, const osg::Cop
 
     _boundingGeometry = new BoundingGeometry( *this );
     _boundingGeometry->update();
+    _cullTree = new BrickCullTree;
 
     _textureCallbackHandler = new TextureCallbackHandler( *this );  
 }
@@ -200,6 +287,12 @@ void TexturePlaneNode::cleanUp()
 	(*it)->unref();
 
     _statesets.clear();
+    _brickOrigins.clear();
+    _brickOpposites.clear();
+    _cullTree->clear();
+    _isBrickGeometryShared = false;
+    _nrGeometriesPerBrick = 0;
+    _setupStateSet = 0;
 
     _compositeCutoutOrigins.clear();
     _compositeCutoutSizes.clear();
@@ -235,8 +328,20 @@ void TexturePlaneNode::traverse( osg::NodeVisitor& nv )
     {
 	forceRedraw( false );
 
+	if ( !_frozen && _texture )
+	    _texture->updateVirtualPages();
+
 	if ( !_frozen && needsUpdate() )
 	    updateGeometry();
+	else if ( !_frozen && _needsGeometryUpdate )
+	{
+	    // Tiling stays valid if texel aspect ratio is unchanged
+	    if ( _isBackBufferPending || getTexelSizeRatio()!=_tiledTexelSizeRatio || !updateVertexCoords() )
+		updateGeometry();
+	}
+
+	if ( !_frozen )
+	    swapBackBufferIfReady();
     }
     else if ( nv.getVisitorType()==osg::NodeVisitor::CULL_VISITOR )
     {
@@ -245,15 +350,45 @@ void TexturePlaneNode::traverse( osg::NodeVisitor& nv )
 	if ( getStateSet() )
 	    cv->pushStateSet( getStateSet() );
 
-	if ( _texture && _texture->getSetupStateSet() )
-	    cv->pushStateSet( _texture->getSetupStateSet() );
+	osg::ref_ptr<osg::StateSet> setupStateSet = _texture ? _texture->getSetupStateSet() : 0;
 
-	int geometryIdx = 0;
-	for ( unsigned int idx=0; idx<_statesets.size(); idx++ )
+	const bool pageFeedback = _texture && _texture->isVirtualTexturingEnabled();
+	bool pagesResident = true;
+
+	// Vertex offsets may move bricks out of their flat bounds
+	const bool cullBricks = !_texture || !_texture->isVertexOffsetUsed();
+
+	_redrawLock.readLock();
+
+	// Front buffer built before a pending retiling keeps its own setup
+	if ( _setupStateSet )
+	    setupStateSet = _setupStateSet;
+	if ( setupStateSet )
+	    cv->pushStateSet( setupStateSet.get() );
+
+	// Off-screen bricks are rejected hierarchically
+	std::vector<int> visibleBricks;
+	_cullTree->getVisibleBricks( *cv, visibleBricks, cullBricks );
+
+	const int nrQuads = _isBrickGeometryShared ? 0 : _nrGeometriesPerBrick;
+
+	for ( unsigned int vidx=0; vidx<visibleBricks.size(); vidx++ )
 	{
+	    const int idx = visibleBricks[vidx];
+	    if ( pageFeedback && !_texture->requestVirtualPages(_brickOrigins[idx],_brickOpposites[idx]) )
+		pagesResident = false;
+
 	    cv->pushStateSet( _statesets[idx] );
 
-	    for ( unsigned int count=_nrQuadsPerBrickSide*_nrQuadsPerBrickSide; count>0; count-- )
+	    if ( _isBrickGeometryShared )
+	    {
+		// Shared geometry has no brick bounds of its own
+		const osg::BoundingBox& bb = _cullTree->getBrickBound( idx );
+		const float depth = cv->getDistanceFromEyePoint(bb.center(),false);
+		cv->addDrawableAndDepth( _geometries[0], cv->getModelViewMatrix(), depth );
+	    }
+
+	    for ( int geometryIdx=idx*nrQuads; geometryIdx<(idx+1)*nrQuads; geometryIdx++ )
 	    {
 #if OSG_MIN_VERSION_REQUIRED(3,3,2)
 		const osg::BoundingBox bb = _geometries[geometryIdx]->getBoundingBox();
@@ -262,13 +397,32 @@ void TexturePlaneNode::traverse( osg::NodeVisitor& nv )
 #endif
 		const float depth = cv->getDistanceFromEyePoint(bb.center(),false);
 		cv->addDrawableAndDepth( _geometries[geometryIdx], cv->getModelViewMatrix(), depth );
-		geometryIdx++;
 	    }
 
 	    cv->popStateSet();
 	}
 
-	if ( _texture && _texture->getSetupStateSet() )
+	// Page in what a pending back buffer will show, before swapping
+	if ( pageFeedback && _isBackBufferPending )
+	{
+	    DisplayBuffer& back = *_backBuffer;
+	    back._cullTree->getVisibleBricks( *cv, visibleBricks, cullBricks );
+	    for ( unsigned int vidx=0; vidx<visibleBricks.size(); vidx++ )
+	    {
+		const int idx = visibleBricks[vidx];
+		if ( !_texture->requestVirtualPages(back._brickOrigins[idx],back._brickOpposites[idx]) )
+		    back._pagesResident.exchange( 0 );
+	    }
+
+	    back._pagesChecked.exchange( 1 );
+	}
+
+	_redrawLock.readUnlock();
+
+	if ( !pagesResident )	// Load missing pages at next update
+	    forceRedraw( true );
+
+	if ( setupStateSet )
 	    cv->popStateSet();
 
 	if ( getStateSet() )
@@ -363,6 +517,228 @@ float TexturePlaneNode::getTexelSizeRatio() const
 }
 
 
+static void setSubQuadCoords( const osg::Vec3Array& corners, int i, int j, int n, osg::Vec3Array& crds )
+{
+#define SET_COORD(idx,i,j,n) \
+    crds[idx] = (corners[0]*(n-i)*(n-j)+corners[1]*i*(n-j)+corners[2]*i*j+corners[3]*(n-i)*j)/(n*n);
+    SET_COORD(0,i,j,n); i++;
+    SET_COORD(1,i,j,n); j++;
+    SET_COORD(2,i,j,n); i--;
+    SET_COORD(3,i,j,n); j--;
+}
+
+
+// Row-major (n+1)x(n+1) vertex grid spanning the brick quad
+static void setGridCoords( const osg::Vec3Array& corners, int n, osg::Vec3Array& crds )
+{
+    crds.resize( (n+1)*(n+1) );
+    for ( int j=0; j<=n; j++ )
+    {
+	for ( int i=0; i<=n; i++ )
+	    SET_COORD(j*(n+1)+i,i,j,n);
+    }
+}
+
+
+static osg::Geometry* createBrickMesh( const osg::Vec3Array& corners, const std::vector<LayeredTexture::TextureCoordData>& tcData, int n, osg::Vec3Array& normals, osg::Vec4Array& colors )
+{
+    osg::ref_ptr<osg::Vec3Array> coords = new osg::Vec3Array;
+    setGridCoords( corners, n, *coords );
+
+    // Vertices are moved in place by updateVertexCoords()
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setDataVariance( osg::Object::DYNAMIC );
+    geometry->setVertexArray( coords.get() );
+
+    for ( std::vector<LayeredTexture::TextureCoordData>::const_iterator it = tcData.begin();
+	  it!=tcData.end();
+	  it++ )
+    {
+	osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array;
+	for ( int j=0; j<=n; j++ )
+	{
+	    for ( int i=0; i<=n; i++ )
+		tCoords->push_back( (it->_tc00*(n-i)*(n-j)+it->_tc01*i*(n-j)+it->_tc11*i*j+it->_tc10*(n-i)*j)/(n*n) );
+	}
+	geometry->setTexCoordArray( it->_textureUnit, tCoords.get() );
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> strips = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    GridMeshBuilder( n+1, n+1 ).addStrips( *strips );
+    GridMeshBuilder::enablePrimitiveRestart( *geometry->getOrCreateStateSet(), strips->getType() );
+
+    geometry->setNormalArray( &normals );
+    geometry->setNormalBinding( osg::Geometry::BIND_OVERALL );
+    geometry->setColorArray( &colors );
+    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+    geometry->addPrimitiveSet( strips.get() );
+    geometry->setUseVertexBufferObjects( true );
+
+    // Precalculate bounding sphere for (multi-threaded) cull traversal
+    geometry->getBound();
+
+    return geometry.release();
+}
+
+
+// Maps unit square of shared brick geometry onto brick quad
+static osg::Matrixf getBrickVertexTransform( const osg::Vec3Array& corners, const osg::Vec3& normal )
+{
+    const osg::Vec3 sSpan = corners[1] - corners[0];
+    const osg::Vec3 tSpan = corners[3] - corners[0];
+
+    return osg::Matrixf( sSpan.x(), sSpan.y(), sSpan.z(), 0.0f,
+			 tSpan.x(), tSpan.y(), tSpan.z(), 0.0f,
+			 normal.x(), normal.y(), normal.z(), 0.0f,
+			 corners[0].x(), corners[0].y(), corners[0].z(), 1.0f );
+}
+
+
+struct TexturePlaneNode::Brick
+{
+    osg::Vec2f					_origin;	// Tiling coords
+    osg::Vec2f					_opposite;
+    Vec2i					_gridPos;
+    osg::ref_ptr<osg::Vec3Array>		_corners;
+    osg::ref_ptr<osg::StateSet>			_stateset;
+    std::vector<LayeredTexture::TextureCoordData> _tcData;
+    std::vector<osg::ref_ptr<osg::Geometry> >	_geometries;
+};
+
+
+class TexturePlaneNode::BrickThread : public GroupThread<BrickThread>
+{
+public:
+			BrickThread(ThreadGroup<BrickThread>& tg)
+			    : GroupThread<BrickThread>(tg)
+			{}
+
+    void		set(const TexturePlaneNode* tpn,
+			    std::vector<Brick>& bricks,
+			    osg::Vec3Array& normals,osg::Vec4Array& colors,
+			    bool shareGeometry,int start,int stop,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _tpn = tpn;
+			    _bricks = &bricks;
+			    _normals = &normals;
+			    _colors = &colors;
+			    _shareGeometry = shareGeometry;
+			    _start = start;
+			    _stop = stop;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const TexturePlaneNode*	_tpn;
+    std::vector<Brick>*		_bricks;
+    osg::Vec3Array*		_normals;
+    osg::Vec4Array*		_colors;
+    bool			_shareGeometry;
+    int				_start;
+    int				_stop;
+};
+
+
+void TexturePlaneNode::BrickThread::doWork()
+{
+    for ( int idx=_start; _tpn && idx<=_stop; idx++ )
+	_tpn->buildBrick( (*_bricks)[idx], *_normals, *_colors, _shareGeometry );
+}
+
+
+void TexturePlaneNode::buildBrick( Brick& brick, osg::Vec3Array& normals, osg::Vec4Array& colors, bool shareGeometry ) const
+{
+    /* Called from multiple threads. LayeredTexture::createCutoutStateSet(.)
+       only registers its tile images under a lock of its own. */
+
+    std::vector<LayeredTexture::TextureCoordData>& tcData = brick._tcData;
+    brick._stateset = _texture->createCutoutStateSet( brick._origin, brick._opposite, tcData );
+
+    const osg::Vec3Array* coords = brick._corners.get();
+
+    if ( shareGeometry )
+    {
+	// Brick is moved in place by updateVertexCoords()
+	const osg::Matrixf brickTrans = getBrickVertexTransform( *coords, normals[0] );
+	osg::ref_ptr<osg::Uniform> uniform = new osg::Uniform( "brickvertextrans", brickTrans );
+	uniform->setDataVariance( osg::Object::DYNAMIC );
+	brick._stateset->addUniform( uniform.get() );
+	brick._stateset->setDataVariance( osg::Object::DYNAMIC );
+	return;
+    }
+
+    if ( _mergeBrickQuads )
+    {
+	brick._geometries.push_back( createBrickMesh(*coords,tcData,_nrQuadsPerBrickSide,normals,colors) );
+	return;
+    }
+
+    for ( int i=0; i<_nrQuadsPerBrickSide; i++ )
+    {
+	for ( int j=0; j<_nrQuadsPerBrickSide; j++ )
+	{
+	    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	    geometry->setDataVariance( osg::Object::DYNAMIC );
+
+	    if ( _nrQuadsPerBrickSide>1 )
+	    {
+		osg::ref_ptr<osg::Vec3Array> crds = new osg::Vec3Array( 4 );
+		setSubQuadCoords( *coords, i, j, _nrQuadsPerBrickSide, *crds );
+		geometry->setVertexArray( crds.get() );
+
+		for ( std::vector<LayeredTexture::TextureCoordData>::iterator it = tcData.begin();
+		      it!=tcData.end();
+		      it++ )
+		{
+		    osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array( 4 );
+
+#define SET_TEX_COORD(idx,i,j,n) \
+    (*tCoords)[idx] = (it->_tc00*(n-i)*(n-j)+it->_tc01*i*(n-j)+it->_tc11*i*j+it->_tc10*(n-i)*j)/(n*n);
+		    SET_TEX_COORD(0,i,j,_nrQuadsPerBrickSide); i++;
+		    SET_TEX_COORD(1,i,j,_nrQuadsPerBrickSide); j++;
+		    SET_TEX_COORD(2,i,j,_nrQuadsPerBrickSide); i--;
+		    SET_TEX_COORD(3,i,j,_nrQuadsPerBrickSide); j--;
+		    geometry->setTexCoordArray( it->_textureUnit, tCoords.get() );
+		}
+	    }
+	    else
+	    {
+		geometry->setVertexArray( brick._corners.get() );
+
+		for ( std::vector<LayeredTexture::TextureCoordData>::iterator it = tcData.begin();
+		      it!=tcData.end();
+		      it++ )
+		{
+		    osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array( 4 );
+		    (*tCoords)[0] = it->_tc00;
+		    (*tCoords)[1] = it->_tc01;
+		    (*tCoords)[2] = it->_tc11;
+		    (*tCoords)[3] = it->_tc10;
+		    geometry->setTexCoordArray( it->_textureUnit, tCoords.get() );
+		}
+	    }
+
+	    geometry->setNormalArray( &normals );
+	    geometry->setNormalBinding( osg::Geometry::BIND_OVERALL );
+	    geometry->setColorArray( &colors );
+	    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+	    geometry->addPrimitiveSet( new osg::DrawArrays(GL_QUADS,0,4) );
+
+	    // Precalculate bounding sphere for (multi-threaded) cull traversal
+	    geometry->getBound();
+
+	    brick._geometries.push_back( geometry );
+	}
+    }
+}
+
+
 bool TexturePlaneNode::updateGeometry()
 {
     if ( !_texture ) 
@@ -371,6 +747,27 @@ bool TexturePlaneNode::updateGeometry()
     osg::Matrix rotMat;
     rotMat.makeRotate( _rotation );
 
+    if ( _backBuffer )
+	_backBuffer->clear();
+
+    _isBackBufferPending = false;
+
+    // Without page feedback, a back buffer would be swapped in at once
+    const bool useBackBuffer = _useDoubleBuffering && _texture->isVirtualTexturingEnabled();
+    if ( useBackBuffer )
+    {
+	// Park front buffer, so that the members serve as back buffer
+	if ( !_backBuffer )
+	    _backBuffer = new DisplayBuffer;
+
+	swapDisplayBuffer( *_backBuffer );
+
+	// Retiling rebuilds the setup in place, not for the parked buffer
+	osg::StateSet* setupStateSet = _texture->getSetupStateSet();
+	if ( !_backBuffer->_setupStateSet && setupStateSet )
+	    _backBuffer->_setupStateSet = new osg::StateSet( *setupStateSet, osg::CopyOp::SHALLOW_COPY );
+    }
+
     cleanUp();
     _texture->reInitTiling( getTexelSizeRatio() );
 
@@ -382,143 +779,393 @@ bool TexturePlaneNode::updateGeometry()
 
     const int nrs = sOrigins.size()-1;
     const int nrt = tOrigins.size()-1;
+    const bool shareGeometry = _texture->isSharedBrickGeometryUsed();
 
     osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
     osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
 
-    const char thinDim = getThinDim();
-    const osg::Vec3 normal = thinDim==2 ? osg::Vec3( 0.0f, 0.0f, getSense() ) :
-			     thinDim==1 ? osg::Vec3( 0.0f,-getSense(), 0.0f ) :
-					  osg::Vec3( getSense(), 0.0f, 0.0f ) ;
-
-    normals->push_back( rotMat.preMult(normal) );
+    normals->push_back( getPlaneNormal(rotMat) );
     colors->push_back( osg::Vec4(1.0f,1.0f,1.0f,1.0f) );
 
+    if ( _disperseFactor < 0 ) _disperseFactor = 0;
+    if ( _disperseFactor > 50 ) _disperseFactor = 50;
+
+    std::vector<Brick> bricks;
+
     for ( int ids=0; ids<nrs; ids++ )
     {
 	for ( int idt=0; idt<nrt; idt++ )
 	{
-	    float ds = sOrigins[ids+1]-sOrigins[ids];
-	    float dt = tOrigins[idt+1]-tOrigins[idt];
+	    const osg::Vec2f envelopeOrigin( sOrigins[0], tOrigins[0] );
+	    const osg::Vec2f envelopeOpposite( sOrigins[nrs], tOrigins[nrt] );
+
+	    bricks.push_back( Brick() );
+	    Brick& brick = bricks.back();
+	    brick._origin = osg::Vec2f( sOrigins[ids], tOrigins[idt] );
+	    brick._opposite = osg::Vec2f( sOrigins[ids+1], tOrigins[idt+1] );
+	    brick._gridPos = Vec2i( ids, idt );
+	    brick._corners = new osg::Vec3Array( 4 );
+	    computeBrickCorners( brick._origin, brick._opposite, envelopeOrigin, envelopeOpposite, rotMat, *brick._corners );
+	}
+    }
+
+    // Cut-out statesets (incl. tile copies) and geometries built in parallel
+    const int nrBricks = bricks.size();
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>nrBricks )
+	nrTasks = nrBricks;
+
+    if ( nrTasks>0 )
+    {
+	if ( !_brickThreads )
+	    _brickThreads = ThreadGroup<BrickThread>::getInst();
+
+	std::vector<osg::ref_ptr<BrickThread> > tasks;
+	OpenThreads::BlockCount readyCount( nrTasks );
+	readyCount.reset();
+
+	int remainder = nrBricks%nrTasks;
+	int start = 0;
+
+	while ( start<nrBricks )
+	{
+	    int stop = start + nrBricks/nrTasks;
+	    if ( remainder )
+		remainder--;
+	    else
+		stop--;
 
-	    if ( _disperseFactor )
-	    {
-		if (_disperseFactor < 0 ) _disperseFactor = 0;
-		if (_disperseFactor > 50 ) _disperseFactor = 50;
-		ds *= 1.0f - _disperseFactor*0.01f;
-		dt *= 1.0f - _disperseFactor*0.01f;
-	    }
+	    osg::ref_ptr<BrickThread> task = _brickThreads->getThread();
+	    task->set( this, bricks, *normals, *colors, shareGeometry, start, stop, readyCount );
+
+	    tasks.push_back( task.get() );
 
-	    osg::ref_ptr<osg::Vec3Array> coords = new osg::Vec3Array( 4 );
+	    start = stop+1;
+	}
+
+	readyCount.block();
+    }
+
+    // Merge in deterministic brick order
+    for ( std::vector<Brick>::iterator bit = bricks.begin(); bit!=bricks.end(); bit++ )
+    {
+	const std::vector<LayeredTexture::TextureCoordData>& tcData = bit->_tcData;
+
+	bit->_stateset->ref();
+	_statesets.push_back( bit->_stateset.get() );
+	_brickOrigins.push_back( bit->_origin );
+	_brickOpposites.push_back( bit->_opposite );
 
-	    (*coords)[0] = osg::Vec3( sOrigins[ids], tOrigins[idt], 0.0f );
-	    (*coords)[1] = osg::Vec3( sOrigins[ids]+ds, tOrigins[idt], 0.0f );
-	    (*coords)[2] = osg::Vec3( sOrigins[ids]+ds, tOrigins[idt]+dt, 0.0f);
-	    (*coords)[3] = osg::Vec3( sOrigins[ids], tOrigins[idt]+dt, 0.0f );
+	osg::BoundingBox bb;
+	for ( int idx=0; idx<4; idx++ )
+	    bb.expandBy( (*bit->_corners)[idx] );
+	_cullTree->addBrick( bb, bit->_gridPos );
 
-	    for ( int idx=0; idx<4; idx++ )
+	if ( shareGeometry )
+	{
+	    if ( _geometries.empty() )
 	    {
-		(*coords)[idx].x() -= sOrigins[0];
-		(*coords)[idx].y() -= tOrigins[0];
-		(*coords)[idx].x() /= sOrigins[nrs] - sOrigins[0];
-		(*coords)[idx].y() /= tOrigins[nrt] - tOrigins[0];
-		(*coords)[idx] -= osg::Vec3( 0.5f, 0.5f, 0.0f );
-
-		if ( _swapTextureAxes )
-		    (*coords)[idx] = osg::Vec3( (*coords)[idx].y(), (*coords)[idx].x(), 0.0f );
-
-		if ( thinDim==0 )
-		    (*coords)[idx] = osg::Vec3( 0.0f, (*coords)[idx].x(), (*coords)[idx].y() );
-		else if ( thinDim==1 )
-		    (*coords)[idx] = osg::Vec3( (*coords)[idx].x(), 0.0f, (*coords)[idx].y() );
-
-		(*coords)[idx].x() *= _width.x();
-		(*coords)[idx].y() *= _width.y();
-		(*coords)[idx].z() *= _width.z();
-		(*coords)[idx] = rotMat.preMult((*coords)[idx]) + _center;
-	    }
+		std::vector<int> texUnits;
+		for ( unsigned int idx=0; idx<tcData.size(); idx++ )
+		    texUnits.push_back( tcData[idx]._textureUnit );
 
-	    std::vector<LayeredTexture::TextureCoordData> tcData;
-	    osg::Vec2f origin( sOrigins[ids], tOrigins[idt] );
-	    osg::Vec2f opposite( sOrigins[ids+1], tOrigins[idt+1] );
-	    osg::ref_ptr<osg::StateSet> stateset = _texture->createCutoutStateSet( origin, opposite, tcData );
-	    stateset->ref();
-	    _statesets.push_back( stateset );
+		osg::Geometry* geometry = createSharedBrickGeometry( texUnits, *normals, *colors );
+		geometry->ref();
+		_geometries.push_back( geometry );
+	    }
+	}
 
-	    for ( int i=0; i<_nrQuadsPerBrickSide; i++ )
+	const int nrGeoms = shareGeometry ? 1 : bit->_geometries.size();
+	for ( int idx=0; idx<nrGeoms; idx++ )
+	{
+	    if ( !shareGeometry )
 	    {
-		for ( int j=0; j<_nrQuadsPerBrickSide; j++ )
-		{
-		    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
-		    geometry->ref();
+		bit->_geometries[idx]->ref();
+		_geometries.push_back( bit->_geometries[idx].get() );
+	    }
 
-		    if ( _nrQuadsPerBrickSide>1 )
-		    {
-			osg::ref_ptr<osg::Vec3Array> crds = new osg::Vec3Array( 4 );
+	    _compositeCutoutTexUnit = tcData.size() ? tcData.begin()->_textureUnit : -1;
+	    _compositeCutoutOrigins.push_back( tcData.size() ? tcData.begin()->_cutoutOrigin : Vec2i(0,0) );
+	    _compositeCutoutSizes.push_back( tcData.size() ? tcData.begin()->_cutoutSize : Vec2i(0,0) );
+	}
+    }
 
-#define SET_COORD(idx,i,j,n) \
-    (*crds)[idx] = ((*coords)[0]*(n-i)*(n-j)+(*coords)[1]*i*(n-j)+(*coords)[2]*i*j+(*coords)[3]*(n-i)*j)/(n*n);
-			SET_COORD(0,i,j,_nrQuadsPerBrickSide); i++;
-			SET_COORD(1,i,j,_nrQuadsPerBrickSide); j++;
-			SET_COORD(2,i,j,_nrQuadsPerBrickSide); i--;
-			SET_COORD(3,i,j,_nrQuadsPerBrickSide); j--;
-			geometry->setVertexArray( crds.get() );
-
-			for ( std::vector<LayeredTexture::TextureCoordData>::iterator it = tcData.begin();
-			      it!=tcData.end();
-			      it++ )
-			{
-			    osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array( 4 );
+    _cullTree->build();
+    _isBrickGeometryShared = shareGeometry && !_geometries.empty();
+    _nrGeometriesPerBrick = nrGeometriesPerBrick();
 
-#define SET_TEX_COORD(idx,i,j,n) \
-    (*tCoords)[idx] = (it->_tc00*(n-i)*(n-j)+it->_tc01*i*(n-j)+it->_tc11*i*j+it->_tc10*(n-i)*j)/(n*n);
-			    SET_TEX_COORD(0,i,j,_nrQuadsPerBrickSide); i++;
-			    SET_TEX_COORD(1,i,j,_nrQuadsPerBrickSide); j++;
-			    SET_TEX_COORD(2,i,j,_nrQuadsPerBrickSide); i--;
-			    SET_TEX_COORD(3,i,j,_nrQuadsPerBrickSide); j--;
-			    geometry->setTexCoordArray( it->_textureUnit, tCoords.get() );
-			}
-		    }
-		    else
-		    {
-			geometry->setVertexArray( coords.get() );
-
-			for ( std::vector<LayeredTexture::TextureCoordData>::iterator it = tcData.begin();
-			      it!=tcData.end();
-			      it++ )
-			{
-			    osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array( 4 );
-			    (*tCoords)[0] = it->_tc00;
-			    (*tCoords)[1] = it->_tc01;
-			    (*tCoords)[2] = it->_tc11;
-			    (*tCoords)[3] = it->_tc10;
-			    geometry->setTexCoordArray( it->_textureUnit, tCoords.get() );
-			}
-		    }
+    _tiledTexelSizeRatio = getTexelSizeRatio();
+    setUpdateVar( _needsGeometryUpdate, false );
+    setUpdateVar( _needsUpdate, false );
 
-		    geometry->setNormalArray( normals.get() );
-		    geometry->setNormalBinding( osg::Geometry::BIND_OVERALL );
-		    geometry->setColorArray( colors.get() );
-		    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
-		    geometry->addPrimitiveSet( new osg::DrawArrays(GL_QUADS,0,4) );
+    if ( useBackBuffer )
+    {
+	// Front buffer back on display, until new one is ready
+	swapDisplayBuffer( *_backBuffer );
+	_backBuffer->_pagesChecked.exchange( 0 );
+	_backBuffer->_pagesResident.exchange( 1 );
+	_backBuffer->_nrWaitFrames = 0;
+	_isBackBufferPending = true;
+    }
 
-		    // Precalculate bounding sphere for (multi-threaded) cull traversal
-		    geometry->getBound();
+    return true;
+}
 
-		    _geometries.push_back( geometry );
-		    _compositeCutoutTexUnit = tcData.size() ? tcData.begin()->_textureUnit : -1;
-		    _compositeCutoutOrigins.push_back( tcData.size() ? tcData.begin()->_cutoutOrigin : Vec2i(0,0) );
-		    _compositeCutoutSizes.push_back( tcData.size() ? tcData.begin()->_cutoutSize : Vec2i(0,0) );
-		}
+
+void TexturePlaneNode::swapDisplayBuffer( DisplayBuffer& buffer )
+{
+    _redrawLock.writeLock();
+
+    _geometries.swap( buffer._geometries );
+    _compositeCutoutOrigins.swap( buffer._compositeCutoutOrigins );
+    _compositeCutoutSizes.swap( buffer._compositeCutoutSizes );
+    std::swap( _compositeCutoutTexUnit, buffer._compositeCutoutTexUnit );
+    _statesets.swap( buffer._statesets );
+    _brickOrigins.swap( buffer._brickOrigins );
+    _brickOpposites.swap( buffer._brickOpposites );
+    std::swap( _isBrickGeometryShared, buffer._isBrickGeometryShared );
+    std::swap( _nrGeometriesPerBrick, buffer._nrGeometriesPerBrick );
+    _cullTree.swap( buffer._cullTree );
+    std::swap( _tiledTexelSizeRatio, buffer._tiledTexelSizeRatio );
+    _setupStateSet.swap( buffer._setupStateSet );
+
+    _redrawLock.writeUnlock();
+}
+
+
+void TexturePlaneNode::swapBackBufferIfReady()
+{
+    if ( !_isBackBufferPending )
+	return;
+
+    DisplayBuffer& back = *_backBuffer;
+    const bool pageFeedback = _texture && _texture->isVirtualTexturingEnabled();
+
+    // Not culled since previous update implies not visible
+    bool ready = !pageFeedback || back._nrWaitFrames>=MAX_BACK_BUFFER_WAIT_FRAMES;
+    if ( !ready )
+	ready = back._pagesChecked ? back._pagesResident!=0 : back._nrWaitFrames>0;
+
+    if ( !ready )
+    {
+	back._nrWaitFrames++;
+	back._pagesChecked.exchange( 0 );
+	back._pagesResident.exchange( 1 );
+	forceRedraw( true );
+	return;
+    }
+
+    swapDisplayBuffer( back );
+    back.clear();
+    _isBackBufferPending = false;
+}
+
+
+osg::Vec3 TexturePlaneNode::getPlaneNormal( const osg::Matrix& rotMat ) const
+{
+    const char thinDim = getThinDim();
+    const osg::Vec3 normal = thinDim==2 ? osg::Vec3( 0.0f, 0.0f, getSense() ) :
+			     thinDim==1 ? osg::Vec3( 0.0f,-getSense(), 0.0f ) :
+					  osg::Vec3( getSense(), 0.0f, 0.0f ) ;
+
+    return rotMat.preMult( normal );
+}
+
+
+void TexturePlaneNode::computeBrickCorners( const osg::Vec2f& origin, const osg::Vec2f& opposite, const osg::Vec2f& envelopeOrigin, const osg::Vec2f& envelopeOpposite, const osg::Matrix& rotMat, osg::Vec3Array& coords ) const
+{
+    float ds = opposite.x()-origin.x();
+    float dt = opposite.y()-origin.y();
+
+    if ( _disperseFactor )
+    {
+	ds *= 1.0f - _disperseFactor*0.01f;
+	dt *= 1.0f - _disperseFactor*0.01f;
+    }
+
+    coords[0] = osg::Vec3( origin.x(), origin.y(), 0.0f );
+    coords[1] = osg::Vec3( origin.x()+ds, origin.y(), 0.0f );
+    coords[2] = osg::Vec3( origin.x()+ds, origin.y()+dt, 0.0f);
+    coords[3] = osg::Vec3( origin.x(), origin.y()+dt, 0.0f );
+
+    const char thinDim = getThinDim();
+
+    for ( int idx=0; idx<4; idx++ )
+    {
+	coords[idx].x() -= envelopeOrigin.x();
+	coords[idx].y() -= envelopeOrigin.y();
+	coords[idx].x() /= envelopeOpposite.x() - envelopeOrigin.x();
+	coords[idx].y() /= envelopeOpposite.y() - envelopeOrigin.y();
+	coords[idx] -= osg::Vec3( 0.5f, 0.5f, 0.0f );
+
+	if ( _swapTextureAxes )
+	    coords[idx] = osg::Vec3( coords[idx].y(), coords[idx].x(), 0.0f );
+
+	if ( thinDim==0 )
+	    coords[idx] = osg::Vec3( 0.0f, coords[idx].x(), coords[idx].y() );
+	else if ( thinDim==1 )
+	    coords[idx] = osg::Vec3( coords[idx].x(), 0.0f, coords[idx].y() );
+
+	coords[idx].x() *= _width.x();
+	coords[idx].y() *= _width.y();
+	coords[idx].z() *= _width.z();
+	coords[idx] = rotMat.preMult(coords[idx]) + _center;
+    }
+}
+
+
+bool TexturePlaneNode::updateVertexCoords()
+{
+    osg::Vec2f envelopeOrigin, envelopeOpposite;
+    if ( !_texture || !getTextureEnvelope(envelopeOrigin,envelopeOpposite) || _geometries.empty() )
+	return false;
+
+    osg::Matrix rotMat;
+    rotMat.makeRotate( _rotation );
+
+    // Normal and color arrays are shared by all geometries of the plane
+    osg::Vec3Array* normals = dynamic_cast<osg::Vec3Array*>( _geometries[0]->getNormalArray() );
+    if ( !normals || normals->empty() )
+	return false;
+
+    (*normals)[0] = getPlaneNormal( rotMat );
+    normals->dirty();
+
+    const bool sharedGeometry = _isBrickGeometryShared;
+    const int nrQuads = _nrGeometriesPerBrick;
+    if ( nrQuads!=nrGeometriesPerBrick() || _cullTree->nrBricks()!=(int) _statesets.size() ||
+	 (!sharedGeometry && _geometries.size()!=_statesets.size()*nrQuads) )
+	return false;
+
+    osg::ref_ptr<osg::Vec3Array> corners = new osg::Vec3Array( 4 );
+    int geometryIdx = 0;
+
+    for ( unsigned int idx=0; idx<_statesets.size(); idx++ )
+    {
+	computeBrickCorners( _brickOrigins[idx], _brickOpposites[idx], envelopeOrigin, envelopeOpposite, rotMat, *corners );
+
+	osg::BoundingBox bb;
+	for ( int cidx=0; cidx<4; cidx++ )
+	    bb.expandBy( (*corners)[cidx] );
+	_cullTree->setBrickBound( idx, bb );
+
+	if ( sharedGeometry )
+	{
+	    osg::Uniform* uniform = _statesets[idx]->getUniform( "brickvertextrans" );
+	    if ( uniform )
+		uniform->set( getBrickVertexTransform(*corners,(*normals)[0]) );
+
+	    continue;
+	}
+
+	if ( _mergeBrickQuads )
+	{
+	    osg::Geometry* geometry = _geometries[geometryIdx++];
+	    osg::Vec3Array* crds = dynamic_cast<osg::Vec3Array*>( geometry->getVertexArray() );
+	    const int n = _nrQuadsPerBrickSide;
+	    if ( !crds || (int) crds->size()!=(n+1)*(n+1) )
+		return false;
+
+	    setGridCoords( *corners, n, *crds );
+	    crds->dirty();
+	    geometry->dirtyBound();
+	    geometry->getBound();
+	    continue;
+	}
+
+	for ( int i=0; i<_nrQuadsPerBrickSide; i++ )
+	{
+	    for ( int j=0; j<_nrQuadsPerBrickSide; j++ )
+	    {
+		osg::Geometry* geometry = _geometries[geometryIdx++];
+		osg::Vec3Array* crds = dynamic_cast<osg::Vec3Array*>( geometry->getVertexArray() );
+		if ( !crds || crds->size()!=4 )
+		    return false;
+
+		if ( _nrQuadsPerBrickSide>1 )
+		    setSubQuadCoords( *corners, i, j, _nrQuadsPerBrickSide, *crds );
+		else
+		    crds->assign( corners->begin(), corners->end() );
+
+		crds->dirty();
+		geometry->dirtyBound();
+
+		// Precalculate bounding sphere for (multi-threaded) cull traversal
+		geometry->getBound();
 	    }
 	}
     }
 
-    setUpdateVar( _needsUpdate, false );
+    _cullTree->refit();
+    setUpdateVar( _needsGeometryUpdate, false );
     return true;
 }
 
 
+bool TexturePlaneNode::getTextureEnvelope( osg::Vec2f& tilingOrigin, osg::Vec2f& tilingOpposite ) const
+{
+    if ( _brickOrigins.empty() )
+	return false;
+
+    // Bricks are created in column-major order from origin to opposite
+    tilingOrigin = _brickOrigins.front();
+    tilingOpposite = _brickOpposites.back();
+    return true;
+}
+
+
+int TexturePlaneNode::nrGeometriesPerBrick() const
+{
+    if ( _isBrickGeometryShared || _mergeBrickQuads )
+	return 1;
+
+    return _nrQuadsPerBrickSide*_nrQuadsPerBrickSide;
+}
+
+
+osg::Geometry* TexturePlaneNode::createSharedBrickGeometry( const std::vector<int>& texUnits, osg::Vec3Array& normals, osg::Vec4Array& colors ) const
+{
+    const int n = _nrQuadsPerBrickSide;
+
+    osg::ref_ptr<osg::Vec2Array> tCoords = new osg::Vec2Array;
+    osg::ref_ptr<osg::Vec3Array> coords = new osg::Vec3Array;
+    for ( int j=0; j<=n; j++ )
+    {
+	for ( int i=0; i<=n; i++ )
+	{
+	    const osg::Vec2 unitCoord( float(i)/n, float(j)/n );
+	    tCoords->push_back( unitCoord );
+	    coords->push_back( osg::Vec3(unitCoord,0.0f) );
+	}
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> strips = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    GridMeshBuilder( n+1, n+1 ).addStrips( *strips );
+
+    // Its shared normal array is updated in place
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setDataVariance( osg::Object::DYNAMIC );
+    geometry->setVertexArray( coords.get() );
+    GridMeshBuilder::enablePrimitiveRestart( *geometry->getOrCreateStateSet(), strips->getType() );
+
+    // Normalized texture coords of all units equal the unit square
+    for ( std::vector<int>::const_iterator it = texUnits.begin(); it!=texUnits.end(); it++ )
+	geometry->setTexCoordArray( *it, tCoords.get() );
+
+    geometry->setNormalArray( &normals );
+    geometry->setNormalBinding( osg::Geometry::BIND_OVERALL );
+    geometry->setColorArray( &colors );
+    geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+    geometry->addPrimitiveSet( strips.get() );
+    geometry->setUseVertexBufferObjects( true );
+
+    return geometry.release();
+}
+
+
 osg::BoundingSphere TexturePlaneNode::computeBound() const
 { return _boundingGeometry->getBound(); }
 
@@ -527,7 +1174,7 @@ void TexturePlaneNode::setCenter( const osg::Vec3& center )
 {
     _center = center;
     _boundingGeometry->update();
-    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsGeometryUpdate, true );
 }
 
 
@@ -539,7 +1186,7 @@ void TexturePlaneNode::setRotation( const osg::Quat& quaternion )
 {
     _rotation = quaternion;
     _boundingGeometry->update(); 
-    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsGeometryUpdate, true );
 }
 
 
@@ -564,7 +1211,7 @@ void TexturePlaneNode::setWidth( const osg::Vec3& width )
 {
     _width = width;
     _boundingGeometry->update();
-    setUpdateVar( _needsUpdate, true );
+    setUpdateVar( _needsGeometryUpdate, true );
 }
 
 
@@ -648,6 +1295,27 @@ bool TexturePlaneNode::isDisplayFrozen() const
 { return _frozen; }
 
 
+void TexturePlaneNode::useDoubleBuffering( bool yn )
+{
+    if ( _useDoubleBuffering == yn )
+	return;
+
+    _useDoubleBuffering = yn;
+
+    if ( !yn && _isBackBufferPending )
+    {
+	swapDisplayBuffer( *_backBuffer );
+	_backBuffer->clear();
+	_isBackBufferPending = false;
+	forceRedraw( true );
+    }
+}
+
+
+bool TexturePlaneNode::isDoubleBufferingUsed() const
+{ return _useDoubleBuffering; }
+
+
 void TexturePlaneNode::setTextureShift( const osg::Vec2& shift )
 {
     _textureShift = shift;
@@ -702,15 +1370,15 @@ osg::Vec3f TexturePlaneNode::getTexelSpanVector( int texdim )
 
 
 
-const osg::Image* TexturePlaneNode::getCompositeTextureImage( bool addBorder )
+const osg::Image* TexturePlaneNode::getCompositeBorders( Vec2i& border0, Vec2i& border1, bool addBorder )
 {
     _borderEnvelopeOffset = osg::Vec2f( 0.0f, 0.0f );
+    _borderEnvelopeGrowth = osg::Vec2f( 0.0f, 0.0f );
+    border0 = Vec2i( 0, 0 );
+    border1 = Vec2i( 0, 0 );
 
     if ( !_texture || !_texture->isEnvelopeDefined() )
-    {
-	_compositeImageWithBorder = 0;
 	return 0;
-    }
 
     std::vector<float> sOrigins, tOrigins;
     _texture->planTiling( _textureBrickSize, sOrigins, tOrigins, _isBrickSizeStrict );
@@ -721,22 +1389,24 @@ const osg::Image* TexturePlaneNode::getCompositeTextureImage( bool addBorder )
     const osg::Image* compositeImage = _texture->getCompositeTextureImage();
 
     if ( !sOrigins.size() || !tOrigins.size() || !compositeImage || !addBorder )
-    {
-	_compositeImageWithBorder = 0;
 	return compositeImage;
-    }
 
-    int sBorder0 = (int) ceil( -sOrigins.front() - 0.5 );
-    int tBorder0 = (int) ceil( -tOrigins.front() - 0.5 );
-    int sBorder1 = (int) ceil(  sOrigins.back() - compositeImage->s() + 0.5 );
-    int tBorder1 = (int) ceil(  tOrigins.back() - compositeImage->t() + 0.5 );
+    _texture->getCompositeBorders( osg::Vec2f(sOrigins.front(),tOrigins.front()),
+				   osg::Vec2f(sOrigins.back(),tOrigins.back()),
+				   border0, border1 );
 
-    if ( sBorder0 < 0 ) sBorder0 = 0;
-    if ( tBorder0 < 0 ) tBorder0 = 0;
-    if ( sBorder1 < 0 ) sBorder1 = 0;
-    if ( tBorder1 < 0 ) tBorder1 = 0;
+    _borderEnvelopeOffset = osg::Vec2f( border0[0], border0[1] );
+    _borderEnvelopeGrowth = osg::Vec2f( border0[0]+border1[0], border0[1]+border1[1] );
+    return compositeImage;
+}
+
+
+const osg::Image* TexturePlaneNode::getCompositeTextureImage( bool addBorder )
+{
+    Vec2i border0, border1;
+    const osg::Image* compositeImage = getCompositeBorders( border0, border1, addBorder );
 
-    if ( !sBorder0 && !tBorder0 && !sBorder1 && !tBorder1 )
+    if ( !compositeImage || (border0==Vec2i(0,0) && border1==Vec2i(0,0)) )
     {
 	_compositeImageWithBorder = 0;
 	return compositeImage;
@@ -745,58 +1415,62 @@ const osg::Image* TexturePlaneNode::getCompositeTextureImage( bool addBorder )
     if ( !_compositeImageWithBorder )
 	_compositeImageWithBorder = new osg::Image;
 
-    const int sSize = sBorder0 + compositeImage->s() + sBorder1;
-    const int tSize = tBorder0 + compositeImage->t() + tBorder1;
+    const int sSize = border0[0] + compositeImage->s() + border1[0];
+    const int tSize = border0[1] + compositeImage->t() + border1[1];
 
     if ( _compositeImageWithBorder->s()!=sSize || _compositeImageWithBorder->t()!=tSize )
     {
 	_compositeImageWithBorder->allocateImage( sSize, tSize, 1, GL_RGBA, GL_UNSIGNED_BYTE );
     }
 
-    const int id = _texture->compositeLayerId();
-    const osg::Vec4f& borderColor = _texture->getDataLayerBorderColor( id );
+    _texture->writeCompositeTextureImage( _compositeImageWithBorder->data(), border0, border1 );
+    _compositeImageWithBorder->dirty();
+
+    return _compositeImageWithBorder;
+}
 
-#if OSG_MIN_VERSION_REQUIRED(3,3,0)
-    for ( int s=0; s<sSize; s++ )
-    {
-	for ( int t=0; t<tSize; t++ )
-	    _compositeImageWithBorder->setColor( borderColor, s, t, 0 );
-    }
-#else
-    // Assuming contiguous data of type GL_RGBA
-    unsigned char* imagePtr = _compositeImageWithBorder->data();
-    for ( int count=0; count<sSize*tSize; count++ )
-    {
-	for ( int channel=0; channel<=3; channel++ )
-	{
-	    int val = (int) floor( 255.0f*borderColor[channel] + 0.5 );
-	    val = val<=0 ? 0 : (val>=255 ? 255 : val);
-	    *imagePtr = (unsigned char) val;
-	    imagePtr++;
-	}
-    }
-#endif
 
-    _compositeImageWithBorder->copySubImage( sBorder0, tBorder0, 0, compositeImage );
+bool TexturePlaneNode::getCompositeTextureImageSize( int& sSize, int& tSize, bool addBorder )
+{
+    Vec2i border0, border1;
+    const osg::Image* compositeImage = getCompositeBorders( border0, border1, addBorder );
+    if ( !compositeImage )
+	return false;
 
-    _borderEnvelopeOffset = osg::Vec2f( sBorder0, tBorder0 );
+    sSize = border0[0] + compositeImage->s() + border1[0];
+    tSize = border0[1] + compositeImage->t() + border1[1];
+    return true;
+}
 
-    return _compositeImageWithBorder;
+
+bool TexturePlaneNode::writeCompositeTextureImage( unsigned char* buffer, bool addBorder )
+{
+    Vec2i border0, border1;
+    if ( !getCompositeBorders(border0,border1,addBorder) )
+	return false;
+
+    _compositeImageWithBorder = 0;
+    return _texture->writeCompositeTextureImage( buffer, border0, border1 );
 }
 
 
 const osg::Vec2Array* TexturePlaneNode::getCompositeTextureCoords( int geomIdx ) const
 {
-    if ( geomIdx<0 || geomIdx>=_geometries.size() || !_texture )
+    // Shared brick geometry has one composite cutout per brick
+    const int nrGeoms = _isBrickGeometryShared ? _brickOrigins.size() : _geometries.size();
+    if ( geomIdx<0 || geomIdx>=nrGeoms || !_texture )
 	return 0;
 
     const osg::Image* compositeImage = _texture->getCompositeTextureImage();
-    if ( _compositeImageWithBorder )
-	compositeImage = _compositeImageWithBorder;
-
     if ( !compositeImage )
 	return 0;
 
+    const osg::Vec2f compositeSize( compositeImage->s() + _borderEnvelopeGrowth[0],
+				    compositeImage->t() + _borderEnvelopeGrowth[1] );
+
+    if ( _isBrickGeometryShared )
+	return getSharedBrickCompositeTextureCoords( geomIdx, compositeSize );
+
     const osg::Geometry* geom = _geometries[geomIdx];
     const osg::Array* arr = geom->getTexCoordArray( _compositeCutoutTexUnit );
     const osg::Vec2Array* texCoords = dynamic_cast<const osg::Vec2Array*>(arr);
@@ -820,8 +1494,43 @@ const osg::Vec2Array* TexturePlaneNode::getCompositeTextureCoords( int geomIdx )
 
 	local += _borderEnvelopeOffset;
 
-	const osg::Vec2 texCoord( local[0] / compositeImage->s(),
-				  local[1] / compositeImage->t() );
+	const osg::Vec2 texCoord( local[0] / compositeSize[0],
+				  local[1] / compositeSize[1] );
+	compositeCoords->push_back( texCoord );
+    }
+
+    return compositeCoords.release();
+}
+
+
+const osg::Vec2Array* TexturePlaneNode::getSharedBrickCompositeTextureCoords( int brickIdx, const osg::Vec2f& compositeSize ) const
+{
+    // The unit-square texture coords of the shared geometry span the brick
+    const int toId = _texture->compositeLayerId();
+    const osg::Vec2f origin = _texture->getDataLayerCoord( toId,
+			_texture->getGlobalCoord(_brickOrigins[brickIdx]) );
+    const osg::Vec2f opposite = _texture->getDataLayerCoord( toId,
+			_texture->getGlobalCoord(_brickOpposites[brickIdx]) );
+
+    const osg::Geometry* geom = _geometries[0];
+    const osg::Array* arr = geom->getTexCoordArray( _compositeCutoutTexUnit );
+    const osg::Vec2Array* unitCoords = dynamic_cast<const osg::Vec2Array*>(arr);
+
+    if ( !unitCoords )
+	return 0;
+
+    osg::ref_ptr<osg::Vec2Array> compositeCoords = new osg::Vec2Array();
+
+    for ( int tcIdx=0; tcIdx<unitCoords->size(); tcIdx++ )
+    {
+	const osg::Vec2f& unitCoord = unitCoords->at( tcIdx );
+	osg::Vec2f local( origin[0] + (opposite[0]-origin[0])*unitCoord[0],
+			  origin[1] + (opposite[1]-origin[1])*unitCoord[1] );
+
+	local += _borderEnvelopeOffset;
+
+	const osg::Vec2 texCoord( local[0] / compositeSize[0],
+				  local[1] / compositeSize[1] );
 	compositeCoords->push_back( texCoord );
     }
 
@@ -0,0 +1,272 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/TextureRenderer.h>
+#include <vsgGeo/LayeredTexture.h>
+#include <vsgGeo/TexturePlane.h>
+
+#include <iostream>
+
+
+namespace vsgGeo
+{
+
+class TexturePlaneRenderThread : public GroupThread<TexturePlaneRenderThread>
+{
+public:
+			TexturePlaneRenderThread(ThreadGroup<TexturePlaneRenderThread>& tg)
+			    : GroupThread<TexturePlaneRenderThread>(tg)
+			{}
+
+    void		set(const TexturePlaneRenderer* renderer,
+			    osg::Image* image,int startRow,int stopRow,
+			    OpenThreads::BlockCount& ready)
+			{
+			    beginSetFunction( &ready );
+
+			    _renderer = renderer;
+			    _image = image;
+			    _start = startRow;
+			    _stop = stopRow;
+			    endSetFunction();
+			}
+
+protected:
+
+    void			doWork() override;
+
+    const TexturePlaneRenderer*	_renderer;
+    osg::Image*			_image;
+    int				_start;
+    int				_stop;
+};
+
+
+void TexturePlaneRenderThread::doWork()
+{
+    for ( int row=_start; _renderer && row<=_stop; row++ )
+	_renderer->renderRow( _image->data(0,row), row );
+}
+
+
+//============================================================================
+
+
+TexturePlaneRenderer::TexturePlaneRenderer( const TexturePlaneNode& node )
+    : _node( &node )
+    , _bgColor( 0.0f, 0.0f, 0.0f, 0.0f )
+    , _width( 0 )
+    , _height( 0 )
+    , _minOpacity( 1.0f )
+{}
+
+
+TexturePlaneRenderer::~TexturePlaneRenderer()
+{}
+
+
+void TexturePlaneRenderer::setViewMatrix( const osg::Matrix& modelView )
+{ _modelView = modelView; }
+
+
+void TexturePlaneRenderer::setProjectionMatrix( const osg::Matrix& projection )
+{ _projection = projection; }
+
+
+void TexturePlaneRenderer::setCamera( const osg::Camera& camera )
+{
+    _modelView = camera.getViewMatrix();
+    _projection = camera.getProjectionMatrix();
+}
+
+
+void TexturePlaneRenderer::setBackgroundColor( const osg::Vec4f& color )
+{ _bgColor = color; }
+
+
+bool TexturePlaneRenderer::initPlaneMapping()
+{
+    if ( !_node->getTextureEnvelope(_tilingOrigin,_tilingOpposite) )
+	return false;
+
+    const osg::Vec3& width = _node->getWidth();
+    const char thinDim = _node->getThinDim();
+    if ( (thinDim!=0 && !width.x()) || (thinDim!=1 && !width.y()) ||
+	 (thinDim!=2 && !width.z()) )
+	return false;
+
+    if ( !_inverseMVP.invert(_modelView*_projection) )
+	return false;
+
+    osg::Matrix rotMat;
+    rotMat.makeRotate( _node->getRotation() );
+    _inverseRotation.invert( rotMat );
+
+    const osg::Vec3 axis( thinDim==0 ? 1.0f : 0.0f,
+			  thinDim==1 ? 1.0f : 0.0f,
+			  thinDim==2 ? 1.0f : 0.0f );
+    _planeNormal = rotMat.preMult( axis );
+    return true;
+}
+
+
+bool TexturePlaneRenderer::getGlobalCoord( float x, float y, osg::Vec2f& global, bool& inside ) const
+{
+    const osg::Vec3 ndc( 2.0f*x/_width-1.0f, 2.0f*y/_height-1.0f, 0.0f );
+
+    const osg::Vec3 nearPos = osg::Vec3(ndc.x(),ndc.y(),-1.0f) * _inverseMVP;
+    const osg::Vec3 farPos  = osg::Vec3(ndc.x(),ndc.y(), 1.0f) * _inverseMVP;
+
+    const osg::Vec3 dir = farPos - nearPos;
+    const float denom = _planeNormal * dir;
+    if ( !denom )
+	return false;
+
+    const osg::Vec3& center = _node->getCenter();
+    const float lambda = (_planeNormal * (center-nearPos)) / denom;
+    const osg::Vec3 local = _inverseRotation.preMult( nearPos + dir*lambda - center );
+
+    // Inverse of the vertex mapping in TexturePlaneNode::updateGeometry()
+    const osg::Vec3& width = _node->getWidth();
+    const char thinDim = _node->getThinDim();
+    osg::Vec2f uv = thinDim==0 ? osg::Vec2f( local.y()/width.y(), local.z()/width.z() ) :
+		    thinDim==1 ? osg::Vec2f( local.x()/width.x(), local.z()/width.z() ) :
+				 osg::Vec2f( local.x()/width.x(), local.y()/width.y() );
+
+    if ( _node->areTextureAxesSwapped() )
+	uv = osg::Vec2f( uv.y(), uv.x() );
+
+    inside = lambda>=0.0f && uv.x()>=-0.5f && uv.x()<=0.5f &&
+			     uv.y()>=-0.5f && uv.y()<=0.5f;
+
+    const osg::Vec2f tiling(
+	_tilingOrigin.x() + (uv.x()+0.5f)*(_tilingOpposite.x()-_tilingOrigin.x()),
+	_tilingOrigin.y() + (uv.y()+0.5f)*(_tilingOpposite.y()-_tilingOrigin.y()) );
+
+    global = _node->getLayeredTexture()->getGlobalCoord( tiling );
+    return true;
+}
+
+
+void TexturePlaneRenderer::renderRow( unsigned char* rowPtr, int row ) const
+{
+    const LayeredTexture* texture = _node->getLayeredTexture();
+
+    for ( int col=0; col<_width; col++ )
+    {
+	osg::Vec2f global, globalDx, globalDy;
+	bool inside, dummy;
+	osg::Vec4f fragColor( 0.0f, 0.0f, 0.0f, 0.0f );
+
+	if ( getGlobalCoord(col+0.5f,row+0.5f,global,inside) && inside )
+	{
+	    // Footprint from the neighbouring pixels on the unbounded plane
+	    if ( getGlobalCoord(col+1.5f,row+0.5f,globalDx,dummy) &&
+		 getGlobalCoord(col+0.5f,row+1.5f,globalDy,dummy) )
+	    {
+		const TexelFootprint footprint( globalDx-global, globalDy-global );
+		fragColor = texture->getFragmentColor( global, _processes, _minOpacity, &footprint );
+	    }
+	    else
+		fragColor = texture->getFragmentColor( global, _processes, _minOpacity );
+	}
+
+	const float a = fragColor[3];
+	osg::Vec4f color = fragColor*a + _bgColor*(1.0f-a);
+	color[3] = a + _bgColor[3]*(1.0f-a);
+
+	color *= 255.0f;
+	for ( int tc=0; tc<4; tc++ )
+	{
+	    int val = (int) floor( color[tc]+0.5 );
+	    val = val<=0 ? 0 : (val>=255 ? 255 : val);
+
+	    *rowPtr = (unsigned char) val;
+	    rowPtr++;
+	}
+    }
+}
+
+
+bool TexturePlaneRenderer::render( osg::Image& image, int width, int height )
+{
+    LayeredTexture* texture = const_cast<LayeredTexture*>( _node->getLayeredTexture() );
+
+    if ( !texture || width<1 || height<1 )
+	return false;
+
+    _width = width;
+    _height = height;
+
+    if ( !initPlaneMapping() )
+    {
+	std::cerr << "TexturePlaneRenderer: plane not updated or view singular" << std::endl;
+	return false;
+    }
+
+    image.allocateImage( width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+
+    texture->updateColorScaleSpaces();
+    texture->readLock();
+
+    texture->getActiveProcesses( _processes, _minOpacity );
+
+    int nrTasks = OpenThreads::GetNumberOfProcessors();
+
+    if ( nrTasks<1 )
+	nrTasks = 1;
+    if ( nrTasks>height )
+	nrTasks = height;
+
+    if ( !_renderThreads )
+	_renderThreads = ThreadGroup<TexturePlaneRenderThread>::getInst();
+
+    std::vector<osg::ref_ptr<TexturePlaneRenderThread> > tasks;
+    OpenThreads::BlockCount readyCount( nrTasks );
+    readyCount.reset();
+
+    int remainder = height%nrTasks;
+    int start = 0;
+
+    while ( start<height )
+    {
+	int stop = start + height/nrTasks;
+	if ( remainder )
+	    remainder--;
+	else
+	    stop--;
+
+	osg::ref_ptr<TexturePlaneRenderThread> task = _renderThreads->getThread();
+	task->set( this, &image, start, stop, readyCount );
+
+	tasks.push_back( task.get() );
+
+	start = stop+1;
+    }
+
+    readyCount.block();
+
+    _processes.clear();
+    texture->readUnLock();
+
+    image.dirty();
+    return true;
+}
+
+
+} // namespace vsgGeo
@@ -0,0 +1,440 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/VirtualTexture.h>
+
+#include <string.h>
+#include <iostream>
+
+
+namespace vsgGeo
+{
+
+/* Uploads only the atlas slots that changed since the last upload to the
+   texture object of a graphics context, instead of the complete atlas. */
+
+class VirtualTextureAtlas::SubloadCallback : public osg::Texture2D::SubloadCallback
+{
+public:
+			SubloadCallback(VirtualTextureAtlas& vta)
+			    : _vta( &vta )
+			{}
+
+    void		load(const osg::Texture2D&,osg::State&) const override;
+    void		subload(const osg::Texture2D&,osg::State&) const override;
+
+protected:
+    osg::observer_ptr<VirtualTextureAtlas>			_vta;
+    mutable osg::buffered_object<std::vector<unsigned int> >	_uploadedVersions;
+};
+
+
+void VirtualTextureAtlas::SubloadCallback::load( const osg::Texture2D& texture, osg::State& state ) const
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta;
+    if ( !_vta.lock(vta) )
+	return;
+
+    const int size = vta->_atlasSize;
+    texture.setTextureSize( size, size );
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( vta->_lock );
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, vta->_atlasImage->data() );
+
+    std::vector<unsigned int>& uploaded = _uploadedVersions[state.getContextID()];
+    uploaded.resize( vta->_slots.size() );
+    for ( unsigned int slot=0; slot<uploaded.size(); slot++ )
+	uploaded[slot] = vta->_slots[slot]._version;
+}
+
+
+void VirtualTextureAtlas::SubloadCallback::subload( const osg::Texture2D&, osg::State& state ) const
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta;
+    if ( !_vta.lock(vta) )
+	return;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( vta->_lock );
+
+    std::vector<unsigned int>& uploaded = _uploadedVersions[state.getContextID()];
+    uploaded.resize( vta->_slots.size(), 0 );
+
+    const int paddedSize = vta->getPaddedPageSize();
+    bool unpackSet = false;
+
+    for ( unsigned int slot=0; slot<uploaded.size(); slot++ )
+    {
+	if ( uploaded[slot]==vta->_slots[slot]._version )
+	    continue;
+
+	if ( !unpackSet )
+	{
+	    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	    glPixelStorei( GL_UNPACK_ROW_LENGTH, vta->_atlasSize );
+	    unpackSet = true;
+	}
+
+	const int x = (slot % vta->_slotsPerSide) * paddedSize;
+	const int y = (slot / vta->_slotsPerSide) * paddedSize;
+	glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, paddedSize, paddedSize, GL_RGBA, GL_UNSIGNED_BYTE, vta->getSlotData(slot) );
+
+	uploaded[slot] = vta->_slots[slot]._version;
+    }
+
+    if ( unpackSet )
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+}
+
+
+//============================================================================
+
+
+bool VirtualTextureAtlas::PageKey::operator<( const PageKey& key ) const
+{
+    if ( _owner!=key._owner )
+	return _owner<key._owner;
+    if ( _layerId!=key._layerId )
+	return _layerId<key._layerId;
+
+    return _pageNr<key._pageNr;
+}
+
+
+VirtualTextureAtlas::VirtualTextureAtlas( int pageSize, int atlasSize )
+    : _pageSize( pageSize<8 ? 8 : pageSize )
+    , _atlasSize( atlasSize<_pageSize+2 ? _pageSize+2 : atlasSize )
+    , _requestStamp( 1 )
+    , _newRoundPending( false )
+    , _budgetWarning( false )
+{
+    _slotsPerSide = _atlasSize / getPaddedPageSize();
+    if ( _slotsPerSide>255 )	// Slot coordinates are stored as bytes
+	_slotsPerSide = 255;
+
+    _budget = nrSlots();
+    _slots.resize( nrSlots() );
+    _lruPositions.resize( nrSlots(), _lruSlots.end() );
+
+    for ( int slot=nrSlots()-1; slot>=0; slot-- )
+	_freeSlots.push_back( slot );
+
+    _atlasImage = new osg::Image;
+    _atlasImage->allocateImage( _atlasSize, _atlasSize, 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    memset( _atlasImage->data(), 0, _atlasImage->getTotalSizeInBytes() );
+
+    _atlasTexture = new osg::Texture2D;
+    _atlasTexture->setTextureSize( _atlasSize, _atlasSize );
+    _atlasTexture->setInternalFormat( GL_RGBA8 );
+    _atlasTexture->setResizeNonPowerOfTwoHint( false );
+    _atlasTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR );
+    _atlasTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+    _atlasTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+    _atlasTexture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+    _atlasTexture->setDataVariance( osg::Object::DYNAMIC );
+    _atlasTexture->setSubloadCallback( new SubloadCallback(*this) );
+}
+
+
+VirtualTextureAtlas::~VirtualTextureAtlas()
+{
+    _atlasTexture->setSubloadCallback( 0 );
+}
+
+
+int VirtualTextureAtlas::nrSlots() const
+{ return _slotsPerSide*_slotsPerSide; }
+
+
+int VirtualTextureAtlas::getAtlasRowSizeInBytes() const
+{ return _atlasImage->getRowSizeInBytes(); }
+
+
+unsigned char* VirtualTextureAtlas::getSlotData( int slot )
+{
+    if ( slot<0 || slot>=nrSlots() )
+	return 0;
+
+    const int x = (slot % _slotsPerSide) * getPaddedPageSize();
+    const int y = (slot / _slotsPerSide) * getPaddedPageSize();
+    return _atlasImage->data( x, y );
+}
+
+
+void VirtualTextureAtlas::setPageBudget( int nrPages )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    _budget = nrPages<1 ? 1 : (nrPages>nrSlots() ? nrSlots() : nrPages);
+
+    while ( (int)_lruSlots.size() > _budget )
+	evictSlot( _lruSlots.front() );
+}
+
+
+void VirtualTextureAtlas::setPageGrid( const void* owner, int layerId, const Vec2i& imageSize )
+{
+    Vec2i nrPages( (imageSize.x()+_pageSize-1) / _pageSize,
+		   (imageSize.y()+_pageSize-1) / _pageSize );
+    if ( nrPages.x()<1 ) nrPages.x() = 1;
+    if ( nrPages.y()<1 ) nrPages.y() = 1;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    PageGrid& grid = _pageGrids[GridKey(owner,layerId)];
+    if ( grid._table && grid._nrPages==nrPages )
+	return;
+
+    for ( int slot=0; slot<nrSlots(); slot++ )
+    {
+	const PageKey& key = _slots[slot]._key;
+	if ( _slots[slot]._inUse && key._owner==owner && key._layerId==layerId )
+	    evictSlot( slot );
+    }
+
+    grid._nrPages = nrPages;
+    grid._table = new osg::Image;
+    grid._table->allocateImage( nrPages.x(), nrPages.y(), 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    memset( grid._table->data(), 0, grid._table->getTotalSizeInBytes() );
+
+    if ( !grid._tableTexture )
+    {
+	grid._tableTexture = new osg::Texture2D;
+	grid._tableTexture->setResizeNonPowerOfTwoHint( false );
+	grid._tableTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::NEAREST );
+	grid._tableTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::NEAREST );
+	grid._tableTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+	grid._tableTexture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+	grid._tableTexture->setDataVariance( osg::Object::DYNAMIC );
+    }
+
+    grid._tableTexture->setImage( grid._table.get() );
+}
+
+
+void VirtualTextureAtlas::removePageGrid( const void* owner, int layerId )
+{
+    invalidatePages( owner, layerId );
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+    _pageGrids.erase( GridKey(owner,layerId) );
+}
+
+
+void VirtualTextureAtlas::invalidatePages( const void* owner, int layerId )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    for ( int slot=0; slot<nrSlots(); slot++ )
+    {
+	const PageKey& key = _slots[slot]._key;
+	if ( _slots[slot]._inUse && key._owner==owner && key._layerId==layerId )
+	    evictSlot( slot );
+    }
+}
+
+
+Vec2i VirtualTextureAtlas::getPageGridSize( const void* owner, int layerId ) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::map<GridKey,PageGrid>::const_iterator it = _pageGrids.find( GridKey(owner,layerId) );
+    return it==_pageGrids.end() ? Vec2i(0,0) : it->second._nrPages;
+}
+
+
+osg::Texture2D* VirtualTextureAtlas::getPageTableTexture( const void* owner, int layerId )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::map<GridKey,PageGrid>::iterator it = _pageGrids.find( GridKey(owner,layerId) );
+    return it==_pageGrids.end() ? 0 : it->second._tableTexture.get();
+}
+
+
+bool VirtualTextureAtlas::requestPages( const void* owner, int layerId, const Vec2i& firstPage, const Vec2i& lastPage )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    /* A round spans all requests between two update traversals, so the
+       stamp advances at the first request after any owner assigned pages,
+       not per owner. */
+    if ( _newRoundPending )
+    {
+	_requestStamp++;
+	_newRoundPending = false;
+    }
+
+    std::map<GridKey,PageGrid>::const_iterator it = _pageGrids.find( GridKey(owner,layerId) );
+    if ( it==_pageGrids.end() )
+	return true;
+
+    const Vec2i& nrPages = it->second._nrPages;
+    const int x0 = firstPage.x()<0 ? 0 : firstPage.x();
+    const int y0 = firstPage.y()<0 ? 0 : firstPage.y();
+    const int x1 = lastPage.x()>=nrPages.x() ? nrPages.x()-1 : lastPage.x();
+    const int y1 = lastPage.y()>=nrPages.y() ? nrPages.y()-1 : lastPage.y();
+
+    bool allResident = true;
+
+    for ( int y=y0; y<=y1; y++ )
+    {
+	for ( int x=x0; x<=x1; x++ )
+	{
+	    const PageKey key( owner, layerId, Vec2i(x,y) );
+	    std::map<PageKey,int>::const_iterator pit = _residentPages.find( key );
+	    if ( pit!=_residentPages.end() )
+	    {
+		_slots[pit->second]._lastRequest = _requestStamp;
+		touchSlot( pit->second );
+	    }
+	    else
+	    {
+		_requestedPages.insert( key );
+		allResident = false;
+	    }
+	}
+    }
+
+    return allResident;
+}
+
+
+void VirtualTextureAtlas::assignRequestedPages( const void* owner, std::vector<PageLoad>& loads )
+{
+    loads.clear();
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::set<PageKey>::iterator it = _requestedPages.begin();
+    while ( it!=_requestedPages.end() )
+    {
+	if ( it->_owner!=owner )
+	{
+	    it++;
+	    continue;
+	}
+
+	const PageKey key = *it;
+	_requestedPages.erase( it++ );
+
+	if ( _residentPages.find(key)!=_residentPages.end() )
+	    continue;
+
+	if ( _pageGrids.find(GridKey(key._owner,key._layerId))==_pageGrids.end() )
+	    continue;
+
+	if ( (int)_lruSlots.size()>=_budget || _freeSlots.empty() )
+	{
+	    // Never evict pages that were requested during this round
+	    if ( _lruSlots.empty() || _slots[_lruSlots.front()]._lastRequest>=_requestStamp )
+	    {
+		if ( !_budgetWarning )
+		{
+		    _budgetWarning = true;
+		    std::cerr << "Visible pages exceed virtual texture page budget" << std::endl;
+		}
+		continue;
+	    }
+
+	    evictSlot( _lruSlots.front() );
+	}
+
+	const int slot = _freeSlots.back();
+	_freeSlots.pop_back();
+
+	_slots[slot]._key = key;
+	_slots[slot]._inUse = true;
+	_slots[slot]._lastRequest = _requestStamp;
+	_lruPositions[slot] = _lruSlots.insert( _lruSlots.end(), slot );
+	_residentPages[key] = slot;
+
+	PageLoad load;
+	load._owner = key._owner;
+	load._layerId = key._layerId;
+	load._pageNr = key._pageNr;
+	load._slot = slot;
+	loads.push_back( load );
+    }
+
+    _newRoundPending = true;
+}
+
+
+void VirtualTextureAtlas::commitPages( const std::vector<PageLoad>& loads )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::vector<PageLoad>::const_iterator it = loads.begin();
+    for ( ; it!=loads.end(); it++ )
+    {
+	const PageKey key( it->_owner, it->_layerId, it->_pageNr );
+	std::map<PageKey,int>::const_iterator pit = _residentPages.find( key );
+	if ( pit==_residentPages.end() || pit->second!=it->_slot )
+	    continue;	// Evicted or invalidated in the meantime
+
+	_slots[it->_slot]._version++;
+	setPageTableEntry( key, it->_slot );
+    }
+}
+
+
+void VirtualTextureAtlas::evictSlot( int slot )
+{
+    if ( slot<0 || slot>=nrSlots() || !_slots[slot]._inUse )
+	return;
+
+    _residentPages.erase( _slots[slot]._key );
+    setPageTableEntry( _slots[slot]._key, -1 );
+
+    _slots[slot]._inUse = false;
+    _lruSlots.erase( _lruPositions[slot] );
+    _lruPositions[slot] = _lruSlots.end();
+    _freeSlots.push_back( slot );
+}
+
+
+void VirtualTextureAtlas::touchSlot( int slot )
+{
+    if ( _slots[slot]._inUse )
+	_lruSlots.splice( _lruSlots.end(), _lruSlots, _lruPositions[slot] );
+}
+
+
+void VirtualTextureAtlas::setPageTableEntry( const PageKey& key, int slot )
+{
+    std::map<GridKey,PageGrid>::iterator it = _pageGrids.find( GridKey(key._owner,key._layerId) );
+    if ( it==_pageGrids.end() || !it->second._table )
+	return;
+
+    const Vec2i& nrPages = it->second._nrPages;
+    if ( key._pageNr.x()>=nrPages.x() || key._pageNr.y()>=nrPages.y() )
+	return;
+
+    unsigned char* ptr = it->second._table->data( key._pageNr.x(), key._pageNr.y() );
+    ptr[0] = slot<0 ? 0 : (unsigned char) (slot % _slotsPerSide);
+    ptr[1] = slot<0 ? 0 : (unsigned char) (slot / _slotsPerSide);
+    ptr[2] = 0;
+    ptr[3] = slot<0 ? 0 : 255;
+
+    it->second._table->dirty();
+}
+
+
+} //namespace
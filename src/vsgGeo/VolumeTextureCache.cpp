@@ -0,0 +1,177 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <vsgGeo/VolumeTextureCache.h>
+
+#include <iostream>
+
+
+namespace vsgGeo
+{
+
+#define MEGABYTE (1024*1024)
+
+
+bool VolumeTextureCache::TextureKey::operator<( const TextureKey& key ) const
+{
+    if ( _volume!=key._volume )
+	return _volume<key._volume;
+    if ( _filter!=key._filter )
+	return _filter<key._filter;
+
+    return _borderColor<key._borderColor;
+}
+
+
+VolumeTextureCache::VolumeTextureCache( unsigned int budgetMB )
+    : _budgetMB( budgetMB )
+    , _usedBytes( 0 )
+    , _budgetWarning( false )
+{}
+
+
+VolumeTextureCache::~VolumeTextureCache()
+{}
+
+
+unsigned int VolumeTextureCache::getMemoryUsage() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+    return (unsigned int) (_usedBytes/MEGABYTE);
+}
+
+
+void VolumeTextureCache::setMemoryBudget( unsigned int megaBytes )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    _budgetMB = megaBytes;
+    _budgetWarning = false;
+    evictToBudget();
+}
+
+
+osg::ref_ptr<osg::Texture3D> VolumeTextureCache::getTexture( osg::Image* volume, osg::Texture::FilterMode filter, const osg::Vec4f& borderColor )
+{
+    if ( !volume || !volume->s() || !volume->t() || !volume->r() )
+	return 0;
+
+    // All negative border colors are equivalent
+    const osg::Vec4f border = borderColor[0]>=0.0f ? borderColor : osg::Vec4f(-1.0f,-1.0f,-1.0f,-1.0f);
+    const TextureKey key( volume, filter, border );
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::map<TextureKey,CacheEntry>::iterator it = _entries.find( key );
+    if ( it!=_entries.end() )
+    {
+	_lruKeys.splice( _lruKeys.end(), _lruKeys, it->second._lruPos );
+	return it->second._texture;
+    }
+
+    osg::ref_ptr<osg::Texture3D> texture = new osg::Texture3D( volume );
+    texture->setResizeNonPowerOfTwoHint( false );
+
+    const osg::Texture::WrapMode wrapMode = border[0]>=0.0f ? osg::Texture::CLAMP_TO_BORDER : osg::Texture::CLAMP_TO_EDGE;
+    texture->setWrap( osg::Texture::WRAP_S, wrapMode );
+    texture->setWrap( osg::Texture::WRAP_T, wrapMode );
+    texture->setWrap( osg::Texture::WRAP_R, wrapMode );
+    texture->setFilter( osg::Texture::MAG_FILTER, filter );
+    texture->setFilter( osg::Texture::MIN_FILTER, filter );
+    texture->setBorderColor( border );
+
+    CacheEntry& entry = _entries[key];
+    entry._texture = texture;
+    entry._sizeInBytes = volume->getTotalSizeInBytes();
+    entry._lruPos = _lruKeys.insert( _lruKeys.end(), key );
+    _usedBytes += entry._sizeInBytes;
+
+    // Held by texture, so the new entry counts as bound and stays
+    evictToBudget();
+    return texture;
+}
+
+
+void VolumeTextureCache::removeVolume( const osg::Image* volume )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::map<TextureKey,CacheEntry>::iterator it = _entries.begin();
+    while ( it!=_entries.end() )
+    {
+	std::map<TextureKey,CacheEntry>::iterator cur = it++;
+	if ( cur->first._volume==volume && !isBound(cur->second) )
+	    evict( cur );
+    }
+}
+
+
+void VolumeTextureCache::releaseUnused()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _lock );
+
+    std::map<TextureKey,CacheEntry>::iterator it = _entries.begin();
+    while ( it!=_entries.end() )
+    {
+	std::map<TextureKey,CacheEntry>::iterator cur = it++;
+	if ( !isBound(cur->second) )
+	    evict( cur );
+    }
+}
+
+
+bool VolumeTextureCache::isBound( const CacheEntry& entry ) const
+{
+    // Any reference besides the cache comes from a stateset
+    return entry._texture->referenceCount()>1;
+}
+
+
+void VolumeTextureCache::evict( std::map<TextureKey,CacheEntry>::iterator it )
+{
+    _usedBytes -= it->second._sizeInBytes;
+    _lruKeys.erase( it->second._lruPos );
+    _entries.erase( it );
+}
+
+
+void VolumeTextureCache::evictToBudget()
+{
+    const std::size_t budget = (std::size_t) _budgetMB * MEGABYTE;
+
+    std::list<TextureKey>::iterator lit = _lruKeys.begin();
+    while ( _usedBytes>budget && lit!=_lruKeys.end() )
+    {
+	std::map<TextureKey,CacheEntry>::iterator it = _entries.find( *lit );
+	lit++;
+
+	if ( !isBound(it->second) )
+	    evict( it );
+    }
+
+    if ( _usedBytes>budget && !_budgetWarning )
+    {
+	std::cerr << "VolumeTextureCache: bound volumes exceed memory budget of " << _budgetMB << " MB" << std::endl;
+	_budgetWarning = true;
+    }
+    else if ( _usedBytes<=budget )
+	_budgetWarning = false;
+}
+
+
+} //namespace
@@ -1,77 +1,83 @@
 #version 130
-# osgGeo - A collection of geoscientific extensions to OpenSceneGraph.
-# Copyright 2011 dGB Beheer B.V. and others.
-# 
-# osgGeo is free software; you can redistribute it and/or modify
-# it under the terms of the GNU Lesser General Public License as published by
-# the Free Software Foundation; either version 3 of the License, or
-# (at your option) any later version.
-# 
-# This program is distributed in the hope that it will be useful,
-# but WITHOUT ANY WARRANTY; without even the implied warranty of
-# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-# GNU Lesser General Public License for more details.
-# 
-# You should have received a copy of the GNU Lesser General Public License
-# along with this program.  If not, see <http://www.gnu.org/licenses/>
-# 
-# $Id$
-#
+// osgGeo - A collection of geoscientific extensions to OpenSceneGraph.
+// Copyright 2011 dGB Beheer B.V. and others.
+//
+// osgGeo is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>
+//
+// $Id$
+//
 
-uniform sampler2D heightMap;
+// Chunk of a HeightField: vertex xy is the grid position within the chunk,
+// z flags skirt vertices.
+uniform vec2 chunkOrigin;
+uniform vec2 chunkStep;
+uniform vec2 gridMin;
+uniform vec2 gridMax;
+uniform vec2 gridSize;
+uniform vec2 chunkFirstNode;
+uniform float chunkNodeStep;
+@if("hasChunkNormals")
+// streamed grids have no normal map
+in vec3 chunkNormal;
+@else
 uniform sampler2D normals;
+@endif
+uniform float skirtDepth;
+uniform float heightOffset;
+uniform float heightScale;
+uniform float heightUndef;
 uniform float depthMin;
 uniform float depthDiff;
 
+// relative to the chunk height range for half floats and 16-bit heights
+in float chunkHeight;
+
 out float depthOut;
-out int undef;
+out float undefOut;
 
-@if("hasGeomShader")
-out vec2 texCoordPass;
-out float diffuseValuePass;
-@else
-out vec2 texCoordOut;
+out float valueOut;
 out float diffuseValue;
-@endif
 
 void main(void)
 {
-    // Extract texture coordinate
-    vec2 texCoord = gl_MultiTexCoord0.st;
+    // undefined heights are NaN for half floats, heightUndef otherwise
+    undefOut = isnan(chunkHeight) || chunkHeight == heightUndef ? 1.0 : 0.0;
+    float height = undefOut > 0.0 ? heightOffset : heightOffset + heightScale * chunkHeight;
 
-    // fetch value from the height map. Luminance component
-    // contains elevation value, alpha contains undefined flag
-    vec4 depthMask = texture2D(heightMap, texCoord);
-    float depthComp = depthMask.r;
+    // chunks sticking out of the grid are clamped to its border
+    vec2 xy = clamp(chunkOrigin + gl_Vertex.xy * chunkStep, gridMin, gridMax);
 
-    // denormalize depth value
-    depthOut = depthMin + depthComp * depthDiff;
-    vec4 pos = vec4(gl_Vertex.xy, depthOut, 1.0);
+    depthOut = height - gl_Vertex.z * skirtDepth;
+    vec4 pos = vec4(xy, depthOut, 1.0);
     gl_Position = gl_ModelViewProjectionMatrix * pos;
 
-    // pass undefined value to geometry shader
-    undef = (depthMask.a > 0.1) ? 1 : 0;
+    // normalized value for the palette
+    float value = depthDiff > 0.0 ? (height - depthMin) / depthDiff : 0.0;
 
-    // Normals and lighting
-
-    //read normal from texture and denormalize it
+@if("hasChunkNormals")
+    vec3 normal = chunkNormal;
+@else
+    // normal map has one texel per grid node
+    vec2 node = min(chunkFirstNode + gl_Vertex.xy * chunkNodeStep, gridSize - 1.0);
+    vec2 texCoord = (node + 0.5) / gridSize;
     vec3 normal = texture2D(normals, texCoord).xyz * 2.0 - 1.0;
+@endif
 
-    // Transforming The Normal To ModelView-Space
+    // depth axis points down, so flip the normal
     vec3 vertex_normal = normalize(gl_NormalMatrix * (-normal));
+    float diffuse_value = abs(dot(vertex_normal, normalize(gl_LightSource[0].position.xyz)));
 
-    vec3 vertex_light_position = gl_LightSource[0].position.xyz;
-
-    float diffuse_value = dot(vertex_normal, vertex_light_position);
-    if(diffuse_value < 0)
-      diffuse_value *= -1;
-
-    // trickery to pass values to either geometry or fragment shader.
-    @if("hasGeomShader")
-        texCoordPass = texCoord;
-        diffuseValuePass = diffuse_value;
-    @else
-        texCoordOut = texCoord;
-        diffuseValue = diffuse_value;
-    @endif
+    valueOut = value;
+    diffuseValue = diffuse_value;
 }
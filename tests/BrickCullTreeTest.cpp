@@ -0,0 +1,160 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/BrickCullTree.h>
+#include <vsgGeo/LayeredTexture.h>
+
+#include <osgUtil/CullVisitor>
+
+#include <algorithm>
+
+using namespace vsgGeo;
+
+
+// Looks down the z-axis at the unit bricks in x,y within [0.1,1.9]
+
+static osg::ref_ptr<osgUtil::CullVisitor> createCullVisitor()
+{
+    osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor;
+    cv->setCullingMode( osg::CullSettings::VIEW_FRUSTUM_CULLING );
+    cv->pushViewport( new osg::Viewport(0,0,100,100) );
+    cv->pushProjectionMatrix( new osg::RefMatrix(osg::Matrix::ortho(0.1,1.9,0.1,1.9,-10.0,10.0)) );
+    cv->pushModelViewMatrix( new osg::RefMatrix(osg::Matrix::identity()), osg::Transform::ABSOLUTE_RF );
+    return cv;
+}
+
+
+static osg::BoundingBox getBrickBox( int i, int j, float z=0.0f )
+{ return osg::BoundingBox( i, j, z, i+1, j+1, z ); }
+
+
+// Bricks of a 4x4 plane, added row by row
+
+static osg::ref_ptr<BrickCullTree> createPlaneTree()
+{
+    osg::ref_ptr<BrickCullTree> tree = new BrickCullTree;
+    for ( int j=0; j<4; j++ )
+    {
+	for ( int i=0; i<4; i++ )
+	    tree->addBrick( getBrickBox(i,j), Vec2i(i,j) );
+    }
+
+    tree->build();
+    return tree;
+}
+
+
+static std::vector<int> getIdxs( int idx0, int idx1, int idx2, int idx3 )
+{
+    std::vector<int> idxs;
+    idxs.push_back( idx0 );
+    idxs.push_back( idx1 );
+    idxs.push_back( idx2 );
+    idxs.push_back( idx3 );
+    return idxs;
+}
+
+
+static void testVisibleBricks()
+{
+    osg::ref_ptr<osgUtil::CullVisitor> cv = createCullVisitor();
+    osg::ref_ptr<BrickCullTree> tree = createPlaneTree();
+    VSGGEO_CHECK( tree->nrBricks()==16 );
+
+    std::vector<int> visible;
+    tree->getVisibleBricks( *cv, visible );
+    VSGGEO_CHECK( visible==getIdxs(0,1,4,5) );
+
+    tree->clear();
+    tree->build();
+    tree->getVisibleBricks( *cv, visible );
+    VSGGEO_CHECK( visible.empty() );
+}
+
+
+static void testRefit()
+{
+    osg::ref_ptr<osgUtil::CullVisitor> cv = createCullVisitor();
+    osg::ref_ptr<BrickCullTree> tree = createPlaneTree();
+
+    // Moving bricks in place keeps their grid grouping
+    tree->setBrickBound( 15, getBrickBox(1,1) );
+    tree->setBrickBound( 0, getBrickBox(5,5) );
+    VSGGEO_CHECK( tree->getBrickBound(15)==getBrickBox(1,1) );
+
+    std::vector<int> visible;
+    tree->refit();
+    tree->getVisibleBricks( *cv, visible );
+    VSGGEO_CHECK( visible==getIdxs(1,4,5,15) );
+}
+
+
+static void testPathTree()
+{
+    // Panel strip: one brick row, several panels per path segment
+    osg::ref_ptr<BrickCullTree> tree = new BrickCullTree;
+    for ( int idx=0; idx<12; idx++ )
+	tree->addBrick( getBrickBox(idx/2,idx%2), Vec2i(idx/2,0) );
+    tree->build();
+
+    osg::ref_ptr<osgUtil::CullVisitor> cv = createCullVisitor();
+    std::vector<int> visible;
+    tree->getVisibleBricks( *cv, visible );
+    VSGGEO_CHECK( visible==getIdxs(0,1,2,3) );
+}
+
+
+static void testDisplacedBricks()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    const int id = texture->addDataLayer();
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage( 4, 4, 1, GL_LUMINANCE, GL_FLOAT );
+    texture->setDataLayerImage( id, image.get() );
+    VSGGEO_CHECK( !texture->isVertexOffsetUsed() );
+
+    texture->setVertexOffsetLayerID( id );
+    VSGGEO_CHECK( texture->isVertexOffsetUsed() );
+
+    /* The flat bounds of brick 15 are off-screen, but vertex offsets may
+       displace it into view. It must stay visible, as for the nodes. */
+    osg::ref_ptr<osgUtil::CullVisitor> cv = createCullVisitor();
+    osg::ref_ptr<BrickCullTree> tree = createPlaneTree();
+    std::vector<int> visible;
+    tree->getVisibleBricks( *cv, visible, !texture->isVertexOffsetUsed() );
+    VSGGEO_CHECK( visible.size()==16 );
+    VSGGEO_CHECK( std::find(visible.begin(),visible.end(),15)!=visible.end() );
+
+    texture->allowShaders( false );
+    VSGGEO_CHECK( !texture->isVertexOffsetUsed() );
+    tree->getVisibleBricks( *cv, visible, !texture->isVertexOffsetUsed() );
+    VSGGEO_CHECK( visible==getIdxs(0,1,4,5) );
+}
+
+
+int main( int, char** )
+{
+    testVisibleBricks();
+    testRefit();
+    testPathTree();
+    testDisplacedBricks();
+
+    return nrFailedChecks;
+}
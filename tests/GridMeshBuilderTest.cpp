@@ -0,0 +1,265 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/GridMeshBuilder.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+using namespace vsgGeo;
+
+
+struct Triangle
+{
+		Triangle(unsigned int a,unsigned int b,unsigned int c)
+		{ _v[0] = a; _v[1] = b; _v[2] = c; std::sort( _v, _v+3 ); }
+
+    bool	operator<(const Triangle& t) const
+		{ return std::lexicographical_compare(_v,_v+3,t._v,t._v+3); }
+    bool	operator==(const Triangle& t) const
+		{ return std::equal(_v,_v+3,t._v); }
+
+    unsigned int _v[3];
+};
+
+
+/* Unpacks the strips, skipping degenerate triangles. Returns false if a
+   triangle is not counter-clockwise with rows going up. */
+
+static bool getTriangles( const osg::DrawElementsUInt& indices, int nrCols, std::vector<Triangle>& triangles )
+{
+    const unsigned int restart = GridMeshBuilder::getRestartIndex( indices.getType() );
+    bool isCCW = true;
+    int stripStart = 0;
+
+    for ( int idx=0; idx<=(int)indices.size(); idx++ )
+    {
+	if ( idx<(int)indices.size() && indices[idx]!=restart )
+	    continue;
+
+	for ( int k=stripStart; k+2<idx; k++ )
+	{
+	    const bool odd = (k-stripStart)%2;
+	    const unsigned int a = indices[odd ? k+1 : k];
+	    const unsigned int b = indices[odd ? k : k+1];
+	    const unsigned int c = indices[k+2];
+	    if ( a==b || b==c || a==c )
+		continue;
+
+	    const int ax = a%nrCols, ay = a/nrCols;
+	    const int bx = b%nrCols, by = b/nrCols;
+	    const int cx = c%nrCols, cy = c/nrCols;
+	    isCCW = isCCW && (bx-ax)*(cy-ay) - (by-ay)*(cx-ax) > 0;
+	    triangles.push_back( Triangle(a,b,c) );
+	}
+
+	stripStart = idx+1;
+    }
+
+    std::sort( triangles.begin(), triangles.end() );
+    return isCCW;
+}
+
+
+// Quads split from vertex (i,j) to (i+1,j+1), without undefined vertices
+
+static void getGridTriangles( int nrCols, int nrRows, const unsigned char* defined, std::vector<Triangle>& triangles )
+{
+    for ( int j=0; j<nrRows-1; j++ )
+    {
+	for ( int i=0; i<nrCols-1; i++ )
+	{
+	    const unsigned int v00 = j*nrCols + i;
+	    const unsigned int v10 = v00+1;
+	    const unsigned int v01 = v00+nrCols;
+	    const unsigned int v11 = v01+1;
+	    if ( defined && (!defined[v00] || !defined[v11]) )
+		continue;
+
+	    if ( !defined || defined[v10] )
+		triangles.push_back( Triangle(v00,v10,v11) );
+	    if ( !defined || defined[v01] )
+		triangles.push_back( Triangle(v00,v11,v01) );
+	}
+    }
+
+    std::sort( triangles.begin(), triangles.end() );
+}
+
+
+// Vertex cache misses per triangle in a FIFO post-transform cache
+
+static float getACMR( const osg::DrawElementsUInt& indices, int cacheSize, int nrTriangles )
+{
+    const unsigned int restart = GridMeshBuilder::getRestartIndex( indices.getType() );
+    std::deque<unsigned int> cache;
+    int nrMisses = 0;
+
+    for ( unsigned int idx=0; idx<indices.size(); idx++ )
+    {
+	const unsigned int v = indices[idx];
+	if ( v==restart || std::find(cache.begin(),cache.end(),v)!=cache.end() )
+	    continue;
+
+	nrMisses++;
+	cache.push_back( v );
+	if ( (int)cache.size()>cacheSize )
+	    cache.pop_front();
+    }
+
+    return float(nrMisses) / nrTriangles;
+}
+
+
+static void testBlockSize()
+{
+    GridMeshBuilder builder( 10, 10 );
+    VSGGEO_CHECK( builder.getBlockSize()==14 );
+    builder.setVertexCacheSize( 10 );
+    VSGGEO_CHECK( builder.getBlockSize()==8 );
+    builder.setVertexCacheSize( 2 );
+    VSGGEO_CHECK( builder.getBlockSize()==1 );
+
+    VSGGEO_CHECK( GridMeshBuilder::getRestartIndex(osg::PrimitiveSet::DrawElementsUBytePrimitiveType)==0xff );
+    VSGGEO_CHECK( GridMeshBuilder::getRestartIndex(osg::PrimitiveSet::DrawElementsUShortPrimitiveType)==0xffff );
+    VSGGEO_CHECK( GridMeshBuilder::getRestartIndex(osg::PrimitiveSet::DrawElementsUIntPrimitiveType)==0xffffffff );
+}
+
+
+static void testZOrder()
+{
+    // 4x4 blocks of 2x2 quads
+    GridMeshBuilder builder( 9, 9 );
+    builder.setVertexCacheSize( 4 );
+    VSGGEO_CHECK( builder.nrBlocks()==16 );
+    if ( builder.nrBlocks()!=16 )
+	return;
+
+    const int zOrder[16][2] = { {0,0}, {1,0}, {0,1}, {1,1}, {2,0}, {3,0}, {2,1}, {3,1},
+				{0,2}, {1,2}, {0,3}, {1,3}, {2,2}, {3,2}, {2,3}, {3,3} };
+    bool inZOrder = true;
+    for ( int idx=0; idx<16; idx++ )
+    {
+	Vec2i first, last;
+	builder.getBlockQuads( idx, first, last );
+	inZOrder = inZOrder && first==Vec2i(2*zOrder[idx][0],2*zOrder[idx][1]) && last==first+Vec2i(1,1);
+    }
+    VSGGEO_CHECK( inZOrder );
+}
+
+
+static void testBlockCoverage()
+{
+    // Partial blocks at the right and top
+    const int nrCols = 12, nrRows = 7;
+    GridMeshBuilder builder( nrCols, nrRows );
+    builder.setVertexCacheSize( 6 );
+
+    std::vector<int> nrCovers( (nrCols-1)*(nrRows-1), 0 );
+    for ( int idx=0; idx<builder.nrBlocks(); idx++ )
+    {
+	Vec2i first, last;
+	builder.getBlockQuads( idx, first, last );
+	for ( int j=first.y(); j<=last.y(); j++ )
+	{
+	    for ( int i=first.x(); i<=last.x(); i++ )
+		nrCovers[j*(nrCols-1)+i]++;
+	}
+    }
+
+    VSGGEO_CHECK( std::count(nrCovers.begin(),nrCovers.end(),1)==(int)nrCovers.size() );
+}
+
+
+static void testStrips()
+{
+    const int nrCols = 23, nrRows = 18;
+    GridMeshBuilder builder( nrCols, nrRows );
+    builder.setVertexCacheSize( 8 );
+
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    builder.addStrips( *indices );
+
+    std::vector<Triangle> triangles, expected;
+    VSGGEO_CHECK( getTriangles(*indices,nrCols,triangles) );
+    getGridTriangles( nrCols, nrRows, 0, expected );
+    VSGGEO_CHECK( triangles==expected );
+}
+
+
+static void testDefinedMask()
+{
+    const int nrCols = 20, nrRows = 20;
+    std::vector<unsigned char> defined( nrCols*nrRows, 1 );
+    defined[5*nrCols+5] = 0;
+    defined[5*nrCols+6] = 0;
+    defined[12*nrCols+3] = 0;
+    for ( int i=0; i<nrCols; i++ )
+	defined[17*nrCols+i] = 0;
+
+    GridMeshBuilder builder( nrCols, nrRows );
+    builder.setDefinedMask( &defined[0] );
+
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    builder.addStrips( *indices );
+
+    std::vector<Triangle> triangles, expected;
+    VSGGEO_CHECK( getTriangles(*indices,nrCols,triangles) );
+    getGridTriangles( nrCols, nrRows, &defined[0], expected );
+    VSGGEO_CHECK( triangles==expected );
+
+    // Blocks concatenate in any order
+    osg::ref_ptr<osg::DrawElementsUInt> reversed = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    for ( int idx=builder.nrBlocks()-1; idx>=0; idx-- )
+	builder.addBlockStrips( idx, *reversed );
+
+    triangles.clear();
+    VSGGEO_CHECK( getTriangles(*reversed,nrCols,triangles) );
+    VSGGEO_CHECK( triangles==expected );
+}
+
+
+static void testVertexCacheReuse()
+{
+    const int nrCols = 65, nrRows = 65;
+    GridMeshBuilder builder( nrCols, nrRows );
+    builder.setVertexCacheSize( 16 );
+
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt( GL_TRIANGLE_STRIP );
+    builder.addStrips( *indices );
+
+    // Row by row strips load every vertex twice, about 1 miss per triangle
+    const int nrTriangles = 2*(nrCols-1)*(nrRows-1);
+    VSGGEO_CHECK( getACMR(*indices,16,nrTriangles) < 0.7f );
+}
+
+
+int main( int, char** )
+{
+    testBlockSize();
+    testZOrder();
+    testBlockCoverage();
+    testStrips();
+    testDefinedMask();
+    testVertexCacheReuse();
+
+    return nrFailedChecks;
+}
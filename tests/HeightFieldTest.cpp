@@ -0,0 +1,789 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/HeightField.h>
+
+#include <osgUtil/UpdateVisitor>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace vsgGeo;
+
+
+typedef float (*HeightFunc)(int col,int row);
+
+static float planeHeight( int col, int row )
+{ return 0.5f*col + 0.25f*row; }
+
+static float bumpyHeight( int col, int row )
+{ return std::sin( 0.7f*col ) * std::cos( 0.45f*row ) + 0.03f*col; }
+
+static float columnHeight( int col, int )
+{ return float( col ); }
+
+static float bowlHeight( int col, int row )
+{ return float( (col-8)*(col-8) + (row-8)*(row-8) ); }
+
+static float noisyHeight( int col, int row )
+{
+    const float value = std::sin( 12.9898f*col + 78.233f*row ) * 43758.5453f;
+    return value - std::floor( value );
+}
+
+
+static osg::ref_ptr<HeightField> createHeightField( int nrCols, int nrRows, HeightFunc func )
+{
+    osg::ref_ptr<osg::FloatArray> heights = new osg::FloatArray( nrRows*nrCols );
+    for ( int row=0; row<nrRows; row++ )
+    {
+	for ( int col=0; col<nrCols; col++ )
+	    (*heights)[row*nrCols+col] = func( col, row );
+    }
+
+    osg::ref_ptr<HeightField> hf = new HeightField;
+    hf->setChunkSize( 8 );
+    hf->setGridGeometry( osg::Vec2(0,0), osg::Vec2(1,1) );
+    hf->setHeightData( heights.get(), nrRows, nrCols );
+    return hf;
+}
+
+
+/* Interpolates the triangles at every grid node they cover. Returns the
+   largest deviation from the node heights, and false unless exactly the
+   defined nodes are covered. */
+
+static bool getMeshDeviation( const HeightField& hf, const osg::Vec3Array& vertices, const osg::DrawElementsUInt& triangles, float& maxDeviation )
+{
+    const osg::FloatArray& heights = *hf.getHeightData();
+    const int nrCols = hf.nrCols();
+    std::vector<bool> covered( heights.size(), false );
+    maxDeviation = 0.0f;
+
+    for ( unsigned int idx=0; idx+2<triangles.size(); idx+=3 )
+    {
+	const osg::Vec3& v0 = vertices[triangles[idx]];
+	const osg::Vec3& v1 = vertices[triangles[idx+1]];
+	const osg::Vec3& v2 = vertices[triangles[idx+2]];
+	const float area = (v1.x()-v0.x())*(v2.y()-v0.y()) - (v2.x()-v0.x())*(v1.y()-v0.y());
+	if ( std::fabs(area)<1e-6f )
+	    continue;
+
+	const int minCol = (int) std::floor( osg::minimum(v0.x(),osg::minimum(v1.x(),v2.x())) );
+	const int maxCol = (int) std::ceil( osg::maximum(v0.x(),osg::maximum(v1.x(),v2.x())) );
+	const int minRow = (int) std::floor( osg::minimum(v0.y(),osg::minimum(v1.y(),v2.y())) );
+	const int maxRow = (int) std::ceil( osg::maximum(v0.y(),osg::maximum(v1.y(),v2.y())) );
+
+	for ( int row=minRow; row<=maxRow; row++ )
+	{
+	    for ( int col=minCol; col<=maxCol; col++ )
+	    {
+		const float w1 = ((col-v0.x())*(v2.y()-v0.y()) - (v2.x()-v0.x())*(row-v0.y())) / area;
+		const float w2 = ((v1.x()-v0.x())*(row-v0.y()) - (col-v0.x())*(v1.y()-v0.y())) / area;
+		const float w0 = 1.0f - w1 - w2;
+		if ( w0<-1e-4f || w1<-1e-4f || w2<-1e-4f )
+		    continue;
+
+		const int node = row*nrCols + col;
+		covered[node] = true;
+		if ( heights[node]==hf.getUndefValue() )
+		    continue;
+
+		const float z = w0*v0.z() + w1*v1.z() + w2*v2.z();
+		maxDeviation = osg::maximum( maxDeviation, std::fabs(z-heights[node]) );
+	    }
+	}
+    }
+
+    for ( unsigned int node=0; node<covered.size(); node++ )
+    {
+	if ( covered[node] != (heights[node]!=hf.getUndefValue()) )
+	    return false;
+    }
+
+    return true;
+}
+
+
+// A vertex inside an edge of another triangle leaves a crack
+
+static bool hasTJunctions( const osg::Vec3Array& vertices, const osg::DrawElementsUInt& triangles )
+{
+    for ( unsigned int idx=0; idx+2<triangles.size(); idx+=3 )
+    {
+	for ( int edge=0; edge<3; edge++ )
+	{
+	    const osg::Vec3& p = vertices[triangles[idx+edge]];
+	    const osg::Vec3& q = vertices[triangles[idx+(edge+1)%3]];
+	    const osg::Vec2 dir( q.x()-p.x(), q.y()-p.y() );
+	    const float length2 = dir.length2();
+
+	    for ( unsigned int vidx=0; vidx<vertices.size(); vidx++ )
+	    {
+		const osg::Vec2 rel( vertices[vidx].x()-p.x(), vertices[vidx].y()-p.y() );
+		const float cross = dir.x()*rel.y() - dir.y()*rel.x();
+		const float dot = dir * rel;
+		if ( std::fabs(cross)<1e-4f && dot>1e-4f && dot<length2-1e-4f )
+		    return true;
+	    }
+	}
+    }
+
+    return false;
+}
+
+
+static void testDecimatedPlane()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, planeHeight );
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt;
+    VSGGEO_CHECK( hf->createDecimatedMesh(0.001f,*vertices,*triangles) );
+
+    // Two triangles per chunk
+    VSGGEO_CHECK( triangles->size()%3==0 );
+    VSGGEO_CHECK( triangles->size()<=2*4*3 );
+
+    float deviation;
+    VSGGEO_CHECK( getMeshDeviation(*hf,*vertices,*triangles,deviation) );
+    VSGGEO_CHECK( deviation<=0.001f );
+    VSGGEO_CHECK( !hasTJunctions(*vertices,*triangles) );
+}
+
+
+static void testFullResolution()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, noisyHeight );
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt;
+    VSGGEO_CHECK( hf->createDecimatedMesh(0.0f,*vertices,*triangles) );
+
+    // Shared chunk border vertices are merged
+    VSGGEO_CHECK( vertices->size()==17*17 );
+    VSGGEO_CHECK( triangles->size()==2*16*16*3 );
+}
+
+
+static void testErrorBound()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 33, 25, bumpyHeight );
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt;
+    const float tolerances[3] = { 0.05f, 0.2f, 0.8f };
+    unsigned int sizes[3];
+
+    for ( int idx=0; idx<3; idx++ )
+    {
+	VSGGEO_CHECK( hf->createDecimatedMesh(tolerances[idx],*vertices,*triangles) );
+
+	float deviation;
+	VSGGEO_CHECK( getMeshDeviation(*hf,*vertices,*triangles,deviation) );
+	VSGGEO_CHECK( deviation<=tolerances[idx]+1e-5f );
+	VSGGEO_CHECK( !hasTJunctions(*vertices,*triangles) );
+
+	sizes[idx] = triangles->size();
+    }
+
+    // Coarser with larger tolerance
+    VSGGEO_CHECK( sizes[0]<2*32*24*3 );
+    VSGGEO_CHECK( sizes[1]<=sizes[0] && sizes[2]<=sizes[1] && sizes[2]<sizes[0] );
+}
+
+
+static void testUndefinedNodes()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, planeHeight );
+    osg::FloatArray& heights = const_cast<osg::FloatArray&>( *hf->getHeightData() );
+    heights[5*17+6] = hf->getUndefValue();
+    hf->dirtyHeightData( Vec2i(6,5), Vec2i(6,5) );
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt;
+    VSGGEO_CHECK( hf->createDecimatedMesh(0.001f,*vertices,*triangles) );
+
+    bool hasUndefVertex = false;
+    for ( unsigned int idx=0; idx<vertices->size(); idx++ )
+	hasUndefVertex = hasUndefVertex || (*vertices)[idx].z()==hf->getUndefValue();
+    VSGGEO_CHECK( !hasUndefVertex );
+
+    // The plane must still be covered up to the hole
+    float deviation;
+    VSGGEO_CHECK( getMeshDeviation(*hf,*vertices,*triangles,deviation) );
+    VSGGEO_CHECK( deviation<=0.001f );
+}
+
+
+typedef std::vector<osg::ref_ptr<osg::PrimitiveSet> > PolyLines;
+
+static const osg::DrawArrays* getPolyLine( const PolyLines& polyLines, int idx )
+{ return dynamic_cast<const osg::DrawArrays*>( polyLines[idx].get() ); }
+
+
+static void testOpenContour()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, columnHeight );
+
+    std::vector<float> levels( 1, 4.5f );
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    PolyLines polyLines;
+    hf->createContours( levels, *vertices, polyLines );
+
+    // Pieces of both tile rows are chained into one line
+    VSGGEO_CHECK( polyLines.size()==1 );
+    if ( polyLines.size()!=1 )
+	return;
+
+    const osg::DrawArrays* line = getPolyLine( polyLines, 0 );
+    VSGGEO_CHECK( line && line->getMode()==osg::PrimitiveSet::LINE_STRIP );
+    VSGGEO_CHECK( line && line->getCount()==17 );
+
+    bool onLevel = true;
+    for ( unsigned int idx=0; idx<vertices->size(); idx++ )
+    {
+	const osg::Vec3& v = (*vertices)[idx];
+	onLevel = onLevel && std::fabs(v.x()-4.5f)<1e-5f && v.z()==4.5f;
+    }
+    VSGGEO_CHECK( onLevel );
+
+    const float firstY = vertices->front().y();
+    const float lastY = vertices->back().y();
+    VSGGEO_CHECK( osg::minimum(firstY,lastY)==0.0f && osg::maximum(firstY,lastY)==16.0f );
+}
+
+
+static void testClosedContour()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, bowlHeight );
+
+    std::vector<float> levels( 1, 20.5f );
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    PolyLines polyLines;
+    hf->createContours( levels, *vertices, polyLines );
+
+    // Crosses all four tiles, and repeats its first vertex
+    VSGGEO_CHECK( polyLines.size()==1 );
+    VSGGEO_CHECK( vertices->size()>4 );
+    VSGGEO_CHECK( !vertices->empty() && vertices->front()==vertices->back() );
+
+    // Every grid edge crossing is visited once
+    std::vector<osg::Vec3> points( vertices->begin(), vertices->end()-1 );
+    std::sort( points.begin(), points.end() );
+    VSGGEO_CHECK( std::unique(points.begin(),points.end())==points.end() );
+}
+
+
+static void testContourLevelsAndHoles()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, columnHeight );
+    osg::FloatArray& heights = const_cast<osg::FloatArray&>( *hf->getHeightData() );
+    heights[8*17+4] = hf->getUndefValue();
+    hf->dirtyHeightData( Vec2i(4,8), Vec2i(4,8) );
+
+    std::vector<float> levels;
+    levels.push_back( 10.5f );
+    levels.push_back( 4.5f );
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    PolyLines polyLines;
+    std::vector<int> levelIdxs;
+    hf->createContours( levels, *vertices, polyLines, &levelIdxs );
+
+    // The hole cuts the line at 4.5 in two
+    VSGGEO_CHECK( polyLines.size()==3 && levelIdxs.size()==3 );
+    if ( polyLines.size()!=3 || levelIdxs.size()!=3 )
+	return;
+
+    int nrCut = 0;
+    for ( int idx=0; idx<3; idx++ )
+    {
+	const osg::DrawArrays* line = getPolyLine( polyLines, idx );
+	const float z = (*vertices)[line->getFirst()].z();
+	VSGGEO_CHECK( z==levels[levelIdxs[idx]] );
+	if ( z==4.5f )
+	{
+	    nrCut++;
+	    VSGGEO_CHECK( line->getCount()==8 );
+	}
+    }
+    VSGGEO_CHECK( nrCut==2 );
+
+    // Edited tiles are redone for the same levels
+    for ( int row=0; row<17; row++ )
+    {
+	for ( int col=0; col<17; col++ )
+	    heights[row*17+col] = col - 1.0f;
+    }
+    hf->dirtyHeightData();
+    hf->createContours( levels, *vertices, polyLines, &levelIdxs );
+
+    VSGGEO_CHECK( polyLines.size()==2 );
+    bool shifted = true;
+    for ( unsigned int idx=0; idx<vertices->size(); idx++ )
+    {
+	const osg::Vec3& v = (*vertices)[idx];
+	shifted = shifted && std::fabs(v.x()-v.z()-1.0f)<1e-5f;
+    }
+    VSGGEO_CHECK( shifted );
+}
+
+
+// Exposes the packing of the chunk height attributes
+
+class PackingHeightField : public HeightField
+{
+public:
+    using HeightField::createHeightArray;
+};
+
+
+static float halfToFloat( unsigned short half )
+{
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    const float sign = (half & 0x8000) ? -1.0f : 1.0f;
+    if ( exponent==31 )
+	return sign * HUGE_VALF;
+    if ( !exponent )
+	return sign * std::ldexp( float(mantissa), -24 );
+
+    return sign * std::ldexp( float(mantissa+1024), exponent-25 );
+}
+
+
+static void testHalfFloatPacking()
+{
+    osg::ref_ptr<PackingHeightField> hf = new PackingHeightField;
+    hf->setHeightFormat( HeightField::HalfFloatHeights );
+
+    std::vector<float> heights;
+    heights.push_back( 100.0f );		// Lowest, packed as 0
+    heights.push_back( 101.0f );
+    heights.push_back( 100.5f );
+    heights.push_back( 100.0f + 65504.0f );	// Largest half float
+    heights.push_back( 1e7f );			// Overflow
+    heights.push_back( hf->getUndefValue() );
+    heights.push_back( 100.0f + 1234.567f );
+
+    float offset, scale, undef;
+    osg::ref_ptr<osg::Array> array = hf->createHeightArray( heights, offset, scale, undef );
+    VSGGEO_CHECK( array.valid() && array->getNumElements()==heights.size() );
+    VSGGEO_CHECK( array.valid() && array->getDataType()==GL_HALF_FLOAT );
+    VSGGEO_CHECK( offset==100.0f && scale==1.0f );
+    if ( !array.valid() || array->getNumElements()!=heights.size() )
+	return;
+
+    const unsigned short* halves = static_cast<const unsigned short*>( array->getDataPointer() );
+    VSGGEO_CHECK( halves[0]==0x0000 );
+    VSGGEO_CHECK( halves[1]==0x3c00 );
+    VSGGEO_CHECK( halves[2]==0x3800 );
+    VSGGEO_CHECK( halves[3]==0x7bff );
+    VSGGEO_CHECK( halves[4]==0x7c00 );
+    VSGGEO_CHECK( halves[5]==0x7e00 );	// NaN, discarded by the shaders
+    VSGGEO_CHECK( undef<0.0f );
+
+    // Rounded to 11 significant bits
+    const float value = halfToFloat( halves[6] );
+    VSGGEO_CHECK( std::fabs(value-1234.567f) <= std::ldexp(1234.567f,-11) );
+}
+
+
+static void test16BitPacking()
+{
+    osg::ref_ptr<PackingHeightField> hf = new PackingHeightField;
+    hf->setHeightFormat( HeightField::QuantizedHeights );
+
+    std::vector<float> heights;
+    for ( int idx=0; idx<100; idx++ )
+	heights.push_back( -250.0f + 3.7f*idx );
+    heights[17] = hf->getUndefValue();
+
+    float offset, scale, undef;
+    osg::ref_ptr<osg::Array> array = hf->createHeightArray( heights, offset, scale, undef );
+    const osg::UShortArray* values = dynamic_cast<const osg::UShortArray*>( array.get() );
+    VSGGEO_CHECK( values && values->getNormalize() );
+    VSGGEO_CHECK( offset==-250.0f );
+    VSGGEO_CHECK( std::fabs(scale-3.7f*99*65535.0f/65534.0f)<1e-3f );
+    if ( !values || values->size()!=heights.size() )
+	return;
+
+    // The maximum stays below the reserved undefined value
+    VSGGEO_CHECK( (*values)[0]==0 && (*values)[99]==65534 );
+    VSGGEO_CHECK( (*values)[17]==HeightField::quantizedUndefValue() );
+    VSGGEO_CHECK( undef==(*values)[17]/65535.0f );
+
+    float maxError = 0.0f;
+    for ( unsigned int idx=0; idx<heights.size(); idx++ )
+    {
+	if ( idx==17 )
+	    continue;
+
+	const float height = offset + scale*(*values)[idx]/65535.0f;
+	maxError = osg::maximum( maxError, std::fabs(height-heights[idx]) );
+    }
+    VSGGEO_CHECK( maxError <= 0.5f*scale/65535.0f + 1e-4f );
+}
+
+
+static void testFloatPacking()
+{
+    osg::ref_ptr<PackingHeightField> hf = new PackingHeightField;
+    hf->setHeightFormat( HeightField::FloatHeights );
+
+    std::vector<float> heights;
+    heights.push_back( 12.5f );
+    heights.push_back( hf->getUndefValue() );
+
+    float offset, scale, undef;
+    osg::ref_ptr<osg::Array> array = hf->createHeightArray( heights, offset, scale, undef );
+    const osg::FloatArray* values = dynamic_cast<const osg::FloatArray*>( array.get() );
+    VSGGEO_CHECK( offset==0.0f && scale==1.0f );
+    VSGGEO_CHECK( values && values->size()==2 && (*values)[0]==12.5f );
+    VSGGEO_CHECK( values && values->size()==2 && (*values)[1]==undef );
+}
+
+
+static void testQuantizedHeights()
+{
+    osg::ref_ptr<osg::FloatArray> heights = new osg::FloatArray;
+    for ( int idx=0; idx<1000; idx++ )
+	heights->push_back( 1500.0f + 0.731f*idx );
+    (*heights)[10] = 1e30f;
+    (*heights)[20] = std::numeric_limits<float>::quiet_NaN();
+
+    osg::ref_ptr<osg::UShortArray> quantized = new osg::UShortArray;
+    float offset, scale;
+    VSGGEO_CHECK( HeightField::quantizeHeights(*heights,1e30f,*quantized,offset,scale) );
+    VSGGEO_CHECK( quantized->size()==heights->size() );
+    if ( quantized->size()!=heights->size() )
+	return;
+
+    // The defined range spans all codes below the undef code
+    VSGGEO_CHECK( offset==1500.0f );
+    VSGGEO_CHECK( (*quantized)[0]==0 && (*quantized)[999]==HeightField::quantizedUndefValue()-1 );
+    VSGGEO_CHECK( (*quantized)[10]==HeightField::quantizedUndefValue() );
+    VSGGEO_CHECK( (*quantized)[20]==HeightField::quantizedUndefValue() );
+
+    float maxError = 0.0f;
+    for ( unsigned int idx=0; idx<heights->size(); idx++ )
+    {
+	if ( idx==10 || idx==20 )
+	    continue;
+
+	const float height = offset + scale*(*quantized)[idx];
+	maxError = osg::maximum( maxError, std::fabs(height-(*heights)[idx]) );
+    }
+    VSGGEO_CHECK( maxError <= 0.5f*scale + 1e-3f );
+
+    // Nothing defined
+    osg::ref_ptr<osg::FloatArray> undefined = new osg::FloatArray;
+    undefined->assign( 4, 1e30f );
+    VSGGEO_CHECK( !HeightField::quantizeHeights(*undefined,1e30f,*quantized,offset,scale) );
+    VSGGEO_CHECK( quantized->size()==4 && (*quantized)[0]==HeightField::quantizedUndefValue() );
+
+    // Flat
+    osg::ref_ptr<osg::FloatArray> flat = new osg::FloatArray;
+    flat->assign( 4, 7.0f );
+    VSGGEO_CHECK( HeightField::quantizeHeights(*flat,1e30f,*quantized,offset,scale) );
+    VSGGEO_CHECK( offset==7.0f && (*quantized)[3]==0 );
+}
+
+
+static void testQuantizedHeightField()
+{
+    osg::ref_ptr<HeightField> floatHf = createHeightField( 17, 17, bowlHeight );
+    osg::FloatArray& heights = const_cast<osg::FloatArray&>( *floatHf->getHeightData() );
+    heights[3*17+3] = floatHf->getUndefValue();
+    floatHf->dirtyHeightData();
+
+    osg::ref_ptr<osg::UShortArray> quantized = new osg::UShortArray;
+    float offset, scale;
+    HeightField::quantizeHeights( heights, floatHf->getUndefValue(), *quantized, offset, scale );
+
+    osg::ref_ptr<HeightField> hf = new HeightField;
+    hf->setChunkSize( 8 );
+    hf->setGridGeometry( osg::Vec2(0,0), osg::Vec2(1,1) );
+    hf->setQuantizedHeightData( quantized.get(), 17, 17, offset, scale );
+    VSGGEO_CHECK( !hf->getHeightData() && hf->getQuantizedHeightData()==quantized.get() );
+
+    float min, max;
+    VSGGEO_CHECK( hf->getHeightRange(min,max) );
+    VSGGEO_CHECK( std::fabs(min)<=scale && std::fabs(max-128.0f)<=scale );
+
+    // Decoded heights at the grid nodes, without the undefined one
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt;
+    VSGGEO_CHECK( hf->createDecimatedMesh(0.0f,*vertices,*triangles) );
+    VSGGEO_CHECK( vertices->size()==17*17-1 );
+
+    float maxError = 0.0f;
+    for ( unsigned int idx=0; idx<vertices->size(); idx++ )
+    {
+	const osg::Vec3& v = (*vertices)[idx];
+	maxError = osg::maximum( maxError, std::fabs(v.z()-bowlHeight(int(v.x()),int(v.y()))) );
+    }
+    VSGGEO_CHECK( maxError <= 0.5f*scale + 1e-4f );
+
+    std::vector<float> levels( 1, 20.5f );
+    PolyLines polyLines;
+    hf->createContours( levels, *vertices, polyLines );
+    VSGGEO_CHECK( polyLines.size()==1 );
+
+    // Float data replaces the quantized data
+    hf->setHeightData( &heights, 17, 17 );
+    VSGGEO_CHECK( hf->getHeightData()==&heights && !hf->getQuantizedHeightData() );
+}
+
+
+// Builds the quadtree, and the pick pyramid
+
+static void update( HeightField& hf )
+{
+    osg::ref_ptr<osgUtil::UpdateVisitor> uv = new osgUtil::UpdateVisitor;
+    hf.accept( *uv );
+}
+
+
+class QuadTreeHeightField : public HeightField
+{
+public:
+    using HeightField::nrLevels;
+    using HeightField::getChunkSpan;
+    using HeightField::getChunkIdx;
+};
+
+
+static void testChunkSize()
+{
+    osg::ref_ptr<HeightField> hf = new HeightField;
+    hf->setChunkSize( 5 );
+    VSGGEO_CHECK( hf->getChunkSize()==8 );
+    hf->setChunkSize( 100 );
+    VSGGEO_CHECK( hf->getChunkSize()==64 );
+    hf->setChunkSize( 1000 );
+    VSGGEO_CHECK( hf->getChunkSize()==128 );
+}
+
+
+static void testQuadTree()
+{
+    osg::ref_ptr<osg::FloatArray> heights = new osg::FloatArray( 17*33 );
+    for ( int row=0; row<17; row++ )
+    {
+	for ( int col=0; col<33; col++ )
+	    (*heights)[row*33+col] = bowlHeight( col, row );
+    }
+
+    osg::ref_ptr<QuadTreeHeightField> hf = new QuadTreeHeightField;
+    hf->setChunkSize( 8 );
+    hf->setGridGeometry( osg::Vec2(0,0), osg::Vec2(1,1) );
+    hf->setHeightData( heights.get(), 17, 33 );
+    update( *hf );
+
+    // Chunks of 4x2, 2x1 and a root, sharing their border nodes
+    VSGGEO_CHECK( hf->nrLevels()==3 );
+    VSGGEO_CHECK( hf->getChunkSpan(0)==8 && hf->getChunkSpan(2)==32 );
+    VSGGEO_CHECK( hf->getChunkIdx(1,0,0)==8 );
+    VSGGEO_CHECK( hf->getChunkIdx(2,0,0)==10 );
+
+    float min, max;
+    VSGGEO_CHECK( hf->getHeightRange(min,max) );
+    VSGGEO_CHECK( min==0.0f && max==bowlHeight(32,16) );
+
+    // In-place edits refit the chunks above them
+    (*heights)[16*33+20] = 1000.0f;
+    hf->dirtyHeightData( Vec2i(20,16), Vec2i(20,16) );
+    update( *hf );
+    VSGGEO_CHECK( hf->getHeightRange(min,max) );
+    VSGGEO_CHECK( max==1000.0f );
+    VSGGEO_CHECK( hf->getBound().contains(osg::Vec3(20.0f,16.0f,1000.0f)) );
+}
+
+
+static osg::Vec3 getPackedNormal( const osg::Image& image, int col, int row )
+{
+    const unsigned char* rgb = image.data( col, row );
+    return osg::Vec3( rgb[0]/127.5f-1.0f, rgb[1]/127.5f-1.0f, rgb[2]/127.5f-1.0f );
+}
+
+
+static void testNormalMap()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 9, planeHeight );
+    osg::FloatArray& heights = const_cast<osg::FloatArray&>( *hf->getHeightData() );
+    heights[4*17+6] = hf->getUndefValue();
+
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    VSGGEO_CHECK( hf->computeNormalMap(*image) );
+    VSGGEO_CHECK( image->s()==17 && image->t()==9 );
+    VSGGEO_CHECK( image->getPixelFormat()==GL_RGB );
+
+    // One-sided differences at borders and holes are exact for a plane
+    osg::Vec3 expected( -0.5f, -0.25f, 1.0f );
+    expected.normalize();
+
+    float maxError = 0.0f;
+    for ( int row=0; row<9; row++ )
+    {
+	for ( int col=0; col<17; col++ )
+	{
+	    if ( col!=6 || row!=4 )
+		maxError = osg::maximum( maxError, (getPackedNormal(*image,col,row)-expected).length() );
+	}
+    }
+    VSGGEO_CHECK( maxError<0.02f );
+
+    // Upward at the undefined node
+    const osg::Vec3 up = getPackedNormal( *image, 6, 4 );
+    VSGGEO_CHECK( (up-osg::Vec3(0.0f,0.0f,1.0f)).length()<0.02f );
+}
+
+
+static void testPartialNormalMap()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 9, columnHeight );
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    VSGGEO_CHECK( hf->computeNormalMap(*image) );
+
+    // Only the nodes in the rectangle, stop inclusive, are recomputed
+    std::fill( image->data(), image->data()+image->getTotalSizeInBytes(), 0 );
+    VSGGEO_CHECK( hf->computeNormalMap(*image,Vec2i(2,3),Vec2i(4,5)) );
+
+    osg::Vec3 expected( -1.0f, 0.0f, 1.0f );
+    expected.normalize();
+
+    for ( int row=0; row<9; row++ )
+    {
+	for ( int col=0; col<17; col++ )
+	{
+	    const unsigned char* rgb = image->data( col, row );
+	    if ( col>=2 && col<=4 && row>=3 && row<=5 )
+	    {
+		VSGGEO_CHECK( (getPackedNormal(*image,col,row)-expected).length()<0.02f );
+	    }
+	    else
+	    {
+		VSGGEO_CHECK( !rgb[0] && !rgb[1] && !rgb[2] );
+	    }
+	}
+    }
+}
+
+
+static void testVerticalPick()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, planeHeight );
+    update( *hf );
+
+    float ratio;
+    osg::Vec3 normal;
+    VSGGEO_CHECK( hf->intersectRay(osg::Vec3(4.5f,6.5f,100.0f),osg::Vec3(4.5f,6.5f,-100.0f),ratio,&normal) );
+    const float height = 0.5f*4.5f + 0.25f*6.5f;
+    VSGGEO_CHECK( std::fabs(ratio-(100.0f-height)/200.0f)<1e-4f );
+
+    osg::Vec3 expected( -0.5f, -0.25f, 1.0f );
+    expected.normalize();
+    VSGGEO_CHECK( (normal-expected).length()<1e-4f );
+
+    // Outside the grid, or above all heights
+    VSGGEO_CHECK( !hf->intersectRay(osg::Vec3(-5.0f,6.5f,100.0f),osg::Vec3(-5.0f,6.5f,-100.0f),ratio) );
+    VSGGEO_CHECK( !hf->intersectRay(osg::Vec3(0.0f,0.0f,100.0f),osg::Vec3(16.0f,16.0f,100.0f),ratio) );
+
+    // Nor does a segment that stops short of the surface
+    VSGGEO_CHECK( !hf->intersectRay(osg::Vec3(4.5f,6.5f,100.0f),osg::Vec3(4.5f,6.5f,50.0f),ratio) );
+}
+
+
+static void testUndefinedPick()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 17, 17, planeHeight );
+    osg::FloatArray& heights = const_cast<osg::FloatArray&>( *hf->getHeightData() );
+    heights[3*17+3] = hf->getUndefValue();
+    hf->dirtyHeightData( Vec2i(3,3), Vec2i(3,3) );
+    update( *hf );
+
+    // Both triangles of the cell at the undefined node are not drawn
+    float ratio;
+    VSGGEO_CHECK( !hf->intersectRay(osg::Vec3(3.2f,3.7f,100.0f),osg::Vec3(3.2f,3.7f,-100.0f),ratio) );
+    VSGGEO_CHECK( !hf->intersectRay(osg::Vec3(3.7f,3.2f,100.0f),osg::Vec3(3.7f,3.2f,-100.0f),ratio) );
+    VSGGEO_CHECK( hf->intersectRay(osg::Vec3(5.5f,5.5f,100.0f),osg::Vec3(5.5f,5.5f,-100.0f),ratio) );
+}
+
+
+static void testParallelPicks()
+{
+    osg::ref_ptr<HeightField> hf = createHeightField( 33, 33, bumpyHeight );
+    update( *hf );
+
+    // Slanted rays, some of which leave the grid before hitting
+    osg::ref_ptr<osg::Vec3Array> starts = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> ends = new osg::Vec3Array;
+    for ( int idx=0; idx<64; idx++ )
+    {
+	starts->push_back( osg::Vec3(0.5f*idx-4.0f,0.3f*idx,5.0f) );
+	ends->push_back( osg::Vec3(40.0f-0.4f*idx,32.0f-0.5f*idx,-5.0f) );
+    }
+
+    std::vector<float> ratios;
+    hf->intersectRays( *starts, *ends, ratios );
+    VSGGEO_CHECK( ratios.size()==starts->size() );
+
+    int nrHits = 0;
+    for ( unsigned int idx=0; idx<ratios.size(); idx++ )
+    {
+	float ratio;
+	if ( !hf->intersectRay((*starts)[idx],(*ends)[idx],ratio) )
+	    ratio = -1.0f;
+	else
+	    nrHits++;
+
+	VSGGEO_CHECK( ratios[idx]==ratio );
+    }
+
+    VSGGEO_CHECK( nrHits>0 );
+}
+
+
+int main( int, char** )
+{
+    testDecimatedPlane();
+    testFullResolution();
+    testErrorBound();
+    testUndefinedNodes();
+    testOpenContour();
+    testClosedContour();
+    testContourLevelsAndHoles();
+    testHalfFloatPacking();
+    test16BitPacking();
+    testFloatPacking();
+    testQuantizedHeights();
+    testQuantizedHeightField();
+    testChunkSize();
+    testQuadTree();
+    testNormalMap();
+    testPartialNormalMap();
+    testVerticalPick();
+    testUndefinedPick();
+    testParallelPicks();
+
+    return nrFailedChecks;
+}
@@ -0,0 +1,145 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/HeightTileSource.h>
+
+#include <cstdio>
+#include <fstream>
+
+using namespace vsgGeo;
+
+
+#define NR_ROWS		5
+#define NR_COLS		20
+#define HEADER_BYTES	8
+
+static const char* sFileName = "HeightTileSourceTest.raw";
+
+
+// Node (col,row) has height 100*row+col, after a header of garbage
+
+static bool writeGrid( int nrRows )
+{
+    std::ofstream file( sFileName, std::ios::out | std::ios::binary );
+    const char header[HEADER_BYTES] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    file.write( header, HEADER_BYTES );
+
+    for ( int row=0; row<nrRows; row++ )
+    {
+	for ( int col=0; col<NR_COLS; col++ )
+	{
+	    const float height = 100.0f*row + col;
+	    file.write( (const char*) &height, sizeof(float) );
+	}
+    }
+
+    return file.good();
+}
+
+
+static float expectedHeight( int col, int row )
+{
+    col = osg::clampBetween( col, 0, NR_COLS-1 );
+    row = osg::clampBetween( row, 0, NR_ROWS-1 );
+    return 100.0f*row + col;
+}
+
+
+static bool checkTile( const HeightTileSource& source, const Vec2i& firstNode, int step, const Vec2i& size )
+{
+    std::vector<float> heights;
+    if ( !source.readTile(firstNode,step,size,heights) )
+	return false;
+    if ( (int) heights.size()!=size.x()*size.y() )
+	return false;
+
+    for ( int j=0; j<size.y(); j++ )
+    {
+	for ( int i=0; i<size.x(); i++ )
+	{
+	    const float expected = expectedHeight( firstNode.x()+i*step, firstNode.y()+j*step );
+	    if ( heights[j*size.x()+i]!=expected )
+		return false;
+	}
+    }
+
+    return true;
+}
+
+
+static void testTileReads()
+{
+    VSGGEO_CHECK( writeGrid(NR_ROWS) );
+    osg::ref_ptr<RawHeightFileSource> source = new RawHeightFileSource( sFileName, NR_ROWS, NR_COLS, HEADER_BYTES );
+    VSGGEO_CHECK( source->nrRows()==NR_ROWS );
+    VSGGEO_CHECK( source->nrCols()==NR_COLS );
+
+    // Contiguous row segments
+    VSGGEO_CHECK( checkTile(*source,Vec2i(0,0),1,Vec2i(NR_COLS,NR_ROWS)) );
+    VSGGEO_CHECK( checkTile(*source,Vec2i(3,1),2,Vec2i(4,2)) );
+
+    // Node by node at steps beyond the segment limit
+    VSGGEO_CHECK( checkTile(*source,Vec2i(1,0),9,Vec2i(3,1)) );
+    VSGGEO_CHECK( checkTile(*source,Vec2i(0,0),19,Vec2i(2,1)) );
+}
+
+
+static void testClamping()
+{
+    VSGGEO_CHECK( writeGrid(NR_ROWS) );
+    osg::ref_ptr<RawHeightFileSource> source = new RawHeightFileSource( sFileName, NR_ROWS, NR_COLS, HEADER_BYTES );
+
+    // Tiles at the grid border repeat its last nodes
+    VSGGEO_CHECK( checkTile(*source,Vec2i(16,3),1,Vec2i(8,4)) );
+    VSGGEO_CHECK( checkTile(*source,Vec2i(-2,-1),1,Vec2i(4,3)) );
+    VSGGEO_CHECK( checkTile(*source,Vec2i(10,2),16,Vec2i(3,3)) );
+}
+
+
+static void testReadErrors()
+{
+    std::vector<float> heights;
+
+    std::remove( sFileName );
+    osg::ref_ptr<RawHeightFileSource> source = new RawHeightFileSource( sFileName, NR_ROWS, NR_COLS, HEADER_BYTES );
+    VSGGEO_CHECK( !source->readTile(Vec2i(0,0),1,Vec2i(2,2),heights) );
+
+    // File shorter than its declared grid
+    VSGGEO_CHECK( writeGrid(NR_ROWS-2) );
+    VSGGEO_CHECK( source->readTile(Vec2i(0,0),1,Vec2i(NR_COLS,NR_ROWS-2),heights) );
+    VSGGEO_CHECK( !source->readTile(Vec2i(0,0),1,Vec2i(NR_COLS,NR_ROWS),heights) );
+
+    VSGGEO_CHECK( !source->readTile(Vec2i(0,0),0,Vec2i(2,2),heights) );
+    VSGGEO_CHECK( !source->readTile(Vec2i(0,0),1,Vec2i(0,2),heights) );
+
+    osg::ref_ptr<RawHeightFileSource> empty = new RawHeightFileSource( sFileName, 0, NR_COLS );
+    VSGGEO_CHECK( !empty->readTile(Vec2i(0,0),1,Vec2i(2,2),heights) );
+}
+
+
+int main( int, char** )
+{
+    testTileReads();
+    testClamping();
+    testReadErrors();
+
+    std::remove( sFileName );
+    return nrFailedChecks;
+}
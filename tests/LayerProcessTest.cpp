@@ -0,0 +1,86 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/LayeredTexture.h>
+#include <vsgGeo/LayerProcess.h>
+
+#include <cmath>
+
+using namespace vsgGeo;
+
+
+static void testOneChannelColTabFootprint()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    texture->enableMipmapping( true );
+
+    const int id = texture->addDataLayer();
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage( 8, 8, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    for ( int t=0; t<8; t++ )
+    {
+	for ( int s=0; s<8; s++ )
+	    *image->data(s,t) = (unsigned char) (s*36 + t);
+    }
+    texture->setDataLayerImage( id, image.get() );
+    texture->setDataLayerFilterType( id, Linear );
+
+    // Red channel of the color table equals the color index
+    unsigned char rgba[256*4];
+    for ( int idx=0; idx<256; idx++ )
+    {
+	rgba[4*idx] = idx;
+	rgba[4*idx+1] = 0;
+	rgba[4*idx+2] = 0;
+	rgba[4*idx+3] = 255;
+    }
+    osg::ref_ptr<ColorSequence> colorSequence = new ColorSequence( rgba );
+
+    ColTabLayerProcess* process = new ColTabLayerProcess( *texture );
+    process->setDataLayerID( 0, id );
+    process->setColorSequence( colorSequence.get() );
+    texture->addProcess( process );
+    texture->updateColorScaleSpaces();
+
+    // Footprint of several texels would average the color indices
+    const osg::Vec2f coord( 3.3f, 4.6f );
+    const TexelFootprint footprint( osg::Vec2f(4.0f,0.0f), osg::Vec2f(0.0f,4.0f) );
+    VSGGEO_CHECK( texture->getDataLayerMipLevel(id,footprint)>0.0f );
+
+    osg::Vec4f color( 0.0f, 0.0f, 0.0f, 0.0f );
+    osg::Vec4f footprintColor( 0.0f, 0.0f, 0.0f, 0.0f );
+    process->doProcess( color, 0.0f, coord );
+    process->doProcess( footprintColor, 0.0f, coord, &footprint );
+
+    // Nearest color of the table, as without footprint
+    VSGGEO_CHECK( footprintColor==color );
+    const float red = 255.0f*footprintColor.r();
+    VSGGEO_CHECK( std::fabs(red-floor(red+0.5f))<1e-3f );
+
+    texture->removeProcess( process );
+}
+
+
+int main( int, char** )
+{
+    testOneChannelColTabFootprint();
+
+    return nrFailedChecks;
+}
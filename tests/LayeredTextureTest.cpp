@@ -0,0 +1,218 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/LayeredTexture.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace vsgGeo;
+
+
+static bool isEqual( const osg::Vec2f& v1, const osg::Vec2f& v2 )
+{ return (v1-v2).length() < 1e-5f; }
+
+
+static int addLayer( LayeredTexture& texture, int size, const osg::Vec2f& origin, const osg::Vec2f& scale )
+{
+    const int id = texture.addDataLayer();
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage( size, size, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    texture.setDataLayerImage( id, image.get() );
+    texture.setDataLayerOrigin( id, origin );
+    texture.setDataLayerScale( id, scale );
+    return id;
+}
+
+
+// Non-power-of-2 float image of 5x3 with the given value per column
+
+static osg::ref_ptr<osg::Image> createColumnImage( const float* colValues )
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage( 5, 3, 1, GL_LUMINANCE, GL_FLOAT );
+    for ( int t=0; t<3; t++ )
+    {
+	for ( int s=0; s<5; s++ )
+	    ((float*) image->data(0,t))[s] = colValues[s];
+    }
+
+    return image;
+}
+
+
+static void testRescaledImages()
+{
+    const RescaleFilter filters[3] = { Box, Bilinear, Lanczos };
+    const float constant[5] = { 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    const float ramp[5] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f };
+
+    for ( int idx=0; idx<3; idx++ )
+    {
+	osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+	texture->setRescaleFilter( filters[idx] );
+	VSGGEO_CHECK( texture->getRescaleFilter()==filters[idx] );
+
+	const int id = texture->addDataLayer();
+	texture->setDataLayerFilterType( id, Nearest );
+	osg::ref_ptr<osg::Image> image = createColumnImage( constant );
+	texture->setDataLayerImage( id, image.get() );
+	VSGGEO_CHECK( texture->getDataLayerImage(id)==image.get() );
+
+	// Normalized kernels keep constant images constant
+	for ( float s=0.25f; s<5.0f; s+=0.5f )
+	{
+	    const osg::Vec4f col = texture->getDataLayerTextureVec( id, osg::Vec2f(s,1.5f) );
+	    VSGGEO_CHECK( fabs(col[0]-0.25f)<1e-5f );
+	}
+
+	if ( filters[idx]==Lanczos )
+	    continue;
+
+	// Without ringing, ramps stay monotonic within the source range
+	image = createColumnImage( ramp );
+	texture->setDataLayerImage( id, image.get() );
+
+	float prev = 0.0f;
+	for ( float s=0.25f; s<5.0f; s+=0.5f )
+	{
+	    const float val = texture->getDataLayerTextureVec( id, osg::Vec2f(s,1.5f) )[0];
+	    VSGGEO_CHECK( val>=prev-1e-5f && val<=4.0f+1e-5f );
+	    prev = val;
+	}
+	VSGGEO_CHECK( prev>2.0f );
+    }
+}
+
+
+static void testDataLayerCoords()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    const int id0 = addLayer( *texture, 8, osg::Vec2f(0,0), osg::Vec2f(1,1) );
+    const int id1 = addLayer( *texture, 4, osg::Vec2f(2,4), osg::Vec2f(2,0.5) );
+
+    // Composite coords of shared bricks are computed from global coords
+    VSGGEO_CHECK( isEqual(texture->getDataLayerCoord(id0,osg::Vec2f(3,5)),osg::Vec2f(3,5)) );
+    VSGGEO_CHECK( isEqual(texture->getDataLayerCoord(id1,osg::Vec2f(6,5)),osg::Vec2f(2,2)) );
+
+    // Consistent with transforming between layers
+    osg::Vec2f local( 6, 5 );
+    texture->transformDataLayerCoord( local, id0, id1 );
+    VSGGEO_CHECK( isEqual(local,texture->getDataLayerCoord(id1,osg::Vec2f(6,5))) );
+
+    // Unknown layers leave the coord as is
+    VSGGEO_CHECK( isEqual(texture->getDataLayerCoord(-1,osg::Vec2f(6,5)),osg::Vec2f(6,5)) );
+}
+
+
+static void testSharedBrickGeometry()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    texture->useSharedBrickGeometry( true );
+
+    // Needs shaders, otherwise bricks keep geometries of their own
+    texture->allowShaders( false );
+    VSGGEO_CHECK( !texture->isSharedBrickGeometryUsed() );
+}
+
+
+static void testCopyOnWriteClones()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    const int id = addLayer( *texture, 8, osg::Vec2f(0,0), osg::Vec2f(1,1) );
+    const osg::Image* image = texture->getDataLayerImage( id );
+
+    // Cloning only reads the original, so clones may be made concurrently
+    const LayeredTexture& original = *texture;
+    osg::ref_ptr<LayeredTexture> clone1 = new LayeredTexture( original );
+    osg::ref_ptr<LayeredTexture> clone2 = new LayeredTexture( original );
+    VSGGEO_CHECK( clone1->getDataLayerImage(id)==image );
+    VSGGEO_CHECK( clone2->getDataLayerImage(id)==image );
+
+    osg::ref_ptr<osg::Image> newImage = new osg::Image;
+    newImage->allocateImage( 4, 4, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    clone1->setDataLayerImage( id, newImage.get() );
+    VSGGEO_CHECK( clone1->getDataLayerImage(id)==newImage.get() );
+    VSGGEO_CHECK( clone2->getDataLayerImage(id)==image );
+    VSGGEO_CHECK( texture->getDataLayerImage(id)==image );
+}
+
+
+static void testBorderedComposite()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    addLayer( *texture, 8, osg::Vec2f(0,0), osg::Vec2f(1,1) );
+    texture->setDataLayerBorderColor( texture->compositeLayerId(), osg::Vec4f(1.0f,0.0f,0.5f,1.0f) );
+
+    const osg::Image* composite = texture->getCompositeTextureImage();
+    VSGGEO_CHECK( composite );
+    if ( !composite )
+	return;
+
+    // Border color as written, after compositing may have changed it
+    const osg::Vec4f& borderColor = texture->getDataLayerBorderColor( texture->compositeLayerId() );
+    unsigned char borderPixel[4];
+    for ( int channel=0; channel<=3; channel++ )
+    {
+	const float val = floor( 255.0f*borderColor[channel] + 0.5f );
+	borderPixel[channel] = (unsigned char) (val<=0.0f ? 0.0f : (val>=255.0f ? 255.0f : val));
+    }
+
+    const Vec2i border0( 2, 1 );
+    const Vec2i border1( 3, 2 );
+    const int sSize = border0.x() + composite->s() + border1.x();
+    const int tSize = border0.y() + composite->t() + border1.y();
+    std::vector<unsigned char> buffer( sSize*tSize*4, 7 );
+    VSGGEO_CHECK( texture->writeCompositeTextureImage(&buffer[0],border0,border1) );
+
+    bool interiorOk = true;
+    bool borderOk = true;
+    for ( int t=0; t<tSize; t++ )
+    {
+	for ( int s=0; s<sSize; s++ )
+	{
+	    const unsigned char* pixel = &buffer[(t*sSize+s)*4];
+	    const int cs = s-border0.x();
+	    const int ct = t-border0.y();
+
+	    if ( cs>=0 && cs<composite->s() && ct>=0 && ct<composite->t() )
+		interiorOk = interiorOk && !memcmp( pixel, composite->data(cs,ct), 4 );
+	    else
+		borderOk = borderOk && !memcmp( pixel, borderPixel, 4 );
+	}
+    }
+
+    VSGGEO_CHECK( interiorOk );
+    VSGGEO_CHECK( borderOk );
+    VSGGEO_CHECK( !texture->writeCompositeTextureImage(0,border0,border1) );
+}
+
+
+int main( int, char** )
+{
+    testDataLayerCoords();
+    testSharedBrickGeometry();
+    testCopyOnWriteClones();
+    testRescaledImages();
+    testBorderedComposite();
+
+    return nrFailedChecks;
+}
@@ -0,0 +1,155 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/Palette.h>
+
+#include <cmath>
+#include <limits>
+
+using namespace vsgGeo;
+
+
+static bool isEqual( const osg::Vec3& c1, const osg::Vec3& c2 )
+{ return (c1-c2).length() < 1e-5f; }
+
+
+static ColorPointList blackToWhite()
+{
+    ColorPointList cps;
+    cps.push_back( ColorPoint(0.0f,osg::Vec3(0,0,0)) );
+    cps.push_back( ColorPoint(1.0f,osg::Vec3(1,1,1)) );
+    return cps;
+}
+
+
+static void testBakedLUT()
+{
+    Palette palette( blackToWhite() );
+    const std::vector<osg::Vec3>& lut = palette.getLUT();
+    VSGGEO_CHECK( (int)lut.size()==Palette::LUTSize );
+
+    bool linear = true;
+    for ( int idx=0; idx<Palette::LUTSize; idx++ )
+    {
+	const float gray = float(idx) / (Palette::LUTSize-1);
+	linear = linear && isEqual( lut[idx], osg::Vec3(gray,gray,gray) );
+    }
+    VSGGEO_CHECK( linear );
+
+    // Below the second color point, the first segment is extrapolated
+    ColorPointList cps;
+    cps.push_back( ColorPoint(0.25f,osg::Vec3(0.25f,0,0)) );
+    cps.push_back( ColorPoint(0.75f,osg::Vec3(0.75f,0,0)) );
+    palette.setColorPoints( cps );
+    VSGGEO_CHECK( isEqual(palette.getLUT().front(),osg::Vec3(0,0,0)) );
+    VSGGEO_CHECK( isEqual(palette.getLUT().back(),osg::Vec3(0.75f,0,0)) );
+
+    palette.setColorPoints( ColorPointList() );
+    VSGGEO_CHECK( (int)palette.getLUT().size()==Palette::LUTSize );
+    VSGGEO_CHECK( isEqual(palette.getLUT().back(),osg::Vec3(0,0,0)) );
+}
+
+
+static void testLUTIndices()
+{
+    const Palette palette( blackToWhite() );
+    const std::vector<osg::Vec3>& lut = palette.getLUT();
+
+    VSGGEO_CHECK( isEqual(palette.get(10.0f,10.0f,20.0f),lut.front()) );
+    VSGGEO_CHECK( isEqual(palette.get(20.0f,10.0f,20.0f),lut.back()) );
+    VSGGEO_CHECK( isEqual(palette.get(15.0f,10.0f,20.0f),lut[Palette::LUTSize/2]) );
+
+    // Out of range and NaN values are clamped
+    VSGGEO_CHECK( isEqual(palette.get(-1e30f,10.0f,20.0f),lut.front()) );
+    VSGGEO_CHECK( isEqual(palette.get(1e30f,10.0f,20.0f),lut.back()) );
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    VSGGEO_CHECK( isEqual(palette.get(nan,10.0f,20.0f),lut.front()) );
+
+    // Empty range
+    VSGGEO_CHECK( isEqual(palette.get(5.0f,5.0f,5.0f),lut.front()) );
+    VSGGEO_CHECK( isEqual(palette.get(6.0f,5.0f,5.0f),lut.back()) );
+
+    // Inverted range
+    VSGGEO_CHECK( isEqual(palette.get(20.0f,20.0f,10.0f),lut.front()) );
+    VSGGEO_CHECK( isEqual(palette.get(10.0f,20.0f,10.0f),lut.back()) );
+}
+
+
+static void testBatchedLookup()
+{
+    const Palette palette;
+
+    // More than one batch, with a partial last one
+    const int nrValues = 600;
+    std::vector<float> values( nrValues );
+    for ( int idx=0; idx<nrValues; idx++ )
+	values[idx] = -0.1f + 1.2f*idx/(nrValues-1);
+
+    std::vector<osg::Vec3> colors( nrValues );
+    std::vector<osg::Vec4ub> rgba( nrValues );
+    palette.get( &values[0], nrValues, 0.0f, 1.0f, &colors[0] );
+    palette.get( &values[0], nrValues, 0.0f, 1.0f, &rgba[0] );
+
+    bool sameColors = true;
+    bool sameRGBA = true;
+    for ( int idx=0; idx<nrValues; idx++ )
+    {
+	const osg::Vec3 color = palette.get( values[idx], 0.0f, 1.0f );
+	sameColors = sameColors && isEqual( colors[idx], color );
+	sameRGBA = sameRGBA &&
+		   rgba[idx].r()==(unsigned char) (color.x()*255.0f+0.5f) &&
+		   rgba[idx].g()==(unsigned char) (color.y()*255.0f+0.5f) &&
+		   rgba[idx].b()==(unsigned char) (color.z()*255.0f+0.5f) &&
+		   rgba[idx].a()==255;
+    }
+
+    VSGGEO_CHECK( sameColors );
+    VSGGEO_CHECK( sameRGBA );
+}
+
+
+static void testOutOfRangeColors()
+{
+    // Color points beyond [0,1] are clamped, not wrapped around
+    ColorPointList cps;
+    cps.push_back( ColorPoint(0.0f,osg::Vec3(-0.5f,1.5f,0.5f)) );
+    cps.push_back( ColorPoint(1.0f,osg::Vec3(-0.5f,1.5f,0.5f)) );
+    const Palette palette( cps );
+
+    osg::ref_ptr<osg::Image> image = palette.createLUTImage();
+    const unsigned char* ptr = image->data();
+    VSGGEO_CHECK( ptr[0]==0 && ptr[1]==255 && ptr[2]==128 );
+
+    const float value = 0.5f;
+    osg::Vec4ub rgba;
+    palette.get( &value, 1, 0.0f, 1.0f, &rgba );
+    VSGGEO_CHECK( rgba==osg::Vec4ub(0,255,128,255) );
+}
+
+
+int main( int, char** )
+{
+    testBakedLUT();
+    testLUTIndices();
+    testBatchedLookup();
+    testOutOfRangeColors();
+
+    return nrFailedChecks;
+}
@@ -0,0 +1,32 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include <iostream>
+
+/* Minimal checks for the unit tests. Every test program counts its failed
+   checks and returns the count, so that CTest reports it as failed. */
+
+static int nrFailedChecks = 0;
+
+#define VSGGEO_CHECK( cond ) \
+    if ( !(cond) ) \
+    { \
+	std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " \
+		  << #cond << std::endl; \
+	nrFailedChecks++; \
+    }
@@ -0,0 +1,276 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/TexturePanelStrip.h>
+
+#include <cmath>
+
+using namespace vsgGeo;
+
+
+class TestPanelStrip : public TexturePanelStripNode
+{
+public:
+    using TexturePanelStripNode::findPanelIdx;
+    using TexturePanelStripNode::getLocalGeomAtTexOffset;
+
+    void	setTilingPathOffsets(const float* offsets,int nrOffsets)
+		{ _tilingPathOffsets.assign( offsets, offsets+nrOffsets ); }
+
+    const osg::Vec3Array&	getPanelNormals() const	{ return *_panelNormals; }
+    const osg::Vec3Array&	getKnotNormals() const	{ return *_knotNormals; }
+    const std::vector<float>&	getArcLengths() const	{ return _knotArcLengths; }
+};
+
+
+static bool isEqual( const osg::Vec2& v1, const osg::Vec2& v2 )
+{ return (v1-v2).length() < 1e-5f; }
+
+
+static bool isEqual( const osg::Vec3& v1, const osg::Vec3& v2 )
+{ return (v1-v2).length() < 1e-5f; }
+
+
+static bool isEqual( const osg::Vec3Array& arr1, const osg::Vec3Array& arr2 )
+{
+    if ( arr1.size()!=arr2.size() )
+	return false;
+
+    for ( unsigned int idx=0; idx<arr1.size(); idx++ )
+    {
+	if ( !isEqual(arr1[idx],arr2[idx]) )
+	    return false;
+    }
+
+    return true;
+}
+
+
+// Straight path along the x-axis with knots at 0, 1, 3 and 6
+
+static osg::ref_ptr<TestPanelStrip> createStraightStrip( const float* offsets )
+{
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    path->push_back( osg::Vec2(0.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+    path->push_back( osg::Vec2(3.0f,0.0f) );
+    path->push_back( osg::Vec2(6.0f,0.0f) );
+
+    osg::ref_ptr<TestPanelStrip> strip = new TestPanelStrip;
+    strip->setPath( *path );
+    strip->setTilingPathOffsets( offsets, 4 );
+    return strip;
+}
+
+
+static std::vector<int> getIdxs( int a, int b, int c=-1, int d=-1 )
+{
+    std::vector<int> idxs;
+    idxs.push_back( a );
+    idxs.push_back( b );
+    if ( c>=0 ) idxs.push_back( c );
+    if ( d>=0 ) idxs.push_back( d );
+    return idxs;
+}
+
+
+static void testStraightPath()
+{
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    for ( int idx=0; idx<5; idx++ )
+	path->push_back( osg::Vec2(idx,2*idx) );
+
+    std::vector<int> retained;
+    TexturePanelStripNode::simplifyPath( *path, 0.0f, retained );
+    VSGGEO_CHECK( retained==getIdxs(0,4) );
+
+    path->resize( 1 );
+    TexturePanelStripNode::simplifyPath( *path, 1.0f, retained );
+    VSGGEO_CHECK( retained.empty() );
+}
+
+
+static void testTolerance()
+{
+    // Zig-zag with an amplitude of 0.1, except 0.5 at its third knot
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    path->push_back( osg::Vec2(0.0f, 0.0f) );
+    path->push_back( osg::Vec2(1.0f, 0.1f) );
+    path->push_back( osg::Vec2(2.0f,-0.5f) );
+    path->push_back( osg::Vec2(3.0f, 0.1f) );
+    path->push_back( osg::Vec2(4.0f, 0.0f) );
+
+    std::vector<int> retained;
+    TexturePanelStripNode::simplifyPath( *path, 0.05f, retained );
+    VSGGEO_CHECK( retained.size()==5 );
+
+    TexturePanelStripNode::simplifyPath( *path, 0.4f, retained );
+    VSGGEO_CHECK( retained==getIdxs(0,2,4) );
+
+    TexturePanelStripNode::simplifyPath( *path, 1.0f, retained );
+    VSGGEO_CHECK( retained==getIdxs(0,4) );
+}
+
+
+static void testFoldedPath()
+{
+    /* The middle knot lies on the line through the end knots, but far
+       beyond them. Dropping it would cut off the fold. */
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    path->push_back( osg::Vec2(0.0f,0.0f) );
+    path->push_back( osg::Vec2(3.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+
+    std::vector<int> retained;
+    TexturePanelStripNode::simplifyPath( *path, 0.5f, retained );
+    VSGGEO_CHECK( retained==getIdxs(0,1,2) );
+}
+
+
+static void testPanelLookup()
+{
+    const float offsets[4] = { 0.0f, 10.0f, 30.0f, 60.0f };
+    osg::ref_ptr<TestPanelStrip> strip = createStraightStrip( offsets );
+
+    VSGGEO_CHECK( strip->findPanelIdx(5.0f)==0 );
+    VSGGEO_CHECK( strip->findPanelIdx(10.0f)==1 );
+    VSGGEO_CHECK( strip->findPanelIdx(59.0f)==2 );
+
+    // Offsets beyond the path are clamped to its first or last panel
+    VSGGEO_CHECK( strip->findPanelIdx(-3.0f)==0 );
+    VSGGEO_CHECK( strip->findPanelIdx(60.0f)==2 );
+    VSGGEO_CHECK( strip->findPanelIdx(100.0f)==2 );
+
+    // Guesses are only used if they bracket the offset
+    VSGGEO_CHECK( strip->findPanelIdx(15.0f,1)==1 );
+    VSGGEO_CHECK( strip->findPanelIdx(45.0f,0)==2 );
+    VSGGEO_CHECK( strip->findPanelIdx(-3.0f,0)==0 );
+    VSGGEO_CHECK( strip->findPanelIdx(5.0f,7)==0 );
+
+    osg::Vec2 coord;
+    osg::Vec3 normal;
+    VSGGEO_CHECK( strip->getLocalGeomAtTexOffset(coord,normal,20.0f) );
+    VSGGEO_CHECK( isEqual(coord,osg::Vec2(2.0f,0.0f)) );
+    VSGGEO_CHECK( fabs(normal*osg::Vec3(0.0f,1.0f,0.0f)-1.0f)<1e-5f );
+
+    VSGGEO_CHECK( strip->getLocalGeomAtTexOffset(coord,normal,45.0f,0) );
+    VSGGEO_CHECK( isEqual(coord,osg::Vec2(4.5f,0.0f)) );
+
+    osg::ref_ptr<TestPanelStrip> emptyStrip = new TestPanelStrip;
+    VSGGEO_CHECK( emptyStrip->findPanelIdx(5.0f)==-1 );
+    VSGGEO_CHECK( !emptyStrip->getLocalGeomAtTexOffset(coord,normal,5.0f) );
+}
+
+
+static void testRepeatedOffsets()
+{
+    // Texture column 10 is mapped on both the second and third knot
+    const float offsets[4] = { 0.0f, 10.0f, 10.0f, 60.0f };
+    osg::ref_ptr<TestPanelStrip> strip = createStraightStrip( offsets );
+
+    VSGGEO_CHECK( strip->findPanelIdx(10.0f)==2 );
+
+    osg::Vec2 coord;
+    osg::Vec3 normal;
+    VSGGEO_CHECK( strip->getLocalGeomAtTexOffset(coord,normal,10.0f) );
+    VSGGEO_CHECK( isEqual(coord,osg::Vec2(3.0f,0.0f)) );
+
+    VSGGEO_CHECK( strip->getLocalGeomAtTexOffset(coord,normal,5.0f) );
+    VSGGEO_CHECK( isEqual(coord,osg::Vec2(0.5f,0.0f)) );
+}
+
+
+static void testNormals()
+{
+    // Turns left at the second knot, which is repeated
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    path->push_back( osg::Vec2(0.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,1.0f) );
+    path->push_back( osg::Vec2(1.0f,3.0f) );
+
+    osg::ref_ptr<TestPanelStrip> strip = new TestPanelStrip;
+    strip->setPath( *path );
+
+    const osg::Vec3 north( 0.0f, 1.0f, 0.0f );
+    const osg::Vec3 west( -1.0f, 0.0f, 0.0f );
+    const osg::Vec3 northWest = (north+west) / sqrt(2.0f);
+
+    const osg::Vec3Array& panelNormals = strip->getPanelNormals();
+    VSGGEO_CHECK( panelNormals.size()==4 );
+    VSGGEO_CHECK( isEqual(panelNormals[0],north) );
+    VSGGEO_CHECK( isEqual(panelNormals[1],northWest) );
+    VSGGEO_CHECK( isEqual(panelNormals[2],west) );
+    VSGGEO_CHECK( isEqual(panelNormals[3],west) );
+
+    // Zero-width panels are skipped when averaging at knots
+    const osg::Vec3Array& knotNormals = strip->getKnotNormals();
+    VSGGEO_CHECK( knotNormals.size()==5 );
+    VSGGEO_CHECK( isEqual(knotNormals[0],north) );
+    VSGGEO_CHECK( isEqual(knotNormals[1],northWest) );
+    VSGGEO_CHECK( isEqual(knotNormals[2],northWest) );
+    VSGGEO_CHECK( isEqual(knotNormals[3],west) );
+    VSGGEO_CHECK( isEqual(knotNormals[4],west) );
+
+    const std::vector<float>& arcLengths = strip->getArcLengths();
+    const float expected[5] = { 0.0f, 1.0f, 1.0f, 2.0f, 4.0f };
+    VSGGEO_CHECK( arcLengths.size()==5 );
+    for ( unsigned int idx=0; idx<arcLengths.size() && idx<5; idx++ )
+	VSGGEO_CHECK( fabs(arcLengths[idx]-expected[idx])<1e-5f );
+}
+
+
+static void testAppendedKnots()
+{
+    osg::ref_ptr<osg::Vec2Array> path = new osg::Vec2Array;
+    path->push_back( osg::Vec2(0.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+    path->push_back( osg::Vec2(1.0f,0.0f) );
+
+    // Appending knots only recomputes the tail, which must match
+    osg::ref_ptr<TestPanelStrip> appended = new TestPanelStrip;
+    appended->setPath( *path );
+
+    path->push_back( osg::Vec2(1.0f,1.0f) );
+    path->push_back( osg::Vec2(3.0f,2.0f) );
+    appended->setPath( *path );
+
+    osg::ref_ptr<TestPanelStrip> full = new TestPanelStrip;
+    full->setPath( *path );
+
+    VSGGEO_CHECK( isEqual(appended->getPanelNormals(),full->getPanelNormals()) );
+    VSGGEO_CHECK( isEqual(appended->getKnotNormals(),full->getKnotNormals()) );
+    VSGGEO_CHECK( appended->getArcLengths()==full->getArcLengths() );
+}
+
+
+int main( int, char** )
+{
+    testStraightPath();
+    testTolerance();
+    testFoldedPath();
+    testPanelLookup();
+    testRepeatedOffsets();
+    testNormals();
+    testAppendedKnots();
+
+    return nrFailedChecks;
+}
@@ -0,0 +1,199 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/GridMeshBuilder.h>
+#include <vsgGeo/LayeredTexture.h>
+#include <vsgGeo/TexturePlane.h>
+
+#include <osgUtil/UpdateVisitor>
+
+using namespace vsgGeo;
+
+
+static osg::ref_ptr<LayeredTexture> createTexture()
+{
+    osg::ref_ptr<LayeredTexture> texture = new LayeredTexture;
+    const int id = texture->addDataLayer();
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage( 64, 64, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    texture->setDataLayerImage( id, image.get() );
+    return texture;
+}
+
+
+static void update( TexturePlaneNode& plane )
+{
+    osg::ref_ptr<osgUtil::UpdateVisitor> uv = new osgUtil::UpdateVisitor;
+    plane.accept( *uv );
+}
+
+
+// Horizontal plane of 10 by 20, tiled in bricks of 16 texels
+
+static osg::ref_ptr<TexturePlaneNode> createPlane( LayeredTexture* texture )
+{
+    osg::ref_ptr<TexturePlaneNode> plane = new TexturePlaneNode;
+    plane->setLayeredTexture( texture );
+    plane->setTextureBrickSize( 16, true );
+    plane->setCenter( osg::Vec3(0.0f,0.0f,0.0f) );
+    plane->setWidth( osg::Vec3(10.0f,20.0f,0.0f) );
+    update( *plane );
+    return plane;
+}
+
+
+static const osg::Vec3Array* getVertices( osg::Geometry* geometry )
+{ return dynamic_cast<const osg::Vec3Array*>( geometry->getVertexArray() ); }
+
+
+static void testBrickOrder()
+{
+    osg::ref_ptr<LayeredTexture> texture = createTexture();
+    osg::ref_ptr<TexturePlaneNode> plane1 = createPlane( texture.get() );
+    osg::ref_ptr<TexturePlaneNode> plane2 = createPlane( texture.get() );
+
+    // Bricks built in parallel are merged in the same order every time
+    std::vector<osg::Geometry*>& geometries1 = plane1->getGeometries();
+    std::vector<osg::Geometry*>& geometries2 = plane2->getGeometries();
+    VSGGEO_CHECK( geometries1.size()>1 );
+    VSGGEO_CHECK( geometries1.size()==geometries2.size() );
+
+    osg::BoundingBox bb;
+    for ( unsigned int idx=0; idx<geometries1.size() && idx<geometries2.size(); idx++ )
+    {
+	const osg::Vec3Array* vertices1 = getVertices( geometries1[idx] );
+	const osg::Vec3Array* vertices2 = getVertices( geometries2[idx] );
+	VSGGEO_CHECK( vertices1 && vertices2 );
+	if ( !vertices1 || !vertices2 )
+	    continue;
+
+	VSGGEO_CHECK( vertices1->asVector()==vertices2->asVector() );
+	for ( unsigned int vidx=0; vidx<vertices1->size(); vidx++ )
+	    bb.expandBy( (*vertices1)[vidx] );
+    }
+
+    // Together the bricks cover the plane
+    VSGGEO_CHECK( (bb._min-osg::Vec3(-5.0f,-10.0f,0.0f)).length()<1e-4f );
+    VSGGEO_CHECK( (bb._max-osg::Vec3(5.0f,10.0f,0.0f)).length()<1e-4f );
+}
+
+
+static void testMoveInPlace()
+{
+    osg::ref_ptr<LayeredTexture> texture = createTexture();
+    osg::ref_ptr<TexturePlaneNode> plane = createPlane( texture.get() );
+
+    const std::vector<osg::Geometry*> oldGeometries = plane->getGeometries();
+    std::vector<std::vector<osg::Vec3> > oldVertices;
+    for ( unsigned int idx=0; idx<oldGeometries.size(); idx++ )
+    {
+	const osg::Vec3Array* vertices = getVertices( oldGeometries[idx] );
+	oldVertices.push_back( vertices ? vertices->asVector() : std::vector<osg::Vec3>() );
+    }
+
+    // Geometry-only changes move the bricks instead of re-tiling
+    const osg::Vec3 shift( 1.0f, 2.0f, 3.0f );
+    plane->setCenter( shift );
+    update( *plane );
+
+    const std::vector<osg::Geometry*>& geometries = plane->getGeometries();
+    VSGGEO_CHECK( geometries==oldGeometries );
+
+    float maxError = 0.0f;
+    for ( unsigned int idx=0; idx<geometries.size() && idx<oldVertices.size(); idx++ )
+    {
+	const osg::Vec3Array* vertices = getVertices( geometries[idx] );
+	VSGGEO_CHECK( vertices && vertices->size()==oldVertices[idx].size() );
+	for ( unsigned int vidx=0; vertices && vidx<vertices->size() && vidx<oldVertices[idx].size(); vidx++ )
+	    maxError = osg::maximum( maxError, ((*vertices)[vidx]-oldVertices[idx][vidx]-shift).length() );
+    }
+    VSGGEO_CHECK( maxError<1e-5f );
+
+    // Changing the texel aspect ratio re-tiles, still covering the plane
+    plane->setWidth( osg::Vec3(10.0f,40.0f,0.0f) );
+    update( *plane );
+
+    osg::BoundingBox bb;
+    for ( unsigned int idx=0; idx<plane->getGeometries().size(); idx++ )
+	bb.expandBy( plane->getGeometries()[idx]->getBoundingBox() );
+
+    VSGGEO_CHECK( (bb._min-osg::Vec3(-5.0f,-20.0f,0.0f)-shift).length()<1e-4f );
+    VSGGEO_CHECK( (bb._max-osg::Vec3(5.0f,20.0f,0.0f)-shift).length()<1e-4f );
+}
+
+
+static void testMergedBrickQuads()
+{
+    osg::ref_ptr<LayeredTexture> texture = createTexture();
+    osg::ref_ptr<TexturePlaneNode> quadPlane = createPlane( texture.get() );
+    quadPlane->setQuadsPerBrickSide( 4 );
+    update( *quadPlane );
+
+    osg::ref_ptr<TexturePlaneNode> meshPlane = createPlane( texture.get() );
+    meshPlane->setQuadsPerBrickSide( 4 );
+    meshPlane->mergeBrickQuads( true );
+    update( *meshPlane );
+
+    // One indexed mesh per brick instead of one geometry per sub-quad
+    const std::vector<osg::Geometry*>& quads = quadPlane->getGeometries();
+    const std::vector<osg::Geometry*>& meshes = meshPlane->getGeometries();
+    VSGGEO_CHECK( !meshes.empty() && meshes.size()*16==quads.size() );
+
+    osg::BoundingBox quadBox, meshBox;
+    for ( unsigned int idx=0; idx<quads.size(); idx++ )
+	quadBox.expandBy( quads[idx]->getBoundingBox() );
+
+    for ( unsigned int idx=0; idx<meshes.size(); idx++ )
+    {
+	meshBox.expandBy( meshes[idx]->getBoundingBox() );
+
+	const osg::Vec3Array* vertices = getVertices( meshes[idx] );
+	VSGGEO_CHECK( vertices && vertices->size()==25 );
+	VSGGEO_CHECK( meshes[idx]->getNumPrimitiveSets()==1 );
+
+	const osg::DrawElementsUInt* strips = dynamic_cast<const osg::DrawElementsUInt*>( meshes[idx]->getPrimitiveSet(0) );
+	VSGGEO_CHECK( strips && strips->getMode()==GL_TRIANGLE_STRIP );
+	if ( !strips || !vertices )
+	    continue;
+
+	// Indices beyond the vertices can only be strip restarts
+	bool indicesOk = true;
+	for ( unsigned int iidx=0; iidx<strips->size(); iidx++ )
+	{
+	    const unsigned int index = (*strips)[iidx];
+	    indicesOk = indicesOk && ( index<vertices->size() ||
+		index==GridMeshBuilder::getRestartIndex(osg::PrimitiveSet::DrawElementsUIntPrimitiveType) );
+	}
+	VSGGEO_CHECK( indicesOk );
+    }
+
+    VSGGEO_CHECK( (meshBox._min-quadBox._min).length()<1e-4f );
+    VSGGEO_CHECK( (meshBox._max-quadBox._max).length()<1e-4f );
+}
+
+
+int main( int, char** )
+{
+    testBrickOrder();
+    testMoveInPlace();
+    testMergedBrickQuads();
+
+    return nrFailedChecks;
+}
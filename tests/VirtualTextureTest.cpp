@@ -0,0 +1,191 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/LayeredTexture.h>
+#include <vsgGeo/VirtualTexture.h>
+
+using namespace vsgGeo;
+
+
+static bool isLoaded( const std::vector<VirtualTextureAtlas::PageLoad>& loads, const void* owner, const Vec2i& pageNr )
+{
+    for ( unsigned int idx=0; idx<loads.size(); idx++ )
+    {
+	if ( loads[idx]._owner==owner && loads[idx]._pageNr==pageNr )
+	    return true;
+    }
+
+    return false;
+}
+
+
+static void loadRequestedPages( VirtualTextureAtlas& vta, const void* owner, std::vector<VirtualTextureAtlas::PageLoad>& loads )
+{
+    vta.assignRequestedPages( owner, loads );
+    vta.commitPages( loads );
+}
+
+
+static void testBudgetClamping()
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta = new VirtualTextureAtlas( 8, 40 );
+    VSGGEO_CHECK( vta->nrSlots()==16 );
+    VSGGEO_CHECK( vta->getPageBudget()==16 );
+
+    vta->setPageBudget( 0 );
+    VSGGEO_CHECK( vta->getPageBudget()==1 );
+    vta->setPageBudget( 1000 );
+    VSGGEO_CHECK( vta->getPageBudget()==16 );
+}
+
+
+static void testLeastRecentlyRequestedEviction()
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta = new VirtualTextureAtlas( 8, 40 );
+    vta->setPageBudget( 2 );
+
+    const int owner = 0;
+    vta->setPageGrid( &owner, 0, Vec2i(32,8) );
+    VSGGEO_CHECK( vta->getPageGridSize(&owner,0)==Vec2i(4,1) );
+
+    std::vector<VirtualTextureAtlas::PageLoad> loads;
+
+    VSGGEO_CHECK( !vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(1,0)) );
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( loads.size()==2 );
+
+    // Page 1 is requested again, so page 0 becomes least recent
+    VSGGEO_CHECK( vta->requestPages(&owner,0,Vec2i(1,0),Vec2i(1,0)) );
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( loads.empty() );
+
+    VSGGEO_CHECK( !vta->requestPages(&owner,0,Vec2i(2,0),Vec2i(2,0)) );
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( loads.size()==1 && isLoaded(loads,&owner,Vec2i(2,0)) );
+
+    VSGGEO_CHECK( vta->requestPages(&owner,0,Vec2i(1,0),Vec2i(2,0)) );
+    VSGGEO_CHECK( !vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(0,0)) );
+}
+
+
+static void testRequestedPagesStayResident()
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta = new VirtualTextureAtlas( 8, 40 );
+    vta->setPageBudget( 2 );
+
+    const int owner = 0;
+    vta->setPageGrid( &owner, 0, Vec2i(32,8) );
+
+    std::vector<VirtualTextureAtlas::PageLoad> loads;
+    vta->requestPages( &owner, 0, Vec2i(0,0), Vec2i(1,0) );
+    loadRequestedPages( *vta, &owner, loads );
+
+    // More visible pages than budget: the ones requested now are kept
+    VSGGEO_CHECK( !vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(3,0)) );
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( loads.empty() );
+    VSGGEO_CHECK( vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(1,0)) );
+}
+
+
+static void testOneRoundForAllOwners()
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta = new VirtualTextureAtlas( 8, 40 );
+    vta->setPageBudget( 1 );
+
+    const int owner1 = 0, owner2 = 0;
+    vta->setPageGrid( &owner1, 0, Vec2i(8,8) );
+    vta->setPageGrid( &owner2, 0, Vec2i(8,8) );
+
+    std::vector<VirtualTextureAtlas::PageLoad> loads;
+    vta->requestPages( &owner1, 0, Vec2i(0,0), Vec2i(0,0) );
+    loadRequestedPages( *vta, &owner1, loads );
+    VSGGEO_CHECK( loads.size()==1 );
+
+    /* Both owners request in the same frame. Assigning the pages of the
+       first owner must not end the round, or the page the first owner
+       just requested could be evicted for the second one. */
+    VSGGEO_CHECK( vta->requestPages(&owner1,0,Vec2i(0,0),Vec2i(0,0)) );
+    VSGGEO_CHECK( !vta->requestPages(&owner2,0,Vec2i(0,0),Vec2i(0,0)) );
+    loadRequestedPages( *vta, &owner1, loads );
+    VSGGEO_CHECK( loads.empty() );
+    loadRequestedPages( *vta, &owner2, loads );
+    VSGGEO_CHECK( loads.empty() );
+
+    VSGGEO_CHECK( vta->requestPages(&owner1,0,Vec2i(0,0),Vec2i(0,0)) );
+}
+
+
+static void testInvalidation()
+{
+    osg::ref_ptr<VirtualTextureAtlas> vta = new VirtualTextureAtlas( 8, 40 );
+
+    const int owner = 0;
+    vta->setPageGrid( &owner, 0, Vec2i(16,16) );
+
+    std::vector<VirtualTextureAtlas::PageLoad> loads;
+    vta->requestPages( &owner, 0, Vec2i(0,0), Vec2i(1,1) );
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( loads.size()==4 );
+    VSGGEO_CHECK( vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(1,1)) );
+
+    vta->invalidatePages( &owner, 0 );
+    VSGGEO_CHECK( !vta->requestPages(&owner,0,Vec2i(0,0),Vec2i(0,0)) );
+
+    // Pages beyond the grid are clipped, unknown grids need no pages
+    loadRequestedPages( *vta, &owner, loads );
+    VSGGEO_CHECK( vta->requestPages(&owner,0,Vec2i(-1,-1),Vec2i(0,0)) );
+    VSGGEO_CHECK( vta->requestPages(&owner,1,Vec2i(0,0),Vec2i(0,0)) );
+}
+
+
+// Exposes the texture units left for data layers
+
+class UnitsLayeredTexture : public LayeredTexture
+{
+public:
+    using LayeredTexture::nrUsableTextureUnits;
+};
+
+
+static void testAtlasUnitNeedsShaders()
+{
+    osg::ref_ptr<UnitsLayeredTexture> texture = new UnitsLayeredTexture;
+    texture->allowShaders( false );
+    const int nrUnits = texture->nrUsableTextureUnits();
+
+    // Fixed-function rendering keeps all units, as it never samples the atlas
+    texture->setVirtualTextureAtlas( new VirtualTextureAtlas(8,40) );
+    VSGGEO_CHECK( !texture->isVirtualTexturingEnabled() );
+    VSGGEO_CHECK( texture->nrUsableTextureUnits()==nrUnits );
+}
+
+
+int main( int, char** )
+{
+    testBudgetClamping();
+    testLeastRecentlyRequestedEviction();
+    testRequestedPagesStayResident();
+    testOneRoundForAllOwners();
+    testInvalidation();
+    testAtlasUnitNeedsShaders();
+
+    return nrFailedChecks;
+}
@@ -0,0 +1,124 @@
+/* vsgGeo - A collection of geoscientific extensions to VulkanSceneGraph.
+Copyright 2025 dGB Beheer B.V.
+
+vsgGeo is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+#include "Testing.h"
+
+#include <vsgGeo/VolumeTextureCache.h>
+
+using namespace vsgGeo;
+
+
+// Volume of exactly one megabyte
+
+static osg::ref_ptr<osg::Image> createVolume()
+{
+    osg::ref_ptr<osg::Image> volume = new osg::Image;
+    volume->allocateImage( 128, 128, 64, GL_LUMINANCE, GL_UNSIGNED_BYTE );
+    return volume;
+}
+
+
+static void testSharedTextures()
+{
+    osg::ref_ptr<VolumeTextureCache> cache = new VolumeTextureCache;
+    osg::ref_ptr<osg::Image> volume = createVolume();
+    const osg::Vec4f black( 0.0f, 0.0f, 0.0f, 1.0f );
+
+    osg::ref_ptr<osg::Texture3D> texture = cache->getTexture( volume.get(), osg::Texture::LINEAR, black );
+    VSGGEO_CHECK( texture.valid() && texture->getImage()==volume.get() );
+    VSGGEO_CHECK( cache->getTexture(volume.get(),osg::Texture::LINEAR,black)==texture );
+    VSGGEO_CHECK( cache->getMemoryUsage()==1 );
+
+    // Other sampling settings need a texture of their own
+    osg::ref_ptr<osg::Texture3D> nearest = cache->getTexture( volume.get(), osg::Texture::NEAREST, black );
+    VSGGEO_CHECK( nearest.valid() && nearest!=texture );
+    VSGGEO_CHECK( cache->getMemoryUsage()==2 );
+
+    // All negative border colors clamp to edge
+    osg::ref_ptr<osg::Texture3D> clamped = cache->getTexture( volume.get(), osg::Texture::LINEAR, osg::Vec4f(-1.0f,0.0f,0.0f,0.0f) );
+    VSGGEO_CHECK( clamped!=texture );
+    VSGGEO_CHECK( clamped->getWrap(osg::Texture::WRAP_R)==osg::Texture::CLAMP_TO_EDGE );
+    VSGGEO_CHECK( cache->getTexture(volume.get(),osg::Texture::LINEAR,osg::Vec4f(-2.0f,1.0f,1.0f,1.0f))==clamped );
+
+    osg::ref_ptr<osg::Image> empty = new osg::Image;
+    VSGGEO_CHECK( !cache->getTexture(empty.get(),osg::Texture::LINEAR,black) );
+    VSGGEO_CHECK( !cache->getTexture(0,osg::Texture::LINEAR,black) );
+}
+
+
+static void testBudgetEviction()
+{
+    osg::ref_ptr<VolumeTextureCache> cache = new VolumeTextureCache( 2 );
+    osg::ref_ptr<osg::Image> volume1 = createVolume();
+    osg::ref_ptr<osg::Image> volume2 = createVolume();
+    osg::ref_ptr<osg::Image> volume3 = createVolume();
+    const osg::Vec4f border( -1.0f, -1.0f, -1.0f, -1.0f );
+
+    cache->getTexture( volume1.get(), osg::Texture::LINEAR, border );
+    osg::ref_ptr<osg::Texture3D> bound = cache->getTexture( volume2.get(), osg::Texture::LINEAR, border );
+    VSGGEO_CHECK( cache->getMemoryUsage()==2 );
+
+    // Least recently used unbound volume goes first
+    osg::ref_ptr<osg::Texture3D> latest = cache->getTexture( volume3.get(), osg::Texture::LINEAR, border );
+    VSGGEO_CHECK( cache->getMemoryUsage()==2 );
+    VSGGEO_CHECK( cache->getTexture(volume2.get(),osg::Texture::LINEAR,border)==bound );
+    VSGGEO_CHECK( cache->getTexture(volume3.get(),osg::Texture::LINEAR,border)==latest );
+
+    // Bound textures stay, even beyond budget
+    cache->setMemoryBudget( 0 );
+    VSGGEO_CHECK( cache->getMemoryUsage()==2 );
+
+    latest = 0;
+    cache->setMemoryBudget( 0 );
+    VSGGEO_CHECK( cache->getMemoryUsage()==1 );
+}
+
+
+static void testRelease()
+{
+    osg::ref_ptr<VolumeTextureCache> cache = new VolumeTextureCache;
+    osg::ref_ptr<osg::Image> volume1 = createVolume();
+    osg::ref_ptr<osg::Image> volume2 = createVolume();
+    const osg::Vec4f border( -1.0f, -1.0f, -1.0f, -1.0f );
+
+    osg::ref_ptr<osg::Texture3D> bound = cache->getTexture( volume1.get(), osg::Texture::LINEAR, border );
+    cache->getTexture( volume1.get(), osg::Texture::NEAREST, border );
+    cache->getTexture( volume2.get(), osg::Texture::LINEAR, border );
+    VSGGEO_CHECK( cache->getMemoryUsage()==3 );
+
+    cache->removeVolume( volume1.get() );
+    VSGGEO_CHECK( cache->getMemoryUsage()==2 );
+
+    cache->releaseUnused();
+    VSGGEO_CHECK( cache->getMemoryUsage()==1 );
+    VSGGEO_CHECK( cache->getTexture(volume1.get(),osg::Texture::LINEAR,border)==bound );
+
+    bound = 0;
+    cache->releaseUnused();
+    VSGGEO_CHECK( !cache->getMemoryUsage() );
+}
+
+
+int main( int, char** )
+{
+    testSharedTextures();
+    testBudgetEviction();
+    testRelease();
+
+    return nrFailedChecks;
+}